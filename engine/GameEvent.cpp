@@ -0,0 +1,390 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Game event values, see CGameEvent in GameEventManager.h
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "GameEventManager.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+DEFINE_FIXEDSIZE_ALLOCATOR_MT( CGameEvent, 64, CUtlMemoryPool::GROW_SLOW );
+
+int CGameEventDescriptor::FindKey( const char *keyName ) const
+{
+	if ( !keyName )
+		return -1;
+
+	// KeyValues key names are case insensitive, keep it that way
+	for ( int i = 0; i < keytable.Count(); i++ )
+	{
+		if ( !Q_stricmp( keytable[i].name, keyName ) )
+			return i;
+	}
+
+	return -1;
+}
+
+void CGameEventDescriptor::CompileKeys()
+{
+	keytable.RemoveAll();
+
+	if ( !keys )
+		return;
+
+	for ( KeyValues *key = keys->GetFirstSubKey(); key; key = key->GetNextKey() )
+	{
+		CGameEventKey &slot = keytable[ keytable.AddToTail() ];
+		slot.name = key->GetName();
+		slot.type = key->GetInt();
+	}
+}
+
+CGameEvent::CGameEvent( CGameEventDescriptor *descriptor )
+{
+	Assert( descriptor );
+	m_pDescriptor = descriptor;
+	m_nSlots = MIN( descriptor->keytable.Count(), MAX_EVENT_KEY_SLOTS );
+	m_pExtraKeys = NULL;
+	m_pDataKeys = NULL;
+	m_pNumberStrings = NULL;
+
+	for ( int i = 0; i < m_nSlots; i++ )
+	{
+		m_Values[i].m_nType = VALUE_EMPTY;
+	}
+}
+
+CGameEvent::~CGameEvent()
+{
+	if ( m_pExtraKeys )
+		m_pExtraKeys->deleteThis();
+
+	if ( m_pDataKeys )
+		m_pDataKeys->deleteThis();
+
+	delete [] m_pNumberStrings;
+}
+
+int CGameEvent::GetSlot( const char *keyName ) const
+{
+	int iSlot = m_pDescriptor->FindKey( keyName );
+	return ( iSlot < m_nSlots ) ? iSlot : -1;
+}
+
+KeyValues *CGameEvent::GetExtraKeys()
+{
+	if ( !m_pExtraKeys )
+	{
+		m_pExtraKeys = new KeyValues( m_pDescriptor->name );
+	}
+	return m_pExtraKeys;
+}
+
+int CGameEvent::AddString( const char *value )
+{
+	int nLen = Q_strlen( value ) + 1;
+
+	// the value may be one of our own strings, which can move when the storage grows
+	int nSource = -1;
+	if ( value >= m_Strings.Base() && value < m_Strings.Base() + m_Strings.Count() )
+	{
+		nSource = value - m_Strings.Base();
+	}
+
+	int nOffset = m_Strings.AddMultipleToTail( nLen );
+	Q_memmove( m_Strings.Base() + nOffset, ( nSource >= 0 ) ? m_Strings.Base() + nSource : value, nLen );
+	return nOffset;
+}
+
+bool CGameEvent::IsEmpty( int iSlot ) const
+{
+	Assert( iSlot >= 0 && iSlot < m_nSlots );
+	return m_Values[iSlot].m_nType == VALUE_EMPTY;
+}
+
+// Conversions between value types work like they do in KeyValues
+
+int CGameEvent::GetInt( int iSlot, int defaultValue )
+{
+	Assert( iSlot >= 0 && iSlot < m_nSlots );
+	const EventValue_t &value = m_Values[iSlot];
+
+	switch ( value.m_nType )
+	{
+	case VALUE_INT		: return value.m_nValue;
+	case VALUE_FLOAT	: return (int)value.m_flValue;
+	case VALUE_STRING	: return Q_atoi( m_Strings.Base() + value.m_nString );
+	default				: return defaultValue;
+	}
+}
+
+float CGameEvent::GetFloat( int iSlot, float defaultValue )
+{
+	Assert( iSlot >= 0 && iSlot < m_nSlots );
+	const EventValue_t &value = m_Values[iSlot];
+
+	switch ( value.m_nType )
+	{
+	case VALUE_INT		: return (float)value.m_nValue;
+	case VALUE_FLOAT	: return value.m_flValue;
+	case VALUE_STRING	: return (float)Q_atof( m_Strings.Base() + value.m_nString );
+	default				: return defaultValue;
+	}
+}
+
+const char *CGameEvent::GetString( int iSlot, const char *defaultValue )
+{
+	Assert( iSlot >= 0 && iSlot < m_nSlots );
+	const EventValue_t &value = m_Values[iSlot];
+
+	if ( value.m_nType == VALUE_STRING )
+		return m_Strings.Base() + value.m_nString;
+
+	if ( value.m_nType != VALUE_INT && value.m_nType != VALUE_FLOAT )
+		return defaultValue;
+
+	// Numbers go to a fixed buffer per slot, adding them to m_Strings could move the
+	// strings callers still hold
+	if ( !m_pNumberStrings )
+	{
+		m_pNumberStrings = new char[ m_nSlots * EVENT_NUMBER_STRING_BYTES ];
+	}
+
+	char *pszNumber = m_pNumberStrings + iSlot * EVENT_NUMBER_STRING_BYTES;
+	if ( value.m_nType == VALUE_INT )
+	{
+		Q_snprintf( pszNumber, EVENT_NUMBER_STRING_BYTES, "%d", value.m_nValue );
+	}
+	else
+	{
+		Q_snprintf( pszNumber, EVENT_NUMBER_STRING_BYTES, "%f", value.m_flValue );
+	}
+	return pszNumber;
+}
+
+void CGameEvent::SetInt( int iSlot, int value )
+{
+	Assert( iSlot >= 0 && iSlot < m_nSlots );
+	m_Values[iSlot].m_nType = VALUE_INT;
+	m_Values[iSlot].m_nValue = value;
+
+	if ( m_pDataKeys )
+		m_pDataKeys->SetInt( m_pDescriptor->keytable[iSlot].name, value );
+}
+
+void CGameEvent::SetFloat( int iSlot, float value )
+{
+	Assert( iSlot >= 0 && iSlot < m_nSlots );
+	m_Values[iSlot].m_nType = VALUE_FLOAT;
+	m_Values[iSlot].m_flValue = value;
+
+	if ( m_pDataKeys )
+		m_pDataKeys->SetFloat( m_pDescriptor->keytable[iSlot].name, value );
+}
+
+void CGameEvent::SetString( int iSlot, const char *value )
+{
+	Assert( iSlot >= 0 && iSlot < m_nSlots );
+	EventValue_t &slot = m_Values[iSlot];
+
+	if ( !value )
+		value = "";
+
+	// reuse the old string's space if the new one fits
+	int nLen = Q_strlen( value );
+	if ( slot.m_nType == VALUE_STRING && nLen <= Q_strlen( m_Strings.Base() + slot.m_nString ) )
+	{
+		Q_memmove( m_Strings.Base() + slot.m_nString, value, nLen + 1 );
+	}
+	else
+	{
+		slot.m_nString = AddString( value );
+		slot.m_nType = VALUE_STRING;
+	}
+
+	if ( m_pDataKeys )
+		m_pDataKeys->SetString( m_pDescriptor->keytable[iSlot].name, value );
+}
+
+bool CGameEvent::GetBool( const char *keyName, bool defaultValue)
+{
+	return GetInt( keyName, defaultValue ) != 0;
+}
+
+int CGameEvent::GetInt( const char *keyName, int defaultValue)
+{
+	int iSlot = GetSlot( keyName );
+	if ( iSlot >= 0 )
+		return GetInt( iSlot, defaultValue );
+
+	return m_pExtraKeys ? m_pExtraKeys->GetInt( keyName, defaultValue ) : defaultValue;
+}
+
+float CGameEvent::GetFloat( const char *keyName, float defaultValue )
+{
+	int iSlot = GetSlot( keyName );
+	if ( iSlot >= 0 )
+		return GetFloat( iSlot, defaultValue );
+
+	return m_pExtraKeys ? m_pExtraKeys->GetFloat( keyName, defaultValue ) : defaultValue;
+}
+
+const char *CGameEvent::GetString( const char *keyName, const char *defaultValue )
+{
+	int iSlot = GetSlot( keyName );
+	if ( iSlot >= 0 )
+		return GetString( iSlot, defaultValue );
+
+	return m_pExtraKeys ? m_pExtraKeys->GetString( keyName, defaultValue ) : defaultValue;
+}
+
+void CGameEvent::SetBool( const char *keyName, bool value )
+{
+	SetInt( keyName, value?1:0 );
+}
+
+void CGameEvent::SetInt( const char *keyName, int value )
+{
+	int iSlot = GetSlot( keyName );
+	if ( iSlot >= 0 )
+	{
+		SetInt( iSlot, value );
+		return;
+	}
+
+	GetExtraKeys()->SetInt( keyName, value );
+	if ( m_pDataKeys )
+		m_pDataKeys->SetInt( keyName, value );
+}
+
+void CGameEvent::SetFloat( const char *keyName, float value )
+{
+	int iSlot = GetSlot( keyName );
+	if ( iSlot >= 0 )
+	{
+		SetFloat( iSlot, value );
+		return;
+	}
+
+	GetExtraKeys()->SetFloat( keyName, value );
+	if ( m_pDataKeys )
+		m_pDataKeys->SetFloat( keyName, value );
+}
+
+void CGameEvent::SetString( const char *keyName, const char *value )
+{
+	int iSlot = GetSlot( keyName );
+	if ( iSlot >= 0 )
+	{
+		SetString( iSlot, value );
+		return;
+	}
+
+	GetExtraKeys()->SetString( keyName, value );
+	if ( m_pDataKeys )
+		m_pDataKeys->SetString( keyName, value );
+}
+
+bool CGameEvent::IsEmpty( const char *keyName )
+{
+	if ( !keyName )
+	{
+		for ( int i = 0; i < m_nSlots; i++ )
+		{
+			if ( m_Values[i].m_nType != VALUE_EMPTY )
+				return false;
+		}
+
+		return !m_pExtraKeys || m_pExtraKeys->IsEmpty();
+	}
+
+	int iSlot = GetSlot( keyName );
+	if ( iSlot >= 0 )
+		return IsEmpty( iSlot );
+
+	return !m_pExtraKeys || m_pExtraKeys->IsEmpty( keyName );
+}
+
+void CGameEvent::CopyFrom( const CGameEvent *pEvent )
+{
+	Assert( pEvent->m_pDescriptor == m_pDescriptor );
+
+	m_nSlots = pEvent->m_nSlots;
+	Q_memcpy( m_Values, pEvent->m_Values, m_nSlots * sizeof( EventValue_t ) );
+
+	m_Strings.CopyArray( pEvent->m_Strings.Base(), pEvent->m_Strings.Count() );
+
+	if ( m_pExtraKeys )
+	{
+		m_pExtraKeys->deleteThis();
+		m_pExtraKeys = NULL;
+	}
+
+	if ( pEvent->m_pExtraKeys )
+	{
+		m_pExtraKeys = pEvent->m_pExtraKeys->MakeCopy();
+	}
+}
+
+KeyValues *CGameEvent::GetDataKeys()
+{
+	if ( m_pDataKeys )
+		return m_pDataKeys;
+
+	m_pDataKeys = m_pExtraKeys ? m_pExtraKeys->MakeCopy() : new KeyValues( m_pDescriptor->name );
+
+	for ( int i = 0; i < m_nSlots; i++ )
+	{
+		const char *keyName = m_pDescriptor->keytable[i].name;
+		const EventValue_t &value = m_Values[i];
+
+		switch ( value.m_nType )
+		{
+		case VALUE_INT		: m_pDataKeys->SetInt( keyName, value.m_nValue ); break;
+		case VALUE_FLOAT	: m_pDataKeys->SetFloat( keyName, value.m_flValue ); break;
+		case VALUE_STRING	: m_pDataKeys->SetString( keyName, m_Strings.Base() + value.m_nString ); break;
+		}
+	}
+
+	return m_pDataKeys;
+}
+
+void CGameEvent::SetDataKeys( KeyValues *keys )
+{
+	if ( m_pDataKeys )
+		m_pDataKeys->deleteThis();
+
+	// set the values before taking the keys so they aren't written back into them
+	m_pDataKeys = NULL;
+
+	for ( KeyValues *key = keys->GetFirstSubKey(); key; key = key->GetNextKey() )
+	{
+		switch ( key->GetDataType() )
+		{
+		case KeyValues::TYPE_INT	: SetInt( key->GetName(), key->GetInt() ); break;
+		case KeyValues::TYPE_FLOAT	: SetFloat( key->GetName(), key->GetFloat() ); break;
+		case KeyValues::TYPE_NONE	: break;
+		default						: SetString( key->GetName(), key->GetString() ); break;
+		}
+	}
+
+	m_pDataKeys = keys;
+}
+
+const char *CGameEvent::GetName() const
+{
+	return m_pDescriptor->name;
+}
+
+bool CGameEvent::IsLocal() const
+{
+	return m_pDescriptor->local;
+}
+
+bool CGameEvent::IsReliable() const
+{
+	return m_pDescriptor->reliable;
+}
@@ -41,78 +41,6 @@ static ConVar net_showevents( "net_showevents", "0", FCVAR_CHEAT, "Dump game eve
 
 EXPOSE_SINGLE_INTERFACE_GLOBALVAR( CGameEventManager, IGameEventManager2, INTERFACEVERSION_GAMEEVENTSMANAGER2, s_GameEventManager );
 
-CGameEvent::CGameEvent( CGameEventDescriptor *descriptor )
-{
-	Assert( descriptor );
-	m_pDescriptor = descriptor;
-	m_pDataKeys = new KeyValues( descriptor->name );
-}
-
-CGameEvent::~CGameEvent()
-{
-	m_pDataKeys->deleteThis();
-}
-
-bool CGameEvent::GetBool( const char *keyName, bool defaultValue)
-{
-	return m_pDataKeys->GetInt( keyName, defaultValue ) != 0;
-}
-
-int CGameEvent::GetInt( const char *keyName, int defaultValue)
-{
-	return m_pDataKeys->GetInt( keyName, defaultValue );
-}
-
-float CGameEvent::GetFloat( const char *keyName, float defaultValue )
-{
-	return m_pDataKeys->GetFloat( keyName, defaultValue );
-}
-
-const char *CGameEvent::GetString( const char *keyName, const char *defaultValue )
-{
-	return m_pDataKeys->GetString( keyName, defaultValue );
-}
-
-void CGameEvent::SetBool( const char *keyName, bool value )
-{
-	m_pDataKeys->SetInt( keyName, value?1:0 );
-}
-
-void CGameEvent::SetInt( const char *keyName, int value )
-{
-	m_pDataKeys->SetInt( keyName, value );
-}
-
-void CGameEvent::SetFloat( const char *keyName, float value )
-{
-	m_pDataKeys->SetFloat( keyName, value );
-}
-
-void CGameEvent::SetString( const char *keyName, const char *value )
-{
-	m_pDataKeys->SetString( keyName, value );
-}
-
-bool CGameEvent::IsEmpty( const char *keyName )
-{
-	return m_pDataKeys->IsEmpty( keyName );
-}
-
-const char *CGameEvent::GetName() const
-{
-	return m_pDataKeys->GetName();
-}
-
-bool CGameEvent::IsLocal() const
-{
-	return m_pDescriptor->local;
-}
-
-bool CGameEvent::IsReliable() const
-{
-	return m_pDescriptor->reliable;
-}
-
 CGameEventManager::CGameEventManager()
 {
 	Reset();
@@ -150,7 +78,8 @@ void CGameEventManager::Reset()
 			e.keys->deleteThis(); // free the value keys
 			e.keys = NULL;
 		}
-					
+
+		e.keytable.Purge();
 		e.listeners.Purge();	// remove listeners
 	}
 
@@ -258,6 +187,7 @@ bool CGameEventManager::ParseEventList(SVC_GameEventList *msg)
 			datatype = msg->m_DataIn.ReadUBitLong( 3 );
 		}
 
+		descriptor->CompileKeys();
 		descriptor->eventid = id;
 	}
 
@@ -350,14 +280,9 @@ IGameEvent *CGameEventManager::DuplicateEvent( IGameEvent *event )
 	if ( !gameEvent )
 		return NULL;
 
-	// create new instance
+	// create new instance and copy the values
 	CGameEvent *newEvent = new CGameEvent ( gameEvent->m_pDescriptor );
-
-	// free keys
-	newEvent->m_pDataKeys->deleteThis();
-
-	// and make copy
-	newEvent->m_pDataKeys = gameEvent->m_pDataKeys->MakeCopy();
+	newEvent->CopyFrom( gameEvent );
 
 	return newEvent;
 }
@@ -369,22 +294,17 @@ void CGameEventManager::ConPrintEvent( IGameEvent *event)
 	if ( !descriptor )
 		return;
 
-	KeyValues *key = descriptor->keys->GetFirstSubKey(); 
-
-	while ( key )
+	for ( int i = 0; i < descriptor->keytable.Count(); i++ )
 	{
-		const char * keyName = key->GetName();
-
-		int type = key->GetInt();
+		const char * keyName = descriptor->keytable[i].name;
 
-		switch ( type )
+		switch ( descriptor->keytable[i].type )
 		{
 		case TYPE_LOCAL : ConMsg( "- \"%s\" = \"%s\" (local)\n", keyName, event->GetString(keyName) ); break;
 		case TYPE_STRING : ConMsg( "- \"%s\" = \"%s\"\n", keyName, event->GetString(keyName) ); break;
 		case TYPE_FLOAT : ConMsg( "- \"%s\" = \"%.2f\"\n", keyName, event->GetFloat(keyName) ); break;
 		default: ConMsg( "- \"%s\" = \"%i\"\n", keyName, event->GetInt(keyName) ); break;
 		}
-		key = key->GetNextKey();
 	}
 }
 
@@ -458,7 +378,7 @@ bool CGameEventManager::FireEventIntern( IGameEvent *event, bool bServerOnly, bo
 			IGameEventListener *pCallback = static_cast<IGameEventListener*>(listener->m_pCallback);
 			CGameEvent *pEvent = static_cast<CGameEvent*>(event);
 
-			pCallback->FireGameEvent( pEvent->m_pDataKeys );
+			pCallback->FireGameEvent( pEvent->GetDataKeys() );
 		}
 		else
 		{
@@ -477,51 +397,98 @@ bool CGameEventManager::FireEventIntern( IGameEvent *event, bool bServerOnly, bo
 	return true;
 }
 
+// Keys past the slot limit live in the KeyValues fallback and are looked up by name
+void CGameEventManager::WriteEventKey( CGameEvent *event, int iKey, bf_write *buf )
+{
+	const CGameEventKey &key = event->m_pDescriptor->keytable[iKey];
+	bool bSlot = ( iKey < MAX_EVENT_KEY_SLOTS );
+
+	// see s_GameEnventTypeMap for index
+	switch ( key.type )
+	{
+		case TYPE_LOCAL : break; // don't network this guy
+		case TYPE_STRING: buf->WriteString( bSlot ? event->GetString( iKey, "" ) : event->GetString( key.name, "" ) ); break;
+		case TYPE_FLOAT : buf->WriteFloat( bSlot ? event->GetFloat( iKey, 0.0f ) : event->GetFloat( key.name, 0.0f ) ); break;
+		case TYPE_LONG	: buf->WriteLong( bSlot ? event->GetInt( iKey, 0 ) : event->GetInt( key.name, 0 ) ); break;
+		case TYPE_SHORT	: buf->WriteShort( bSlot ? event->GetInt( iKey, 0 ) : event->GetInt( key.name, 0 ) ); break;
+		case TYPE_BYTE	: buf->WriteByte( bSlot ? event->GetInt( iKey, 0 ) : event->GetInt( key.name, 0 ) ); break;
+		case TYPE_BOOL	: buf->WriteOneBit( bSlot ? event->GetInt( iKey, 0 ) : event->GetInt( key.name, 0 ) ); break;
+		default: DevMsg(1, "CGameEventManager: unkown type %i for key '%s'.\n", key.type, key.name ); break;
+	}
+}
+
+void CGameEventManager::ReadEventKey( CGameEvent *event, int iKey, bf_read *buf )
+{
+	const CGameEventKey &key = event->m_pDescriptor->keytable[iKey];
+	bool bSlot = ( iKey < MAX_EVENT_KEY_SLOTS );
+
+	int nValue;
+	switch ( key.type )
+	{
+		case TYPE_LOCAL		: return; // ignore 
+		case TYPE_STRING	:
+			{
+				char databuf[MAX_EVENT_BYTES];
+				if ( !buf->ReadString( databuf, sizeof(databuf) ) )
+					return;
+
+				if ( bSlot )
+					event->SetString( iKey, databuf );
+				else
+					event->SetString( key.name, databuf );
+			}
+			return;
+		case TYPE_FLOAT		:
+			{
+				float flValue = buf->ReadFloat();
+				if ( bSlot )
+					event->SetFloat( iKey, flValue );
+				else
+					event->SetFloat( key.name, flValue );
+			}
+			return;
+		case TYPE_LONG		: nValue = buf->ReadLong(); break;
+		case TYPE_SHORT		: nValue = buf->ReadShort(); break;
+		case TYPE_BYTE		: nValue = buf->ReadByte(); break;
+		case TYPE_BOOL		: nValue = buf->ReadOneBit(); break;
+		default: DevMsg(1, "CGameEventManager: unknown type %i for key '%s'.\n", key.type, key.name ); return;
+	}
+
+	if ( bSlot )
+		event->SetInt( iKey, nValue );
+	else
+		event->SetInt( key.name, nValue );
+}
+
 bool CGameEventManager::SerializeEvent( IGameEvent *event, bf_write* buf )
 {
-	CGameEventDescriptor *descriptor = GetEventDescriptor( event );
+	CGameEvent *gameEvent = dynamic_cast<CGameEvent*>( event );
 
-	Assert( descriptor );
+	Assert( gameEvent );
+	if ( !gameEvent )
+		return false;
+
+	CGameEventDescriptor *descriptor = gameEvent->m_pDescriptor;
 
 	buf->WriteUBitLong( descriptor->eventid, MAX_EVENT_BITS );
 
 	// now iterate trough all fields described in gameevents.res and put them in the buffer
 
-	KeyValues * key = descriptor->keys->GetFirstSubKey();
-
 	if ( net_showevents.GetInt() > 2 )
 	{
 		DevMsg("Serializing event '%s' (%i):\n", descriptor->name, descriptor->eventid );
 	}
-	
-	while ( key )
-	{
-		const char * keyName = key->GetName();
 
-		int type = key->GetInt();
+	for ( int i = 0; i < descriptor->keytable.Count(); i++ )
+	{
+		const CGameEventKey &key = descriptor->keytable[i];
 
 		if ( net_showevents.GetInt() > 2 )
 		{
-			DevMsg(" - %s (%i)\n", keyName, type );
+			DevMsg(" - %s (%i)\n", key.name, key.type );
 		}
 
-		//Make sure every key is used in the event
-		// Assert( event->FindKey(keyName) && "GameEvent field not found in passed KeyValues" );
-
-		// see s_GameEnventTypeMap for index
-		switch ( type )
-		{
-			case TYPE_LOCAL : break; // don't network this guy
-			case TYPE_STRING: buf->WriteString( event->GetString( keyName, "") ); break;
-			case TYPE_FLOAT : buf->WriteFloat( event->GetFloat( keyName, 0.0f) ); break;
-			case TYPE_LONG	: buf->WriteLong( event->GetInt( keyName, 0) ); break;
-			case TYPE_SHORT	: buf->WriteShort( event->GetInt( keyName, 0) ); break;
-			case TYPE_BYTE	: buf->WriteByte( event->GetInt( keyName, 0) ); break;
-			case TYPE_BOOL	: buf->WriteOneBit( event->GetInt( keyName, 0) ); break;
-			default: DevMsg(1, "CGameEventManager: unkown type %i for key '%s'.\n", type, key->GetName() ); break;
-		}
-
-		key = key->GetNextKey();
+		WriteEventKey( gameEvent, i, buf );
 	}
 
 	return !buf->IsOverflowed();
@@ -529,8 +496,6 @@ bool CGameEventManager::SerializeEvent( IGameEvent *event, bf_write* buf )
 
 IGameEvent *CGameEventManager::UnserializeEvent( bf_read *buf)
 {
-	char databuf[MAX_EVENT_BYTES];
-
 	// read event id
 
 	int eventid = buf->ReadUBitLong( MAX_EVENT_BITS );
@@ -545,37 +510,11 @@ IGameEvent *CGameEventManager::UnserializeEvent( bf_read *buf)
 	}
 
 	// create new event
-	IGameEvent *event = CreateEvent( descriptor );
-
-	if ( !event )
-	{
-		DevMsg( "CGameEventManager::UnserializeEvent:: failed to create event %s.\n", descriptor->name );
-		return NULL;
-	}
-
-	KeyValues * key = descriptor->keys->GetFirstSubKey(); 
+	CGameEvent *event = new CGameEvent( descriptor );
 
-	while ( key )
+	for ( int i = 0; i < descriptor->keytable.Count(); i++ )
 	{
-		const char * keyName = key->GetName();
-
-		int type = key->GetInt();
-
-		switch ( type )
-		{
-			case TYPE_LOCAL		: break; // ignore 
-			case TYPE_STRING	: if ( buf->ReadString( databuf, sizeof(databuf) ) )
-									event->SetString( keyName, databuf );
-								  break;
-			case TYPE_FLOAT		: event->SetFloat( keyName, buf->ReadFloat() ); break;
-			case TYPE_LONG		: event->SetInt( keyName, buf->ReadLong() ); break;
-			case TYPE_SHORT		: event->SetInt( keyName, buf->ReadShort() ); break;
-			case TYPE_BYTE		: event->SetInt( keyName, buf->ReadByte() ); break;
-			case TYPE_BOOL		: event->SetInt( keyName, buf->ReadOneBit() ); break;
-			default: DevMsg(1, "CGameEventManager: unknown type %i for key '%s'.\n", type, key->GetName() ); break;
-		}
-
-		key = key->GetNextKey();
+		ReadEventKey( event, i, buf );
 	}
 
 	return event;
@@ -821,6 +760,8 @@ bool CGameEventManager::RegisterEvent( KeyValues * event)
 		
 		subkey = subkey->GetNextKey();
 	}
+
+	descriptor->CompileKeys();
 	
 	return true;
 }
@@ -18,6 +18,7 @@
 #include <KeyValues.h>
 #include <networkstringtabledefs.h>
 #include <utlsymbol.h>
+#include <mempool.h>
 
 class SVC_GameEventList;
 class CLC_ListenEvents;
@@ -29,6 +30,22 @@ class CGameEventCallback
 	int					m_nListenerType;	// client or server side ?
 };
 
+// Keys beyond this many per event are kept in a KeyValues like undeclared ones
+#define MAX_EVENT_KEY_SLOTS		32
+
+// Strings of an event are stored in the event itself up to this many bytes
+#define EVENT_STRING_BYTES		256
+
+// Longest number GetString() formats, "%f" of the largest float fits
+#define EVENT_NUMBER_STRING_BYTES	64
+
+class CGameEventKey
+{
+public:
+	const char	*name;		// key name, owned by the KeyValues symbol table
+	int			type;		// CGameEventManager::TYPE_*
+};
+
 class CGameEventDescriptor
 {
 public:
@@ -41,6 +58,12 @@ class CGameEventDescriptor
 		reliable = true;
 	}
 
+	// Slot of the key with that name, -1 if the event doesn't declare it
+	int FindKey( const char *keyName ) const;
+
+	// Builds keytable from keys
+	void CompileKeys();
+
 public:
 	char		name[MAX_EVENT_NAME_LENGTH];	// name of this event
 	int			eventid;	// network index number, -1 = not networked
@@ -48,8 +71,15 @@ class CGameEventDescriptor
 	bool		local;		// local event, never tell clients about that
 	bool		reliable;	// send this event as reliable message
     CUtlVector<CGameEventCallback*>	listeners;	// registered listeners
+	CUtlVector<CGameEventKey>		keytable;	// keys in the order they're networked, index is the value slot
 };
 
+//-----------------------------------------------------------------------------
+// Event values are stored in a fixed slot per key of the descriptor instead of
+// a KeyValues tree, and events are recycled through a free list, so creating,
+// filling and serializing an event doesn't allocate. Keys the descriptor doesn't
+// declare still work and go to a KeyValues.
+//-----------------------------------------------------------------------------
 class CGameEvent : public IGameEvent
 {
 public:
@@ -71,9 +101,60 @@ class CGameEvent : public IGameEvent
 	void SetInt( const char *keyName, int value );
 	void SetFloat( const char *keyName, float value );
 	void SetString( const char *keyName, const char *value );
-	
+
+	// Access by slot in the descriptor's key table
+	bool  IsEmpty( int iSlot ) const;
+	int   GetInt( int iSlot, int defaultValue = 0 );
+	float GetFloat( int iSlot, float defaultValue = 0.0f );
+	const char *GetString( int iSlot, const char *defaultValue = "" );
+
+	void SetInt( int iSlot, int value );
+	void SetFloat( int iSlot, float value );
+	void SetString( int iSlot, const char *value );
+
+	// Copies all values from another event of the same type
+	void CopyFrom( const CGameEvent *pEvent );
+
+	// All values as KeyValues for the old listener interface. The event owns it.
+	KeyValues *GetDataKeys();
+	// Takes over the values and ownership of keys from the old event interface
+	void SetDataKeys( KeyValues *keys );
+
 	CGameEventDescriptor	*m_pDescriptor;
-	KeyValues				*m_pDataKeys;
+
+private:
+	enum
+	{
+		VALUE_EMPTY = 0,
+		VALUE_INT,
+		VALUE_FLOAT,
+		VALUE_STRING,
+	};
+
+	struct EventValue_t
+	{
+		int		m_nType;
+		union
+		{
+			int		m_nValue;
+			float	m_flValue;
+			int		m_nString;	// offset into m_Strings
+		};
+	};
+
+	int GetSlot( const char *keyName ) const;
+	int AddString( const char *value );
+	KeyValues *GetExtraKeys();
+
+	int						m_nSlots;
+	EventValue_t			m_Values[MAX_EVENT_KEY_SLOTS];
+	CUtlVectorFixedGrowable<char, EVENT_STRING_BYTES>	m_Strings;
+
+	KeyValues				*m_pExtraKeys;	// keys the descriptor doesn't have a slot for
+	KeyValues				*m_pDataKeys;	// only for the old listener interface
+	char					*m_pNumberStrings;	// numbers read as strings, EVENT_NUMBER_STRING_BYTES per slot
+
+	DECLARE_FIXEDSIZE_ALLOCATOR_MT( CGameEvent );
 };
 
 class CGameEventManager : public IGameEventManager2
@@ -150,6 +231,8 @@ class CGameEventManager : public IGameEventManager2
 	void UnregisterEvent(int index);
 	bool FireEventIntern( IGameEvent *event, bool bServerSide, bool bClientOnly );
 	CGameEventCallback* FindEventListener( void* listener );
+	void WriteEventKey( CGameEvent *event, int iKey, bf_write *buf );
+	void ReadEventKey( CGameEvent *event, int iKey, bf_read *buf );
 	
 	CUtlVector<CGameEventDescriptor>	m_GameEvents;	// list of all known events
 	CUtlVector<CGameEventCallback*>		m_Listeners;	// list of all registered listeners
@@ -26,6 +26,8 @@
 #include "iregistry.h"
 #include "sv_main.h"
 #include "hltvserver.h"
+#include "net_chan.h"
+#include "vstdlib/jobthread.h"
 #include <ctype.h>
 #if defined( REPLAY_ENABLED )
 #include "replay_internal.h"
@@ -66,10 +68,16 @@ CBaseClient::CBaseClient()
 	m_bReportFakeClient = true;
 	m_iTracing = 0;
 	m_bPlayerNameLocked = false;
+	m_pPreparedFrame = NULL;
+	m_pPreparedDeltaFrame = NULL;
+	m_bPreparedBaselinePending = false;
+	m_bPreparedBaselineUpdate = false;
+	m_pPrepareJob = NULL;
 }
 
 CBaseClient::~CBaseClient()
 {
+	FinishPrepareDeltaEntities( true );
 }
 
 
@@ -216,6 +224,9 @@ int CBaseClient::GetUpdateRate(void) const
 
 void CBaseClient::FreeBaselines()
 {
+	// a queued delta still refers to the baseline and the frames
+	FinishPrepareDeltaEntities( true );
+
 	if ( m_pBaseline )
 	{
 		m_pBaseline->ReleaseReference();
@@ -251,6 +262,8 @@ void CBaseClient::Clear()
 	m_nSignonTick = 0;
 	m_nStringTableAckTick = 0;
 	m_pLastSnapshot = NULL;
+	m_pPreparedFrame = NULL;
+	m_pPreparedDeltaFrame = NULL;
 	m_nForceWaitForTick = -1;
 	m_bFakePlayer = false;
 	m_bIsHLTV = false;
@@ -933,6 +946,9 @@ bool CBaseClient::ProcessClientInfo( CLC_ClientInfo *msg )
 
 bool CBaseClient::ProcessBaselineAck( CLC_BaselineAck *msg )
 {
+	// the baseline is about to change under a queued delta
+	FinishPrepareDeltaEntities( true );
+
 	if ( msg->m_nBaselineTick != m_nBaselineUpdateTick )
 	{
 		// This occurs when there are multiple ack's queued up for processing from a client.
@@ -1145,6 +1161,9 @@ void CBaseClient::TraceNetworkMsg( int nBits, char const *fmt, ... )
 
 void CBaseClient::SendSnapshot( CClientFrame *pFrame )
 {
+	// pick up packet entities still being written by a job
+	FinishPrepareDeltaEntities( false );
+
 	// never send the same snapshot twice
 	if ( m_pLastSnapshot == pFrame->GetSnapshot() )
 	{
@@ -1205,8 +1224,34 @@ void CBaseClient::SendSnapshot( CClientFrame *pFrame )
 		nDeltaStartBit = msg.GetNumBitsWritten();
 	}
 
-	// send entity update, delta compressed if deltaFrame != NULL
-	m_Server->WriteDeltaEntities( this, pFrame, deltaFrame, msg );
+	// send entity update, delta compressed if deltaFrame != NULL. A delta prepared in the last tick
+	// may be from a frame older than the one acked since, the client still has that frame.
+	if ( m_pPreparedFrame == pFrame && m_pPreparedDeltaFrame && deltaFrame && 
+		m_pPreparedDeltaFrame->tick_count <= deltaFrame->tick_count && !IsTracing() )
+	{
+		// already written by PrepareDeltaEntities, just splice the bits in
+		if ( m_PreparedDeltaMsg.IsOverflowed() )
+		{
+			msg.SetOverflowFlag();
+		}
+		else
+		{
+			msg.WriteBits( m_PreparedDeltaMsg.GetBasePointer(), m_PreparedDeltaMsg.GetNumBitsWritten() );
+		}
+
+		if ( m_bPreparedBaselineUpdate )
+		{
+			m_BaselinesSent = m_PreparedBaselinesSent;
+			m_nBaselineUpdateTick = pFrame->tick_count;
+		}
+	}
+	else
+	{
+		m_Server->WriteDeltaEntities( this, pFrame, deltaFrame, msg );
+	}
+
+	m_pPreparedFrame = NULL;
+	m_pPreparedDeltaFrame = NULL;
 
 	if ( IsTracing() )
 	{
@@ -1437,6 +1482,13 @@ void CBaseClient::UpdateUserSettings()
 
 	SetMaxRoutablePayloadSize( m_ConVars->GetInt( "net_maxroutable", MAX_ROUTABLE_PAYLOAD ) );
 
+	// clients that don't send this only know the codecs from before it was added
+	if ( m_NetChannel )
+	{
+		// every channel NET_CreateNetChannel hands out is a CNetChan
+		static_cast<CNetChan*>( m_NetChannel )->SetCompressionCodecs( m_ConVars->GetInt( "net_compresscodecs", COMPRESSION_CODECS_DEFAULT ) );
+	}
+
 	m_Server->UserInfoChanged( m_nClientSlot );
 
 	m_bConVarsChanged = false;
@@ -1522,6 +1574,109 @@ void CBaseClient::OnRequestFullUpdate()
 	DevMsg("Sending full update to Client %s\n", GetClientName() );
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Writes the packet entities SendSnapshot would write for pFrame into
+//			a per-client buffer, so the expensive delta encoding can run on a job
+//			thread. Returns false if SendSnapshot has to write them itself.
+//-----------------------------------------------------------------------------
+bool CBaseClient::PrepareDeltaEntities( CClientFrame *pFrame )
+{
+	m_pPreparedFrame = NULL;
+	m_pPreparedDeltaFrame = NULL;
+
+	CClientFrame *deltaFrame = GetPrepareDeltaFrame( pFrame );
+	if ( !deltaFrame )
+		return false;
+
+	m_pPreparedFrame = pFrame;
+	m_pPreparedDeltaFrame = deltaFrame;
+	m_bPreparedBaselinePending = ( m_nBaselineUpdateTick == -1 );
+	WritePreparedDeltaEntities();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Like PrepareDeltaEntities, but the packet entities are written by a
+//			job on the thread pool while the main thread moves on. The job only
+//			reads the frames and the baseline, everything that changes those waits
+//			for it or drops it through FinishPrepareDeltaEntities.
+//-----------------------------------------------------------------------------
+bool CBaseClient::QueuePrepareDeltaEntities( CClientFrame *pFrame )
+{
+	FinishPrepareDeltaEntities( true );
+
+	CClientFrame *deltaFrame = GetPrepareDeltaFrame( pFrame );
+	if ( !deltaFrame )
+		return false;
+
+	m_pPreparedFrame = pFrame;
+	m_pPreparedDeltaFrame = deltaFrame;
+	m_bPreparedBaselinePending = ( m_nBaselineUpdateTick == -1 );
+	m_pPrepareJob = g_pThreadPool->QueueCall( this, &CBaseClient::WritePreparedDeltaEntities );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Waits for a queued PrepareDeltaEntities job, running it right here if
+//			no thread picked it up yet. With bDiscard the job is dropped instead and
+//			SendSnapshot writes the packet entities itself.
+//-----------------------------------------------------------------------------
+void CBaseClient::FinishPrepareDeltaEntities( bool bDiscard )
+{
+	if ( !m_pPrepareJob )
+		return;
+
+	// both return once a job that's already running is done
+	if ( bDiscard )
+	{
+		m_pPrepareJob->Abort();
+	}
+	else
+	{
+		m_pPrepareJob->Execute();
+	}
+
+	m_pPrepareJob->Release();
+	m_pPrepareJob = NULL;
+
+	if ( bDiscard )
+	{
+		m_pPreparedFrame = NULL;
+		m_pPreparedDeltaFrame = NULL;
+	}
+}
+
+// Returns the frame SendSnapshot would delta pFrame from, NULL if it has to write it itself
+CClientFrame *CBaseClient::GetPrepareDeltaFrame( CClientFrame *pFrame )
+{
+	// SendSnapshot won't write a snapshot at all in these cases
+	if ( m_pLastSnapshot == pFrame->GetSnapshot() || m_nForceWaitForTick > 0 )
+		return NULL;
+
+	// netspike traces record bit offsets into the final message
+	if ( m_iTracing >= 2 || sv_netspike_sendtime_ms.GetFloat() > 0.0f || 
+		( !IsHLTV() && !IsReplay() && !IsFakeClient() && GetNetSpikeValue() > 0 ) )
+		return NULL;
+
+	// full updates reset the client baselines first, leave them to SendSnapshot
+	return GetDeltaFrame( m_nDeltaTick );
+}
+
+void CBaseClient::WritePreparedDeltaEntities()
+{
+	if ( m_PreparedDeltaBuffer.Count() == 0 )
+	{
+		m_PreparedDeltaBuffer.Grow( SNAPSHOT_SCRATCH_BUFFER_SIZE / 4 );
+	}
+
+	m_PreparedDeltaMsg.StartWriting( m_PreparedDeltaBuffer.Base(), SNAPSHOT_SCRATCH_BUFFER_SIZE );
+	m_PreparedDeltaMsg.SetDebugName( "CBaseClient::PrepareDeltaEntities" );
+
+	m_PreparedBaselinesSent.ClearAll();
+	m_bPreparedBaselineUpdate = m_Server->WriteDeltaEntities( this, m_pPreparedFrame, m_pPreparedDeltaFrame, m_PreparedDeltaMsg, 
+		m_bPreparedBaselinePending ? &m_PreparedBaselinesSent : NULL );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : *cl - 
@@ -1609,6 +1764,9 @@ bool CBaseClient::UpdateAcknowledgedFramecount(int tick)
 	if ( (m_nBaselineUpdateTick > -1) && (m_nDeltaTick > m_nBaselineUpdateTick) )
 	{
 		// server sent a baseline update, but it wasn't acknowledged yet so it was probably lost. 
+		// A queued delta was written while the client waited for the ack, drop it so the
+		// next snapshot can carry a new baseline update.
+		FinishPrepareDeltaEntities( true );
 		m_nBaselineUpdateTick = -1;
 	}
 
@@ -22,6 +22,7 @@
 #include "smartptr.h"
 #include "userid.h"
 #include "tier1/bitbuf.h"
+#include "tier1/utlmemory.h"
 #include "steam/steamclientpublic.h"
 
 // class CClientFrame;
@@ -30,6 +31,7 @@ class CClientFrame;
 struct player_info_s;
 class CFrameSnapshot;
 class CEventInfo;
+class CJob;
 
 struct Spike_t
 {
@@ -159,6 +161,9 @@ class CBaseClient : public IGameEventListener2, public IClient, public IClientMe
 	
 	virtual CClientFrame *GetDeltaFrame( int nTick );
 	virtual void	SendSnapshot( CClientFrame *pFrame );
+			bool	PrepareDeltaEntities( CClientFrame *pFrame );
+			bool	QueuePrepareDeltaEntities( CClientFrame *pFrame );
+			void	FinishPrepareDeltaEntities( bool bDiscard );
 	virtual bool	SendServerInfo( void );
 	virtual bool	SendSignonData( void );
 	virtual void	SpawnPlayer( void );
@@ -279,7 +284,24 @@ class CBaseClient : public IGameEventListener2, public IClient, public IClientMe
 
 	unsigned int		m_SnapshotScratchBuffer[ SNAPSHOT_SCRATCH_BUFFER_SIZE / 4 ];
 
+	// Packet entities written ahead of SendSnapshot by PrepareDeltaEntities (possibly on a job thread).
+	// Only valid while m_pPreparedFrame/m_pPreparedDeltaFrame match what SendSnapshot is about to write.
+	CClientFrame		*m_pPreparedFrame;
+	CClientFrame		*m_pPreparedDeltaFrame;
+	bf_write			m_PreparedDeltaMsg;
+	CUtlMemory<unsigned int> m_PreparedDeltaBuffer;
+	// The job leaves the baseline state alone, SendSnapshot applies it with the bits
+	bool				m_bPreparedBaselinePending;	// the client wasn't waiting for a baseline ack when it was queued
+	bool				m_bPreparedBaselineUpdate;	// the prepared snapshot is flagged as a baseline update
+	CBitVec<MAX_EDICTS>	m_PreparedBaselinesSent;
+
+	// Job writing m_PreparedDeltaMsg while the next tick simulates (sv_pipeline_snapshots)
+	CJob				*m_pPrepareJob;
+
 private:
+	CClientFrame		*GetPrepareDeltaFrame( CClientFrame *pFrame );
+	void				WritePreparedDeltaEntities();
+
 	void				StartTrace( bf_write &msg );
 	void				EndTrace( bf_write &msg );
 
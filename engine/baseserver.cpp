@@ -1351,16 +1351,15 @@ const char *CBaseServer::CompressPackedEntity(ServerClass *pServerClass, const c
 	return s_packedData;
 }
 
-// uncompresses a 
-const char* CBaseServer::UncompressPackedEntity(PackedEntity *pPackedEntity, int &bits)
+// uncompresses a packed entity into pBuffer, which must hold MAX_PACKEDENTITY_DATA bytes
+const char* CBaseServer::UncompressPackedEntity(PackedEntity *pPackedEntity, int &bits, char *pBuffer)
 {
-	UnpackedDataCache_t *pdc = framesnapshotmanager->GetCachedUncompressedEntity( pPackedEntity );
+	CUnpackedDataCache &cache = framesnapshotmanager->GetUnpackedDataCache();
 
-	if ( pdc->bits > 0 )
+	if ( cache.Lookup( pPackedEntity, pBuffer, MAX_PACKEDENTITY_DATA, bits ) )
 	{
 		// found valid uncompressed version in cache
-		bits= pdc->bits;
-		return pdc->data;
+		return pBuffer;
 	}
 
 	// not in cache, so uncompress it
@@ -1375,7 +1374,7 @@ const char* CBaseServer::UncompressPackedEntity(PackedEntity *pPackedEntity, int
 	// store this baseline in u.m_pUpdateBaselines
 	bf_read oldBuf( "UncompressPackedEntity1", pBaseline, nBaselineBytes );
 	bf_read newBuf( "UncompressPackedEntity2", pPackedEntity->GetData(), Bits2Bytes(pPackedEntity->GetNumBits()) );
-	bf_write outBuf( "UncompressPackedEntity3", pdc->data, MAX_PACKEDENTITY_DATA );
+	bf_write outBuf( "UncompressPackedEntity3", pBuffer, MAX_PACKEDENTITY_DATA );
 
 	Assert( pPackedEntity->m_pClientClass );
 
@@ -1385,9 +1384,11 @@ const char* CBaseServer::UncompressPackedEntity(PackedEntity *pPackedEntity, int
 		&newBuf,
 		&outBuf );
 
-	bits = pdc->bits = outBuf.GetNumBitsWritten();
+	bits = outBuf.GetNumBitsWritten();
+
+	cache.Add( pPackedEntity, pBuffer, bits );
 		
-	return pdc->data;
+	return pBuffer;
 }
 
 /*
@@ -103,6 +103,7 @@ class CBaseServer  : public IServer
 	virtual void	DisconnectClient(IClient *client, const char *reason );
 	
 	virtual void	WriteDeltaEntities( CBaseClient *client, CClientFrame *to, CClientFrame *from,	bf_write &pBuf );
+	bool			WriteDeltaEntities( CBaseClient *client, CClientFrame *to, CClientFrame *from,	bf_write &pBuf, CBitVec<MAX_EDICTS> *pBaselinesSent );
 	virtual void	WriteTempEntities( CBaseClient *client, CFrameSnapshot *to, CFrameSnapshot *from, bf_write &pBuf, int nMaxEnts );
 	
 public: // IConnectionlessPacketHandler implementation
@@ -127,7 +128,7 @@ class CBaseServer  : public IServer
 	void	SendPendingServerInfo(void);
 
 	const char	*CompressPackedEntity(ServerClass *pServerClass, const char *data, int &bits);
-	const char	*UncompressPackedEntity(PackedEntity *pPackedEntity, int &size);
+	const char	*UncompressPackedEntity(PackedEntity *pPackedEntity, int &size, char *pBuffer);
 
 	INetworkStringTable *GetInstanceBaselineTable( void );
 	INetworkStringTable *GetLightStyleTable( void );
@@ -1,28 +1,84 @@
 //========= Copyright Valve Corporation, All rights reserved. ============//
 //
-// Purpose: 
+// Purpose:
 //
 // $NoKeywords: $
 //=============================================================================//
 
+#include <limits.h>
 #include "basetypes.h"
 #include "changeframelist.h"
-#include "dt.h"
-#include "utlvector.h"
+#include "dt_common.h"
+#include "bitvec.h"
+#include "tier0/tslist.h"
+
+#if defined(__arm__) || defined(__aarch64__)
+#include "sse2neon.h"
+#else
+#include <emmintrin.h>
+#endif
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
 
 
+// Props are stored in groups of this many ticks. Each group also remembers its newest change
+// tick, so GetPropsChangedAfterTick can skip whole groups and only compares the rest four
+// ticks at a time with SSE.
+#define CHANGEFRAME_GROUP_SIZE		16
+#define CHANGEFRAME_MAX_GROUPS		( ( MAX_DATATABLE_PROPS + CHANGEFRAME_GROUP_SIZE - 1 ) / CHANGEFRAME_GROUP_SIZE )
+
+// Tick for the padding at the end of the last group, never newer than anything
+#define CHANGEFRAME_PAD_TICK		INT_MIN
+
+
+// Change lists are created and released for every entity that changes each tick (from the
+// parallel PackEntities jobs too), so they're recycled through lock free free lists instead
+// of going through the heap. There's one list per group count, a list and its ticks share
+// one block of memory.
+static CTSListBase g_ChangeFrameListPool[ CHANGEFRAME_MAX_GROUPS + 1 ];
+
+
+// Lists are constructed in place in their pooled block
+#include "tier0/memdbgoff.h"
+
 class CChangeFrameList : public IChangeFrameList
 {
 public:
 
-	void	Init( int nProperties, int iCurTick )
+	static CChangeFrameList *Alloc( int nProperties )
+	{
+		Assert( nProperties >= 0 && nProperties <= MAX_DATATABLE_PROPS );
+
+		int nGroups = ( nProperties + CHANGEFRAME_GROUP_SIZE - 1 ) / CHANGEFRAME_GROUP_SIZE;
+
+		void *pMem = g_ChangeFrameListPool[nGroups].Pop();
+		if ( !pMem )
+		{
+			pMem = MemAlloc_AllocAligned( GetAllocSize( nGroups ), 16 );
+		}
+
+		CChangeFrameList *pRet = new ( pMem ) CChangeFrameList;
+		pRet->m_nProps = nProperties;
+		pRet->m_nGroups = nGroups;
+		pRet->m_pChangeTicks = (int *)( (byte *)pMem + GetHeaderSize() );
+		pRet->m_pGroupTicks = pRet->m_pChangeTicks + nGroups * CHANGEFRAME_GROUP_SIZE;
+		return pRet;
+	}
+
+	void	Init( int iCurTick )
 	{
-		m_ChangeTicks.SetSize( nProperties );
-		for ( int i=0; i < nProperties; i++ )
-			m_ChangeTicks[i] = iCurTick;
+		for ( int i=0; i < m_nProps; i++ )
+			m_pChangeTicks[i] = iCurTick;
+
+		int nPadded = m_nGroups * CHANGEFRAME_GROUP_SIZE;
+		for ( int i=m_nProps; i < nPadded; i++ )
+			m_pChangeTicks[i] = CHANGEFRAME_PAD_TICK;
+
+		for ( int i=0; i < m_nGroups; i++ )
+			m_pGroupTicks[i] = iCurTick;
+
+		m_nNewestTick = m_nProps ? iCurTick : CHANGEFRAME_PAD_TICK;
 	}
 
 
@@ -31,53 +87,73 @@ class CChangeFrameList : public IChangeFrameList
 
 	virtual void	Release()
 	{
-		delete this;
+		int nGroups = m_nGroups;
+		this->~CChangeFrameList();
+
+		g_ChangeFrameListPool[nGroups].Push( (TSLNodeBase_t *)this );
 	}
 
 	virtual IChangeFrameList* Copy()
 	{
-		CChangeFrameList *pRet = new CChangeFrameList;
-
-		int numProps = m_ChangeTicks.Count();
+		CChangeFrameList *pRet = Alloc( m_nProps );
 
-		pRet->m_ChangeTicks.SetSize( numProps );
-
-		for ( int i=0; i < numProps; i++ )
-		{
-			pRet->m_ChangeTicks[ i ] = m_ChangeTicks[ i ];
-		}
+		memcpy( pRet->m_pChangeTicks, m_pChangeTicks, m_nGroups * ( CHANGEFRAME_GROUP_SIZE + 1 ) * sizeof( int ) );
+		pRet->m_nNewestTick = m_nNewestTick;
 
 		return pRet;
-
 	}
 
 	virtual int		GetNumProps()
 	{
-		return m_ChangeTicks.Count();
+		return m_nProps;
 	}
 
 	virtual void	SetChangeTick( const int *pPropIndices, int nPropIndices, const int iTick )
 	{
 		for ( int i=0; i < nPropIndices; i++ )
 		{
-			m_ChangeTicks[ pPropIndices[i] ] = iTick;
+			int iProp = pPropIndices[i];
+			m_pChangeTicks[ iProp ] = iTick;
+
+			int &groupTick = m_pGroupTicks[ iProp / CHANGEFRAME_GROUP_SIZE ];
+			groupTick = MAX( groupTick, iTick );
+		}
+
+		if ( nPropIndices )
+		{
+			m_nNewestTick = MAX( m_nNewestTick, iTick );
 		}
 	}
 
 	virtual int		GetPropsChangedAfterTick( int iTick, int *iOutProps, int nMaxOutProps )
 	{
-		int nOutProps = 0;
+		Assert( m_nProps <= nMaxOutProps );
 
-		int c = m_ChangeTicks.Count();
-		
-		Assert( c <= nMaxOutProps );
+		// most entities didn't change at all since the client's last ack
+		if ( m_nNewestTick <= iTick )
+			return 0;
 
-		for ( int i=0; i < c; i++ )
+		int nOutProps = 0;
+		__m128i tick = _mm_set1_epi32( iTick );
+
+		for ( int iGroup=0; iGroup < m_nGroups; iGroup++ )
 		{
-			if ( m_ChangeTicks[i] > iTick )
+			if ( m_pGroupTicks[iGroup] <= iTick )
+				continue;
+
+			const __m128i *pTicks = (const __m128i *)( m_pChangeTicks + iGroup * CHANGEFRAME_GROUP_SIZE );
+
+			unsigned int mask =
+				( _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpgt_epi32( _mm_load_si128( pTicks + 0 ), tick ) ) ) ) |
+				( _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpgt_epi32( _mm_load_si128( pTicks + 1 ), tick ) ) ) << 4 ) |
+				( _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpgt_epi32( _mm_load_si128( pTicks + 2 ), tick ) ) ) << 8 ) |
+				( _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpgt_epi32( _mm_load_si128( pTicks + 3 ), tick ) ) ) << 12 );
+
+			int iBase = iGroup * CHANGEFRAME_GROUP_SIZE;
+			while ( mask )
 			{
-				iOutProps[nOutProps] = i;
-				++nOutProps;
+				iOutProps[nOutProps++] = FirstBitInWord( mask, iBase );
+				mask &= mask - 1;
 			}
 		}
 
@@ -92,17 +168,32 @@ class CChangeFrameList : public IChangeFrameList
 	}
 
 private:
-	// Change frames for each property.
-	CUtlVector<int>		m_ChangeTicks;
+	static int GetHeaderSize()
+	{
+		return ( sizeof( CChangeFrameList ) + 15 ) & ~15;
+	}
+
+	// header, change ticks for each group, newest tick per group
+	static int GetAllocSize( int nGroups )
+	{
+		return GetHeaderSize() + nGroups * ( CHANGEFRAME_GROUP_SIZE + 1 ) * sizeof( int );
+	}
+
+	int		m_nProps;
+	int		m_nGroups;
+	int		m_nNewestTick;		// newest change tick of any property
+
+	// Change frames for each property, padded to a multiple of CHANGEFRAME_GROUP_SIZE
+	int		*m_pChangeTicks;
+	int		*m_pGroupTicks;
 };
 
+#include "tier0/memdbgon.h"
+
 
 IChangeFrameList* AllocChangeFrameList( int nProperties, int iCurTick )
 {
-	CChangeFrameList *pRet = new CChangeFrameList;
-	pRet->Init( nProperties, iCurTick);
+	CChangeFrameList *pRet = CChangeFrameList::Alloc( nProperties );
+	pRet->Init( iCurTick );
 	return pRet;
 }
-
-
-
@@ -44,6 +44,7 @@ static ConVar demo_recordcommands( "demo_recordcommands", "1", FCVAR_CHEAT, "Rec
 static ConVar demo_quitafterplayback( "demo_quitafterplayback", "0", 0, "Quits game after demo playback." );
 static ConVar demo_debug( "demo_debug", "0", 0, "Demo debug info." );
 static ConVar demo_interpolateview( "demo_interpolateview", "1", 0, "Do view interpolation during dem playback." );
+static ConVar demo_usekeyframes( "demo_usekeyframes", "1", 0, "Jump to the nearest keyframe of indexed demos when skipping ahead." );
 static ConVar demo_pauseatservertick( "demo_pauseatservertick", "0", 0, "Pauses demo playback at server tick" );
 static ConVar timedemo_runcount( "timedemo_runcount", "0", 0, "Runs time demo X number of times." );
 
@@ -1122,12 +1123,42 @@ netpacket_t *CDemoPlayer::ReadPacket( void )
 	if ( CheckPausedPlayback() )
 		return NULL;
 
+	// Once signon is done, skip ahead by jumping to the newest keyframe before the target
+	if ( IsSkipping() && demo_usekeyframes.GetBool() && cl.IsActive() &&
+		 ( ( m_nSkipToTick & SKIP_TO_TICK_FLAG ) != SKIP_TO_TICK_FLAG ) )
+	{
+		const demoindexentry_t *pKeyframe = m_DemoFile.FindKeyframe( m_nSkipToTick );
+		if ( pKeyframe && pKeyframe->tick > GetPlaybackTick() )
+		{
+			if ( demo_debug.GetBool() )
+			{
+				Msg( "%d jumping to keyframe at tick %d\n", GetPlaybackTick(), pKeyframe->tick );
+			}
+
+			m_DemoFile.SeekTo( pKeyframe->offset, true );
+			m_nKeyframeJumpPos = pKeyframe->offset;
+			ResetDemoInterpolation();
+		}
+	}
+
 	bool bStopReading = false;
 	
 	while ( !bStopReading )
 	{
 		curpos = m_DemoFile.GetCurPos( true );
 
+		// Keyframes repeat state we already have unless we jumped to one
+		if ( curpos != m_nKeyframeJumpPos )
+		{
+			const demoindexentry_t *pKeyframe = m_DemoFile.FindKeyframeAtPos( curpos );
+			if ( pKeyframe )
+			{
+				m_DemoFile.SeekTo( curpos + pKeyframe->length, true );
+				continue;
+			}
+		}
+		m_nKeyframeJumpPos = -1;
+
 		m_DemoFile.ReadCmdHeader( cmd, tick );
 
 		// always read control commands 
@@ -1626,6 +1657,7 @@ CDemoPlayer::CDemoPlayer()
 	m_bResetInterpolation = false;
 	m_nPreviousTick = 0;
 	m_nEndTick = 0;
+	m_nKeyframeJumpPos = -1;
 }
 
 CDemoPlayer::~CDemoPlayer()
@@ -1670,6 +1702,12 @@ bool CDemoPlayer::StartPlayback( const char *filename, bool bAsTimeDemo )
 		return false;
 	}
 	
+	if ( m_DemoFile.ReadIndex() && demo_debug.GetBool() )
+	{
+		Msg( "Demo has %d keyframes\n", m_DemoFile.m_Index.Count() );
+	}
+	m_nKeyframeJumpPos = -1;
+
 	ConMsg ("Playing demo from %s.\n", filename);
 
 	// Now read in the directory structure.
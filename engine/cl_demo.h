@@ -99,6 +99,7 @@ class CDemoPlayer : public IDemoPlayer
 	bool			m_bLoading; // true if demo is loading
 
 	unsigned		m_nSkipPacketsPlayed; // Track consecutive skip packets returned to avoid excess
+	int				m_nKeyframeJumpPos;	// file offset of the keyframe we jumped to, -1 = none
 
 	// view origin/angle interpolation:
 	CUtlVector< DemoCommandQueue >	m_DestCmdInfo;
@@ -9,6 +9,7 @@
 #include "cmodel_private.h"
 #include "dispcoll_common.h"
 #include "coordsize.h"
+#include "cmodel_raypacket.h"
 
 #include "quakedef.h"
 #include <string.h>
@@ -1910,120 +1911,52 @@ void CM_RayLeafnums( const Ray_t &ray, int *pLeafList, int nMaxLeafCount, int &n
 
 
 
-/*
-==================
-CM_RecursiveHullCheck
-
-==================
-Attempt to do whatever is nessecary to get this function to unroll at least once
-*/
+//-----------------------------------------------------------------------------
+// Lets CM_RecursiveRayCheck walk the collision bsp with one ray or box
+//-----------------------------------------------------------------------------
 template <bool IS_POINT>
-static void FASTCALL CM_RecursiveHullCheckImpl( TraceInfo_t *pTraceInfo, int num, const float p1f, const float p2f, const Vector& p1, const Vector& p2)
+class CBSPHullCheckTree
 {
-	if (pTraceInfo->m_trace.fraction <= p1f)
-		return;		// already hit something nearer
-
-	cnode_t		*node = NULL;
-	cplane_t	*plane;
-	float		t1 = 0, t2 = 0, offset = 0;
-	float		frac, frac2;
-	float		idist;
-	Vector		mid;
-	int			side;
-	float		midf;
-
+public:
+	CBSPHullCheckTree( TraceInfo_t *pTraceInfo ) : m_pTraceInfo( pTraceInfo ), m_pNodes( pTraceInfo->m_pBSPData->map_rootnode ) {}
 
-	// find the point distances to the seperating plane
-	// and the offset for the size of the box
+	const cplane_t *GetPlane( int num ) const	{ return m_pNodes[num].plane; }
+	int GetChild( int num, int side ) const		{ return m_pNodes[num].children[side]; }
 
-	while( num >= 0 )
+	bool HitBefore( int lane, float frac ) const
 	{
-		node = pTraceInfo->m_pBSPData->map_rootnode + num;
-		plane = node->plane;
-		byte type = plane->type;
-		float dist = plane->dist;
-
-		if (type < 3)
-		{
-			t1 = p1[type] - dist;
-			t2 = p2[type] - dist;
-			offset = pTraceInfo->m_extents[type];
-		}
-		else
-		{
-			t1 = DotProduct (plane->normal, p1) - dist;
-			t2 = DotProduct (plane->normal, p2) - dist;
-			if( IS_POINT )
-			{
-				offset = 0;
-			}
-			else
-			{
-				offset = fabsf(pTraceInfo->m_extents[0]*plane->normal[0]) +
-					fabsf(pTraceInfo->m_extents[1]*plane->normal[1]) +
-					fabsf(pTraceInfo->m_extents[2]*plane->normal[2]);
-			}
-		}
-
-		// see which sides we need to consider
-		if (t1 > offset && t2 > offset )
-//		if (t1 >= offset && t2 >= offset)
-		{
-			num = node->children[0];
-			continue;
-		}
-		if (t1 < -offset && t2 < -offset)
-		{
-			num = node->children[1];
-			continue;
-		}
-		break;
+		return m_pTraceInfo->m_trace.fraction <= frac;
 	}
 
-	// if < 0, we are in a leaf node
-	if (num < 0)
-	{
-		CM_TraceToLeaf<IS_POINT>(pTraceInfo, -1-num, p1f, p2f);
-		return;
-	}
-	
-	// put the crosspoint DIST_EPSILON pixels on the near side
-	if (t1 < t2)
+	void TraceToLeaf( int lane, int leaf, float p1f, float p2f )
 	{
-		idist = 1.0/(t1-t2);
-		side = 1;
-		frac2 = (t1 + offset + DIST_EPSILON)*idist;
-		frac = (t1 - offset - DIST_EPSILON)*idist;
+		CM_TraceToLeaf<IS_POINT>( m_pTraceInfo, leaf, p1f, p2f );
 	}
-	else if (t1 > t2)
-	{
-		idist = 1.0/(t1-t2);
-		side = 0;
-		frac2 = (t1 - offset - DIST_EPSILON)*idist;
-		frac = (t1 + offset + DIST_EPSILON)*idist;
-	}
-	else
+
+	float GetOffset( int lane, const cplane_t *plane ) const
 	{
-		side = 0;
-		frac = 1;
-		frac2 = 0;
-	}
+		if ( plane->type < 3 )
+			return m_pTraceInfo->m_extents[plane->type];
 
-	// move up to the node
-	frac = clamp( frac, 0.f, 1.f );
-	midf = p1f + (p2f - p1f)*frac;
-	VectorLerp( p1, p2, frac, mid );
+		if ( IS_POINT )
+			return 0;
 
-	CM_RecursiveHullCheckImpl<IS_POINT>(pTraceInfo, node->children[side], p1f, midf, p1, mid);
+		return fabsf(m_pTraceInfo->m_extents[0]*plane->normal[0]) +
+			fabsf(m_pTraceInfo->m_extents[1]*plane->normal[1]) +
+			fabsf(m_pTraceInfo->m_extents[2]*plane->normal[2]);
+	}
 
-	// go past the node
-	frac2 = clamp( frac2, 0.f, 1.f );
-	midf = p1f + (p2f - p1f)*frac2;
-	VectorLerp( p1, p2, frac2, mid );
+private:
+	TraceInfo_t *m_pTraceInfo;
+	cnode_t *m_pNodes;
+};
 
-	CM_RecursiveHullCheckImpl<IS_POINT>(pTraceInfo, node->children[side^1], midf, p2f, mid, p2);
-}
+/*
+==================
+CM_RecursiveHullCheck
 
+==================
+*/
 void FASTCALL CM_RecursiveHullCheck ( TraceInfo_t *pTraceInfo, int num, const float p1f, const float p2f )
 {
 	const Vector& p1 = pTraceInfo->m_start;
@@ -2031,11 +1964,13 @@ void FASTCALL CM_RecursiveHullCheck ( TraceInfo_t *pTraceInfo, int num, const fl
 
 	if( pTraceInfo->m_ispoint )
 	{
-		CM_RecursiveHullCheckImpl<true>( pTraceInfo, num, p1f, p2f, p1, p2);
+		CBSPHullCheckTree<true> tree( pTraceInfo );
+		CM_RecursiveRayCheck( tree, 0, num, p1f, p2f, p1, p2 );
 	}
 	else
 	{
-		CM_RecursiveHullCheckImpl<false>( pTraceInfo, num, p1f, p2f, p1, p2);
+		CBSPHullCheckTree<false> tree( pTraceInfo );
+		CM_RecursiveRayCheck( tree, 0, num, p1f, p2f, p1, p2 );
 	}
 }
 
@@ -2179,6 +2114,25 @@ void CM_BoxTraceAgainstLeafList( const Ray_t &ray, int *pLeafList, int nLeafCoun
 	Assert( !ray.m_IsRay || trace.allsolid || ( trace.fraction >= trace.fractionleftsolid ) );
 }
 
+//-----------------------------------------------------------------------------
+// Sets up the trace data for sweeping a ray through the world
+//-----------------------------------------------------------------------------
+static inline void CM_SetupBoxTrace( TraceInfo_t *pTraceInfo, const Ray_t& ray, int brushmask )
+{
+	pTraceInfo->m_bDispHit = false;
+	pTraceInfo->m_DispStabDir.Init();
+	pTraceInfo->m_contents = brushmask;
+	VectorCopy (ray.m_Start, pTraceInfo->m_start);
+	VectorAdd  (ray.m_Start, ray.m_Delta, pTraceInfo->m_end);
+	VectorMultiply (ray.m_Extents, -1.0f, pTraceInfo->m_mins);
+	VectorCopy (ray.m_Extents, pTraceInfo->m_maxs);
+	VectorCopy (ray.m_Extents, pTraceInfo->m_extents);
+	pTraceInfo->m_delta = ray.m_Delta;
+	pTraceInfo->m_invDelta = ray.InvDelta();
+	pTraceInfo->m_ispoint = ray.m_IsRay;
+	pTraceInfo->m_isswept = ray.m_IsSwept;
+}
+
 void CM_BoxTrace( const Ray_t& ray, int headnode, int brushmask, bool computeEndpt, trace_t& tr )
 {
 	VPROF("BoxTrace");
@@ -2203,18 +2157,7 @@ void CM_BoxTrace( const Ray_t& ray, int headnode, int brushmask, bool computeEnd
 		return;
 	}
 
-	pTraceInfo->m_bDispHit = false;
-	pTraceInfo->m_DispStabDir.Init();
-	pTraceInfo->m_contents = brushmask;
-	VectorCopy (ray.m_Start, pTraceInfo->m_start);
-	VectorAdd  (ray.m_Start, ray.m_Delta, pTraceInfo->m_end);
-	VectorMultiply (ray.m_Extents, -1.0f, pTraceInfo->m_mins);
-	VectorCopy (ray.m_Extents, pTraceInfo->m_maxs);
-	VectorCopy (ray.m_Extents, pTraceInfo->m_extents);
-	pTraceInfo->m_delta = ray.m_Delta;
-	pTraceInfo->m_invDelta = ray.InvDelta();
-	pTraceInfo->m_ispoint = ray.m_IsRay;
-	pTraceInfo->m_isswept = ray.m_IsSwept;
+	CM_SetupBoxTrace( pTraceInfo, ray, brushmask );
 
 	if (!ray.m_IsSwept)
 	{
@@ -2239,6 +2182,133 @@ void CM_BoxTrace( const Ray_t& ray, int headnode, int brushmask, bool computeEnd
 }
 
 
+//-----------------------------------------------------------------------------
+// Lets CM_RecursiveRayPacketCheck walk the collision bsp, each lane tracing into its own TraceInfo_t
+//-----------------------------------------------------------------------------
+class CBSPRayPacketTree
+{
+public:
+	CBSPRayPacketTree( TraceInfo_t **ppTraceInfos ) : m_ppTraceInfos( ppTraceInfos ), m_pNodes( ppTraceInfos[0]->m_pBSPData->map_rootnode ) {}
+
+	const cplane_t *GetPlane( int num ) const	{ return m_pNodes[num].plane; }
+	int GetChild( int num, int side ) const		{ return m_pNodes[num].children[side]; }
+
+	bool HitBefore( int lane, float frac ) const
+	{
+		return m_ppTraceInfos[lane]->m_trace.fraction <= frac;
+	}
+
+	void TraceToLeaf( int lane, int leaf, float p1f, float p2f )
+	{
+		CM_TraceToLeaf<true>( m_ppTraceInfos[lane], leaf, p1f, p2f );
+	}
+
+	// rays only, no box to widen the planes by
+	float GetOffset( int lane, const cplane_t *plane ) const	{ return 0.0f; }
+
+private:
+	TraceInfo_t **m_ppTraceInfos;
+	cnode_t *m_pNodes;
+};
+
+//-----------------------------------------------------------------------------
+// Sweeps up to four rays without extents through the world together
+//-----------------------------------------------------------------------------
+static void CM_BoxTracePacket( int nRays, const Ray_t **ppRays, int headnode, int brushmask, bool computeEndpt, trace_t **ppTraces )
+{
+	TraceInfo_t *ppTraceInfos[RAYPACKET_SIZE];
+	RayPacket_t packet;
+	packet.m_p1f = Four_Zeros;
+	packet.m_p2f = Four_Ones;
+
+	for ( int i = 0; i < RAYPACKET_SIZE; i++ )
+	{
+		// unused lanes repeat the first ray so they hold sensible numbers
+		int iRay = ( i < nRays ) ? i : 0;
+		if ( i < nRays )
+		{
+			TraceInfo_t *pTraceInfo = ppTraceInfos[i] = BeginTrace();
+
+#ifdef COUNT_COLLISIONS
+			g_CollisionCounts.m_Traces++;
+#endif
+
+			CM_ClearTrace( &pTraceInfo->m_trace );
+			pTraceInfo->m_pBSPData = GetCollisionBSPData();
+			CM_SetupBoxTrace( pTraceInfo, *ppRays[i], brushmask );
+		}
+
+		packet.SetLane( i, 0.0f, 1.0f, ppTraceInfos[iRay]->m_start, ppTraceInfos[iRay]->m_end );
+	}
+
+	CBSPRayPacketTree tree( ppTraceInfos );
+	CM_RecursiveRayPacketCheck( tree, headnode, packet, ( 1 << nRays ) - 1 );
+
+	for ( int i = 0; i < nRays; i++ )
+	{
+		TraceInfo_t *pTraceInfo = ppTraceInfos[i];
+		if ( computeEndpt )
+		{
+			CM_ComputeTraceEndpoints( *ppRays[i], pTraceInfo->m_trace );
+		}
+
+		*ppTraces[i] = pTraceInfo->m_trace;
+		EndTrace( pTraceInfo );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Traces several rays through the world, walking the bsp for up to four
+// at once. Each trace comes out the same as CM_BoxTrace would give it.
+//-----------------------------------------------------------------------------
+void CM_BoxTraces( int nRays, const Ray_t *pRays, int headnode, int brushmask, bool computeEndpt, trace_t *pTraces )
+{
+	VPROF("BoxTraces");
+
+	// check if the map is not loaded
+	if ( !GetCollisionBSPData()->numnodes )
+	{
+		for ( int i = 0; i < nRays; i++ )
+		{
+			CM_BoxTrace( pRays[i], headnode, brushmask, computeEndpt, pTraces[i] );
+		}
+		return;
+	}
+
+	const Ray_t *ppRays[RAYPACKET_SIZE];
+	trace_t *ppTraces[RAYPACKET_SIZE];
+	int nPacketRays = 0;
+	for ( int i = 0; i < nRays; i++ )
+	{
+		const Ray_t &ray = pRays[i];
+
+		// boxes and position tests go on their own
+		if ( !ray.m_IsRay || !ray.m_IsSwept || ray.m_Extents != vec3_origin )
+		{
+			CM_BoxTrace( ray, headnode, brushmask, computeEndpt, pTraces[i] );
+			continue;
+		}
+
+		ppRays[nPacketRays] = &ray;
+		ppTraces[nPacketRays] = &pTraces[i];
+		if ( ++nPacketRays == RAYPACKET_SIZE )
+		{
+			CM_BoxTracePacket( nPacketRays, ppRays, headnode, brushmask, computeEndpt, ppTraces );
+			nPacketRays = 0;
+		}
+	}
+
+	if ( nPacketRays == 1 )
+	{
+		CM_BoxTrace( *ppRays[0], headnode, brushmask, computeEndpt, *ppTraces[0] );
+	}
+	else if ( nPacketRays )
+	{
+		CM_BoxTracePacket( nPacketRays, ppRays, headnode, brushmask, computeEndpt, ppTraces );
+	}
+}
+
+
 void CM_TransformedBoxTrace( const Ray_t& ray, int headnode, int brushmask,
 							const Vector& origin, QAngle const& angles, trace_t& tr )
 {
@@ -0,0 +1,375 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Walks a BSP tree with four rays at once
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef CMODEL_RAYPACKET_H
+#define CMODEL_RAYPACKET_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "mathlib/mathlib.h"
+#include "mathlib/ssemath.h"
+#include "coordsize.h"
+
+#define RAYPACKET_SIZE		4
+
+// Bound on how far apart two ways of adding up a plane distance can round,
+// relative to the sum of the magnitudes of its terms
+#define RAYPACKET_ROUNDING_ERROR	( 1.0f / ( 1 << 18 ) )
+
+
+//-----------------------------------------------------------------------------
+// The parts of four rays between fractions p1f and p2f, one ray per lane
+//-----------------------------------------------------------------------------
+struct RayPacket_t
+{
+	fltx4	m_p1f;
+	fltx4	m_p2f;
+	fltx4	m_p1[3];		// x, y and z of each part's start
+	fltx4	m_p2[3];		// x, y and z of each part's end
+
+	void GetLane( int i, float &p1f, float &p2f, Vector &p1, Vector &p2 ) const
+	{
+		p1f = SubFloat( m_p1f, i );
+		p2f = SubFloat( m_p2f, i );
+		p1.Init( SubFloat( m_p1[0], i ), SubFloat( m_p1[1], i ), SubFloat( m_p1[2], i ) );
+		p2.Init( SubFloat( m_p2[0], i ), SubFloat( m_p2[1], i ), SubFloat( m_p2[2], i ) );
+	}
+
+	void SetLane( int i, float p1f, float p2f, const Vector &p1, const Vector &p2 )
+	{
+		SubFloat( m_p1f, i ) = p1f;
+		SubFloat( m_p2f, i ) = p2f;
+		for ( int k = 0; k < 3; k++ )
+		{
+			SubFloat( m_p1[k], i ) = p1[k];
+			SubFloat( m_p2[k], i ) = p2[k];
+		}
+	}
+};
+
+
+//-----------------------------------------------------------------------------
+// Where a line from distance t1 to t2 in front of a plane, widened by offset,
+// crosses it. Returns the side the line starts on, frac is where it leaves that
+// side and frac2 where it enters the other, DIST_EPSILON pixels to the near side
+//-----------------------------------------------------------------------------
+FORCEINLINE int CM_SplitAtPlane( float t1, float t2, float offset, float &frac, float &frac2 )
+{
+	float idist;
+	if (t1 < t2)
+	{
+		idist = 1.0/(t1-t2);
+		frac2 = (t1 + offset + DIST_EPSILON)*idist;
+		frac = (t1 - offset - DIST_EPSILON)*idist;
+		return 1;
+	}
+	else if (t1 > t2)
+	{
+		idist = 1.0/(t1-t2);
+		frac2 = (t1 - offset - DIST_EPSILON)*idist;
+		frac = (t1 + offset + DIST_EPSILON)*idist;
+		return 0;
+	}
+
+	frac = 1;
+	frac2 = 0;
+	return 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// The distances of a lone ray's ends in front of a plane, worked out exactly
+// as CM_RecursiveRayCheck does
+//-----------------------------------------------------------------------------
+FORCEINLINE void CM_RayPacketPlaneDist( const cplane_t *plane, const Vector &p1, const Vector &p2, float &t1, float &t2 )
+{
+	byte type = plane->type;
+	float dist = plane->dist;
+	if (type < 3)
+	{
+		t1 = p1[type] - dist;
+		t2 = p2[type] - dist;
+	}
+	else
+	{
+		t1 = DotProduct (plane->normal, p1) - dist;
+		t2 = DotProduct (plane->normal, p2) - dist;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Walks one ray or box down a BSP tree. This is the walk CM_RecursiveHullCheck does,
+// and the packets fall back to it, so both ways give the same traces.
+//
+// TREE provides:
+//	const cplane_t *GetPlane( int num )
+//	int GetChild( int num, int side )
+//	bool HitBefore( int lane, float frac )		- the lane's trace already hit something nearer than frac
+//	void TraceToLeaf( int lane, int leaf, float p1f, float p2f )
+//	float GetOffset( int lane, const cplane_t *plane )
+//												- how far the lane's box reaches out from its center, along the plane normal
+//-----------------------------------------------------------------------------
+template < class TREE >
+void CM_RecursiveRayCheck( TREE &tree, int lane, int num, float p1f, float p2f, const Vector &p1, const Vector &p2 );
+
+// The same without the HitBefore test, for when the caller already made it
+template < class TREE >
+FORCEINLINE void CM_RecursiveRayDescend( TREE &tree, int lane, int num, float p1f, float p2f, const Vector &p1, const Vector &p2 )
+{
+	const cplane_t *plane = NULL;
+	float t1 = 0, t2 = 0, offset = 0;
+
+	// find the point distances to the seperating plane
+	// and the offset for the size of the box
+	while ( num >= 0 )
+	{
+		plane = tree.GetPlane( num );
+		CM_RayPacketPlaneDist( plane, p1, p2, t1, t2 );
+		offset = tree.GetOffset( lane, plane );
+
+		// see which sides we need to consider
+		if ( t1 > offset && t2 > offset )
+		{
+			num = tree.GetChild( num, 0 );
+			continue;
+		}
+		if ( t1 < -offset && t2 < -offset )
+		{
+			num = tree.GetChild( num, 1 );
+			continue;
+		}
+		break;
+	}
+
+	// if < 0, we are in a leaf node
+	if ( num < 0 )
+	{
+		tree.TraceToLeaf( lane, -1-num, p1f, p2f );
+		return;
+	}
+
+	// put the crosspoint DIST_EPSILON pixels on the near side
+	float frac, frac2;
+	int side = CM_SplitAtPlane( t1, t2, offset, frac, frac2 );
+
+	// move up to the node
+	Vector mid;
+	frac = clamp( frac, 0.f, 1.f );
+	float midf = p1f + (p2f - p1f)*frac;
+	VectorLerp( p1, p2, frac, mid );
+
+	CM_RecursiveRayCheck( tree, lane, tree.GetChild( num, side ), p1f, midf, p1, mid );
+
+	// go past the node
+	frac2 = clamp( frac2, 0.f, 1.f );
+	midf = p1f + (p2f - p1f)*frac2;
+	VectorLerp( p1, p2, frac2, mid );
+
+	CM_RecursiveRayCheck( tree, lane, tree.GetChild( num, side^1 ), midf, p2f, mid, p2 );
+}
+
+template < class TREE >
+void CM_RecursiveRayCheck( TREE &tree, int lane, int num, float p1f, float p2f, const Vector &p1, const Vector &p2 )
+{
+	if ( tree.HitBefore( lane, p1f ) )
+		return;		// already hit something nearer
+
+	CM_RecursiveRayDescend( tree, lane, num, p1f, p2f, p1, p2 );
+}
+
+
+template < class TREE >
+void CM_RayPacketDescend( TREE &tree, int num, const RayPacket_t &packet, int nLaneMask );
+
+//-----------------------------------------------------------------------------
+// Sends up to four rays down a BSP tree together, testing them against each node
+// with one set of SIMD ops for as long as they go the same way. Each ray visits
+// the same leaves, in the same order and with the same fractions, as it would
+// walking the tree on its own, so the traces come out exactly the same.
+// Only rays without extents can share a packet.
+//
+// TREE provides what CM_RecursiveRayCheck needs, with GetOffset always 0.
+//-----------------------------------------------------------------------------
+template < class TREE >
+void CM_RecursiveRayPacketCheck( TREE &tree, int num, const RayPacket_t &packet, int nLaneMask )
+{
+	for ( int i = 0; i < RAYPACKET_SIZE; i++ )
+	{
+		if ( ( nLaneMask & ( 1 << i ) ) && tree.HitBefore( i, SubFloat( packet.m_p1f, i ) ) )
+		{
+			nLaneMask &= ~( 1 << i );
+		}
+	}
+
+	CM_RayPacketDescend( tree, num, packet, nLaneMask );
+}
+
+template < class TREE >
+void CM_RayPacketDescend( TREE &tree, int num, const RayPacket_t &packet, int nLaneMask )
+{
+	if ( !nLaneMask )
+		return;
+
+	// A lone ray is quicker on its own
+	if ( !( nLaneMask & ( nLaneMask - 1 ) ) )
+	{
+		int i = 0;
+		while ( !( nLaneMask & ( 1 << i ) ) )
+		{
+			i++;
+		}
+
+		float p1f, p2f;
+		Vector p1, p2;
+		packet.GetLane( i, p1f, p2f, p1, p2 );
+		CM_RecursiveRayDescend( tree, i, num, p1f, p2f, p1, p2 );
+		return;
+	}
+
+	// Sums can be rounded differently by the single ray walk, so a lane's distances are only
+	// trusted while they're further from the plane than any rounding could move them
+	fltx4 roundingError = ReplicateX4( RAYPACKET_ROUNDING_ERROR );
+
+	const cplane_t *plane = NULL;
+	int nFront = 0, nBack = 0;
+	while ( num >= 0 )
+	{
+		plane = tree.GetPlane( num );
+		fltx4 dist = ReplicateX4( plane->dist );
+		if ( plane->type < 3 )
+		{
+			// a single subtraction, always exactly the same as the lone ray's
+			fltx4 t1 = SubSIMD( packet.m_p1[plane->type], dist );
+			fltx4 t2 = SubSIMD( packet.m_p2[plane->type], dist );
+			nFront = TestSignSIMD( AndSIMD( CmpGtSIMD( t1, Four_Zeros ), CmpGtSIMD( t2, Four_Zeros ) ) ) & nLaneMask;
+			nBack = TestSignSIMD( AndSIMD( CmpLtSIMD( t1, Four_Zeros ), CmpLtSIMD( t2, Four_Zeros ) ) ) & nLaneMask;
+		}
+		else
+		{
+			fltx4 nx = ReplicateX4( plane->normal.x );
+			fltx4 ny = ReplicateX4( plane->normal.y );
+			fltx4 nz = ReplicateX4( plane->normal.z );
+			fltx4 x1 = MulSIMD( nx, packet.m_p1[0] ), y1 = MulSIMD( ny, packet.m_p1[1] ), z1 = MulSIMD( nz, packet.m_p1[2] );
+			fltx4 x2 = MulSIMD( nx, packet.m_p2[0] ), y2 = MulSIMD( ny, packet.m_p2[1] ), z2 = MulSIMD( nz, packet.m_p2[2] );
+			fltx4 t1 = SubSIMD( AddSIMD( AddSIMD( x1, y1 ), z1 ), dist );
+			fltx4 t2 = SubSIMD( AddSIMD( AddSIMD( x2, y2 ), z2 ), dist );
+
+			fltx4 absDist = fabs( dist );
+			fltx4 err1 = MulSIMD( AddSIMD( AddSIMD( AddSIMD( fabs( x1 ), fabs( y1 ) ), fabs( z1 ) ), absDist ), roundingError );
+			fltx4 err2 = MulSIMD( AddSIMD( AddSIMD( AddSIMD( fabs( x2 ), fabs( y2 ) ), fabs( z2 ) ), absDist ), roundingError );
+			nFront = TestSignSIMD( AndSIMD( CmpGtSIMD( t1, err1 ), CmpGtSIMD( t2, err2 ) ) ) & nLaneMask;
+			nBack = TestSignSIMD( AndSIMD( CmpLtSIMD( t1, NegSIMD( err1 ) ), CmpLtSIMD( t2, NegSIMD( err2 ) ) ) ) & nLaneMask;
+
+			// too close to call, work these out the way the lone ray does
+			int nUnsure = TestSignSIMD( OrSIMD( CmpInBoundsSIMD( t1, err1 ), CmpInBoundsSIMD( t2, err2 ) ) ) & nLaneMask;
+			for ( int i = 0; nUnsure && i < RAYPACKET_SIZE; i++ )
+			{
+				if ( !( nUnsure & ( 1 << i ) ) )
+					continue;
+
+				float p1f, p2f, lt1, lt2;
+				Vector p1, p2;
+				packet.GetLane( i, p1f, p2f, p1, p2 );
+				CM_RayPacketPlaneDist( plane, p1, p2, lt1, lt2 );
+				if ( lt1 > 0 && lt2 > 0 )
+				{
+					nFront |= 1 << i;
+				}
+				else if ( lt1 < 0 && lt2 < 0 )
+				{
+					nBack |= 1 << i;
+				}
+			}
+		}
+
+		if ( nFront == nLaneMask )
+		{
+			num = tree.GetChild( num, 0 );
+			continue;
+		}
+		if ( nBack == nLaneMask )
+		{
+			num = tree.GetChild( num, 1 );
+			continue;
+		}
+		break;
+	}
+
+	// if < 0, we are in a leaf node
+	if ( num < 0 )
+	{
+		for ( int i = 0; i < RAYPACKET_SIZE; i++ )
+		{
+			if ( nLaneMask & ( 1 << i ) )
+			{
+				tree.TraceToLeaf( i, -1-num, SubFloat( packet.m_p1f, i ), SubFloat( packet.m_p2f, i ) );
+			}
+		}
+		return;
+	}
+
+	// The rays all on one side carry on down it
+	CM_RayPacketDescend( tree, tree.GetChild( num, 0 ), packet, nFront );
+	CM_RayPacketDescend( tree, tree.GetChild( num, 1 ), packet, nBack );
+
+	// The rest cross the plane, split them there
+	int nCross = nLaneMask & ~( nFront | nBack );
+	int nSideMask[2] = { 0, 0 };
+	float frac[RAYPACKET_SIZE], frac2[RAYPACKET_SIZE];
+	for ( int i = 0; i < RAYPACKET_SIZE; i++ )
+	{
+		if ( !( nCross & ( 1 << i ) ) )
+			continue;
+
+		float t1, t2;
+		Vector p1( SubFloat( packet.m_p1[0], i ), SubFloat( packet.m_p1[1], i ), SubFloat( packet.m_p1[2], i ) );
+		Vector p2( SubFloat( packet.m_p2[0], i ), SubFloat( packet.m_p2[1], i ), SubFloat( packet.m_p2[2], i ) );
+		CM_RayPacketPlaneDist( plane, p1, p2, t1, t2 );
+
+		int side = CM_SplitAtPlane( t1, t2, 0.0f, frac[i], frac2[i] );
+		nSideMask[side] |= 1 << i;
+	}
+
+	// and walk each one's near part before its far part
+	for ( int side = 0; side < 2; side++ )
+	{
+		if ( !nSideMask[side] )
+			continue;
+
+		RayPacket_t nearPacket = packet;
+		RayPacket_t farPacket = packet;
+		for ( int i = 0; i < RAYPACKET_SIZE; i++ )
+		{
+			if ( !( nSideMask[side] & ( 1 << i ) ) )
+				continue;
+
+			float p1f, p2f, midf;
+			Vector p1, p2, mid;
+			packet.GetLane( i, p1f, p2f, p1, p2 );
+
+			// move up to the node
+			float f = clamp( frac[i], 0.f, 1.f );
+			midf = p1f + (p2f - p1f)*f;
+			VectorLerp( p1, p2, f, mid );
+			nearPacket.SetLane( i, p1f, midf, p1, mid );
+
+			// go past the node
+			f = clamp( frac2[i], 0.f, 1.f );
+			midf = p1f + (p2f - p1f)*f;
+			VectorLerp( p1, p2, f, mid );
+			farPacket.SetLane( i, midf, p2f, mid, p2 );
+		}
+
+		CM_RecursiveRayPacketCheck( tree, tree.GetChild( num, side ), nearPacket, nSideMask[side] );
+		CM_RecursiveRayPacketCheck( tree, tree.GetChild( num, side ^ 1 ), farPacket, nSideMask[side] );
+	}
+}
+
+
+#endif // CMODEL_RAYPACKET_H
@@ -42,8 +42,6 @@
 #endif
 #include "tier3/tier3.h"
 #include <vgui/ILocalize.h>
-#include "tier1/lzss.h"
-#include "tier1/snappy.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -1219,202 +1217,3 @@ bool COM_IsValidLogFilename( const char *pszFilename )
 
 	return true;
 }
-
-//-----------------------------------------------------------------------------
-unsigned int COM_GetIdealDestinationCompressionBufferSize_Snappy( unsigned int uncompressedSize )
-{
-	// 4 for the ID, plus whatever Snappy says it would need.
-	return 4 + snappy::MaxCompressedLength( uncompressedSize );
-}
-
-//-----------------------------------------------------------------------------
-void *COM_CompressBuffer_Snappy( const void *source, unsigned int sourceLen, unsigned int *compressedLen, unsigned int maxCompressedLen )
-{
-	Assert( source );
-	Assert( compressedLen );
-
-	// Allocate a buffer big enough to hold the worst case.
-	unsigned nMaxCompressedSize = COM_GetIdealDestinationCompressionBufferSize_Snappy( sourceLen );
-	char *pCompressed = (char*)malloc( nMaxCompressedSize );
-	if ( pCompressed == NULL )
-		return NULL;
-
-	// Do the compression
-	*(uint32 *)pCompressed = SNAPPY_ID;
-	size_t compressed_length;
-	snappy::RawCompress( (const char *)source, sourceLen, pCompressed + sizeof(uint32), &compressed_length );
-	compressed_length += 4;
-	Assert( compressed_length <= nMaxCompressedSize );
-
-	// Check if this result is OK
-	if ( maxCompressedLen != 0 && compressed_length > maxCompressedLen )
-	{
-		free( pCompressed );
-		return NULL;
-	}
-
-	*compressedLen = compressed_length;
-	return pCompressed;
-}
-
-//-----------------------------------------------------------------------------
-bool COM_BufferToBufferCompress_Snappy( void *dest, unsigned int *destLen, const void *source, unsigned int sourceLen )
-{
-	Assert( dest );
-	Assert( destLen );
-	Assert( source );
-
-	// Check if we need to use a temporary buffer
-	unsigned nMaxCompressedSize = COM_GetIdealDestinationCompressionBufferSize_Snappy( sourceLen );
-	unsigned compressedLen = *destLen;
-	if ( compressedLen < nMaxCompressedSize )
-	{
-
-		// Yep.  Use the other function to allocate the buffer of the right size and comrpess into it
-		void *temp = COM_CompressBuffer_Snappy( source, sourceLen, &compressedLen, compressedLen );
-		if ( temp == NULL )
-			return false;
-
-		// Copy over the data
-		V_memcpy( dest, temp, compressedLen );
-		*destLen = compressedLen;
-		free( temp );
-		return true;
-	}
-
-	// We have room and should be able to compress directly
-	*(uint32 *)dest = SNAPPY_ID;
-	size_t compressed_length;
-	snappy::RawCompress( (const char *)source, sourceLen, (char *)dest + sizeof(uint32), &compressed_length );
-	compressed_length += 4;
-	Assert( compressed_length <= nMaxCompressedSize );
-	*destLen = compressed_length;
-	return true;
-}
-
-//-----------------------------------------------------------------------------
-unsigned COM_GetIdealDestinationCompressionBufferSize_LZSS( unsigned int uncompressedSize )
-{
-	// Our LZSS compressor doesn't need any extra space because it will stop and fail
-	// as soon as it figures out it's unable to reduce the size of the data by more than
-	// 32 bytes
-	return uncompressedSize;
-}
-
-//-----------------------------------------------------------------------------
-void *COM_CompressBuffer_LZSS( const void *source, unsigned int sourceLen, unsigned int *compressedLen, unsigned int maxCompressedLen )
-{
-	Assert( source );
-	Assert( compressedLen );
-
-	CLZSS s;
-	unsigned int uCompressedLen = 0;
-	byte *pbOut = s.Compress( (const byte *)source, sourceLen, &uCompressedLen );
-	if ( pbOut && uCompressedLen > 0 && ( uCompressedLen <= maxCompressedLen || maxCompressedLen == 0 ) )
-	{
-		*compressedLen = uCompressedLen;
-		return pbOut;
-	}
-
-	if ( pbOut )
-	{
-		free( pbOut );
-	}
-	return NULL;
-}
-
-//-----------------------------------------------------------------------------
-bool COM_BufferToBufferCompress_LZSS( void *dest, unsigned int *destLen, const void *source, unsigned int sourceLen )
-{
-	Assert( dest );
-	Assert( destLen );
-	Assert( source );
-
-	CLZSS s;
-	unsigned int uCompressedLen = 0;
-	if ( !s.CompressNoAlloc( (const byte *)source, sourceLen, (unsigned char *)dest, &uCompressedLen ) )
-		return false;
-
-	*destLen = uCompressedLen;
-	return true;
-}
-
-//-----------------------------------------------------------------------------
-int COM_GetUncompressedSize( const void *compressed, unsigned int compressedLen )
-{
-	const lzss_header_t *pHeader = (const lzss_header_t *)compressed;
-
-	// Check for our own LZSS compressed data
-	if ( ( compressedLen >= sizeof(lzss_header_t) ) && pHeader->id == LZSS_ID )
-		return LittleLong( pHeader->actualSize );
-
-	// Check for Snappy compressed
-	if ( compressedLen > sizeof(pHeader->id) && pHeader->id == SNAPPY_ID )
-	{
-		size_t snappySize;
-		if ( snappy::GetUncompressedLength( (const char *)compressed + sizeof(pHeader->id), compressedLen-sizeof(pHeader->id), &snappySize ) )
-			return (int)snappySize;
-	}
-
-	return -1;
-}
-
-//-----------------------------------------------------------------------------
-// Purpose: Generic buffer decompression from source into dest
-//-----------------------------------------------------------------------------
-bool COM_BufferToBufferDecompress( void *dest, unsigned int *destLen, const void *source, unsigned int sourceLen )
-{
-	int nDecompressedSize = COM_GetUncompressedSize( source, sourceLen );
-	if ( nDecompressedSize >= 0 )
-	{
-
-		// Check buffer size
-		if ( (unsigned)nDecompressedSize > *destLen )
-		{
-			Warning( "NET_BufferToBufferDecompress with improperly sized dest buffer (%u in, %u needed)\n", *destLen, nDecompressedSize );
-			return false;
-		}
-
-		const lzss_header_t *pHeader = (const lzss_header_t *)source;
-		if ( pHeader->id == LZSS_ID )
-		{
-			CLZSS s;
-			int nActualDecompressedSize = s.SafeUncompress( (byte *)source, sourceLen, (byte *)dest, *destLen );
-			if ( nActualDecompressedSize != nDecompressedSize )
-			{
-				Warning( "NET_BufferToBufferDecompress: header said %d bytes would be decompressed, but we LZSS decompressed %d\n", nDecompressedSize, nActualDecompressedSize );
-				return false;
-			}
-			*destLen = nDecompressedSize;
-			return true;
-		}
-
-		if ( pHeader->id == SNAPPY_ID )
-		{
-			if ( !snappy::RawUncompress( (const char *)source + 4, sourceLen - 4, (char *)dest ) )
-			{
-				Warning( "NET_BufferToBufferDecompress: Snappy decompression failed\n" );
-				return false;
-			}
-			*destLen = nDecompressedSize;
-			return true;
-		}
-
-		// Mismatch between this routine and COM_GetUncompressedSize
-		AssertMsg( false, "Unknown compression type?" );
-		return false;
-	}
-	else
-	{
-		if ( sourceLen > *destLen )
-		{
-			Warning( "NET_BufferToBufferDecompress with improperly sized dest buffer (%u in, %u needed)\n", *destLen, sourceLen );
-			return false;
-		}
-
-		V_memcpy( dest, source, sourceLen );
-		*destLen = sourceLen;
-	}
-
-	return true;
-}
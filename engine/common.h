@@ -114,6 +114,30 @@ void *COM_CompressBuffer_Snappy( const void *source, unsigned int sourceLen, uns
 bool COM_BufferToBufferCompress_Snappy( void *dest, unsigned int *destLen, const void *source, unsigned int sourceLen );
 unsigned int COM_GetIdealDestinationCompressionBufferSize_Snappy( unsigned int uncompressedSize );
 
+bool COM_BufferToBufferCompress_LZ4( void *dest, unsigned int *destLen, const void *source, unsigned int sourceLen );
+unsigned int COM_GetIdealDestinationCompressionBufferSize_LZ4( unsigned int uncompressedSize );
+
+/// Codecs COM_BufferToBufferDecompress understands. Net channels pick one of the codecs
+/// the remote side advertised it can decompress (see net_compresscodecs).
+enum CompressionCodec_t
+{
+	COMPRESSION_CODEC_SNAPPY = 0,
+	COMPRESSION_CODEC_LZSS,
+	COMPRESSION_CODEC_LZ4,
+
+	COMPRESSION_CODEC_COUNT
+};
+
+#define COMPRESSION_CODEC_BIT( codec )		( 1 << ( codec ) )
+
+// Every engine since Snappy was added can decompress these
+#define COMPRESSION_CODECS_DEFAULT			( COMPRESSION_CODEC_BIT( COMPRESSION_CODEC_SNAPPY ) | COMPRESSION_CODEC_BIT( COMPRESSION_CODEC_LZSS ) )
+#define COMPRESSION_CODECS_ALL				( COMPRESSION_CODECS_DEFAULT | COMPRESSION_CODEC_BIT( COMPRESSION_CODEC_LZ4 ) )
+
+const char *COM_GetCompressionCodecName( CompressionCodec_t codec );
+unsigned int COM_GetIdealDestinationCompressionBufferSize_Codec( CompressionCodec_t codec, unsigned int uncompressedSize );
+bool COM_BufferToBufferCompress_Codec( CompressionCodec_t codec, void *dest, unsigned int *destLen, const void *source, unsigned int sourceLen );
+
 /// Fetch ideal working buffer size.  You should allocate the buffer you wish to compress into
 /// at least this big, in order to get the best performance when using COM_BufferToBufferCompress
 inline unsigned int COM_GetIdealDestinationCompressionBufferSize( unsigned int uncompressedSize )
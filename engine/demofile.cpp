@@ -13,6 +13,9 @@
 #include "demo.h"
 #include "proto_version.h"
 #include "convar.h"	// For dbg_demofile
+#include "tier0/threadtools.h"
+#include "tier0/tslist.h"
+#include "tier1/snappy.h"
 
 // NOTE: This has to be the last file included!
 #include "tier0/memdbgon.h"
@@ -46,6 +49,250 @@ int CDbgPrint::s_nIndent = 0;
 #define DemoFileDbg(_txt) (void)0
 #endif
 
+// Async demos are collected in blocks of about this size before they're handed to the writer
+#define DEMO_ASYNC_BLOCK_SIZE	( 256 * 1024 )
+
+//-----------------------------------------------------------------------------
+// A block of demo data waiting to be written. m_nFileOffset is where it goes in
+// the file, -1 appends it.
+//-----------------------------------------------------------------------------
+struct DemoBlock_t : TSLNodeBase_t
+{
+	int			m_nFileOffset;
+	CUtlBuffer	m_Buffer;
+};
+
+//-----------------------------------------------------------------------------
+// Writes demo blocks to disk on its own thread, so recording never waits on the
+// file system. The recording thread fills one block while the previous ones are
+// written, written blocks are recycled.
+//-----------------------------------------------------------------------------
+class CDemoAsyncWriter : public CThread
+{
+public:
+	CDemoAsyncWriter()
+	{
+		SetName( "DemoWriter" );
+		m_hFile = FILESYSTEM_INVALID_HANDLE;
+		m_bThreadShouldExit = false;
+		m_bCompress = false;
+		m_bWriteError = false;
+		m_nFlushBytes = 0;
+		m_nUnflushedBytes = 0;
+		m_nLogicalPos = 0;
+		m_nMaxQueued = 0;
+		m_nBytesWritten = 0;
+		m_nBytesOnDisk = 0;
+	}
+
+	~CDemoAsyncWriter()
+	{
+		Close();
+
+		DemoBlock_t *pBlock;
+		while ( ( pBlock = m_FreeBlocks.Pop() ) != NULL )
+		{
+			delete pBlock;
+		}
+	}
+
+	bool Open( const char *name, bool bCompress, int nFlushBytes )
+	{
+		m_hFile = g_pFileSystem->Open( name, "wb" );
+		if ( m_hFile == FILESYSTEM_INVALID_HANDLE )
+			return false;
+
+		m_bCompress = bCompress;
+		m_nFlushBytes = nFlushBytes;
+		m_bThreadShouldExit = false;
+
+		if ( !Start() )
+		{
+			g_pFileSystem->Close( m_hFile );
+			m_hFile = FILESYSTEM_INVALID_HANDLE;
+			return false;
+		}
+
+		return true;
+	}
+
+	// Waits for everything queued to be written. Returns false if a write failed.
+	bool Close()
+	{
+		if ( m_hFile == FILESYSTEM_INVALID_HANDLE )
+			return !m_bWriteError;
+
+		if ( IsAlive() )
+		{
+			m_bThreadShouldExit = true;
+			m_QueuedEvent.Set();
+			Join();
+		}
+
+		// anything queued after the thread saw the exit flag
+		WriteQueuedBlocks();
+
+		g_pFileSystem->Flush( m_hFile );
+		g_pFileSystem->Close( m_hFile );
+		m_hFile = FILESYSTEM_INVALID_HANDLE;
+
+		return !m_bWriteError;
+	}
+
+	DemoBlock_t *AllocBlock()
+	{
+		DemoBlock_t *pBlock = m_FreeBlocks.Pop();
+		if ( !pBlock )
+		{
+			pBlock = new DemoBlock_t;
+			pBlock->m_Buffer.EnsureCapacity( DEMO_ASYNC_BLOCK_SIZE + DEMO_ASYNC_BLOCK_SIZE / 4 );
+		}
+
+		pBlock->m_Buffer.Clear();
+		pBlock->m_Buffer.SetBigEndian( false );
+		pBlock->m_nFileOffset = -1;
+		return pBlock;
+	}
+
+	void Submit( DemoBlock_t *pBlock )
+	{
+		m_QueuedBlocks.PushItem( pBlock );
+
+		int nQueued = ++m_nQueued;
+		if ( nQueued > m_nMaxQueued )
+		{
+			m_nMaxQueued = nQueued;
+		}
+
+		m_QueuedEvent.Set();
+	}
+
+	void GetStats( int &nQueuedBlocks, int &nMaxQueuedBlocks, int64 &nBytesWritten, int64 &nBytesOnDisk )
+	{
+		nQueuedBlocks = m_nQueued;
+		nMaxQueuedBlocks = m_nMaxQueued;
+		nBytesWritten = m_nBytesWritten;
+		nBytesOnDisk = m_nBytesOnDisk;
+	}
+
+private:
+	virtual int Run()
+	{
+		for ( ;; )
+		{
+			bool bExit = m_bThreadShouldExit;
+
+			WriteQueuedBlocks();
+
+			if ( bExit )
+				break;
+
+			m_QueuedEvent.Wait( 100 );
+		}
+
+		return 0;
+	}
+
+	void WriteQueuedBlocks()
+	{
+		DemoBlock_t *pBlock;
+		while ( m_QueuedBlocks.PopItem( &pBlock ) )
+		{
+			WriteBlock( pBlock );
+			--m_nQueued;
+			m_FreeBlocks.Push( pBlock );
+		}
+	}
+
+	void WriteData( const void *pData, int nBytes )
+	{
+		if ( g_pFileSystem->Write( pData, nBytes, m_hFile ) != nBytes )
+		{
+			m_bWriteError = true;
+		}
+
+		m_nBytesOnDisk += nBytes;
+		m_nUnflushedBytes += nBytes;
+	}
+
+	void WriteBlock( DemoBlock_t *pBlock )
+	{
+		const char *pData = (const char *)pBlock->m_Buffer.Base();
+		int nBytes = MAX( 0, pBlock->m_Buffer.TellMaxPut() );
+
+		if ( pBlock->m_nFileOffset >= 0 )
+		{
+			// rewrites something already on disk, the header is never compressed
+			unsigned int nEnd = g_pFileSystem->Tell( m_hFile );
+			g_pFileSystem->Seek( m_hFile, pBlock->m_nFileOffset, FILESYSTEM_SEEK_HEAD );
+			if ( g_pFileSystem->Write( pData, nBytes, m_hFile ) != nBytes )
+			{
+				m_bWriteError = true;
+			}
+			g_pFileSystem->Seek( m_hFile, nEnd, FILESYSTEM_SEEK_HEAD );
+			return;
+		}
+
+		m_nBytesWritten += nBytes;
+
+		if ( !m_bCompress )
+		{
+			WriteData( pData, nBytes );
+		}
+		else
+		{
+			// the demo header is stored as is so it can still be read and rewritten in place
+			int nRawBytes = MIN( nBytes, MAX( 0, (int)sizeof( demoheader_t ) - m_nLogicalPos ) );
+			if ( nRawBytes > 0 )
+			{
+				WriteData( pData, nRawBytes );
+			}
+
+			int nCompressBytes = nBytes - nRawBytes;
+			if ( nCompressBytes > 0 )
+			{
+				m_Compressed.EnsureCount( 2 * sizeof( int ) + snappy::MaxCompressedLength( nCompressBytes ) );
+
+				size_t nCompressedBytes = 0;
+				snappy::RawCompress( pData + nRawBytes, nCompressBytes, m_Compressed.Base() + 2 * sizeof( int ), &nCompressedBytes );
+
+				int *pSizes = (int *)m_Compressed.Base();
+				pSizes[0] = LittleLong( nCompressBytes );
+				pSizes[1] = LittleLong( (int)nCompressedBytes );
+
+				WriteData( m_Compressed.Base(), 2 * sizeof( int ) + (int)nCompressedBytes );
+			}
+		}
+
+		m_nLogicalPos += nBytes;
+
+		if ( m_nFlushBytes > 0 && m_nUnflushedBytes >= m_nFlushBytes )
+		{
+			g_pFileSystem->Flush( m_hFile );
+			m_nUnflushedBytes = 0;
+		}
+	}
+
+	FileHandle_t						m_hFile;
+	CTSQueue< DemoBlock_t * >			m_QueuedBlocks;
+	CTSSimpleList< DemoBlock_t >		m_FreeBlocks;
+	CThreadEvent						m_QueuedEvent;
+	volatile bool						m_bThreadShouldExit;
+
+	// only touched by the writer thread while it runs
+	bool								m_bCompress;
+	bool								m_bWriteError;
+	int									m_nFlushBytes;
+	int									m_nUnflushedBytes;
+	int									m_nLogicalPos;
+	CUtlVector< char >					m_Compressed;
+
+	CInterlockedInt						m_nQueued;
+	int									m_nMaxQueued;
+	volatile int64						m_nBytesWritten;
+	volatile int64						m_nBytesOnDisk;
+};
+
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
@@ -53,7 +300,11 @@ int CDbgPrint::s_nIndent = 0;
 CDemoFile::CDemoFile() :
 	m_pBuffer( NULL ),
 	m_bAllowHeaderWrite( true ),
-	m_bIsStreamBuffer( false )
+	m_bIsStreamBuffer( false ),
+	m_pAsyncWriter( NULL ),
+	m_pAsyncBlock( NULL ),
+	m_nAsyncOffset( 0 ),
+	m_bAsyncCompress( false )
 {
 }
 
@@ -146,6 +397,13 @@ void CDemoFile::WriteCmdHeader( unsigned char cmd, int tick )
 	Assert( cmd >= dem_signon && cmd <= dem_lastcmd );
 
 	Assert( m_pBuffer && m_pBuffer->IsValid() );
+	// commands are never split between blocks, so hand the current block to the
+	// writer before starting a new one once it's full
+	if ( m_pAsyncWriter && m_pBuffer->TellPut() >= DEMO_ASYNC_BLOCK_SIZE )
+	{
+		SubmitAsyncBlock();
+	}
+
 	m_pBuffer->PutUnsignedChar( cmd );
 	m_pBuffer->PutInt( tick );
 
@@ -229,7 +487,7 @@ unsigned int CDemoFile::GetCurPos( bool bRead )
 		return 0;
 	if ( bRead )
 		return m_pBuffer->TellGet();
-	return m_pBuffer->TellPut();
+	return m_nAsyncOffset + m_pBuffer->TellPut();
 }
 
 //-----------------------------------------------------------------------------
@@ -332,7 +590,9 @@ void CDemoFile::SeekTo( int position, bool bRead )
 	}
 	else
 	{
-		m_pBuffer->SeekPut( CUtlBuffer::SEEK_HEAD, position );
+		// async files can only seek within the block that's still in memory
+		Assert( position >= m_nAsyncOffset );
+		m_pBuffer->SeekPut( CUtlBuffer::SEEK_HEAD, position - m_nAsyncOffset );
 	}
 }
 
@@ -413,11 +673,29 @@ void CDemoFile::WriteDemoHeader()
 	demoheader_t littleEndianHeader = *((demoheader_t*)&m_DemoHeader);
 	ByteSwap_demoheader_t( littleEndianHeader );
 
+	if ( m_bAsyncCompress )
+	{
+		Q_strncpy( littleEndianHeader.demofilestamp, DEMO_HEADER_ID_COMPRESSED, sizeof( littleEndianHeader.demofilestamp ) );
+	}
+
+	if ( m_pAsyncWriter && m_nAsyncOffset > 0 )
+	{
+		// the start of the file was already handed to the writer, queue the header
+		// after everything else so it overwrites the old one in place
+		SubmitAsyncBlock();
+
+		DemoBlock_t *pHeaderBlock = m_pAsyncWriter->AllocBlock();
+		pHeaderBlock->m_nFileOffset = 0;
+		pHeaderBlock->m_Buffer.Put( &littleEndianHeader, sizeof( littleEndianHeader ) );
+		m_pAsyncWriter->Submit( pHeaderBlock );
+		return;
+	}
+
 	// Goto file start
 	m_pBuffer->SeekPut( CUtlBuffer::SEEK_HEAD, 0 );
 
 	// Write
-	m_pBuffer->Put( &m_DemoHeader, sizeof( m_DemoHeader ) );
+	m_pBuffer->Put( &littleEndianHeader, sizeof( littleEndianHeader ) );
 }
 
 demoheader_t *CDemoFile::ReadDemoHeader()
@@ -485,6 +763,127 @@ void CDemoFile::WriteFileBytes( FileHandle_t fh, int length )
 	g_pFileSystem->Flush ( fh );
 }
 
+void CDemoFile::AddIndexEntry( int tick, int offset, int length )
+{
+	demoindexentry_t &entry = m_Index[ m_Index.AddToTail() ];
+	entry.tick = tick;
+	entry.offset = offset;
+	entry.length = length;
+}
+
+void CDemoFile::WriteIndex()
+{
+	DemoFileDbg( "WriteIndex()\n" );
+
+	if ( !m_pBuffer || !m_pBuffer->IsValid() || !m_Index.Count() )
+		return;
+
+	int nIndexOffset = GetCurPos( false );
+
+	m_pBuffer->PutInt( m_Index.Count() );
+	for ( int i = 0; i < m_Index.Count(); i++ )
+	{
+		m_pBuffer->PutInt( m_Index[i].tick );
+		m_pBuffer->PutInt( m_Index[i].offset );
+		m_pBuffer->PutInt( m_Index[i].length );
+	}
+
+	m_pBuffer->PutInt( nIndexOffset );
+	m_pBuffer->Put( DEMO_INDEX_ID, sizeof( DEMO_INDEX_ID ) );
+}
+
+bool CDemoFile::ReadIndex()
+{
+	m_Index.RemoveAll();
+
+	const int nTrailerSize = sizeof( int ) + sizeof( DEMO_INDEX_ID );
+	int nSize = GetSize();
+
+	if ( !m_pBuffer || !m_pBuffer->IsValid() || nSize < (int)sizeof( demoheader_t ) + nTrailerSize )
+		return false;
+
+	int nGet = m_pBuffer->TellGet();
+
+	m_pBuffer->SeekGet( CUtlBuffer::SEEK_HEAD, nSize - nTrailerSize );
+	int nIndexOffset = m_pBuffer->GetInt();
+
+	char id[ sizeof( DEMO_INDEX_ID ) ];
+	m_pBuffer->Get( id, sizeof( id ) );
+
+	if ( m_pBuffer->IsValid() && !Q_memcmp( id, DEMO_INDEX_ID, sizeof( id ) ) &&
+		nIndexOffset >= (int)sizeof( demoheader_t ) && nIndexOffset < nSize - nTrailerSize )
+	{
+		m_pBuffer->SeekGet( CUtlBuffer::SEEK_HEAD, nIndexOffset );
+
+		int nCount = m_pBuffer->GetInt();
+		if ( nCount > 0 && nCount <= ( nSize - nTrailerSize - nIndexOffset ) / (int)sizeof( demoindexentry_t ) )
+		{
+			m_Index.EnsureCapacity( nCount );
+
+			for ( int i = 0; i < nCount && m_pBuffer->IsValid(); i++ )
+			{
+				demoindexentry_t entry;
+				entry.tick = m_pBuffer->GetInt();
+				entry.offset = m_pBuffer->GetInt();
+				entry.length = m_pBuffer->GetInt();
+
+				// keyframes are written in order and all before the index
+				if ( entry.offset < (int)sizeof( demoheader_t ) || entry.length <= 0 || entry.offset + entry.length > nIndexOffset ||
+					( m_Index.Count() && ( entry.tick < m_Index.Tail().tick || entry.offset < m_Index.Tail().offset + m_Index.Tail().length ) ) )
+				{
+					ConDMsg( "%s has an invalid demo index, ignoring it.\n", m_szFileName );
+					m_Index.RemoveAll();
+					break;
+				}
+
+				m_Index.AddToTail( entry );
+			}
+
+			if ( !m_pBuffer->IsValid() )
+			{
+				m_Index.RemoveAll();
+			}
+		}
+	}
+
+	m_pBuffer->SeekGet( CUtlBuffer::SEEK_HEAD, nGet );
+
+	return m_Index.Count() > 0;
+}
+
+const demoindexentry_t *CDemoFile::FindKeyframe( int tick )
+{
+	// last entry with entry.tick <= tick
+	int nLow = 0;
+	int nHigh = m_Index.Count();
+	while ( nLow < nHigh )
+	{
+		int nMid = ( nLow + nHigh ) / 2;
+		if ( m_Index[nMid].tick <= tick )
+			nLow = nMid + 1;
+		else
+			nHigh = nMid;
+	}
+
+	return nLow > 0 ? &m_Index[nLow - 1] : NULL;
+}
+
+const demoindexentry_t *CDemoFile::FindKeyframeAtPos( int offset )
+{
+	int nLow = 0;
+	int nHigh = m_Index.Count();
+	while ( nLow < nHigh )
+	{
+		int nMid = ( nLow + nHigh ) / 2;
+		if ( m_Index[nMid].offset < offset )
+			nLow = nMid + 1;
+		else
+			nHigh = nMid;
+	}
+
+	return ( nLow < m_Index.Count() && m_Index[nLow].offset == offset ) ? &m_Index[nLow] : NULL;
+}
+
 bool CDemoFile::Open(const char *name, bool bReadOnly, bool bMemoryBuffer, int nBufferSize/*=0*/, bool bAllowHeaderWrite/*=true*/)
 {
 	if ( m_pBuffer && m_pBuffer->IsValid() )
@@ -495,6 +894,7 @@ bool CDemoFile::Open(const char *name, bool bReadOnly, bool bMemoryBuffer, int n
 
 	m_szFileName[0] = 0;  // clear name
 	Q_memset( &m_DemoHeader, 0, sizeof(m_DemoHeader) ); // and demo header
+	m_Index.RemoveAll();
 
 	// This is used by replay, which manually writes a header.
 	m_bAllowHeaderWrite = bAllowHeaderWrite;
@@ -523,6 +923,13 @@ bool CDemoFile::Open(const char *name, bool bReadOnly, bool bMemoryBuffer, int n
 		return false;
 	}
 
+	if ( bReadOnly && !UncompressDemo() )
+	{
+		ConMsg ("CDemoFile::Open: couldn't decompress demo file %s.\n", name );
+		Close();
+		return false;
+	}
+
 	if ( name )
 	{
 		Q_strncpy( m_szFileName, name, sizeof(m_szFileName) );
@@ -531,6 +938,136 @@ bool CDemoFile::Open(const char *name, bool bReadOnly, bool bMemoryBuffer, int n
 	return true;
 }
 
+bool CDemoFile::OpenAsync( const char *name, bool bCompress, int nFlushKB )
+{
+	if ( m_pBuffer && m_pBuffer->IsValid() )
+	{
+		ConMsg ("CDemoFile::OpenAsync: file already open.\n");
+		return false;
+	}
+
+	m_szFileName[0] = 0;  // clear name
+	Q_memset( &m_DemoHeader, 0, sizeof(m_DemoHeader) ); // and demo header
+	m_Index.RemoveAll();
+
+	m_bAllowHeaderWrite = true;
+
+	m_pAsyncWriter = new CDemoAsyncWriter;
+	if ( !m_pAsyncWriter->Open( name, bCompress, nFlushKB * 1024 ) )
+	{
+		ConMsg ("CDemoFile::OpenAsync: couldn't open file %s for writing.\n", name );
+		delete m_pAsyncWriter;
+		m_pAsyncWriter = NULL;
+		return false;
+	}
+
+	m_bAsyncCompress = bCompress;
+	m_nAsyncOffset = 0;
+	m_pAsyncBlock = m_pAsyncWriter->AllocBlock();
+
+	// the block buffer belongs to the writer, Close() must not delete it
+	m_pBuffer = &m_pAsyncBlock->m_Buffer;
+	m_bIsStreamBuffer = false;
+
+	Q_strncpy( m_szFileName, name, sizeof(m_szFileName) );
+
+	return true;
+}
+
+void CDemoFile::SubmitAsyncBlock( bool bAllocNext )
+{
+	m_nAsyncOffset += MAX( 0, m_pBuffer->TellMaxPut() );
+	m_pAsyncWriter->Submit( m_pAsyncBlock );
+
+	if ( !bAllocNext )
+	{
+		m_pAsyncBlock = NULL;
+		m_pBuffer = NULL;
+		return;
+	}
+
+	m_pAsyncBlock = m_pAsyncWriter->AllocBlock();
+	m_pBuffer = &m_pAsyncBlock->m_Buffer;
+}
+
+void CDemoFile::GetAsyncStats( int &nQueuedBlocks, int &nMaxQueuedBlocks, int64 &nBytesWritten, int64 &nBytesOnDisk )
+{
+	if ( !m_pAsyncWriter )
+	{
+		nQueuedBlocks = nMaxQueuedBlocks = 0;
+		nBytesWritten = nBytesOnDisk = 0;
+		return;
+	}
+
+	m_pAsyncWriter->GetStats( nQueuedBlocks, nMaxQueuedBlocks, nBytesWritten, nBytesOnDisk );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Compressed demos are decompressed into memory up front, the rest of
+//			the demo code reads them like any other file.
+//-----------------------------------------------------------------------------
+bool CDemoFile::UncompressDemo()
+{
+	demoheader_t header;
+	m_pBuffer->Get( &header, sizeof( header ) );
+
+	bool bCompressed = m_pBuffer->IsValid() &&
+		!Q_strncmp( header.demofilestamp, DEMO_HEADER_ID_COMPRESSED, sizeof( header.demofilestamp ) );
+
+	if ( !bCompressed )
+	{
+		m_pBuffer->SeekGet( CUtlBuffer::SEEK_HEAD, 0 );
+		return true;
+	}
+
+	CUtlBuffer *pBuffer = new CUtlBuffer( 0, 4 * DEMO_ASYNC_BLOCK_SIZE, 0 );
+	pBuffer->SetBigEndian( false );
+
+	Q_strncpy( header.demofilestamp, DEMO_HEADER_ID, sizeof( header.demofilestamp ) );
+	pBuffer->Put( &header, sizeof( header ) );
+
+	CUtlVector< char > compressed;
+	bool bOk = true;
+
+	while ( bOk && m_pBuffer->GetBytesRemaining() > 0 )
+	{
+		int nSize = m_pBuffer->GetInt();
+		int nCompressedSize = m_pBuffer->GetInt();
+
+		if ( !m_pBuffer->IsValid() || nSize <= 0 || nCompressedSize <= 0 )
+		{
+			bOk = false;
+			break;
+		}
+
+		compressed.EnsureCount( nCompressedSize );
+		m_pBuffer->Get( compressed.Base(), nCompressedSize );
+
+		size_t nUncompressedSize = 0;
+		if ( !m_pBuffer->IsValid() ||
+			!snappy::GetUncompressedLength( compressed.Base(), nCompressedSize, &nUncompressedSize ) ||
+			(int)nUncompressedSize != nSize )
+		{
+			bOk = false;
+			break;
+		}
+
+		pBuffer->EnsureCapacity( pBuffer->TellPut() + nSize );
+		if ( !snappy::RawUncompress( compressed.Base(), nCompressedSize, (char *)pBuffer->PeekPut() ) )
+		{
+			bOk = false;
+			break;
+		}
+		pBuffer->SeekPut( CUtlBuffer::SEEK_CURRENT, nSize );
+	}
+
+	delete static_cast<CUtlStreamBuffer*>(m_pBuffer);
+	m_pBuffer = pBuffer;
+	m_bIsStreamBuffer = false;
+
+	return bOk;
+}
+
 bool CDemoFile::IsOpen()
 {
 	return m_pBuffer && m_pBuffer->IsValid();
@@ -538,6 +1075,23 @@ bool CDemoFile::IsOpen()
 
 void CDemoFile::Close()
 {
+	if ( m_pAsyncWriter )
+	{
+		// the writer only frees blocks it has back, don't take another one
+		SubmitAsyncBlock( false );
+
+		if ( !m_pAsyncWriter->Close() )
+		{
+			Warning( "CDemoFile::Close: error writing demo file %s.\n", m_szFileName );
+		}
+
+		delete m_pAsyncWriter;
+		m_pAsyncWriter = NULL;
+		m_nAsyncOffset = 0;
+		m_bAsyncCompress = false;
+		return;
+	}
+
 	// CUtlBuffer base class does NOT have a virtual destructor!
 	if ( m_bIsStreamBuffer )
 	{
@@ -553,7 +1107,7 @@ void CDemoFile::Close()
 
 int CDemoFile::GetSize()
 {
-	return m_pBuffer->TellMaxPut();
+	return m_nAsyncOffset + m_pBuffer->TellMaxPut();
 }
 
 // Returns the PROTOCOL_VERSION used when .dem was recorded
@@ -28,6 +28,8 @@
 // Forward declarations
 //-----------------------------------------------------------------------------
 class IDemoBuffer;
+class CDemoAsyncWriter;
+struct DemoBlock_t;
 
 //-----------------------------------------------------------------------------
 // Demo file 
@@ -39,6 +41,9 @@ class CDemoFile
 	~CDemoFile();
 
 	bool	Open(const char *name, bool bReadOnly, bool bMemoryBuffer = false, int nBufferSize = 0, bool bAllowHeaderWrite = true);
+	// Opens for writing, writes are collected in memory blocks that a background thread
+	// writes to disk, optionally compressed. nFlushKB flushes the file every that many KB.
+	bool	OpenAsync( const char *name, bool bCompress, int nFlushKB );
 	bool	IsOpen();
 	void	Close();
 
@@ -75,14 +80,37 @@ class CDemoFile
 
 	void	WriteFileBytes( FileHandle_t fh, int length );
 
+	// Keyframe index, see DEMO_INDEX_ID. Entries are added while recording and written
+	// after dem_stop, ReadIndex loads them without moving the read position.
+	void	AddIndexEntry( int tick, int offset, int length );
+	void	WriteIndex();
+	bool	ReadIndex();
+	const demoindexentry_t *FindKeyframe( int tick );			// newest keyframe at or before tick
+	const demoindexentry_t *FindKeyframeAtPos( int offset );	// keyframe starting at this file offset
+
 	// Returns the PROTOCOL_VERSION used when .dem was recorded
 	int		GetProtocolVersion();
+
+	bool	IsAsync() const { return m_pAsyncWriter != NULL; }
+	void	GetAsyncStats( int &nQueuedBlocks, int &nMaxQueuedBlocks, int64 &nBytesWritten, int64 &nBytesOnDisk );
+
+private:
+	void	SubmitAsyncBlock( bool bAllocNext = true );
+	bool	UncompressDemo();
+
 public:
 	char			m_szFileName[MAX_PATH];	//name of current demo file
 	demoheader_t    m_DemoHeader;  //general demo info
 	CUtlBuffer		*m_pBuffer;
 	bool			m_bAllowHeaderWrite;
 	bool			m_bIsStreamBuffer;
+	CUtlVector< demoindexentry_t > m_Index;
+
+private:
+	CDemoAsyncWriter *m_pAsyncWriter;
+	DemoBlock_t		*m_pAsyncBlock;		// block m_pBuffer points into
+	int				m_nAsyncOffset;		// file position of the start of the current block
+	bool			m_bAsyncCompress;
 };
 
 #endif // DEMOFILE_H
@@ -67,6 +67,11 @@ class CDeltaBitsReader
 	int		ComparePropData( CDeltaBitsReader* pOut, const SendProp *pProp );
 	void	CopyPropData( bf_write* pOut, const SendProp *pProp );
 
+	// Same as the above for props with a fixed encoded size, see CSendPropEncodeOp::m_nFixedBits.
+	void	SkipPropBits( int nBits );
+	int		ComparePropBits( CDeltaBitsReader* pOut, int nBits );
+	void	CopyPropBits( bf_write* pOut, int nBits );
+
 	// If you know you're done but you're not at the end (you haven't called until
 	// ReadNextPropIndex returns -1), call this so it won't assert in its destructor.
 	void		ForceFinished();
@@ -155,6 +160,32 @@ FORCEINLINE int CDeltaBitsReader::ComparePropData( CDeltaBitsReader *pInReader,
 	return g_PropTypeFns[pProp->m_Type].CompareDeltas( pProp, m_pBuf, pIn );
 }
 
+FORCEINLINE void CDeltaBitsReader::SkipPropBits( int nBits )
+{
+	m_pBuf->SeekRelative( nBits );
+}
+
+FORCEINLINE void CDeltaBitsReader::CopyPropBits( bf_write* pOut, int nBits )
+{
+	pOut->WriteBitsFromBuffer( m_pBuf, nBits );
+}
+
+FORCEINLINE int CDeltaBitsReader::ComparePropBits( CDeltaBitsReader *pInReader, int nBits )
+{
+	bf_read *pIn = pInReader->m_pBuf;
+	int nDiff = 0;
+	while ( nBits > 32 )
+	{
+		nDiff |= m_pBuf->CompareBits( pIn, 32 );
+		nBits -= 32;
+	}
+	if ( nBits > 0 )
+	{
+		nDiff |= m_pBuf->CompareBits( pIn, nBits );
+	}
+	return nDiff;
+}
+
 
 // ------------------------------------------------------------------------------------ //
 // CDeltaBitsWriter.
@@ -188,18 +219,28 @@ inline bf_write* CDeltaBitsWriter::GetBitBuf()
 	return m_pBuf;
 }
 
-FORCEINLINE void CDeltaBitsWriter::WritePropIndex( int iProp )
+// The bits WritePropIndex writes for the distance from the last prop index.
+FORCEINLINE int GetPropIndexDiffBits( unsigned int diff, unsigned int &nData )
 {
-	Assert( iProp >= 0 && iProp < MAX_DATATABLE_PROPS );
-	unsigned int diff = iProp - m_iLastProp;
-	m_iLastProp = iProp;
 	Assert( diff > 0 && diff <= MAX_DATATABLE_PROPS );
 	// Expanded inline for maximum efficiency.
 	//m_pBuf->WriteOneBit( 1 );
 	//m_pBuf->WriteUBitVar( diff - 1 );
 	COMPILE_TIME_ASSERT( MAX_DATATABLE_PROPS <= 0x1000u );
 	int n = ((diff < 0x11u) ? -1 : 0) + ((diff < 0x101u) ? -1 : 0);
-	m_pBuf->WriteUBitLong( diff*8 - 8 + 4 + n*2 + 1, 8 + n*4 + 4 + 2 + 1 );
+	nData = diff*8 - 8 + 4 + n*2 + 1;
+	return 8 + n*4 + 4 + 2 + 1;
+}
+
+FORCEINLINE void CDeltaBitsWriter::WritePropIndex( int iProp )
+{
+	Assert( iProp >= 0 && iProp < MAX_DATATABLE_PROPS );
+	unsigned int diff = iProp - m_iLastProp;
+	m_iLastProp = iProp;
+
+	unsigned int nData;
+	int nBits = GetPropIndexDiffBits( diff, nData );
+	m_pBuf->WriteUBitLong( nData, nBits );
 }
 
 inline CDeltaBitsWriter::~CDeltaBitsWriter()
@@ -410,6 +451,9 @@ class CSendTablePrecalc
 	
 	// Map prop offsets to indices for properties that can use it.
 	CUtlMap<unsigned short, unsigned short> m_PropOffsetToIndexMap;
+
+	// How each of m_Props is encoded, set up by SendTable_InitTable.
+	CUtlVector<CSendPropEncodeOp> m_EncodeOps;
 };
 
 
@@ -58,14 +58,8 @@ static inline bool EncodeSpecialFloat( const SendProp *pProp, float fVal, bf_wri
 }
 
 
-static inline void EncodeFloat( const SendProp *pProp, float fVal, bf_write *pOut, int objectID )
+uint32 EncodeScaledFloat( const SendProp *pProp, float fVal, int objectID )
 {
-	// Check for special flags like SPROP_COORD, SPROP_NOSCALE, and SPROP_NORMAL.
-	if( EncodeSpecialFloat( pProp, fVal, pOut ) )
-	{
-		return;
-	}
-
 	uint32 ulVal;
 	if( fVal < pProp->m_fLowValue )
 	{
@@ -92,8 +86,20 @@ static inline void EncodeFloat( const SendProp *pProp, float fVal, bf_write *pOu
 		float fRangeVal = (fVal - pProp->m_fLowValue) * pProp->m_fHighLowMul;
 		ulVal = RoundFloatToUnsignedLong( fRangeVal );
 	}
-	
-	pOut->WriteUBitLong(ulVal, pProp->m_nBits);
+
+	return ulVal;
+}
+
+
+static inline void EncodeFloat( const SendProp *pProp, float fVal, bf_write *pOut, int objectID )
+{
+	// Check for special flags like SPROP_COORD, SPROP_NOSCALE, and SPROP_NORMAL.
+	if( EncodeSpecialFloat( pProp, fVal, pOut ) )
+	{
+		return;
+	}
+
+	pOut->WriteUBitLong( EncodeScaledFloat( pProp, fVal, objectID ), pProp->m_nBits );
 }
 
 
@@ -1302,6 +1308,109 @@ void Int64_SkipProp( const SendProp *pProp, bf_read *pIn )
 
 
 
+// ---------------------------------------------------------------------------------------- //
+// Encode ops, see CSendPropEncodeOp.
+// ---------------------------------------------------------------------------------------- //
+
+// Same order of precedence as EncodeSpecialFloat
+static SendPropFloatOp_t GetFloatEncodeOp( const SendProp *pProp, int &nFixedBits )
+{
+	int flags = pProp->GetFlags();
+
+	nFixedBits = -1;
+	if ( flags & SPROP_COORD )
+		return SENDPROP_FLOAT_COORD;
+	else if ( flags & SPROP_COORD_MP )
+		return SENDPROP_FLOAT_COORD_MP;
+	else if ( flags & SPROP_COORD_MP_LOWPRECISION )
+		return SENDPROP_FLOAT_COORD_MP_LOWPRECISION;
+	else if ( flags & SPROP_COORD_MP_INTEGRAL )
+		return SENDPROP_FLOAT_COORD_MP_INTEGRAL;
+
+	if ( flags & SPROP_NOSCALE )
+	{
+		nFixedBits = 32;
+		return SENDPROP_FLOAT_NOSCALE;
+	}
+	else if ( flags & SPROP_NORMAL )
+	{
+		nFixedBits = NORMAL_FRACTIONAL_BITS + 1;
+		return SENDPROP_FLOAT_NORMAL;
+	}
+
+	nFixedBits = pProp->m_nBits;
+	return SENDPROP_FLOAT_SCALED;
+}
+
+void SendProp_BuildEncodeOp( const SendProp *pProp, CSendPropEncodeOp *pOp )
+{
+	int flags = pProp->GetFlags();
+	int nFloatBits;
+
+	pOp->m_Op = SENDPROP_ENCODE_GENERIC;
+	pOp->m_FloatOp = SENDPROP_FLOAT_SCALED;
+	pOp->m_nComponents = 0;
+	pOp->m_bNormalSignBit = false;
+	pOp->m_nBits = pProp->m_nBits;
+	pOp->m_nFixedBits = -1;
+	pOp->m_nIntPreserveBits = ~0;
+
+	switch ( pProp->m_Type )
+	{
+	case DPT_Int:
+		if ( flags & SPROP_VARINT )
+		{
+			pOp->m_Op = ( flags & SPROP_UNSIGNED ) ? SENDPROP_ENCODE_VARINT : SENDPROP_ENCODE_SIGNED_VARINT;
+		}
+		else if ( pProp->m_nBits > 0 && pProp->m_nBits <= 32 )
+		{
+			pOp->m_Op = SENDPROP_ENCODE_INT;
+			pOp->m_nFixedBits = pProp->m_nBits;
+			pOp->m_nIntPreserveBits = ( flags & SPROP_UNSIGNED ) ? ~0 : ( 0x7FFFFFFF >> ( 32 - pProp->m_nBits ) );
+		}
+		break;
+
+	case DPT_Float:
+		pOp->m_Op = SENDPROP_ENCODE_FLOAT;
+		pOp->m_FloatOp = GetFloatEncodeOp( pProp, nFloatBits );
+		pOp->m_nComponents = 1;
+		pOp->m_nFixedBits = nFloatBits;
+		break;
+
+	case DPT_Vector:
+		pOp->m_Op = SENDPROP_ENCODE_FLOAT;
+		pOp->m_FloatOp = GetFloatEncodeOp( pProp, nFloatBits );
+		pOp->m_nComponents = 3;
+		pOp->m_bNormalSignBit = ( flags & SPROP_NORMAL ) != 0;
+		if ( nFloatBits >= 0 )
+		{
+			pOp->m_nFixedBits = pOp->m_bNormalSignBit ? nFloatBits * 2 + 1 : nFloatBits * 3;
+		}
+		break;
+
+	case DPT_VectorXY:
+		pOp->m_Op = SENDPROP_ENCODE_FLOAT;
+		pOp->m_FloatOp = GetFloatEncodeOp( pProp, nFloatBits );
+		pOp->m_nComponents = 2;
+		if ( nFloatBits >= 0 )
+		{
+			pOp->m_nFixedBits = nFloatBits * 2;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	// scaled floats are written with WriteUBitLong
+	if ( pOp->m_Op == SENDPROP_ENCODE_FLOAT && pOp->m_FloatOp == SENDPROP_FLOAT_SCALED && ( pProp->m_nBits <= 0 || pProp->m_nBits > 32 ) )
+	{
+		pOp->m_Op = SENDPROP_ENCODE_GENERIC;
+		pOp->m_nFixedBits = -1;
+	}
+}
+
+
 PropTypeFns g_PropTypeFns[DPT_NUMSendPropTypes] =
 {
 	// DPT_Int
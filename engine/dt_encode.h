@@ -86,6 +86,47 @@ typedef struct
 extern PropTypeFns g_PropTypeFns[DPT_NUMSendPropTypes];
 
 
+// How SendTable_Encode writes a flattened prop. This is resolved from the prop's type and flags
+// once when the table is set up, so the encoder can switch on it instead of calling through
+// g_PropTypeFns and testing the flags again for every prop of every entity.
+enum SendPropEncodeOp_t
+{
+	SENDPROP_ENCODE_INT=0,				// m_nBits fixed bits
+	SENDPROP_ENCODE_VARINT,
+	SENDPROP_ENCODE_SIGNED_VARINT,
+	SENDPROP_ENCODE_FLOAT,				// m_nComponents floats written with m_FloatOp
+	SENDPROP_ENCODE_GENERIC				// everything else goes through g_PropTypeFns
+};
+
+enum SendPropFloatOp_t
+{
+	SENDPROP_FLOAT_SCALED=0,
+	SENDPROP_FLOAT_NOSCALE,
+	SENDPROP_FLOAT_NORMAL,
+	SENDPROP_FLOAT_COORD,
+	SENDPROP_FLOAT_COORD_MP,
+	SENDPROP_FLOAT_COORD_MP_LOWPRECISION,
+	SENDPROP_FLOAT_COORD_MP_INTEGRAL
+};
+
+class CSendPropEncodeOp
+{
+public:
+	unsigned char	m_Op;				// SendPropEncodeOp_t
+	unsigned char	m_FloatOp;			// SendPropFloatOp_t
+	unsigned char	m_nComponents;		// 1 for floats, 2 for VectorXY and 3 for Vector
+	bool			m_bNormalSignBit;	// Vector with SPROP_NORMAL: the last component is just a sign bit
+	int				m_nBits;
+	int				m_nFixedBits;		// Encoded size if it doesn't depend on the value, otherwise -1
+	int				m_nIntPreserveBits;	// Int_Encode's low bits kept before sign extending signed ints
+};
+
+void	SendProp_BuildEncodeOp( const SendProp *pProp, CSendPropEncodeOp *pOp );
+
+// Returns the m_nBits value EncodeFloat writes for a prop without special float flags.
+uint32	EncodeScaledFloat( const SendProp *pProp, float fVal, int objectID );
+
+
 // This is used for comparing packed buffers. Just extracts the raw bits for the 
 // data and returns the number of bits used to encode the data.
 int	DecodeBits( DecodeInfo *pInfo, unsigned char *pOut );
@@ -17,6 +17,8 @@
 #include "dt_stack.h"
 #include "common.h"
 #include "packed_entity.h"
+#include "coordsize.h"
+#include "convar.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include <tier0/memdbgon.h>
@@ -29,6 +31,8 @@ class CSendNode;
 
 extern bool Sendprop_UsingDebugWatch();
 
+static ConVar sv_sendtable_encodeops( "sv_sendtable_encodeops", "1", 0, "Encode, delta and copy entity props with the encode ops resolved per SendTable at startup instead of the per type functions." );
+
 
 // This stack doesn't actually call any proxies. It uses the CSendProxyRecipients to tell
 // what can be sent to the specified client.
@@ -316,6 +320,218 @@ static FORCEINLINE void SendTable_EncodeProp( CEncodeInfo * pInfo, unsigned long
 }
 
 
+//-----------------------------------------------------------------------------
+// Collects the fixed size writes of consecutive props and their indices in a
+// 64 bit accumulator, so they go into the buffer a dword at a time.
+//-----------------------------------------------------------------------------
+class CEncodeBitAccumulator
+{
+public:
+	CEncodeBitAccumulator( bf_write *pOut ) : m_pOut( pOut ), m_nData( 0 ), m_nBits( 0 )
+	{
+	}
+
+	// nData mustn't have any bits set above nBits.
+	FORCEINLINE void WriteBits( uint32 nData, int nBits )
+	{
+		Assert( nBits >= 0 && nBits <= 32 );
+		Assert( nBits == 32 || ( nData >> nBits ) == 0 );
+
+		m_nData |= (uint64)nData << m_nBits;
+		m_nBits += nBits;
+		if ( m_nBits >= 32 )
+		{
+			m_pOut->WriteUBitLong( (uint32)m_nData, 32, false );
+			m_nData >>= 32;
+			m_nBits -= 32;
+		}
+	}
+
+	// Must be called before writing to the buffer directly.
+	FORCEINLINE bf_write *Flush()
+	{
+		if ( m_nBits )
+		{
+			m_pOut->WriteUBitLong( (uint32)m_nData, m_nBits, false );
+			m_nData = 0;
+			m_nBits = 0;
+		}
+		return m_pOut;
+	}
+
+private:
+	bf_write	*m_pOut;
+	uint64		m_nData;
+	int			m_nBits;
+};
+
+
+static FORCEINLINE uint32 GetEncodeBitMask( int nBits )
+{
+	return ( nBits < 32 ) ? ( ( 1u << nBits ) - 1 ) : ~0u;
+}
+
+// Returns the encode ops for the table or NULL if they're switched off.
+static FORCEINLINE const CSendPropEncodeOp *SendTable_GetEncodeOps( const CSendTablePrecalc *pPrecalc )
+{
+	if ( !sv_sendtable_encodeops.GetBool() || pPrecalc->m_EncodeOps.Count() != pPrecalc->GetNumProps() )
+		return NULL;
+
+	return pPrecalc->m_EncodeOps.Base();
+}
+
+// Writes a float the same way EncodeFloat in dt_encode.cpp does.
+static FORCEINLINE void SendTable_EncodeFloatOp( CEncodeBitAccumulator &bits, const CSendPropEncodeOp &op, const SendProp *pProp, float fVal, int objectID )
+{
+	switch ( op.m_FloatOp )
+	{
+	case SENDPROP_FLOAT_SCALED:
+		{
+			uint32 ulVal;
+			if ( fVal >= pProp->m_fLowValue && fVal <= pProp->m_fHighValue )
+			{
+				ulVal = RoundFloatToUnsignedLong( ( fVal - pProp->m_fLowValue ) * pProp->m_fHighLowMul );
+			}
+			else
+			{
+				// clamps and warns
+				ulVal = EncodeScaledFloat( pProp, fVal, objectID );
+			}
+			bits.WriteBits( ulVal & GetEncodeBitMask( op.m_nBits ), op.m_nBits );
+		}
+		break;
+
+	case SENDPROP_FLOAT_NOSCALE:
+		{
+			union { float f; uint32 u; } c;
+			c.f = fVal;
+			bits.WriteBits( c.u, 32 );
+		}
+		break;
+
+	case SENDPROP_FLOAT_NORMAL:
+		bits.Flush()->WriteBitNormal( fVal );
+		break;
+
+	case SENDPROP_FLOAT_COORD:
+		bits.Flush()->WriteBitCoord( fVal );
+		break;
+
+	case SENDPROP_FLOAT_COORD_MP:
+		bits.Flush()->WriteBitCoordMP( fVal, false, false );
+		break;
+
+	case SENDPROP_FLOAT_COORD_MP_LOWPRECISION:
+		bits.Flush()->WriteBitCoordMP( fVal, false, true );
+		break;
+
+	case SENDPROP_FLOAT_COORD_MP_INTEGRAL:
+		bits.Flush()->WriteBitCoordMP( fVal, true, false );
+		break;
+	}
+}
+
+// SendTable_Encode's prop loop, running the table's encode ops. The output is the same bits
+// the per type Encode functions write.
+static void SendTable_EncodeOps( CEncodeInfo *pInfo, const CSendPropEncodeOp *pOps, bf_write *pOut, bool bNonZeroOnly )
+{
+	CSendTablePrecalc *pPrecalc = pInfo->m_pPrecalc;
+	int iNumProps = pPrecalc->GetNumProps();
+	int objectID = pInfo->GetObjectID();
+
+	CEncodeBitAccumulator bits( pOut );
+	int iLastProp = -1;
+
+	for ( int iProp=0; iProp < iNumProps; iProp++ )
+	{
+		// skip if we don't have a valid prop proxy
+		if ( !pInfo->IsPropProxyValid( iProp ) )
+			continue;
+
+		pInfo->SeekToProp( iProp );
+
+		const SendProp *pProp = pInfo->GetCurProp();
+		unsigned char *pStructBase = pInfo->GetCurStructBase();
+
+		// Call their proxy to get the property's value.
+		DVariant var;
+		pProp->GetProxyFn()( 
+			pProp,
+			pStructBase, 
+			pStructBase + pProp->GetOffset(), 
+			&var, 
+			0, // iElement
+			objectID
+			);
+
+		// skip empty prop if we only encode non-zero values
+		if ( bNonZeroOnly && g_PropTypeFns[pProp->m_Type].IsZero( pStructBase, &var, pProp ) )
+			continue;
+
+		// Write the index.
+		unsigned int nIndexData;
+		int nIndexBits = GetPropIndexDiffBits( iProp - iLastProp, nIndexData );
+		bits.WriteBits( nIndexData, nIndexBits );
+		iLastProp = iProp;
+
+		const CSendPropEncodeOp &op = pOps[iProp];
+		switch ( op.m_Op )
+		{
+		case SENDPROP_ENCODE_INT:
+			{
+				// same as Int_Encode, out of range signed values keep their sign
+				int nValue = var.m_Int;
+				nValue = ( nValue & op.m_nIntPreserveBits ) | ( ( nValue >> 31 ) & ~op.m_nIntPreserveBits );
+				bits.WriteBits( (uint32)nValue & GetEncodeBitMask( op.m_nBits ), op.m_nBits );
+			}
+			break;
+
+		case SENDPROP_ENCODE_VARINT:
+			bits.Flush()->WriteVarInt32( var.m_Int );
+			break;
+
+		case SENDPROP_ENCODE_SIGNED_VARINT:
+			bits.Flush()->WriteSignedVarInt32( var.m_Int );
+			break;
+
+		case SENDPROP_ENCODE_FLOAT:
+			if ( op.m_nComponents == 1 )
+			{
+				SendTable_EncodeFloatOp( bits, op, pProp, var.m_Float, objectID );
+			}
+			else
+			{
+				SendTable_EncodeFloatOp( bits, op, pProp, var.m_Vector[0], objectID );
+				SendTable_EncodeFloatOp( bits, op, pProp, var.m_Vector[1], objectID );
+
+				if ( op.m_bNormalSignBit )
+				{
+					// Write a sign bit for z instead!
+					bits.WriteBits( var.m_Vector[2] <= -NORMAL_RESOLUTION, 1 );
+				}
+				else if ( op.m_nComponents == 3 )
+				{
+					SendTable_EncodeFloatOp( bits, op, pProp, var.m_Vector[2], objectID );
+				}
+			}
+			break;
+
+		default:
+			g_PropTypeFns[pProp->m_Type].Encode( 
+				pStructBase, 
+				&var, 
+				pProp, 
+				bits.Flush(), 
+				objectID
+				); 
+			break;
+		}
+	}
+
+	bits.Flush();
+}
+
+
 static bool SendTable_IsPropZero( CEncodeInfo *pInfo, unsigned long iProp )
 {
 	const SendProp *pProp = pInfo->GetCurProp();
@@ -428,6 +644,13 @@ bool SendTable_Encode(
 	info.m_pRecipients = pRecipients;	// optional buffer to store the bits for which clients get what data.
 
 	info.Init();
+
+	const CSendPropEncodeOp *pEncodeOps = SendTable_GetEncodeOps( pPrecalc );
+	if ( pEncodeOps )
+	{
+		SendTable_EncodeOps( &info, pEncodeOps, pOut, bNonZeroOnly );
+		return !pOut->IsOverflowed();
+	}
 	
 	int iNumProps = pPrecalc->GetNumProps();
 
@@ -473,6 +696,7 @@ void SendTable_WritePropList(
 	s_debug_bits_start = pOut->GetNumBitsWritten();
 	
 	CSendTablePrecalc *pPrecalc = pTable->m_pPrecalc;
+	const CSendPropEncodeOp *pEncodeOps = SendTable_GetEncodeOps( pPrecalc );
 	CDeltaBitsWriter deltaBitsWriter( pOut );
 
 	bf_read inputBuffer( "SendTable_WritePropList->inputBuffer", pState, BitByte( nBits ), nBits );
@@ -486,7 +710,14 @@ void SendTable_WritePropList(
 		// Seek the 'to' state to the current property we want to check.
 		while ( iToProp < (unsigned int) pCheckProps[i] )
 		{
-			inputBitsReader.SkipPropData( pPrecalc->GetProp( iToProp ) );
+			if ( pEncodeOps && pEncodeOps[iToProp].m_nFixedBits >= 0 )
+			{
+				inputBitsReader.SkipPropBits( pEncodeOps[iToProp].m_nFixedBits );
+			}
+			else
+			{
+				inputBitsReader.SkipPropData( pPrecalc->GetProp( iToProp ) );
+			}
 			iToProp = inputBitsReader.ReadNextPropIndex();
 		}
 
@@ -510,7 +741,14 @@ void SendTable_WritePropList(
 			int iStartBit = pOut->GetNumBitsWritten();
 
 			deltaBitsWriter.WritePropIndex( iToProp );
-			inputBitsReader.CopyPropData( deltaBitsWriter.GetBitBuf(), pProp ); 
+			if ( pEncodeOps && pEncodeOps[iToProp].m_nFixedBits >= 0 )
+			{
+				inputBitsReader.CopyPropBits( deltaBitsWriter.GetBitBuf(), pEncodeOps[iToProp].m_nFixedBits );
+			}
+			else
+			{
+				inputBitsReader.CopyPropData( deltaBitsWriter.GetBitBuf(), pProp ); 
+			}
 
 			nToStateBits = pOut->GetNumBitsWritten() - iStartBit;
 
@@ -562,6 +800,7 @@ int SendTable_CalcDelta(
 	//}
 
 	CSendTablePrecalc* pPrecalc = pTable->m_pPrecalc;
+	const CSendPropEncodeOp *pEncodeOps = SendTable_GetEncodeOps( pPrecalc );
 
 	bf_read toBits( "SendTable_CalcDelta/toBits", pToState, BitByte(nToBits), nToBits );
 	CDeltaBitsReader toBitsReader( &toBits );
@@ -580,15 +819,33 @@ int SendTable_CalcDelta(
 			// Skip any properties in the from state that aren't in the to state.
 			while ( iFromProp < iToProp )
 			{
-				fromBitsReader.SkipPropData( pPrecalc->GetProp( iFromProp ) );
+				if ( pEncodeOps && pEncodeOps[iFromProp].m_nFixedBits >= 0 )
+				{
+					fromBitsReader.SkipPropBits( pEncodeOps[iFromProp].m_nFixedBits );
+				}
+				else
+				{
+					fromBitsReader.SkipPropData( pPrecalc->GetProp( iFromProp ) );
+				}
 				iFromProp = fromBitsReader.ReadNextPropIndex();
 			}
 
 			if ( iFromProp == iToProp )
 			{
 				// The property is in both states, so compare them and write the index 
-				// if the states are different.
-				if ( fromBitsReader.ComparePropData( &toBitsReader, pPrecalc->GetProp( iToProp ) ) )
+				// if the states are different. Fixed size props are compared bit for bit,
+				// which is what their CompareDeltas functions do too.
+				int nDiff;
+				if ( pEncodeOps && pEncodeOps[iToProp].m_nFixedBits >= 0 )
+				{
+					nDiff = fromBitsReader.ComparePropBits( &toBitsReader, pEncodeOps[iToProp].m_nFixedBits );
+				}
+				else
+				{
+					nDiff = fromBitsReader.ComparePropData( &toBitsReader, pPrecalc->GetProp( iToProp ) );
+				}
+
+				if ( nDiff )
 				{
 					*pDeltaProps++ = iToProp;
 					if ( pDeltaProps >= pDeltaPropsEnd )
@@ -603,7 +860,14 @@ int SendTable_CalcDelta(
 			else
 			{
 				// Only the 'to' state has this property, so just skip its data and register a change.
-				toBitsReader.SkipPropData( pPrecalc->GetProp( iToProp ) );
+				if ( pEncodeOps && pEncodeOps[iToProp].m_nFixedBits >= 0 )
+				{
+					toBitsReader.SkipPropBits( pEncodeOps[iToProp].m_nFixedBits );
+				}
+				else
+				{
+					toBitsReader.SkipPropData( pPrecalc->GetProp( iToProp ) );
+				}
 				*pDeltaProps++ = iToProp;
 				if ( pDeltaProps >= pDeltaPropsEnd )
 				{
@@ -763,6 +1027,13 @@ static bool SendTable_InitTable( SendTable *pTable )
 	if ( !pPrecalc->SetupFlatPropertyArray() )
 		return false;
 
+	// Resolve how each prop gets encoded.
+	pPrecalc->m_EncodeOps.SetSize( pPrecalc->GetNumProps() );
+	for ( int iProp=0; iProp < pPrecalc->GetNumProps(); iProp++ )
+	{
+		SendProp_BuildEncodeOp( pPrecalc->GetProp( iProp ), &pPrecalc->m_EncodeOps[iProp] );
+	}
+
 	SendTable_Validate( pPrecalc );
 	return true;
 }
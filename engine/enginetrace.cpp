@@ -82,6 +82,9 @@ abstract_class CEngineTrace : public IEngineTrace
 	// A version that simply accepts a ray (can work as a traceline or tracehull)
 	virtual void	TraceRay( const Ray_t &ray, unsigned int fMask, ITraceFilter *pTraceFilter, trace_t *pTrace );
 
+	// Traces several rays at once, each result is the same as TraceRay gives
+	virtual void	TraceRays( int nRays, const Ray_t *pRays, unsigned int fMask, ITraceFilter *pTraceFilter, trace_t *pTraces );
+
 	// A version that sets up the leaf and entity lists and allows you to pass those in for collision.
 	virtual void	SetupLeafAndEntityListRay( const Ray_t &ray, CTraceListData &traceData );
 	virtual void    SetupLeafAndEntityListBox( const Vector &vecBoxMin, const Vector &vecBoxMax, CTraceListData &traceData );
@@ -158,6 +161,9 @@ abstract_class CEngineTrace : public IEngineTrace
 
 	// Clips a trace to another trace
 	bool ClipTraceToTrace( trace_t &clipTrace, trace_t *pFinalTrace );
+
+	// Clips a trace against the world to the entities along the ray
+	void TraceRayAgainstEntities( const Ray_t &ray, unsigned int fMask, ITraceFilter *pTraceFilter, trace_t *pTrace );
 private:
 	int m_traceStatCounters[NUM_TRACE_STAT_COUNTER];
 	const matrix3x4_t *m_pRootMoveParent;
@@ -1689,6 +1695,62 @@ void CEngineTrace::TraceRay( const Ray_t &ray, unsigned int fMask, ITraceFilter
 	CM_ClearTrace( pTrace );
 
 	// Collide with the world.
+	if ( pTraceFilter->GetTraceType() != TRACE_ENTITIES_ONLY )
+	{
+		CM_BoxTrace( ray, 0, fMask, true, *pTrace );
+	}
+
+	TraceRayAgainstEntities( ray, fMask, pTraceFilter, pTrace );
+}
+
+
+//-----------------------------------------------------------------------------
+// Traces several rays with the same mask and filter. The world is walked for
+// up to four rays at once, then each is traced against the entities along it.
+//-----------------------------------------------------------------------------
+void CEngineTrace::TraceRays( int nRays, const Ray_t *pRays, unsigned int fMask, ITraceFilter *pTraceFilter, trace_t *pTraces )
+{
+#if defined _DEBUG && !defined SWDS
+	if( debugrayenable.GetBool() )
+	{
+		s_FrameRays.AddMultipleToTail( nRays, pRays );
+	}
+#endif
+
+	tmZone( TELEMETRY_LEVEL1, TMZF_NONE, "%s:%d", __FUNCTION__, __LINE__ );
+	VPROF_INCREMENT_COUNTER( "TraceRay", nRays );
+	m_traceStatCounters[TRACE_STAT_COUNTER_TRACERAY] += nRays;
+
+	CTraceFilterHitAll traceFilter;
+	if ( !pTraceFilter )
+	{
+		pTraceFilter = &traceFilter;
+	}
+
+	if ( pTraceFilter->GetTraceType() != TRACE_ENTITIES_ONLY )
+	{
+		CM_BoxTraces( nRays, pRays, 0, fMask, true, pTraces );
+	}
+	else
+	{
+		for ( int i = 0; i < nRays; i++ )
+		{
+			CM_ClearTrace( &pTraces[i] );
+		}
+	}
+
+	for ( int i = 0; i < nRays; i++ )
+	{
+		TraceRayAgainstEntities( pRays[i], fMask, pTraceFilter, &pTraces[i] );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Finishes a trace whose world part is done, clipping it to the entities along the ray
+//-----------------------------------------------------------------------------
+void CEngineTrace::TraceRayAgainstEntities( const Ray_t &ray, unsigned int fMask, ITraceFilter *pTraceFilter, trace_t *pTrace )
+{
 	if ( pTraceFilter->GetTraceType() != TRACE_ENTITIES_ONLY )
 	{
 		ICollideable *pCollide = GetWorldCollideable();
@@ -1701,7 +1763,6 @@ void CEngineTrace::TraceRay( const Ray_t &ray, unsigned int fMask, ITraceFilter
 		Assert(!pCollide || pCollide->GetCollisionOrigin() == vec3_origin );
 		Assert(!pCollide || pCollide->GetCollisionAngles() == vec3_angle );
 
-		CM_BoxTrace( ray, 0, fMask, true, *pTrace );
 		SetTraceEntity( pCollide, pTrace );
 
 		// inside world, no need to check being inside anything else
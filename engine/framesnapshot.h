@@ -51,13 +51,53 @@ class CReplayEntityData
 	unsigned int	m_nNodeCluster;  // if (1<<31) is set it's a node, otherwise a cluster
 };
 
-typedef struct
+//-----------------------------------------------------------------------------
+// Purpose: Cache of uncompressed HLTV/replay packed entities. Entries are hashed
+//  by packed entity into sets of a few entries each, LRU within a set. The sets
+//  are spread over shards with their own lock so clients written in parallel
+//  don't wait on each other, and entries only keep as much data as the entity has.
+//-----------------------------------------------------------------------------
+#define UNPACKED_CACHE_SHARDS		16
+#define UNPACKED_CACHE_SETS			8		// per shard
+#define UNPACKED_CACHE_WAYS			4		// entries per set
+
+class CUnpackedDataCache
 {
-	PackedEntity	*pEntity;	// original packed entity
-	int				counter;	// increaseing counter to find LRU entries
-	int				bits;		// uncompressed data length in bits
-	char			data[MAX_PACKEDENTITY_DATA]; // uncompressed data cache
-} UnpackedDataCache_t;
+public:
+	CUnpackedDataCache();
+
+	// Copies the uncompressed data of pEntity to pOut if it's cached
+	bool	Lookup( const PackedEntity *pEntity, void *pOut, int nOutBytes, int &nBits );
+	void	Add( const PackedEntity *pEntity, const void *pData, int nBits );
+	void	Remove( const PackedEntity *pEntity );
+	void	Purge();
+
+	void	PrintStats();
+	void	ResetStats();
+
+private:
+	struct Entry_t
+	{
+		const PackedEntity	*m_pEntity;
+		int					m_nLastUse;		// shard use counter when last looked up, for LRU
+		int					m_nBits;
+		CUtlMemory<byte>	m_Data;
+	};
+
+	struct Shard_t
+	{
+		CThreadFastMutex	m_Mutex;
+		int					m_nUseCounter;
+		int					m_nHits;
+		int					m_nMisses;
+		int					m_nEvictions;
+		Entry_t				m_Entries[ UNPACKED_CACHE_SETS * UNPACKED_CACHE_WAYS ];
+	};
+
+	Shard_t &GetShard( const PackedEntity *pEntity, Entry_t *&pSet );
+
+	Shard_t		m_Shards[ UNPACKED_CACHE_SHARDS ];
+};
 
 
 
@@ -155,8 +195,8 @@ class CFrameSnapshotManager
 
 	PackedEntity*	GetPreviouslySentPacket( int iEntity, int iSerialNumber );
 
-	// Return the entity sitting in iEntity's slot if iSerialNumber matches its number.
-	UnpackedDataCache_t *GetCachedUncompressedEntity( PackedEntity *pPackedEntity );
+	// Cache for uncompressed versions of compressed packed entities
+	CUnpackedDataCache &GetUnpackedDataCache() { return m_UnpackedDataCache; }
 
 	CThreadFastMutex	&GetMutex();
 
@@ -169,8 +209,7 @@ class CFrameSnapshotManager
 	CUtlLinkedList<CFrameSnapshot*, unsigned short>		m_FrameSnapshots;
 	CClassMemoryPool< PackedEntity >					m_PackedEntitiesPool;
 
-	int								m_nPackedEntityCacheCounter;  // increase with every cache access
-	CUtlVector<UnpackedDataCache_t>	m_PackedEntityCache;	// cache for uncompressed packed entities
+	CUnpackedDataCache		m_UnpackedDataCache;	// cache for uncompressed packed entities
 
 	// The most recently sent packets for each entity
 	PackedEntityHandle_t	m_pPackedData[ MAX_EDICTS ];
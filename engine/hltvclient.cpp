@@ -425,9 +425,24 @@ void CHLTVClient::SendSnapshot( CClientFrame * pFrame )
 {
 	VPROF_BUDGET( "CHLTVClient::SendSnapshot", "HLTV" );
 
+	CClientFrame *pDeltaFrame;
+	if ( !StartSnapshot( pFrame, pDeltaFrame ) )
+		return;
+
+	EncodeAndSendSnapshot( pFrame, pDeltaFrame );
+}
+
+void CHLTVClient::EncodeAndSendSnapshot( CClientFrame *pFrame, CClientFrame *pDeltaFrame )
+{
 	ALIGN4 byte		buf[NET_MAX_PAYLOAD] ALIGN4_POST;
 	bf_write	msg( "CHLTVClient::SendSnapshot", buf, sizeof(buf) );
 
+	WriteSnapshot( pFrame, pDeltaFrame, msg );
+	FinishSnapshot( pFrame, pDeltaFrame, msg );
+}
+
+bool CHLTVClient::StartSnapshot( CClientFrame *pFrame, CClientFrame *&pDeltaFrame )
+{
 	// if we send a full snapshot (no delta-compression) before, wait until client
 	// received and acknowledge that update. don't spam client with full updates
 
@@ -435,7 +450,7 @@ void CHLTVClient::SendSnapshot( CClientFrame * pFrame )
 	{
 		// never send the same snapshot twice
 		m_NetChannel->Transmit();	
-		return;
+		return false;
 	}
 
 	if ( m_nForceWaitForTick > 0 )
@@ -443,10 +458,10 @@ void CHLTVClient::SendSnapshot( CClientFrame * pFrame )
 		// just continue transmitting reliable data
 		Assert( !m_bFakePlayer );	// Should never happen
 		m_NetChannel->Transmit();	
-		return;
+		return false;
 	}
 
-	CClientFrame	*pDeltaFrame = GetDeltaFrame( m_nDeltaTick ); // NULL if delta_tick is not found
+	pDeltaFrame = GetDeltaFrame( m_nDeltaTick ); // NULL if delta_tick is not found
 	CHLTVFrame		*pLastFrame = (CHLTVFrame*) GetDeltaFrame( m_nLastSendTick );
 
 	if ( pLastFrame )
@@ -470,6 +485,11 @@ void CHLTVClient::SendSnapshot( CClientFrame * pFrame )
 		pLastFrame = (CHLTVFrame*) pLastFrame->m_pNext;
 	}
 
+	return true;
+}
+
+void CHLTVClient::WriteSnapshot( CClientFrame *pFrame, CClientFrame *pDeltaFrame, bf_write &msg )
+{
 	// now create client snapshot packet
 
 	// send tick time
@@ -479,10 +499,12 @@ void CHLTVClient::SendSnapshot( CClientFrame * pFrame )
 	// Update shared client/server string tables. Must be done before sending entities
 	m_Server->m_StringTables->WriteUpdateMessage( NULL, GetMaxAckTickCount(), msg );
 
-	// TODO delta cache whole snapshots, not just packet entities. then use net_Align
 	// send entity update, delta compressed if deltaFrame != NULL
 	m_Server->WriteDeltaEntities( this, pFrame, pDeltaFrame, msg );
+}
 
+void CHLTVClient::FinishSnapshot( CClientFrame *pFrame, CClientFrame *pDeltaFrame, bf_write &msg )
+{
 	// write message to packet and check for overflow
 	if ( msg.IsOverflowed() )
 	{
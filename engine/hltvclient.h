@@ -59,6 +59,13 @@ class CHLTVClient : public CBaseClient
 
 public:
 	CClientFrame *GetDeltaFrame( int nTick );
+
+	// SendSnapshot in steps, so the server can encode a snapshot once for all spectators at the
+	// same delta tick. StartSnapshot returns false if no snapshot goes out this frame.
+	bool	StartSnapshot( CClientFrame *pFrame, CClientFrame *&pDeltaFrame );
+	void	WriteSnapshot( CClientFrame *pFrame, CClientFrame *pDeltaFrame, bf_write &msg );
+	void	FinishSnapshot( CClientFrame *pFrame, CClientFrame *pDeltaFrame, bf_write &msg );
+	void	EncodeAndSendSnapshot( CClientFrame *pFrame, CClientFrame *pDeltaFrame );
 	
 public:
 	int		m_nLastSendTick;	// last send tick, don't send ticks twice
@@ -729,12 +729,13 @@ void CHLTVClientState::ReadDeltaEnt( CEntityReadInfo &u )
 
 	// Make space for the baseline data.
 	ALIGN4 char packedData[MAX_PACKEDENTITY_DATA] ALIGN4_POST;
+	ALIGN4 char fromData[MAX_PACKEDENTITY_DATA] ALIGN4_POST;
 	const void *pFromData;
 	int nFromBits;
 
 	if ( pFromPackedEntity->IsCompressed() )
 	{
-		pFromData = m_pHLTV->UncompressPackedEntity( pFromPackedEntity, nFromBits );
+		pFromData = m_pHLTV->UncompressPackedEntity( pFromPackedEntity, nFromBits, fromData );
 	}
 	else
 	{
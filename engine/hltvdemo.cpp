@@ -30,6 +30,11 @@
 
 extern CNetworkStringTableContainer *networkStringTableContainerServer;
 
+static ConVar tv_demo_async( "tv_demo_async", "1", 0, "Write SourceTV demos to disk on a background thread." );
+static ConVar tv_demo_compress( "tv_demo_compress", "0", 0, "Compress SourceTV demos while recording (needs tv_demo_async)." );
+static ConVar tv_demo_keyframe_interval( "tv_demo_keyframe_interval", "30", 0, "Seconds between keyframes in SourceTV demos, playback jumps to these when skipping (0 = off).", true, 0, false, 0 );
+static ConVar tv_demo_flush_kb( "tv_demo_flush_kb", "4096", 0, "Flush SourceTV demos to disk every this many KB written, 0 leaves it to the OS.", true, 0, false, 0 );
+
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
@@ -62,7 +67,17 @@ void CHLTVDemoRecorder::StartRecording( const char *filename, bool bContinuously
 {
 	StopRecording();	// stop if we're already recording
 	
-	if ( !m_DemoFile.Open( filename, false ) )
+	bool bOpened;
+	if ( tv_demo_async.GetBool() )
+	{
+		bOpened = m_DemoFile.OpenAsync( filename, tv_demo_compress.GetBool(), tv_demo_flush_kb.GetInt() );
+	}
+	else
+	{
+		bOpened = m_DemoFile.Open( filename, false );
+	}
+
+	if ( !bOpened )
 	{
 		ConMsg ("StartRecording: couldn't open demo file %s.\n", filename );
 		return;
@@ -98,6 +113,8 @@ void CHLTVDemoRecorder::StartRecording( const char *filename, bool bContinuously
 
 	m_nStartTick = host_tickcount;
 
+	m_nLastKeyframeTick = 0;
+
 	// Demo playback should read this as an incoming message.
 	// Write the client's realtime value out so we can synchronize the reads.
 	m_DemoFile.WriteCmdHeader( dem_synctick, 0 );
@@ -121,6 +138,9 @@ void CHLTVDemoRecorder::StopRecording()
 	// Demo playback should read this as an incoming message.
 	m_DemoFile.WriteCmdHeader( dem_stop, GetRecordingTick() );
 
+	// keyframe index goes after dem_stop, older engines never read past it
+	m_DemoFile.WriteIndex();
+
 	// update demo header info
 	m_DemoFile.m_DemoHeader.playback_ticks = GetRecordingTick();
 	m_DemoFile.m_DemoHeader.playback_time =  host_state.interval_per_tick *	GetRecordingTick();
@@ -383,7 +403,38 @@ void CHLTVDemoRecorder::WriteFrame( CHLTVFrame *pFrame )
 	m_nDeltaTick = pFrame->tick_count;
 
 	// write packet to demo file
+	m_nFrameCount++;
 	WriteMessages( dem_packet, msg ); 
+
+	int nKeyframeInterval = TIME_TO_TICKS( tv_demo_keyframe_interval.GetFloat() );
+	if ( nKeyframeInterval > 0 && GetRecordingTick() - m_nLastKeyframeTick >= nKeyframeInterval )
+	{
+		msg.Reset();
+		WriteKeyframe( pFrame, msg );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes the state after the packet just written as a full string table
+//			dump and a full entity update. Regular playback skips over these, demo
+//			playback jumps to them when skipping ahead.
+//-----------------------------------------------------------------------------
+void CHLTVDemoRecorder::WriteKeyframe( CHLTVFrame *pFrame, bf_write &msg )
+{
+	int nStart = m_DemoFile.GetCurPos( false );
+
+	RecordStringTables();
+
+	NET_Tick tickmsg( pFrame->tick_count, host_frametime_unbounded, host_frametime_stddeviation );
+	tickmsg.WriteToBuffer( msg );
+
+	// not delta compressed, the next regular packet is still a delta from this tick
+	sv.WriteDeltaEntities( hltv->m_MasterClient, pFrame, NULL, msg );
+
+	WriteMessages( dem_packet, msg );
+
+	m_DemoFile.AddIndexEntry( GetRecordingTick(), nStart, m_DemoFile.GetCurPos( false ) - nStart );
+	m_nLastKeyframeTick = GetRecordingTick();
 }
 
 void CHLTVDemoRecorder::WriteMessages( unsigned char cmd, bf_write &message )
@@ -406,11 +457,6 @@ void CHLTVDemoRecorder::WriteMessages( unsigned char cmd, bf_write &message )
 	// and wait for packet time
 	// byte cmd = (m_pDemoFileHeader != NULL)  ? dem_signon : dem_packet;
 
-	if ( cmd == dem_packet )
-	{
-		m_nFrameCount++;
-	}
-
 	// write command & time
 	m_DemoFile.WriteCmdHeader( cmd, GetRecordingTick() ); 
 	
@@ -451,6 +497,7 @@ void CHLTVDemoRecorder::RecordPacket()
 {
 	if( m_MessageData.GetBasePointer() )
 	{
+		m_nFrameCount++;
 		WriteMessages( dem_packet, m_MessageData );
 		m_MessageData.Reset(); // clear message buffer
 	}
@@ -45,6 +45,7 @@ class CHLTVDemoRecorder : public IDemoRecorder
 
 public:
 	void	WriteFrame( CHLTVFrame *pFrame );
+	void	WriteKeyframe( CHLTVFrame *pFrame, bf_write &msg );
 	void	CloseFile();
 	void	Reset();
 
@@ -62,6 +63,7 @@ class CHLTVDemoRecorder : public IDemoRecorder
 	int				m_SequenceInfo;
 	int				m_nDeltaTick;	
 	int				m_nSignonTick;
+	int				m_nLastKeyframeTick;	// recording tick of the last keyframe
 	bf_write		m_MessageData; // temp buffer for all network messages
 };
 
@@ -87,6 +87,24 @@ ConVar tv_debug( "tv_debug", "0", 0, "SourceTV debug info." );
 ConVar tv_title( "tv_title", "SourceTV", 0, "Set title for SourceTV spectator UI", tv_title_changed_f );
 static ConVar tv_deltacache( "tv_deltacache", "2", 0, "Enable delta entity bit stream cache" );
 static ConVar tv_relayvoice( "tv_relayvoice", "1", 0, "Relay voice data: 0=off, 1=on" );
+static ConVar tv_broadcast( "tv_broadcast", "1", 0, "Encode delta snapshots once for all spectators at the same delta tick" );
+
+#define MAX_SNAPSHOT_GROUPS	16
+
+// A delta snapshot encoded once and sent to every spectator that would have been sent the same bits
+struct SnapshotGroup_t
+{
+	CClientFrame		*pDeltaFrame;
+	int					nStringTableTick;	// string table changes after this tick are included
+	int					nBaselineUsed;
+	bool				bBaselinePending;	// snapshot may become a baseline update
+	int					nBaselineUpdateTick;	// baseline state the encode left behind
+	CBitVec<MAX_EDICTS>	baselinesSent;
+	CUtlVector<int>		enterEntities;		// entities that may enter the PVS, written against the baseline
+	CUtlVector<PackedEntityHandle_t> enterBaselines;	// and the baselines they were written against
+	CUtlMemory<byte>	data;
+	bf_write			msg;
+};
 
 CDeltaEntityCache::CDeltaEntityCache()
 {
@@ -475,6 +493,7 @@ CHLTVServer::CHLTVServer()
 	m_nGlobalSlots = 0;
 	m_nGlobalClients = 0;
 	m_nGlobalProxies = 0;
+	m_nSnapshotGroups = 0;
 }
 
 CHLTVServer::~CHLTVServer()
@@ -488,6 +507,8 @@ CHLTVServer::~CHLTVServer()
 	// make sure everything was destroyed
 	Assert( m_CurrentFrame == NULL );
 	Assert( CountClientFrames() == 0 );
+
+	m_SnapshotGroups.PurgeAndDeleteElements();
 }
 
 void CHLTVServer::SetMaxClients( int number )
@@ -1372,6 +1393,8 @@ CClientFrame *CHLTVServer::AddNewFrame( CClientFrame *clientFrame )
 
 void CHLTVServer::SendClientMessages ( bool bSendSnapshots )
 {
+	m_nSnapshotGroups = 0;
+
 	// build individual updates
 	for ( int i=0; i< m_Clients.Count(); i++ )
 	{
@@ -1387,7 +1410,14 @@ void CHLTVServer::SendClientMessages ( bool bSendSnapshots )
 		if ( m_CurrentFrame && client->IsActive() )
 		{
 			// don't send same snapshot twice
-			client->SendSnapshot( m_CurrentFrame );
+			if ( tv_broadcast.GetBool() )
+			{
+				BroadcastSnapshot( client, m_CurrentFrame );
+			}
+			else
+			{
+				client->SendSnapshot( m_CurrentFrame );
+			}
 		}
 		else
 		{
@@ -1400,6 +1430,139 @@ void CHLTVServer::SendClientMessages ( bool bSendSnapshots )
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Sends a snapshot to a spectator, sharing the encoded bits with all
+//			other spectators that are at the same delta tick this frame
+//-----------------------------------------------------------------------------
+void CHLTVServer::BroadcastSnapshot( CHLTVClient *client, CClientFrame *pFrame )
+{
+	VPROF_BUDGET( "CHLTVServer::BroadcastSnapshot", "HLTV" );
+
+	CClientFrame *pDeltaFrame;
+	if ( !client->StartSnapshot( pFrame, pDeltaFrame ) )
+		return;
+
+	SnapshotGroup_t *pGroup = NULL;
+
+	// full updates are sent reliable, tracing clients want to see their own bits
+	if ( pDeltaFrame && client->m_pBaseline && !client->IsTracing() )
+	{
+		pGroup = FindSnapshotGroup( client, pDeltaFrame );
+
+		if ( pGroup )
+		{
+			// leave the baseline state like our own encode would have
+			if ( pGroup->bBaselinePending )
+			{
+				client->m_BaselinesSent = pGroup->baselinesSent;
+				client->m_nBaselineUpdateTick = pGroup->nBaselineUpdateTick;
+			}
+		}
+		else
+		{
+			pGroup = AddSnapshotGroup( client, pFrame, pDeltaFrame );
+		}
+	}
+
+	if ( !pGroup )
+	{
+		client->EncodeAndSendSnapshot( pFrame, pDeltaFrame );
+		return;
+	}
+
+	// every spectator may reset its copy on overflow
+	bf_write msg = pGroup->msg;
+	client->FinishSnapshot( pFrame, pDeltaFrame, msg );
+}
+
+SnapshotGroup_t *CHLTVServer::FindSnapshotGroup( CHLTVClient *client, CClientFrame *pDeltaFrame )
+{
+	int nStringTableTick = client->GetMaxAckTickCount();
+	bool bBaselinePending = ( client->m_nBaselineUpdateTick == -1 );
+
+	for ( int i = 0; i < m_nSnapshotGroups; i++ )
+	{
+		SnapshotGroup_t *pGroup = m_SnapshotGroups[i];
+
+		if ( pGroup->pDeltaFrame != pDeltaFrame ||
+			 pGroup->nStringTableTick != nStringTableTick ||
+			 pGroup->nBaselineUsed != client->m_nBaselineUsed ||
+			 pGroup->bBaselinePending != bBaselinePending )
+			continue;
+
+		// entities entering the PVS are written against the spectator's own baselines
+		CFrameSnapshot *pBaseline = client->m_pBaseline;
+		bool bSameBaselines = true;
+
+		FOR_EACH_VEC( pGroup->enterEntities, iEntity )
+		{
+			if ( pBaseline->m_pEntities[ pGroup->enterEntities[iEntity] ].m_pPackedData != pGroup->enterBaselines[iEntity] )
+			{
+				bSameBaselines = false;
+				break;
+			}
+		}
+
+		if ( bSameBaselines )
+			return pGroup;
+	}
+
+	return NULL;
+}
+
+SnapshotGroup_t *CHLTVServer::AddSnapshotGroup( CHLTVClient *client, CClientFrame *pFrame, CClientFrame *pDeltaFrame )
+{
+	if ( m_nSnapshotGroups >= MAX_SNAPSHOT_GROUPS )
+		return NULL;
+
+	if ( m_nSnapshotGroups == m_SnapshotGroups.Count() )
+	{
+		SnapshotGroup_t *pNew = new SnapshotGroup_t;
+		pNew->data.EnsureCapacity( NET_MAX_PAYLOAD );
+		m_SnapshotGroups.AddToTail( pNew );
+	}
+
+	SnapshotGroup_t *pGroup = m_SnapshotGroups[ m_nSnapshotGroups++ ];
+
+	pGroup->pDeltaFrame = pDeltaFrame;
+	pGroup->nStringTableTick = client->GetMaxAckTickCount();
+	pGroup->nBaselineUsed = client->m_nBaselineUsed;
+	pGroup->bBaselinePending = ( client->m_nBaselineUpdateTick == -1 );
+
+	// entities that are new or were recreated since the delta frame, a superset of the ones
+	// the encode writes as entering the PVS
+	CFrameSnapshot *pToSnapshot = pFrame->GetSnapshot();
+	CFrameSnapshot *pFromSnapshot = pDeltaFrame->GetSnapshot();
+
+	pGroup->enterEntities.RemoveAll();
+	pGroup->enterBaselines.RemoveAll();
+
+	int nEntity = pFrame->transmit_entity.FindNextSetBit( 0 );
+	while ( nEntity >= 0 && nEntity < pToSnapshot->m_nNumEntities )
+	{
+		if ( !pDeltaFrame->transmit_entity.Get( nEntity ) ||
+			 nEntity >= pFromSnapshot->m_nNumEntities ||
+			 pFromSnapshot->m_pEntities[nEntity].m_nSerialNumber != pToSnapshot->m_pEntities[nEntity].m_nSerialNumber ||
+			 pFromSnapshot->m_pEntities[nEntity].m_pClass != pToSnapshot->m_pEntities[nEntity].m_pClass )
+		{
+			pGroup->enterEntities.AddToTail( nEntity );
+			pGroup->enterBaselines.AddToTail( client->m_pBaseline->m_pEntities[nEntity].m_pPackedData );
+		}
+
+		nEntity = pFrame->transmit_entity.FindNextSetBit( nEntity + 1 );
+	}
+
+	pGroup->msg.StartWriting( pGroup->data.Base(), NET_MAX_PAYLOAD );
+	pGroup->msg.SetDebugName( "CHLTVServer::BroadcastSnapshot" );
+
+	client->WriteSnapshot( pFrame, pDeltaFrame, pGroup->msg );
+
+	pGroup->nBaselineUpdateTick = client->m_nBaselineUpdateTick;
+	pGroup->baselinesSent = client->m_BaselinesSent;
+
+	return pGroup;
+}
+
 void CHLTVServer::UpdateStats( void )
 {
 	if ( m_fNextSendUpdateTime > net_time )
@@ -2205,6 +2368,17 @@ CON_COMMAND( tv_status, "Show SourceTV server status." )
 	{
 		ConMsg("Recording to \"%s\", length %s.\n", hltv->m_DemoRecorder.GetDemoFile()->m_szFileName, 
 			COM_FormatSeconds( host_state.interval_per_tick * hltv->m_DemoRecorder.GetRecordingTick() ) );
+
+		CDemoFile *pDemoFile = hltv->m_DemoRecorder.GetDemoFile();
+		if ( pDemoFile->IsAsync() )
+		{
+			int nQueued, nMaxQueued;
+			int64 nBytesWritten, nBytesOnDisk;
+			pDemoFile->GetAsyncStats( nQueued, nMaxQueued, nBytesWritten, nBytesOnDisk );
+
+			ConMsg("Demo writer queue %i (max %i), %i KB written, %i KB on disk\n",
+				nQueued, nMaxQueued, (int)( nBytesWritten / 1024 ), (int)( nBytesOnDisk / 1024 ) );
+		}
 	}		
 }
 
@@ -88,6 +88,7 @@ class CDeltaEntityCache
 class CGameClient;
 class CGameServer;
 class IHLTVDirector;
+struct SnapshotGroup_t;
 
 class CHLTVServer : public IGameEventListener2, public CBaseServer, public CClientFrameManager, public IHLTVServer, public IDemoPlayer
 {
@@ -206,6 +207,11 @@ friend class CHLTVClientState;
 	void		ReadCompleteDemoFile();
 	void		ResyncDemoClock();
 
+	// snapshot broadcast to spectators at the same delta tick
+	void		BroadcastSnapshot( CHLTVClient *client, CClientFrame *pFrame );
+	SnapshotGroup_t *FindSnapshotGroup( CHLTVClient *client, CClientFrame *pDeltaFrame );
+	SnapshotGroup_t *AddSnapshotGroup( CHLTVClient *client, CClientFrame *pFrame, CClientFrame *pDeltaFrame );
+
 #ifndef NO_STEAM
 	void		ReplyInfo( const netadr_t &adr );
 #endif
@@ -247,6 +253,9 @@ friend class CHLTVClientState;
 	CDeltaEntityCache				m_DeltaCache;
 	CUtlVector<CFrameCacheEntry_s>	m_FrameCache;
 
+	CUtlVector<SnapshotGroup_t*>	m_SnapshotGroups;	// reused every frame
+	int								m_nSnapshotGroups;	// groups in use this frame
+
 	// demoplayer stuff:
 	CDemoFile		m_DemoFile;		// for demo playback
 	int				m_nStartTick;
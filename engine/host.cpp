@@ -28,6 +28,7 @@
 #include "eiface.h"
 #include "sv_main.h"
 #include "sv_log.h"
+#include "sv_phaseprofile.h"
 #include "shadowmgr.h"
 #include "zone.h"
 #include "gl_cvars.h"
@@ -2669,7 +2670,9 @@ void _Host_RunFrame_Server( bool finaltick )
 
 	// Run the Server frame ( read, run physics, respond )
 	g_HostTimes.StartFrameSegment( FRAME_SEGMENT_SERVER );
+	SV_PhaseProfile_BeginTick();
 	SV_Frame ( finaltick );
+	SV_PhaseProfile_EndTick( sv.m_nTickCount );
 	g_HostTimes.EndFrameSegment( FRAME_SEGMENT_SERVER );
 
 	// Look for connectionless rcon packets on dedicated servers
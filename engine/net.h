@@ -137,6 +137,9 @@ void		NET_OutOfBandPrintf(int sock, const netadr_t &adr, PRINTF_FORMAT_STRING co
 int			NET_SendPacket ( INetChannel *chan, int sock,  const netadr_t &to, const  unsigned char *data, int length, bf_write *pVoicePayload = NULL, bool bUseCompression = false );
 // Called periodically to maybe send any queued packets (up to 4 per frame)
 void		NET_SendQueuedPackets();
+// Collect outgoing datagrams from here on and send them with as few syscalls as possible on flush
+void		NET_BeginBatchedSends();
+void		NET_FlushBatchedSends();
 // Start set current network configuration
 void		NET_SetMutiplayer(bool multiplayer);
 // Set net_time
@@ -168,6 +171,10 @@ unsigned short NET_NetToHostShort( unsigned short us_in );
 // Find out what port is mapped to a local socket
 unsigned short NET_GetUDPPort(int socket);
 
+// OS handles of the server UDP sockets the main thread reads itself, so the host can
+// wait for packets on them. Returns the number of handles written.
+int NET_GetServerSocketHandles( int *pHandles, int nMaxHandles );
+
 // add/remove extra sockets for testing
 int NET_AddExtraSocket( int port );
 void NET_RemoveAllExtraSockets();
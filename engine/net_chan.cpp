@@ -43,6 +43,10 @@ static ConVar net_chokeloopback( "net_chokeloop", "0", 0, "Apply bandwidth choke
 static ConVar net_maxfilesize( "net_maxfilesize", "16", 0, "Maximum allowed file size for uploading in MB", true, 0, true, 64 );
 static ConVar net_compresspackets( "net_compresspackets", "1", 0, "Use compression on game packets." );
 static ConVar net_compresspackets_minsize( "net_compresspackets_minsize", "1024", 0, "Don't bother compressing packets below this size." );
+static ConVar net_compresspackets_codec( "net_compresspackets_codec", "0", 0, "Codec for compressed packets and reliable data if the remote side supports it: 0 = fastest available, 1 = snappy, 2 = lzss, 3 = lz4", true, 0, true, COMPRESSION_CODEC_COUNT );
+static ConVar net_compresspackets_lzss_minsize( "net_compresspackets_lzss_minsize", "0", 0, "Reliable data blocks of at least this size are compressed with LZSS, smaller but much slower to compress (0 = never)." );
+// Tells the server which codecs we can decompress, everything COM_BufferToBufferDecompress knows
+static ConVar net_compresscodecs( "net_compresscodecs", "7", FCVAR_USERINFO | FCVAR_HIDDEN, "Mask of compression codecs this client can decompress." );
 static ConVar net_maxcleartime( "net_maxcleartime", "4.0", 0, "Max # of seconds we can wait for next packets to be sent based on rate setting (0 == no limit)." );
 static ConVar net_maxpacketdrop( "net_maxpacketdrop", "5000", 0, "Ignore any packets with the sequence number more than this ahead (0 == no limit)" );
 
@@ -166,27 +170,32 @@ void CNetChan::CompressFragments()
 			CFastTimer compressTimer;
 			compressTimer.Start();
 
-			// fragments data is in memory
-			unsigned int compressedSize = COM_GetIdealDestinationCompressionBufferSize_Snappy( data->bytes );
-			char * compressedData = new char[ compressedSize ];
+			CompressionCodec_t codec = GetCompressionCodec( i, data->bytes );
 
-			if ( COM_BufferToBufferCompress_Snappy( compressedData, &compressedSize, data->buffer, data->bytes ) &&
+			// fragments data is in memory, compress it straight into the new fragments buffer
+			unsigned int compressedSize = COM_GetIdealDestinationCompressionBufferSize_Codec( codec, data->bytes );
+			char * compressedData = new char[ PAD_NUMBER( compressedSize, 4 ) ];
+
+			if ( COM_BufferToBufferCompress_Codec( codec, compressedData, &compressedSize, data->buffer, data->bytes ) &&
 				( compressedSize < data->bytes ) )
 			{
 				compressTimer.End(); 
-				DevMsg("Compressing fragments (%d -> %d bytes): %.2fms\n",
-						data->bytes, compressedSize, compressTimer.GetDuration().GetMillisecondsF() );
+				DevMsg("Compressing fragments with %s (%d -> %d bytes): %.2fms\n",
+						COM_GetCompressionCodecName( codec ), data->bytes, compressedSize, compressTimer.GetDuration().GetMillisecondsF() );
 
-				// copy compressed data but dont reallocate memory
-				Q_memcpy( data->buffer, compressedData, compressedSize );
+				// swap in the compressed buffer
+				delete [] data->buffer;
+				data->buffer = compressedData;
 
 				data->nUncompressedSize = data->bytes;
 				data->bytes = compressedSize;
 				data->numFragments = BYTES2FRAGMENTS(data->bytes);
 				data->isCompressed = true;				
 			}
-
-			delete [] compressedData; // free temp buffer
+			else
+			{
+				delete [] compressedData;
+			}
 		}
 		else // it's a file
 		{
@@ -458,6 +467,7 @@ CNetChan::CNetChan()
 	m_FileRequestCounter = 0;
 	m_bFileBackgroundTranmission = true;
 	m_bUseCompression = false;
+	m_nCompressionCodecs = COMPRESSION_CODECS_DEFAULT;
 	m_nQueuedPackets = 0;
 
 	m_flRemoteFrameTime = 0;
@@ -716,6 +726,34 @@ void CNetChan::SetCompressionMode( bool bUseCompression )
 	m_bUseCompression = bUseCompression;
 }
 
+void CNetChan::SetCompressionCodecs( int nCodecs )
+{
+	// everybody can decompress snappy
+	m_nCompressionCodecs = ( nCodecs & COMPRESSION_CODECS_ALL ) | COMPRESSION_CODEC_BIT( COMPRESSION_CODEC_SNAPPY );
+}
+
+CompressionCodec_t CNetChan::GetCompressionCodec( int stream, int nBytes ) const
+{
+	// forced by the server operator
+	int nCodec = net_compresspackets_codec.GetInt() - 1;
+	if ( nCodec >= 0 && nCodec < COMPRESSION_CODEC_COUNT && ( m_nCompressionCodecs & COMPRESSION_CODEC_BIT( nCodec ) ) )
+		return (CompressionCodec_t)nCodec;
+
+	// compressed files are cached on disk and sent to every client
+	if ( stream == FRAG_FILE_STREAM )
+		return COMPRESSION_CODEC_SNAPPY;
+
+	// big signon blobs are sent once, trade CPU for bandwidth if asked to
+	int nLZSSMinSize = net_compresspackets_lzss_minsize.GetInt();
+	if ( nLZSSMinSize > 0 && nBytes >= nLZSSMinSize && ( m_nCompressionCodecs & COMPRESSION_CODEC_BIT( COMPRESSION_CODEC_LZSS ) ) )
+		return COMPRESSION_CODEC_LZSS;
+
+	if ( m_nCompressionCodecs & COMPRESSION_CODEC_BIT( COMPRESSION_CODEC_LZ4 ) )
+		return COMPRESSION_CODEC_LZ4;
+
+	return COMPRESSION_CODEC_SNAPPY;
+}
+
 void CNetChan::SetDataRate(float rate)
 {
 	m_Rate = clamp( rate, (float) MIN_RATE, (float) MAX_RATE );
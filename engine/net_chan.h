@@ -20,6 +20,7 @@
 #include "utlbuffer.h"
 #include "const.h"
 #include "inetchannel.h"
+#include "common.h"
 
 // How fast to converge flow estimates
 #define FLOW_AVG ( 3.0 / 4.0 )
@@ -200,6 +201,13 @@ class CNetChan : public INetChannel
 
 	virtual int		GetProtocolVersion();
 
+	// Mask of COMPRESSION_CODEC_BIT()s the remote side can decompress. Engine only, so it
+	// isn't part of INetChannel.
+	void			SetCompressionCodecs( int nCodecs );
+
+	// Codec to compress nBytes of data going out on stream with
+	CompressionCodec_t	GetCompressionCodec( int stream, int nBytes ) const;
+
 	int			IncrementSplitPacketSequence();
 
 public:
@@ -311,6 +319,7 @@ class CNetChan : public INetChannel
 	unsigned int	m_FileRequestCounter;	// increasing counter with each file request
 	bool			m_bFileBackgroundTranmission; // if true, only send 1 fragment per packet
 	bool			m_bUseCompression;	// if true, larger reliable data will be bzip compressed
+	int				m_nCompressionCodecs;	// codecs the remote side can decompress
 	
 	// TCP stream state maschine:
 	bool		m_StreamActive;		// true if TCP is active
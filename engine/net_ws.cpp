@@ -14,6 +14,7 @@
 #include "net_ws_queued_packet_sender.h"
 #include "fmtstr.h"
 #include "master.h"
+#include "sv_phaseprofile.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -175,6 +176,7 @@ ConVar net_maxroutable
 
 netadr_t	net_local_adr;
 double		net_time = 0.0f;	// current time, updated each frame
+static double s_last_realtime = 0;	// real time net_time was last updated at
 
 static	CUtlVector<netsocket_t> net_sockets;	// the 4 sockets, Server, Client, HLTV, Matchmaking
 static	CUtlVector<netpacket_t>	net_packets;
@@ -185,7 +187,7 @@ static	bool net_nodns = false;	// Disable DNS request to avoid long timeouts
 static  bool net_notcp = true;	// Disable TCP support
 static	bool net_nohltv = false; // disable HLTV support
 static	bool net_dedicated = false;	// true is dedicated system
-static	int  net_error = 0;			// global error code updated with NET_GetLastError()
+static	CTHREADLOCALINT net_error;	// per thread error code updated with NET_GetLastError(), the receive thread has its own
 
 
 static CUtlVectorMT< CUtlVector< CNetChan* > >			s_NetChannels;
@@ -337,14 +339,15 @@ void NET_ClearLastError( void )
 int NET_GetLastError( void )
 {
 #if defined( _WIN32 )
-	net_error = WSAGetLastError();
+	int nError = WSAGetLastError();
 #else
-	net_error = errno;
+	int nError = errno;
 #endif
 #if !defined( NO_VCR )
-	VCRGenericValue( "WSAGetLastError", &net_error, sizeof( net_error ) );
+	VCRGenericValue( "WSAGetLastError", &nError, sizeof( nError ) );
 #endif
-	return net_error;
+	net_error = nError;
+	return nError;
 }
 
 /*
@@ -1400,6 +1403,114 @@ bool NET_GetLoopPacket ( netpacket_t * packet )
 	return ( NET_LagPacket( true, packet ) );	
 }
 
+#if defined( LINUX )
+//-----------------------------------------------------------------------------
+// Batched receive: drain up to NET_MMSG_BATCH datagrams per recvmmsg call into
+// per socket buffers and hand them out one at a time to NET_ReceiveDatagram.
+//-----------------------------------------------------------------------------
+static ConVar net_mmsg( "net_mmsg", "1", 0, "Use recvmmsg/sendmmsg to receive and send UDP datagrams in batches" );
+
+#define NET_MMSG_BATCH			16
+#define NET_MMSG_DATAGRAM_SIZE	65536	// largest possible UDP datagram
+
+struct RecvBatch_t
+{
+	SOCKET				m_hSocket;		// socket the pending datagrams were read from
+	int					m_nCount;
+	int					m_nNext;
+	byte				*m_pData;		// NET_MMSG_BATCH buffers of NET_MMSG_DATAGRAM_SIZE bytes
+	struct mmsghdr		m_Msgs[NET_MMSG_BATCH];
+	struct iovec		m_Iov[NET_MMSG_BATCH];
+	struct sockaddr		m_From[NET_MMSG_BATCH];
+};
+
+static RecvBatch_t *s_pRecvBatch[MAX_SOCKETS];
+
+static bool NET_UseBatchedIO()
+{
+	return net_mmsg.GetBool() && VCRGetMode() == VCR_Disabled;
+}
+
+static void NET_FreeRecvBatches()
+{
+	for ( int i = 0; i < MAX_SOCKETS; i++ )
+	{
+		if ( !s_pRecvBatch[i] )
+			continue;
+
+		delete[] s_pRecvBatch[i]->m_pData;
+		delete s_pRecvBatch[i];
+		s_pRecvBatch[i] = NULL;
+	}
+}
+
+// Same contract as recvfrom: returns the datagram size or -1 with errno set
+static int NET_RecvFromBatched( int sock, SOCKET s, char *buf, int len, struct sockaddr *from, int *fromlen )
+{
+	RecvBatch_t *pBatch = s_pRecvBatch[sock];
+	if ( !pBatch )
+	{
+		pBatch = s_pRecvBatch[sock] = new RecvBatch_t;
+		pBatch->m_hSocket = s;
+		pBatch->m_nCount = 0;
+		pBatch->m_nNext = 0;
+		pBatch->m_pData = new byte[NET_MMSG_BATCH * NET_MMSG_DATAGRAM_SIZE];
+	}
+
+	// socket was reopened, anything left over belongs to the old one
+	if ( pBatch->m_hSocket != s )
+	{
+		pBatch->m_hSocket = s;
+		pBatch->m_nCount = 0;
+		pBatch->m_nNext = 0;
+	}
+
+	if ( pBatch->m_nNext >= pBatch->m_nCount )
+	{
+		for ( int i = 0; i < NET_MMSG_BATCH; i++ )
+		{
+			pBatch->m_Iov[i].iov_base = pBatch->m_pData + i * NET_MMSG_DATAGRAM_SIZE;
+			pBatch->m_Iov[i].iov_len = NET_MMSG_DATAGRAM_SIZE;
+
+			struct msghdr &hdr = pBatch->m_Msgs[i].msg_hdr;
+			V_memset( &hdr, 0, sizeof( hdr ) );
+			hdr.msg_name = &pBatch->m_From[i];
+			hdr.msg_namelen = sizeof( pBatch->m_From[i] );
+			hdr.msg_iov = &pBatch->m_Iov[i];
+			hdr.msg_iovlen = 1;
+			pBatch->m_Msgs[i].msg_len = 0;
+		}
+
+		int nReceived;
+		{
+			VPROF_BUDGET( "recvmmsg", VPROF_BUDGETGROUP_OTHER_NETWORKING );
+			nReceived = recvmmsg( s, pBatch->m_Msgs, NET_MMSG_BATCH, MSG_DONTWAIT, NULL );
+		}
+
+		pBatch->m_nNext = 0;
+		pBatch->m_nCount = MAX( nReceived, 0 );
+
+		if ( nReceived <= 0 )
+		{
+			if ( nReceived == 0 )
+				errno = EWOULDBLOCK;
+			return -1;
+		}
+	}
+
+	int i = pBatch->m_nNext++;
+	int nSize = MIN( (int)pBatch->m_Msgs[i].msg_len, len );
+
+	Q_memcpy( buf, pBatch->m_pData + i * NET_MMSG_DATAGRAM_SIZE, nSize );
+
+	int nFromLen = MIN( (int)pBatch->m_Msgs[i].msg_hdr.msg_namelen, *fromlen );
+	Q_memcpy( from, &pBatch->m_From[i], nFromLen );
+	*fromlen = nFromLen;
+
+	return nSize;
+}
+#endif // LINUX
+
 bool NET_ReceiveDatagram ( const int sock, netpacket_t * packet )
 {
 	VPROF_BUDGET( "NET_ReceiveDatagram", VPROF_BUDGETGROUP_OTHER_NETWORKING );
@@ -1413,8 +1524,17 @@ bool NET_ReceiveDatagram ( const int sock, netpacket_t * packet )
 
 	int ret = 0;
 	{
-		VPROF_BUDGET( "recvfrom", VPROF_BUDGETGROUP_OTHER_NETWORKING );
-		ret = VCRHook_recvfrom(net_socket, (char *)packet->data, NET_MAX_MESSAGE, 0, (struct sockaddr *)&from, (int *)&fromlen );
+#if defined( LINUX )
+		if ( sock < MAX_SOCKETS && NET_UseBatchedIO() )
+		{
+			ret = NET_RecvFromBatched( sock, net_socket, (char *)packet->data, NET_MAX_MESSAGE, &from, &fromlen );
+		}
+		else
+#endif
+		{
+			VPROF_BUDGET( "recvfrom", VPROF_BUDGETGROUP_OTHER_NETWORKING );
+			ret = VCRHook_recvfrom(net_socket, (char *)packet->data, NET_MAX_MESSAGE, 0, (struct sockaddr *)&from, (int *)&fromlen );
+		}
 	}
 	if ( ret >= NET_MIN_MESSAGE )
 	{
@@ -1814,9 +1934,310 @@ struct NetScratchBuffer_t : TSLNodeBase_t
 };
 CTSSimpleList<NetScratchBuffer_t> g_NetScratchBuffers;
 
+//-----------------------------------------------------------------------------
+// Receive thread: reads the server sockets, reassembles split packets and drops
+// sequenced packets nobody is connected for while the main thread simulates.
+// Complete packets are handed to NET_ProcessSocket through lock free queues.
+//-----------------------------------------------------------------------------
+static ConVar net_receive_thread( "net_receive_thread", "0", 0, "Read server sockets on a separate thread and hand complete packets to the main loop (dedicated server only)" );
+
+#define NET_RECEIVE_PACKET_SIZE		2048	// bigger packets get their own allocation
+#define NET_RECEIVE_MAX_QUEUED		4096	// per socket, if the main thread is stalled
+
+struct NetReceivedPacket_t : TSLNodeBase_t
+{
+	netpacket_t		packet;
+	byte			*pLargeData;
+	byte			data[NET_RECEIVE_PACKET_SIZE];
+};
+
+//-----------------------------------------------------------------------------
+// Turns the real time a packet arrived at into net_time, for packets received
+// off the main thread. Main thread only, that's where net_time is updated.
+//-----------------------------------------------------------------------------
+static double NET_ArrivalTime( double flArrivalRealtime )
+{
+	double elapsed = clamp( flArrivalRealtime - s_last_realtime, -1.0, 1.0 );
+	return net_time + elapsed * host_timescale.GetFloat();
+}
+
+class CNetReceiveThread : public CThread
+{
+public:
+	CNetReceiveThread()
+	{
+		SetName( "NetReceive" );
+		m_bThreadShouldExit = false;
+		m_bOwnsSockets = false;
+	}
+
+	~CNetReceiveThread()
+	{
+		Stop();
+		Flush();
+
+		NetReceivedPacket_t *pPacket;
+		while ( ( pPacket = m_FreePackets.Pop() ) != NULL )
+		{
+			delete pPacket;
+		}
+	}
+
+	bool Start( unsigned nBytesStack = 0 )
+	{
+		for ( int i = 0; i < (int)ARRAYSIZE( m_hSockets ); i++ )
+		{
+			m_hSockets[i] = net_sockets[ s_ThreadSockets[i] ].hUDP;
+		}
+
+		m_bThreadShouldExit = false;
+		m_bOwnsSockets = CThread::Start( nBytesStack );
+		return m_bOwnsSockets;
+	}
+
+	void Stop()
+	{
+		if ( !IsAlive() )
+			return;
+
+		m_bThreadShouldExit = true;
+		Join();
+
+		m_bOwnsSockets = false;
+
+		if ( m_nDropped > 0 )
+		{
+			ConDMsg( "NET_ReceiveThread: dropped %d packets while the main thread was stalled\n", (int)m_nDropped );
+			m_nDropped = 0;
+		}
+	}
+
+	// Only the receive thread reads from these sockets while it's running
+	bool OwnsSocket( int sock ) const
+	{
+		return m_bOwnsSockets && ( sock == NS_SERVER || sock == NS_HLTV );
+	}
+
+	NetReceivedPacket_t *GetPacket( int sock )
+	{
+		NetReceivedPacket_t *pPacket;
+		if ( sock >= MAX_SOCKETS || !m_ReceivedPackets[sock].PopItem( &pPacket ) )
+			return NULL;
+
+		pPacket->packet.received = NET_ArrivalTime( pPacket->packet.received );
+		pPacket->packet.message.StartReading( pPacket->packet.data, pPacket->packet.size );
+		return pPacket;
+	}
+
+	void ReleasePacket( NetReceivedPacket_t *pPacket )
+	{
+		delete[] pPacket->pLargeData;
+		pPacket->pLargeData = NULL;
+		m_FreePackets.Push( pPacket );
+	}
+
+	// Throws away anything received but not processed yet
+	void Flush()
+	{
+		for ( int i = 0; i < MAX_SOCKETS; i++ )
+		{
+			NetReceivedPacket_t *pPacket;
+			while ( m_ReceivedPackets[i].PopItem( &pPacket ) )
+			{
+				ReleasePacket( pPacket );
+			}
+		}
+	}
+
+private:
+	virtual int Run();
+	void ReceivePackets( int sock, byte *scratch );
+
+	// sockets don't change while the thread runs, NET_CloseAllSockets stops it first
+	static const int					s_ThreadSockets[2];
+	int									m_hSockets[2];
+
+	CTSQueue< NetReceivedPacket_t * >	m_ReceivedPackets[MAX_SOCKETS];
+	CTSSimpleList< NetReceivedPacket_t >	m_FreePackets;
+	CInterlockedInt						m_nDropped;
+	volatile bool						m_bThreadShouldExit;
+	bool								m_bOwnsSockets;
+};
+
+static CNetReceiveThread s_NetReceiveThread;
+
+const int CNetReceiveThread::s_ThreadSockets[2] = { NS_SERVER, NS_HLTV };
+
+int CNetReceiveThread::Run()
+{
+	NetScratchBuffer_t *scratch = new NetScratchBuffer_t;
+
+	while ( !m_bThreadShouldExit )
+	{
+		fd_set readSet;
+		FD_ZERO( &readSet );
+
+		int nMaxSocket = -1;
+		for ( int i = 0; i < (int)ARRAYSIZE( s_ThreadSockets ); i++ )
+		{
+			int hUDP = m_hSockets[i];
+			if ( hUDP )
+			{
+				FD_SET( hUDP, &readSet );
+				nMaxSocket = MAX( nMaxSocket, hUDP );
+			}
+		}
+
+		if ( nMaxSocket < 0 )
+		{
+			ThreadSleep( 10 );
+			continue;
+		}
+
+		// wake up regularly to see if we should exit
+		struct timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = 10000;
+
+		if ( select( nMaxSocket + 1, &readSet, NULL, NULL, &tv ) <= 0 )
+			continue;
+
+		for ( int i = 0; i < (int)ARRAYSIZE( s_ThreadSockets ); i++ )
+		{
+			int hUDP = m_hSockets[i];
+			if ( hUDP && FD_ISSET( hUDP, &readSet ) )
+			{
+				ReceivePackets( s_ThreadSockets[i], scratch->data );
+			}
+		}
+	}
+
+	delete scratch;
+	return 0;
+}
+
+void CNetReceiveThread::ReceivePackets( int sock, byte *scratch )
+{
+	netpacket_t inpacket;
+
+	NET_DiscardStaleSplitpackets( sock );
+
+	while ( 1 )
+	{
+		inpacket.from.SetType( NA_IP );
+		inpacket.from.Clear();
+		inpacket.received = Plat_FloatTime();	// real time until GetPacket, net_time belongs to the main thread
+		inpacket.source = sock;
+		inpacket.data = scratch;
+		inpacket.size = 0;
+		inpacket.wiresize = 0;
+		inpacket.stream = false;
+		inpacket.pNext = NULL;
+
+		if ( !NET_ReceiveValidDatagram( sock, &inpacket ) )
+			break;
+
+		Assert( inpacket.size );
+
+		// sequenced packets without a channel are ignored by NET_ProcessSocket anyway
+		if ( LittleLong( *(unsigned int *)inpacket.data ) != CONNECTIONLESS_HEADER && !NET_FindNetChannel( sock, inpacket.from ) )
+			continue;
+
+		if ( m_ReceivedPackets[sock].Count() >= NET_RECEIVE_MAX_QUEUED )
+		{
+			++m_nDropped;
+			continue;
+		}
+
+		NetReceivedPacket_t *pPacket = m_FreePackets.Pop();
+		if ( !pPacket )
+		{
+			pPacket = new NetReceivedPacket_t;
+			pPacket->pLargeData = NULL;
+		}
+
+		pPacket->packet = inpacket;
+		pPacket->packet.message.SetDebugName( "inpacket.message" );
+
+		if ( inpacket.size > NET_RECEIVE_PACKET_SIZE )
+		{
+			pPacket->pLargeData = new byte[inpacket.size];
+			pPacket->packet.data = pPacket->pLargeData;
+		}
+		else
+		{
+			pPacket->packet.data = pPacket->data;
+		}
+
+		Q_memcpy( pPacket->packet.data, inpacket.data, inpacket.size );
+
+		m_ReceivedPackets[sock].PushItem( pPacket );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Starts or stops the receive thread when its settings changed, main thread only
+//-----------------------------------------------------------------------------
+static void NET_UpdateReceiveThread()
+{
+	// fake lag and loss keep their state on the main thread
+	bool bWantThread = net_receive_thread.GetBool() && net_dedicated && NET_IsMultiplayer() &&
+		s_FakeLag <= 0.0f && fakeloss.GetFloat() == 0.0f && VCRGetMode() == VCR_Disabled;
+
+	if ( bWantThread && !s_NetReceiveThread.IsAlive() )
+	{
+		if ( !s_NetReceiveThread.Start() )
+		{
+			Warning( "NET_UpdateReceiveThread: couldn't start network receive thread.\n" );
+			net_receive_thread.SetValue( 0 );
+		}
+	}
+	else if ( !bWantThread && s_NetReceiveThread.IsAlive() )
+	{
+		s_NetReceiveThread.Stop();
+	}
+}
+
+static void NET_DispatchPacket( int sock, netpacket_t *packet, IConnectionlessPacketHandler *handler )
+{
+	if ( Filter_ShouldDiscard ( packet->from ) )	// filtering is done by network layer
+	{
+		Filter_SendBan( packet->from );	// tell them we aren't listening...
+		return;
+	} 
+
+	// check for connectionless packet (0xffffffff) first
+	if ( LittleLong( *(unsigned int *)packet->data ) == CONNECTIONLESS_HEADER )
+	{
+		packet->message.ReadLong();	// read the -1
+
+		if ( net_showudp.GetInt() )
+		{
+			Msg("UDP <- %s: sz=%i OOB '%c' wire=%i\n", packet->from.ToString(), packet->size, packet->data[4], packet->wiresize );
+		}
+
+		handler->ProcessConnectionlessPacket( packet );
+		return;
+	}
+
+	// check for packets from connected clients
+	
+	CNetChan * netchan = NET_FindNetChannel( sock, packet->from );
+
+	if ( netchan )
+	{
+		netchan->ProcessPacket( packet, true );
+	}
+	/* else	// Not an error that may happen during connect or disconnect
+	{
+		Msg ("Sequenced packet without connection from %s\n" , packet->from.ToString() );
+	}*/
+}
+
 void NET_ProcessSocket( int sock, IConnectionlessPacketHandler *handler )
 {
 	VPROF_BUDGET( "NET_ProcessSocket", VPROF_BUDGETGROUP_OTHER_NETWORKING );
+	SV_PHASE_SCOPE( SERVER_PHASE_NET_RECEIVE );
 
 	netpacket_t * packet;
 	
@@ -1844,6 +2265,20 @@ void NET_ProcessSocket( int sock, IConnectionlessPacketHandler *handler )
 		}
 	}
 
+	// packets the receive thread got for us, only take what's there now
+	if ( sock < MAX_SOCKETS )
+	{
+		NetReceivedPacket_t *pReceived;
+		for ( int i = NET_RECEIVE_MAX_QUEUED; i > 0 && ( pReceived = s_NetReceiveThread.GetPacket( sock ) ) != NULL; --i )
+		{
+			NET_DispatchPacket( sock, &pReceived->packet, handler );
+			s_NetReceiveThread.ReleasePacket( pReceived );
+		}
+	}
+
+	if ( s_NetReceiveThread.OwnsSocket( sock ) )
+		return;
+
 	// now get datagrams from sockets
 	NetScratchBuffer_t *scratch = g_NetScratchBuffers.Pop();
 	if ( !scratch )
@@ -1852,38 +2287,7 @@ void NET_ProcessSocket( int sock, IConnectionlessPacketHandler *handler )
 	}
 	while ( ( packet = NET_GetPacket ( sock, scratch->data ) ) != NULL )
 	{
-		if ( Filter_ShouldDiscard ( packet->from ) )	// filtering is done by network layer
-		{
-			Filter_SendBan( packet->from );	// tell them we aren't listening...
-			continue;
-		} 
-
-		// check for connectionless packet (0xffffffff) first
-		if ( LittleLong( *(unsigned int *)packet->data ) == CONNECTIONLESS_HEADER )
-		{
-			packet->message.ReadLong();	// read the -1
-
-			if ( net_showudp.GetInt() )
-			{
-				Msg("UDP <- %s: sz=%i OOB '%c' wire=%i\n", packet->from.ToString(), packet->size, packet->data[4], packet->wiresize );
-			}
-
-			handler->ProcessConnectionlessPacket( packet );
-			continue;
-		}
-
-		// check for packets from connected clients
-		
-		CNetChan * netchan = NET_FindNetChannel( sock, packet->from );
-
-		if ( netchan )
-		{
-			netchan->ProcessPacket( packet, true );
-		}
-		/* else	// Not an error that may happen during connect or disconnect
-		{
-			Msg ("Sequenced packet without connection from %s\n" , packet->from.ToString() );
-		}*/
+		NET_DispatchPacket( sock, packet, handler );
 	}
 	g_NetScratchBuffers.Push( scratch );
 }
@@ -1957,6 +2361,155 @@ int NET_SendToImpl( SOCKET s, const char FAR * buf, int len, const struct sockad
 	return nSend;
 }
 
+//-----------------------------------------------------------------------------
+// Warns about the send error in net_error, unless it's one that's expected.
+// Returns false for those.
+//-----------------------------------------------------------------------------
+static bool NET_ReportSendError( const netadr_t &to )
+{
+	// wouldblock is silent
+	if ( net_error == WSAEWOULDBLOCK )
+		return false;
+
+	if ( net_error == WSAECONNRESET )
+		return false;
+
+	// some PPP links dont allow broadcasts
+	if ( ( net_error == WSAEADDRNOTAVAIL) && ( to.type == NA_BROADCAST ) )
+		return false;
+
+	ConDMsg ("NET_SendPacket Warning: %s : %s\n", NET_ErrorString(net_error), to.ToString() );
+	return true;
+}
+
+#if defined( LINUX )
+//-----------------------------------------------------------------------------
+// Batched send: while a batch is open datagrams are copied into a queue (from any
+// thread, SendSnapshot runs in parallel) and written with sendmmsg on flush.
+//-----------------------------------------------------------------------------
+struct SendBatchItem_t
+{
+	SOCKET				m_Socket;
+	int					m_nOffset;		// into SendBatch_t::m_Data
+	int					m_nLength;
+	struct sockaddr		m_To;
+	int					m_nToLen;
+};
+
+struct SendBatch_t
+{
+	SendBatch_t() : m_bActive( false ) {}
+
+	CThreadFastMutex				m_Mutex;
+	bool							m_bActive;
+	CUtlVector< byte >				m_Data;
+	CUtlVector< SendBatchItem_t >	m_Items;
+};
+
+static SendBatch_t s_SendBatch;
+
+// datagrams that were queued, so reported as sent, and then failed in sendmmsg
+static CInterlockedInt s_nBatchedSendErrors;
+
+static bool NET_QueueBatchedSend( SOCKET s, const char *buf, int len, const struct sockaddr *to, int tolen )
+{
+	if ( tolen > (int)sizeof( struct sockaddr ) )
+		return false;
+
+	AUTO_LOCK( s_SendBatch.m_Mutex );
+
+	if ( !s_SendBatch.m_bActive )
+		return false;
+
+	SendBatchItem_t &item = s_SendBatch.m_Items[ s_SendBatch.m_Items.AddToTail() ];
+	item.m_Socket = s;
+	item.m_nOffset = s_SendBatch.m_Data.AddMultipleToTail( len, (const byte *)buf );
+	item.m_nLength = len;
+	Q_memcpy( &item.m_To, to, tolen );
+	item.m_nToLen = tolen;
+
+	return true;
+}
+#endif // LINUX
+
+void NET_BeginBatchedSends()
+{
+#if defined( LINUX )
+	if ( !NET_UseBatchedIO() || !NET_IsMultiplayer() )
+		return;
+
+	AUTO_LOCK( s_SendBatch.m_Mutex );
+	s_SendBatch.m_bActive = true;
+#endif
+}
+
+void NET_FlushBatchedSends()
+{
+#if defined( LINUX )
+	AUTO_LOCK( s_SendBatch.m_Mutex );
+
+	if ( !s_SendBatch.m_bActive )
+		return;
+
+	s_SendBatch.m_bActive = false;
+
+	VPROF_BUDGET( "NET_FlushBatchedSends", VPROF_BUDGETGROUP_OTHER_NETWORKING );
+
+	struct mmsghdr msgs[NET_MMSG_BATCH];
+	struct iovec iov[NET_MMSG_BATCH];
+
+	int nItems = s_SendBatch.m_Items.Count();
+	int iItem = 0;
+
+	while ( iItem < nItems )
+	{
+		// gather a run of datagrams going out the same socket
+		SOCKET s = s_SendBatch.m_Items[iItem].m_Socket;
+		int nMsgs = 0;
+
+		while ( iItem + nMsgs < nItems && nMsgs < NET_MMSG_BATCH && s_SendBatch.m_Items[iItem + nMsgs].m_Socket == s )
+		{
+			SendBatchItem_t &item = s_SendBatch.m_Items[iItem + nMsgs];
+
+			iov[nMsgs].iov_base = s_SendBatch.m_Data.Base() + item.m_nOffset;
+			iov[nMsgs].iov_len = item.m_nLength;
+
+			struct msghdr &hdr = msgs[nMsgs].msg_hdr;
+			V_memset( &hdr, 0, sizeof( hdr ) );
+			hdr.msg_name = &item.m_To;
+			hdr.msg_namelen = item.m_nToLen;
+			hdr.msg_iov = &iov[nMsgs];
+			hdr.msg_iovlen = 1;
+			msgs[nMsgs].msg_len = 0;
+
+			++nMsgs;
+		}
+
+		int nSent = sendmmsg( s, msgs, nMsgs, 0 );
+		if ( nSent < 0 )
+		{
+			// sendmmsg stops at the first datagram that fails, so the error is this one's
+			NET_GetLastError();
+
+			netadr_t to;
+			to.SetFromSockadr( &s_SendBatch.m_Items[iItem].m_To );
+			if ( NET_ReportSendError( to ) )
+			{
+				++s_nBatchedSendErrors;
+			}
+
+			// skip it and go on
+			nSent = 1;
+		}
+
+		iItem += nSent;
+	}
+
+	s_SendBatch.m_Items.RemoveAll();
+	s_SendBatch.m_Data.RemoveAll();
+#endif
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : sock - 
@@ -2009,15 +2562,25 @@ int NET_SendTo( bool verbose, SOCKET s, const char FAR * buf, int len, const str
 		}
 #endif // _WIN32
 
-		nSend = NET_SendToImpl
-		( 
-			s, 
-			buf,
-			len,
-			to, 
-			tolen, 
-			iGameDataLength 
-		);
+#if defined( LINUX )
+		if ( iGameDataLength == -1 && NET_QueueBatchedSend( s, buf, len, to, tolen ) )
+		{
+			// errors only show up on flush, NET_FlushBatchedSends reports them
+			nSend = len;
+		}
+		else
+#endif
+		{
+			nSend = NET_SendToImpl
+			( 
+				s, 
+				buf,
+				len,
+				to, 
+				tolen, 
+				iGameDataLength 
+			);
+		}
 	}
 
 #if defined( _DEBUG )
@@ -2434,13 +2997,14 @@ int NET_SendPacket ( INetChannel *chan, int sock,  const netadr_t &to, const uns
 	if ( bUseCompression )
 	{
 		VPROF_BUDGET( "NET_SendPacket_Compress", VPROF_BUDGETGROUP_OTHER_NETWORKING );
-		unsigned int nCompressedLength = COM_GetIdealDestinationCompressionBufferSize_Snappy( length );
+		CompressionCodec_t codec = chan ? static_cast< CNetChan * >( chan )->GetCompressionCodec( FRAG_NORMAL_STREAM, length ) : COMPRESSION_CODEC_SNAPPY;
+		unsigned int nCompressedLength = COM_GetIdealDestinationCompressionBufferSize_Codec( codec, length );
 	
 		memCompressed.EnsureCapacity( nCompressedLength + nVoiceBytes + sizeof( unsigned int ) );
 
 		*(int *)memCompressed.Base() = LittleLong( NET_HEADER_FLAG_COMPRESSEDPACKET );
 
-		if ( COM_BufferToBufferCompress_Snappy( memCompressed.Base() + sizeof( unsigned int ), &nCompressedLength, data, length )
+		if ( COM_BufferToBufferCompress_Codec( codec, memCompressed.Base() + sizeof( unsigned int ), &nCompressedLength, data, length )
 			&& (int)nCompressedLength < length )
 		{
 			data	= memCompressed.Base();
@@ -2495,19 +3059,10 @@ int NET_SendPacket ( INetChannel *chan, int sock,  const netadr_t &to, const uns
 	if (ret == -1)
 	{
 		NET_GetLastError();
-		
-		// wouldblock is silent
-		if ( net_error == WSAEWOULDBLOCK )
-			return 0;
 
-		if ( net_error == WSAECONNRESET )
+		if ( !NET_ReportSendError( to ) )
 			return 0;
 
-		// some PPP links dont allow broadcasts
-		if ( ( net_error == WSAEADDRNOTAVAIL) && ( to.type == NA_BROADCAST ) )
-			return 0;
-
-		ConDMsg ("NET_SendPacket Warning: %s : %s\n", NET_ErrorString(net_error), to.ToString() );
 		ret = length;
 	}
 	
@@ -2538,6 +3093,10 @@ NET_CloseAllSockets
 */
 void NET_CloseAllSockets (void)
 {
+	// the receive thread must not touch sockets while they're closed and reopened
+	s_NetReceiveThread.Stop();
+	s_NetReceiveThread.Flush();
+
 	// shut down any existing and open sockets
 	for (int i=0 ; i<net_sockets.Count() ; i++)
 	{
@@ -2722,6 +3281,9 @@ void NET_OpenSockets (void)
 
 int NET_AddExtraSocket( int port )
 {
+	// the receive thread uses the socket lists, it's started again next frame
+	s_NetReceiveThread.Stop();
+
 	int newSocket = net_sockets.AddToTail();
 
 	Q_memset( &net_sockets[newSocket], 0, sizeof(netsocket_t) );
@@ -2757,6 +3319,27 @@ unsigned short NET_GetUDPPort(int socket)
 	return net_sockets[socket].nPort;
 }
 
+int NET_GetServerSocketHandles( int *pHandles, int nMaxHandles )
+{
+	static const int s_ServerSockets[] = { NS_SERVER, NS_HLTV, NS_SVLAN };
+
+	int nHandles = 0;
+	for ( int i = 0; i < (int)ARRAYSIZE( s_ServerSockets ) && nHandles < nMaxHandles; i++ )
+	{
+		int sock = s_ServerSockets[i];
+		if ( sock >= net_sockets.Count() || !net_sockets[sock].hUDP )
+			continue;
+
+		// the receive thread wakes up for these itself
+		if ( s_NetReceiveThread.OwnsSocket( sock ) )
+			continue;
+
+		pHandles[nHandles++] = net_sockets[sock].hUDP;
+	}
+
+	return nHandles;
+}
+
 
 /*
 ================
@@ -2944,8 +3527,6 @@ Updates net_time
 */
 void NET_SetTime( double flRealtime )
 {
-	static double s_last_realtime = 0;
-
 	double frametime = flRealtime - s_last_realtime;
 	s_last_realtime = flRealtime;
 
@@ -2975,6 +3556,8 @@ void NET_RunFrame( double flRealtime )
 {
 	NET_SetTime( flRealtime );
 
+	NET_UpdateReceiveThread();
+
 	RCONServer().RunFrame();
 
 #ifdef ENABLE_RPT
@@ -3339,6 +3922,10 @@ void NET_Shutdown (void)
 	NET_CloseAllSockets();
 	NET_ConfigLoopbackBuffers( false );
 
+#if defined( LINUX )
+	NET_FreeRecvBatches();
+#endif
+
 #if defined(_WIN32)
 	if ( !net_noip )
 	{
@@ -3462,4 +4049,11 @@ CON_COMMAND( net_status, "Shows current network status" )
 	ConMsg( "           per client out %.1f/s, in %.1f/s\n", avgPacketsOut/numChannels, avgPacketsIn/numChannels );
 	ConMsg( "- Data:    net total out  %.1f, in %.1f kB/s\n", avgDataOut/1024.0f, avgDataIn/1024.0f );
 	ConMsg( "           per client out %.1f, in %.1f kB/s\n", (avgDataOut/numChannels)/1024.0f, (avgDataIn/numChannels)/1024.0f );
+
+#if defined( LINUX )
+	if ( s_nBatchedSendErrors > 0 )
+	{
+		ConMsg( "- Errors:  %d batched sends failed\n", (int)s_nBatchedSendErrors );
+	}
+#endif
 }
@@ -22,6 +22,7 @@
 #include "tier0/memdbgon.h"
 ConVar sv_dumpstringtables( "sv_dumpstringtables", "0", FCVAR_CHEAT );
 ConVar sv_compressstringtablebaselines_threshhold( "sv_compressstringtablebaselines_threshold", "2048", 0, "Minimum size (in bytes) for stringtablebaseline buffer to be compressed." );
+ConVar sv_stringtable_updatecache( "sv_stringtable_updatecache", "1", 0, "Share encoded string table updates between clients acking the same tick." );
 
 #define SUBSTRING_BITS	5
 struct StringHistoryEntry
@@ -51,6 +52,11 @@ static int GetBestPreviousString( CUtlVector< StringHistoryEntry >& history, cha
 	for ( int i = 0; i < c; i++ )
 	{
 		char const *prev = history[ i ].string;
+
+		// can't share the 3 characters needed to be worth it
+		if ( prev[0] != newstring[0] )
+			continue;
+
 		int similar = CountSimilarCharacters( prev, newstring );
 		
 		if ( similar < 3 )
@@ -221,6 +227,16 @@ CNetworkStringTable::CNetworkStringTable( TABLEID id, const char *tableName, int
 	m_bChangeHistoryEnabled = false;
 	m_bLocked = false;
 
+#ifndef SHARED_NET_STRING_TABLES
+	m_bChangeLogValid = true;
+	m_nChangeSerial = 0;
+	m_nNextCachedUpdate = 0;
+	for ( int i = 0; i < NUM_CACHED_UPDATES; i++ )
+	{
+		m_CachedUpdates[i].m_nAckTick = -1;
+	}
+#endif
+
 	m_nMaxEntries = maxentries;
 	m_nEntryBits = Q_log2( m_nMaxEntries );
 
@@ -347,6 +363,12 @@ void CNetworkStringTable::DeleteAllStrings( void )
 		m_pItemsClientSide->Insert( "___clientsideitemsplaceholder0___" ); // 0 slot can't be used
 		m_pItemsClientSide->Insert( "___clientsideitemsplaceholder1___" ); // -1 can't be used since it looks like the "invalid" index from other string lookups
 	}
+
+#ifndef SHARED_NET_STRING_TABLES
+	m_ChangeLog.Purge();
+	m_bChangeLogValid = !m_bChangeHistoryEnabled;
+	m_nChangeSerial++;
+#endif
 }
 
 //-----------------------------------------------------------------------------
@@ -428,6 +450,9 @@ void CNetworkStringTable::EnableRollback()
 	// stringtable must be empty 
 	Assert( m_pItems->Count() == 0);
 	m_bChangeHistoryEnabled = true;
+
+	m_ChangeLog.Purge();
+	m_bChangeLogValid = false;
 }
 
 void CNetworkStringTable::SetMirrorTable(INetworkStringTable *table)
@@ -464,16 +489,14 @@ void CNetworkStringTable::UpdateMirrorTable( int tick_ack  )
 
 	m_pMirrorTable->SetTick( m_nTickCount ); // use same tick
 
-	int count = m_pItems->Count();
-	
-	for ( int i = 0; i < count; i++ )
+	CUtlVector< int > entries;
+	GetChangedEntries( tick_ack, entries );
+
+	for ( int iEntry = 0; iEntry < entries.Count(); iEntry++ )
 	{
+		int i = entries[iEntry];
 		CNetworkStringTableItem *p = &m_pItems->Element( i );
 
-		// mirror is up to date
-		if ( p->GetTickChanged() <= tick_ack )
-			continue;
-
 		const void *pUserData = p->GetUserData();
 
 		int nBytes = p->GetUserDataLength();
@@ -499,7 +522,170 @@ void CNetworkStringTable::UpdateMirrorTable( int tick_ack  )
 	}
 }
 
+static int IntSortFunc( const int *a, const int *b )
+{
+	return *a - *b;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Collects the entries changed after tick_ack from the change log, or
+//			from the whole table when there's no log or most of the table changed
+//-----------------------------------------------------------------------------
+void CNetworkStringTable::GetChangedEntries( int tick_ack, CUtlVector<int> &entries )
+{
+	entries.RemoveAll();
+
+	int count = m_pItems->Count();
+
+	if ( m_bChangeLogValid )
+	{
+		// first change after the ack
+		int iLow = 0;
+		int iHigh = m_ChangeLog.Count();
+		while ( iLow < iHigh )
+		{
+			int iMid = ( iLow + iHigh ) / 2;
+			if ( m_ChangeLog[iMid].m_nTick <= tick_ack )
+			{
+				iLow = iMid + 1;
+			}
+			else
+			{
+				iHigh = iMid;
+			}
+		}
+
+		int nChanges = m_ChangeLog.Count() - iLow;
+		if ( nChanges < count / 2 )
+		{
+			entries.EnsureCapacity( nChanges );
+			for ( int i = iLow; i < m_ChangeLog.Count(); i++ )
+			{
+				entries.AddToTail( m_ChangeLog[i].m_nIndex );
+			}
+
+			// entries go out in index order, an entry can be in the log more than once
+			entries.Sort( IntSortFunc );
+
+			int nUnique = 0;
+			for ( int i = 0; i < entries.Count(); i++ )
+			{
+				if ( nUnique == 0 || entries[nUnique - 1] != entries[i] )
+				{
+					entries[nUnique++] = entries[i];
+				}
+			}
+			entries.SetCountNonDestructively( nUnique );
+			return;
+		}
+	}
+
+	for ( int i = 0; i < count; i++ )
+	{
+		if ( m_pItems->Element( i ).GetTickChanged() > tick_ack )
+		{
+			entries.AddToTail( i );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Drops all but the newest change of each entry, that's all
+//			GetChangedEntries needs
+//-----------------------------------------------------------------------------
+void CNetworkStringTable::CompactChangeLog()
+{
+	CUtlVector< unsigned char > seen;
+	seen.SetCount( m_pItems->Count() );
+	V_memset( seen.Base(), 0, seen.Count() );
+
+	int nFirst = m_ChangeLog.Count();
+	for ( int i = m_ChangeLog.Count() - 1; i >= 0; i-- )
+	{
+		int iEntry = m_ChangeLog[i].m_nIndex;
+		if ( seen[iEntry] )
+			continue;
+
+		seen[iEntry] = 1;
+		m_ChangeLog[--nFirst] = m_ChangeLog[i];
+	}
+
+	m_ChangeLog.RemoveMultipleFromHead( nFirst );
+}
+
+bool CNetworkStringTable::ReadCachedUpdate( bf_write &buf, int tick_ack, int &entries )
+{
+	AUTO_LOCK( m_CachedUpdateMutex );
+
+	for ( int i = 0; i < NUM_CACHED_UPDATES; i++ )
+	{
+		CachedUpdate_t &update = m_CachedUpdates[i];
+		if ( update.m_nAckTick != tick_ack || update.m_nChangeSerial != m_nChangeSerial )
+			continue;
+
+		buf.WriteBits( update.m_Data.Base(), update.m_nBits );
+		entries = update.m_nEntries;
+		return true;
+	}
+
+	return false;
+}
+
+void CNetworkStringTable::AddCachedUpdate( const bf_write &buf, int nStartBit, int tick_ack, int entries )
+{
+	AUTO_LOCK( m_CachedUpdateMutex );
+
+	for ( int i = 0; i < NUM_CACHED_UPDATES; i++ )
+	{
+		// another client beat us to it
+		if ( m_CachedUpdates[i].m_nAckTick == tick_ack && m_CachedUpdates[i].m_nChangeSerial == m_nChangeSerial )
+			return;
+	}
+
+	CachedUpdate_t &update = m_CachedUpdates[ m_nNextCachedUpdate ];
+	m_nNextCachedUpdate = ( m_nNextCachedUpdate + 1 ) % NUM_CACHED_UPDATES;
+
+	int nBits = buf.GetNumBitsWritten() - nStartBit;
+	int nBytes = PAD_NUMBER( Bits2Bytes( nBits ), 4 );
+
+	update.m_nAckTick = tick_ack;
+	update.m_nChangeSerial = m_nChangeSerial;
+	update.m_nEntries = entries;
+	update.m_nBits = nBits;
+	update.m_Data.SetCount( nBytes );
+
+	if ( nBits > 0 )
+	{
+		bf_read inBuffer;
+		inBuffer.StartReading( buf.m_pData, buf.m_nDataBytes, nStartBit );
+
+		bf_write outBuffer( update.m_Data.Base(), nBytes );
+		outBuffer.WriteBitsFromBuffer( &inBuffer, nBits );
+	}
+}
+
 int CNetworkStringTable::WriteUpdate( CBaseClient *client, bf_write &buf, int tick_ack )
+{
+	// tracing clients trace every entry, rollback tables don't log their changes
+	bool bUseCache = sv_stringtable_updatecache.GetBool() && !m_bChangeHistoryEnabled && !( client && client->IsTracing() );
+
+	int entriesUpdated;
+	if ( bUseCache && ReadCachedUpdate( buf, tick_ack, entriesUpdated ) )
+		return entriesUpdated;
+
+	int nStartBit = buf.GetNumBitsWritten();
+
+	entriesUpdated = EncodeUpdate( client, buf, tick_ack );
+
+	if ( bUseCache && !buf.IsOverflowed() )
+	{
+		AddCachedUpdate( buf, nStartBit, tick_ack, entriesUpdated );
+	}
+
+	return entriesUpdated;
+}
+
+int CNetworkStringTable::EncodeUpdate( CBaseClient *client, bf_write &buf, int tick_ack )
 {
 	CUtlVector< StringHistoryEntry > history;
 
@@ -507,16 +693,14 @@ int CNetworkStringTable::WriteUpdate( CBaseClient *client, bf_write &buf, int ti
 	int lastEntry = -1;
 	int nTableStartBit = buf.GetNumBitsWritten();
 
-	int count = m_pItems->Count();
+	CUtlVector< int > entries;
+	GetChangedEntries( tick_ack, entries );
 
-	for ( int i = 0; i < count; i++ )
+	for ( int iEntry = 0; iEntry < entries.Count(); iEntry++ )
 	{
+		int i = entries[iEntry];
 		CNetworkStringTableItem *p = &m_pItems->Element( i );
 
-		// Client is up to date
-		if ( p->GetTickChanged() <= tick_ack )
-			continue;
-
 		int nStartBit = buf.GetNumBitsWritten();
 
 		// Write Entry index
@@ -1016,6 +1200,32 @@ void CNetworkStringTable::DataChanged( int stringNumber, CNetworkStringTableItem
 
 	// Mark table as changed
 	m_nLastChangedTick = m_nTickCount;
+
+#ifndef SHARED_NET_STRING_TABLES
+	m_nChangeSerial++;
+
+	// client side entries (negative indices) aren't networked
+	if ( m_bChangeLogValid && stringNumber >= 0 )
+	{
+		if ( m_ChangeLog.Count() && m_ChangeLog.Tail().m_nTick > m_nTickCount )
+		{
+			// ticks went backwards, scan the whole table from now on
+			m_ChangeLog.Purge();
+			m_bChangeLogValid = false;
+		}
+		else
+		{
+			ChangeLogEntry_t &change = m_ChangeLog[ m_ChangeLog.AddToTail() ];
+			change.m_nTick = m_nTickCount;
+			change.m_nIndex = stringNumber;
+
+			if ( m_ChangeLog.Count() > 2 * (int)m_pItems->Count() + 64 )
+			{
+				CompactChangeLog();
+			}
+		}
+	}
+#endif
 	
 	// Invoke callback if one was installed
 	
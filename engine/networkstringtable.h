@@ -16,6 +16,7 @@
 #include <utldict.h>
 #include <utlbuffer.h>
 #include "tier1/bitbuf.h"
+#include "tier0/threadtools.h"
 
 class SVC_CreateStringTable;
 class CBaseClient;
@@ -107,6 +108,16 @@ class CNetworkStringTable  : public INetworkStringTable
 protected:
 	void			DataChanged( int stringNumber, CNetworkStringTableItem *item );
 
+#ifndef SHARED_NET_STRING_TABLES
+	// Indices of all entries changed after tick_ack, in ascending order
+	void			GetChangedEntries( int tick_ack, CUtlVector<int> &entries );
+	void			CompactChangeLog();
+
+	int				EncodeUpdate( CBaseClient *client, bf_write &buf, int tick_ack );
+	bool			ReadCachedUpdate( bf_write &buf, int tick_ack, int &entries );
+	void			AddCachedUpdate( const bf_write &buf, int nStartBit, int tick_ack, int entries );
+#endif
+
 	// Destroy string table
 	void			DeleteAllStrings( void );
 
@@ -139,6 +150,37 @@ class CNetworkStringTable  : public INetworkStringTable
 
 	INetworkStringDict		*m_pItems;
 	INetworkStringDict		*m_pItemsClientSide;	 // For m_bAllowClientSideAddString, these items are non-networked and are referenced by a negative string index!!!
+
+#ifndef SHARED_NET_STRING_TABLES
+	// Every change to a networked entry in tick order, so updates only visit what changed since
+	// the client's ack instead of the whole table. Not used with change history, rollback moves
+	// the item ticks backwards.
+	struct ChangeLogEntry_t
+	{
+		int		m_nTick;
+		int		m_nIndex;
+	};
+
+	CUtlVector< ChangeLogEntry_t >	m_ChangeLog;
+	bool					m_bChangeLogValid;
+	int						m_nChangeSerial;	// bumped on every change, invalidates cached updates
+
+	// Encoded updates for the last few ack ticks, shared by all clients acking the same tick
+	enum { NUM_CACHED_UPDATES = 4 };
+
+	struct CachedUpdate_t
+	{
+		int		m_nAckTick;
+		int		m_nChangeSerial;
+		int		m_nEntries;
+		int		m_nBits;
+		CUtlVector< unsigned char > m_Data;
+	};
+
+	CachedUpdate_t			m_CachedUpdates[ NUM_CACHED_UPDATES ];
+	int						m_nNextCachedUpdate;
+	CThreadFastMutex		m_CachedUpdateMutex;
+#endif
 };
 
 //-----------------------------------------------------------------------------
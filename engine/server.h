@@ -23,6 +23,7 @@
 #include "precache.h"
 #include "sv_client.h"
 #include "baseserver.h"
+#include "sv_deltacache.h"
 #include <ihltvdirector.h>
 
 
@@ -86,6 +87,9 @@ protected :
 	bool		FinishCertificateCheck( netadr_t &adr, int nAuthProtocol, const char *szRawCertificate, int clientChallenge );
 	void		SendClientDatagrams ( int clientCount, CGameClient** clients, CFrameSnapshot* pSnapshot );
 	void		CopyTempEntities( CFrameSnapshot* pSnapshot );
+	int			PipelineSnapshots( int clientCount, CGameClient** clients, CFrameSnapshot* pSnapshot );
+	void		SendPipelinedSnapshots();
+	void		DiscardPipelinedSnapshots();
 	void		AssignClassIds();
 
 	virtual void UpdateMasterServerPlayers();
@@ -115,6 +119,17 @@ protected :
 	bf_write			m_FullSendTables;
 	CUtlMemory<byte>	m_FullSendTablesBuffer;
 
+	CPackedEntityDeltaCache	m_DeltaCache;	// delta bits shared between clients
+
+	// Snapshots whose packet entities are written by jobs while the next tick simulates
+	struct PipelinedSnapshot_t
+	{
+		CGameClient		*m_pClient;
+		CClientFrame	*m_pFrame;
+	};
+	CFrameSnapshot		*m_pPipelinedSnapshot;
+	CUtlVector<PipelinedSnapshot_t> m_PipelinedSnapshots;
+
 	bool		m_bLoadedPlugins;
 
 public:
@@ -180,6 +195,7 @@ class IServerGameTags;
 extern IServerGameDLL	*serverGameDLL;
 extern int g_iServerGameDLLVersion;
 extern IServerGameEnts *serverGameEnts;
+extern int g_iServerGameEntsVersion;	// This matches the number at the end of the interface name (so for "ServerGameEnts002", this would be 2).
 
 extern IServerGameClients *serverGameClients;
 extern int g_iServerGameClientsVersion;	// This matches the number at the end of the interface name (so for "ServerGameClients004", this would be 4).
@@ -14,6 +14,7 @@
 #include "PlayerState.h"
 #include "tier0/vprof.h"
 #include "sv_packedentities.h"
+#include "sv_phaseprofile.h"
 #include "LocalNetworkBackdoor.h"
 #include "testscriptmgr.h"
 #include "hltvserver.h"
@@ -186,6 +187,7 @@ bool CGameClient::ProcessMove(CLC_Move *msg)
 	
 	int startbit = msg->m_DataIn.GetNumBitsRead();
 
+	SV_PHASE_SCOPE( SERVER_PHASE_USERCMDS );
 	serverGameClients->ProcessUsercmds
 	( 
 		edict,					// Player edict
@@ -445,10 +447,11 @@ void CGameClient::SetupPackInfo( CFrameSnapshot *pSnapshot )
 	// Since area to area visibility is determined by each player's PVS, copy
 	//  the area network lookups into the ClientPackInfo_t
 	m_PackInfo.m_AreasNetworked = 0;
-	int areaCount = g_AreasNetworked.Count();
+	const CUtlVector<int> &areasNetworked = SV_GetAreasNetworked();
+	int areaCount = areasNetworked.Count();
 	for ( int j = 0; j < areaCount; j++ )
 	{
-		m_PackInfo.m_Areas[m_PackInfo.m_AreasNetworked] = g_AreasNetworked[ j ];
+		m_PackInfo.m_Areas[m_PackInfo.m_AreasNetworked] = areasNetworked[ j ];
 		m_PackInfo.m_AreasNetworked++;
 
 		// Msg("CGameClient::SetupPackInfo: too much areas (%i)", areaCount );
@@ -631,6 +634,10 @@ bool CGameClient::UpdateAcknowledgedFramecount(int tick)
 		if ( sv_maxreplay.GetFloat() > 0 )
 			removeTick -= (sv_maxreplay.GetFloat() / m_Server->GetTickInterval() ); // keep a replay buffer
 
+		// a snapshot prepared last tick is still to be sent as a delta from this frame
+		if ( m_pPreparedDeltaFrame )
+			removeTick = min( removeTick, m_pPreparedDeltaFrame->tick_count );
+
 		if ( removeTick > 0 )
 		{
 			DeleteClientFrames( removeTick );	
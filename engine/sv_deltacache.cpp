@@ -0,0 +1,168 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose:
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "server_pch.h"
+#include "sv_deltacache.h"
+#include "packed_entity.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+ConVar sv_deltacache( "sv_deltacache", "2", 0, "Size in KB per entity of the delta bit stream cache shared by game clients (0 = off)" );
+
+
+CPackedEntityDeltaCache::CPackedEntityDeltaCache()
+{
+	for ( int i = 0; i < MAX_EDICTS; i++ )
+	{
+		m_Slots[i].m_nTick = -1;
+	}
+}
+
+CPackedEntityDeltaCache::~CPackedEntityDeltaCache()
+{
+	Flush();
+}
+
+void CPackedEntityDeltaCache::Flush()
+{
+	for ( int i = 0; i < MAX_EDICTS; i++ )
+	{
+		AUTO_LOCK( m_Slots[i].m_Mutex );
+		m_Slots[i].m_nTick = -1;
+		m_Slots[i].m_Data.Purge();
+	}
+}
+
+CPackedEntityDeltaCache::DeltaEntry_t *CPackedEntityDeltaCache::FindEntry( EntitySlot_t &slot, const PackedEntity *pFrom, const PackedEntity *pTo, int nFromTick )
+{
+	int nOffset = 0;
+
+	while ( nOffset < slot.m_Data.Count() )
+	{
+		DeltaEntry_t *pEntry = (DeltaEntry_t *)( slot.m_Data.Base() + nOffset );
+
+		if ( pEntry->pFrom == pFrom && pEntry->pTo == pTo && pEntry->nFromTick == nFromTick )
+			return pEntry;
+
+		nOffset += sizeof( DeltaEntry_t ) + PAD_NUMBER( Bits2Bytes( pEntry->nBits ), 4 );
+	}
+
+	return NULL;
+}
+
+bool CPackedEntityDeltaCache::ReadDeltaBits( const PackedEntity *pFrom, const PackedEntity *pTo, int nFromTick, int nToTick, bf_write *pBuf, int &nBits )
+{
+	nBits = -1;
+
+	int nEntityIndex = pTo->m_nEntityIndex;
+	if ( nEntityIndex < 0 || nEntityIndex >= MAX_EDICTS )
+		return false;
+
+	EntitySlot_t &slot = m_Slots[nEntityIndex];
+
+	AUTO_LOCK( slot.m_Mutex );
+
+	DeltaEntry_t *pEntry = ( slot.m_nTick == nToTick ) ? FindEntry( slot, pFrom, pTo, nFromTick ) : NULL;
+	if ( !pEntry )
+	{
+		++m_nMisses;
+		return false;
+	}
+
+	++m_nHits;
+	nBits = pEntry->nBits;
+
+	if ( nBits > 0 )
+	{
+		pBuf->WriteBits( pEntry + 1, nBits );
+	}
+
+	return true;
+}
+
+void CPackedEntityDeltaCache::AddDeltaBits( const PackedEntity *pFrom, const PackedEntity *pTo, int nFromTick, int nToTick, int nBits, const bf_write *pStart )
+{
+	int nEntityIndex = pTo->m_nEntityIndex;
+	if ( nEntityIndex < 0 || nEntityIndex >= MAX_EDICTS )
+		return;
+
+	int nCacheSize = sv_deltacache.GetInt() * 1024;
+	int nBufferSize = PAD_NUMBER( Bits2Bytes( nBits ), 4 );
+	int nEntrySize = sizeof( DeltaEntry_t ) + nBufferSize;
+
+	EntitySlot_t &slot = m_Slots[nEntityIndex];
+
+	AUTO_LOCK( slot.m_Mutex );
+
+	if ( nToTick > slot.m_nTick )
+	{
+		// everything in here was written for an older snapshot
+		slot.m_nTick = nToTick;
+		slot.m_Data.RemoveAll();
+	}
+	else if ( nToTick < slot.m_nTick )
+	{
+		// don't throw away the current tick for a client sending an old frame
+		return;
+	}
+	else if ( FindEntry( slot, pFrom, pTo, nFromTick ) )
+	{
+		// another client beat us to it
+		return;
+	}
+
+	if ( slot.m_Data.Count() + nEntrySize > nCacheSize )
+	{
+		++m_nDropped;
+		return;
+	}
+
+	int nOffset = slot.m_Data.AddMultipleToTail( nEntrySize );
+
+	DeltaEntry_t *pEntry = (DeltaEntry_t *)( slot.m_Data.Base() + nOffset );
+	pEntry->pFrom = pFrom;
+	pEntry->pTo = pTo;
+	pEntry->nFromTick = nFromTick;
+	pEntry->nBits = nBits;
+
+	if ( nBits > 0 )
+	{
+		bf_read inBuffer;
+		inBuffer.StartReading( pStart->m_pData, pStart->m_nDataBytes, pStart->GetNumBitsWritten() );
+
+		bf_write outBuffer( pEntry + 1, nBufferSize );
+		outBuffer.WriteBitsFromBuffer( &inBuffer, nBits );
+	}
+
+	++m_nAdded;
+}
+
+void CPackedEntityDeltaCache::PrintStats()
+{
+	int nHits = m_nHits;
+	int nMisses = m_nMisses;
+	int nLookups = nHits + nMisses;
+
+	int nBytes = 0;
+	for ( int i = 0; i < MAX_EDICTS; i++ )
+	{
+		nBytes += m_Slots[i].m_Data.NumAllocated();
+	}
+
+	ConMsg( "Delta cache: %d lookups, %d hits (%.1f%%), %d misses, %d added, %d dropped, %d KB allocated\n",
+		nLookups, nHits, nLookups ? ( 100.0f * nHits / nLookups ) : 0.0f, nMisses, (int)m_nAdded, (int)m_nDropped, nBytes / 1024 );
+}
+
+void CPackedEntityDeltaCache::ResetStats()
+{
+	m_nHits = 0;
+	m_nMisses = 0;
+	m_nAdded = 0;
+	m_nDropped = 0;
+}
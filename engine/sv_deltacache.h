@@ -0,0 +1,78 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Shares encoded entity delta bits between game clients that
+//			delta from the same packed entity at the same tick.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef SV_DELTACACHE_H
+#define SV_DELTACACHE_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+
+#include "const.h"
+#include "tier0/threadtools.h"
+#include "tier1/utlvector.h"
+
+
+class bf_write;
+class PackedEntity;
+
+
+// Many clients acknowledge the same delta tick, so the same (old pack, new pack, from tick)
+// triple gets culled and written over and over in SV_DetermineUpdateType. This caches the
+// prop bits written after the delta header so the next client can just copy them.
+//
+// Unlike CDeltaEntityCache (which HLTV relays use from the main thread only) this is called
+// from the parallel WriteDeltaEntities jobs, so each entity slot has its own lock. Entries
+// are only valid for the snapshot tick they were written at and are thrown away lazily when
+// a slot sees a newer tick, so no per-frame flush is needed.
+class CPackedEntityDeltaCache
+{
+public:
+	CPackedEntityDeltaCache();
+	~CPackedEntityDeltaCache();
+
+	// Appends the cached delta bits to pBuf and returns true on a hit. nBits is 0 if the
+	// cached result was "nothing changed" (PreserveEnt), in which case nothing is written.
+	bool	ReadDeltaBits( const PackedEntity *pFrom, const PackedEntity *pTo, int nFromTick, int nToTick, bf_write *pBuf, int &nBits );
+
+	// Stores the nBits written to pBuf since pStart. Pass nBits 0 and pStart NULL for PreserveEnt.
+	void	AddDeltaBits( const PackedEntity *pFrom, const PackedEntity *pTo, int nFromTick, int nToTick, int nBits, const bf_write *pStart );
+
+	void	Flush();
+
+	void	PrintStats();
+	void	ResetStats();
+
+private:
+	struct DeltaEntry_t
+	{
+		const PackedEntity *pFrom;
+		const PackedEntity *pTo;
+		int		nFromTick;
+		int		nBits;		// followed by PAD_NUMBER( Bits2Bytes( nBits ), 4 ) bytes of delta bits
+	};
+
+	struct EntitySlot_t
+	{
+		CThreadFastMutex		m_Mutex;
+		int						m_nTick;	// tick all entries in m_Data were written for
+		CUtlVector<byte>		m_Data;		// packed DeltaEntry_t list
+	};
+
+	DeltaEntry_t	*FindEntry( EntitySlot_t &slot, const PackedEntity *pFrom, const PackedEntity *pTo, int nFromTick );
+
+	EntitySlot_t	m_Slots[MAX_EDICTS];
+
+	CInterlockedInt	m_nHits;
+	CInterlockedInt	m_nMisses;
+	CInterlockedInt	m_nAdded;
+	CInterlockedInt	m_nDropped;		// not added because the slot was full
+};
+
+
+#endif // SV_DELTACACHE_H
@@ -21,6 +21,7 @@
 #include "replayserver.h"
 #include "tier0/vcrmode.h"
 #include "framesnapshot.h"
+#include "sv_deltacache.h"
 
 
 // memdbgon must be the last include file in a .cpp file!!!
@@ -33,7 +34,9 @@ extern ConVar g_CV_DTWatchEnt;
 //-----------------------------------------------------------------------------
 
 static ConVar		sv_deltatime( "sv_deltatime", "0", 0, "Enable profiling of CalcDelta calls" );
-static ConVar		sv_deltaprint( "sv_deltaprint", "0", 0, "Print accumulated CalcDelta profiling data (only if sv_deltatime is on)" );
+static ConVar		sv_deltaprint( "sv_deltaprint", "0", 0, "Every N seconds, print delta cache statistics and accumulated CalcDelta profiling data (only if sv_deltatime is on)" );
+
+extern ConVar		sv_deltacache;
 
 #if defined( DEBUG_NETWORKING )
 ConVar  sv_packettrace( "sv_packettrace", "1", 0, "For debugging, print entity creation/deletion info to console." );
@@ -75,8 +78,12 @@ class CEntityWriteInfo : public CEntityInfo
 
 	CBaseServer		*m_pServer;	// the server who writes this entity
 
+	CPackedEntityDeltaCache *m_pDeltaCache; // delta bits shared with other game clients, or NULL
+
 	int				m_nFullProps;	// number of properties send as full update (Enter PVS)
 	bool			m_bCullProps;	// filter props by clients in recipient lists
+
+	CBitVec<MAX_EDICTS>	*m_pBaselinesSent;	// entities sent from their baseline, NULL if this can't become a baseline update
 	
 	/* Some profiling data
 	int				m_nTotalGap;
@@ -146,6 +153,32 @@ void PrintChangeTracks()
 }
 
 
+void SV_DeltaPrint()
+{
+	static double s_flNextPrintTime = 0.0;
+
+	if ( sv_deltaprint.GetFloat() <= 0.0f )
+		return;
+
+	double flTime = Plat_FloatTime();
+	if ( flTime < s_flNextPrintTime )
+		return;
+
+	s_flNextPrintTime = flTime + sv_deltaprint.GetFloat();
+
+	if ( sv_deltatime.GetBool() )
+	{
+		PrintChangeTracks();
+	}
+
+	sv.m_DeltaCache.PrintStats();
+	sv.m_DeltaCache.ResetStats();
+
+	framesnapshotmanager->GetUnpackedDataCache().PrintStats();
+	framesnapshotmanager->GetUnpackedDataCache().ResetStats();
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: Entity wasn't dealt with in packet, but it has been deleted, we'll flag
 //  the entity for destruction
@@ -339,11 +372,12 @@ static inline void SV_WritePropsFromPackedEntity(
 
 	const void *pToData;
 	int nToBits;
+	ALIGN4 char toData[MAX_PACKEDENTITY_DATA] ALIGN4_POST;
 
 	if ( pTo->IsCompressed() )
 	{
 		// let server uncompress PackedEntity
-		pToData = u.m_pServer->UncompressPackedEntity( pTo, nToBits );
+		pToData = u.m_pServer->UncompressPackedEntity( pTo, nToBits, toData );
 	}
 	else
 	{
@@ -533,6 +567,40 @@ static inline void SV_DetermineUpdateType( CEntityWriteInfo &u )
 	}
 #endif
 
+	// Other game clients delta from the same packs at the same tick, so reuse their bits. Only
+	// safe if no SendProxy recipient lists make the culled props depend on this client.
+	bool bUseDeltaCache = u.m_pDeltaCache && !u.m_pOldPack->GetNumRecipients() && !u.m_pNewPack->GetNumRecipients();
+
+	if ( bUseDeltaCache )
+	{
+		// tentatively write the header, it's backed out if the entity didn't change or isn't cached
+		bf_write bufHeader = *u.m_pBuf;
+		int nHeaderCount = u.m_nHeaderCount;
+		int nHeaderBase = u.m_nHeaderBase;
+
+		SV_WriteDeltaHeader( u, u.m_nNewEntity, FHDR_ZERO );
+
+		int nCachedBits;
+		bool bFound = u.m_pDeltaCache->ReadDeltaBits( u.m_pOldPack, u.m_pNewPack, 
+			u.m_pFromSnapshot->m_nTickCount, u.m_pToSnapshot->m_nTickCount, u.m_pBuf, nCachedBits );
+
+		if ( bFound && nCachedBits > 0 )
+		{
+			u.m_UpdateType = DeltaEnt;
+			return;
+		}
+
+		*u.m_pBuf = bufHeader;
+		u.m_nHeaderCount = nHeaderCount;
+		u.m_nHeaderBase = nHeaderBase;
+
+		if ( bFound )
+		{
+			u.m_UpdateType = PreserveEnt;
+			return;
+		}
+	}
+
 	int checkProps[MAX_DATATABLE_PROPS];
 	int nCheckProps = u.m_pNewPack->GetPropsChangedAfterTick( u.m_pFromSnapshot->m_nTickCount, checkProps, ARRAYSIZE( checkProps ) );
 	
@@ -543,10 +611,12 @@ static inline void SV_DetermineUpdateType( CEntityWriteInfo &u )
 
 		const void *pOldData, *pNewData;
 		int nOldBits, nNewBits;
+		ALIGN4 char oldData[MAX_PACKEDENTITY_DATA] ALIGN4_POST;
+		ALIGN4 char newData[MAX_PACKEDENTITY_DATA] ALIGN4_POST;
 
 		if ( u.m_pOldPack->IsCompressed() )
 		{
-			pOldData = u.m_pServer->UncompressPackedEntity( u.m_pOldPack, nOldBits );
+			pOldData = u.m_pServer->UncompressPackedEntity( u.m_pOldPack, nOldBits, oldData );
 		}
 		else
 		{
@@ -556,7 +626,7 @@ static inline void SV_DetermineUpdateType( CEntityWriteInfo &u )
 
 		if ( u.m_pNewPack->IsCompressed() )
 		{
-			pNewData = u.m_pServer->UncompressPackedEntity( u.m_pNewPack, nNewBits );
+			pNewData = u.m_pServer->UncompressPackedEntity( u.m_pNewPack, nNewBits, newData );
 		}
 		else
 		{
@@ -587,14 +657,16 @@ static inline void SV_DetermineUpdateType( CEntityWriteInfo &u )
 	{
 		// Write a header.
 		SV_WriteDeltaHeader( u, u.m_nNewEntity, FHDR_ZERO );
-#if defined( DEBUG_NETWORKING )
-		int startBit = u.m_pBuf->GetNumBitsWritten();
-#endif
+		bf_write bufStart = *u.m_pBuf;
 		SV_WritePropsFromPackedEntity( u, checkProps, nCheckProps );
-#if defined( DEBUG_NETWORKING )
-		int endBit = u.m_pBuf->GetNumBitsWritten();
-		TRACE_PACKET( ( "    Delta Bits (%d) = %d (%d bytes)\n", u.m_nNewEntity, (endBit - startBit), ( (endBit - startBit) + 7 ) / 8 ) );
-#endif
+		int nDeltaBits = u.m_pBuf->GetNumBitsWritten() - bufStart.GetNumBitsWritten();
+		TRACE_PACKET( ( "    Delta Bits (%d) = %d (%d bytes)\n", u.m_nNewEntity, nDeltaBits, ( nDeltaBits + 7 ) / 8 ) );
+
+		if ( bUseDeltaCache && !u.m_pBuf->IsOverflowed() )
+		{
+			u.m_pDeltaCache->AddDeltaBits( u.m_pOldPack, u.m_pNewPack, 
+				u.m_pFromSnapshot->m_nTickCount, u.m_pToSnapshot->m_nTickCount, nDeltaBits, &bufStart );
+		}
 		// If the numbers are the same, then the entity was in the old and new packet.
 		// Just delta compress the differences.
 		u.m_UpdateType = DeltaEnt;
@@ -619,6 +691,13 @@ static inline void SV_DetermineUpdateType( CEntityWriteInfo &u )
 #endif
 		}
 #endif
+		if ( bUseDeltaCache )
+		{
+			// no bits changed, PreserveEnt
+			u.m_pDeltaCache->AddDeltaBits( u.m_pOldPack, u.m_pNewPack, 
+				u.m_pFromSnapshot->m_nTickCount, u.m_pToSnapshot->m_nTickCount, 0, NULL );
+		}
+
 		u.m_UpdateType = PreserveEnt;
 	}
 }
@@ -690,18 +769,19 @@ static inline void SV_WriteEnterPVS( CEntityWriteInfo &u )
 									// by more than 7 bits).
 	}
 
-	if ( u.m_pTo->from_baseline )
+	if ( u.m_pBaselinesSent )
 	{
 		// remember that we sent this entity as full update from entity baseline
-		u.m_pTo->from_baseline->Set( u.m_nNewEntity );
+		u.m_pBaselinesSent->Set( u.m_nNewEntity );
 	}
 
 	const void *pToData;
 	int nToBits;
+	ALIGN4 char toData[MAX_PACKEDENTITY_DATA] ALIGN4_POST;
 
 	if ( u.m_pNewPack->IsCompressed() )
 	{
-		pToData = u.m_pServer->UncompressPackedEntity( u.m_pNewPack, nToBits );
+		pToData = u.m_pServer->UncompressPackedEntity( u.m_pNewPack, nToBits, toData );
 	}
 	else
 	{
@@ -868,6 +948,28 @@ Returns the size IN BITS of the message buffer created.
 */
 
 void CBaseServer::WriteDeltaEntities( CBaseClient *client, CClientFrame *to, CClientFrame *from, bf_write &pBuf )
+{
+	// this snapshot may become a baseline update if the client isn't waiting for the ack of one
+	CBitVec<MAX_EDICTS> *pBaselinesSent = NULL;
+	if ( client->m_nBaselineUpdateTick == -1 )
+	{
+		client->m_BaselinesSent.ClearAll();
+		pBaselinesSent = &client->m_BaselinesSent;
+	}
+
+	if ( WriteDeltaEntities( client, to, from, pBuf, pBaselinesSent ) )
+	{
+		client->m_nBaselineUpdateTick = to->tick_count;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes the packet entities without changing the client's baseline state,
+//			so it can run on a job that may be thrown away. pBaselinesSent gets the
+//			entities written from their baseline, pass NULL if the snapshot must not
+//			become a baseline update. Returns true if it was flagged as one.
+//-----------------------------------------------------------------------------
+bool CBaseServer::WriteDeltaEntities( CBaseClient *client, CClientFrame *to, CClientFrame *from, bf_write &pBuf, CBitVec<MAX_EDICTS> *pBaselinesSent )
 {
 	VPROF_BUDGET( "CBaseServer::WriteDeltaEntities", VPROF_BUDGETGROUP_OTHER_NETWORKING );
 	// Setup the CEntityWriteInfo structure.
@@ -879,6 +981,13 @@ void CBaseServer::WriteDeltaEntities( CBaseClient *client, CClientFrame *to, CCl
 	u.m_nFullProps = 0;
 	u.m_pServer = this;
 	u.m_nClientEntity = client->m_nEntityIndex;
+
+	// HLTV and replay have their own m_DeltaCache, and server DTI wants to see every encode
+	u.m_pDeltaCache = NULL;
+	if ( !IsHLTV() && !IsReplay() && sv_deltacache.GetInt() > 0 && !g_bServerDTIEnabled )
+	{
+		u.m_pDeltaCache = &sv.m_DeltaCache;
+	}
 #ifndef _XBOX
 	if ( IsHLTV() || IsReplay() )
 	{
@@ -909,12 +1018,7 @@ void CBaseServer::WriteDeltaEntities( CBaseClient *client, CClientFrame *to, CCl
 //	u.m_nTotalGap = 0;
 //	u.m_nTotalGapCount = 0;
 
-	// set from_baseline pointer if this snapshot may become a baseline update
-	if ( client->m_nBaselineUpdateTick == -1 )
-	{
-		client->m_BaselinesSent.ClearAll();
-		to->from_baseline = &client->m_BaselinesSent;
-	}
+	u.m_pBaselinesSent = pBaselinesSent;
 
 	// Write the header, TODO use class SVC_PacketEntities
 		
@@ -1017,24 +1121,18 @@ void CBaseServer::WriteDeltaEntities( CBaseClient *client, CClientFrame *to, CCl
 	savepos.WriteUBitLong( u.m_nHeaderCount, MAX_EDICT_BITS );
 	savepos.WriteUBitLong( length, DELTASIZE_BITS );
 
-	bool bUpdateBaseline = ( (client->m_nBaselineUpdateTick == -1) && 
-		(u.m_nFullProps > 0 || !u.m_bAsDelta) );
+	bool bUpdateBaseline = ( pBaselinesSent && 
+		(u.m_nFullProps > 0 || !u.m_bAsDelta) && u.m_pBaseline );
 
-	if ( bUpdateBaseline && u.m_pBaseline )
-	{
-		// tell client to use this snapshot as baseline update
-		savepos.WriteOneBit( 1 ); 
-		client->m_nBaselineUpdateTick = to->tick_count;
-	}
-	else
-	{
-		savepos.WriteOneBit( 0 ); 
-	}
+	// tell client to use this snapshot as baseline update
+	savepos.WriteOneBit( bUpdateBaseline ? 1 : 0 ); 
 
 	if ( bIsTracing )
 	{
 		client->TraceNetworkData( pBuf, "Delta Finish" );
 	}
+
+	return bUpdateBaseline;
 }
 
 
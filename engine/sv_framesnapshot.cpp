@@ -58,7 +58,7 @@ void CFrameSnapshotManager::LevelChanged()
 	Assert( m_FrameSnapshots.Count() == 0 );
 
 	// Release the most recent snapshot...
-	m_PackedEntityCache.RemoveAll();
+	m_UnpackedDataCache.Purge();
 	COMPILE_TIME_ASSERT( INVALID_PACKED_ENTITY_HANDLE == 0 );
 	Q_memset( m_pPackedData, 0x00, MAX_EDICTS * sizeof(PackedEntityHandle_t) );
 }
@@ -204,19 +204,13 @@ void CFrameSnapshotManager::RemoveEntityReference( PackedEntityHandle_t handle )
 	{
 		AUTO_LOCK( m_WriteMutex );
 
-		m_PackedEntitiesPool.Free( packedEntity );
-
 		// if we have a uncompression cache, remove reference too
-		FOR_EACH_VEC( m_PackedEntityCache, i )
+		if ( packedEntity->IsCompressed() )
 		{
-			UnpackedDataCache_t &pdc = m_PackedEntityCache[i];
-			if ( pdc.pEntity == packedEntity )
-			{
-				pdc.pEntity = NULL;
-				pdc.counter = 0;
-				break;
-			}
+			m_UnpackedDataCache.Remove( packedEntity );
 		}
+
+		m_PackedEntitiesPool.Free( packedEntity );
 	}
 }
 
@@ -372,56 +366,166 @@ PackedEntity* CFrameSnapshotManager::GetPackedEntity( CFrameSnapshot* pSnapshot,
 
 
 
-// ------------------------------------------------------------------------------------------------ //
-// purpose: lookup cache if we have an uncompressed version of this packed entity
-// ------------------------------------------------------------------------------------------------ //
-UnpackedDataCache_t *CFrameSnapshotManager::GetCachedUncompressedEntity( PackedEntity *packedEntity )
+//-----------------------------------------------------------------------------
+// CUnpackedDataCache
+//-----------------------------------------------------------------------------
+CUnpackedDataCache::CUnpackedDataCache()
+{
+	for ( int i = 0; i < UNPACKED_CACHE_SHARDS; i++ )
+	{
+		Shard_t &shard = m_Shards[i];
+		shard.m_nUseCounter = 0;
+		shard.m_nHits = shard.m_nMisses = shard.m_nEvictions = 0;
+
+		for ( int j = 0; j < ARRAYSIZE( shard.m_Entries ); j++ )
+		{
+			shard.m_Entries[j].m_pEntity = NULL;
+			shard.m_Entries[j].m_nLastUse = 0;
+			shard.m_Entries[j].m_nBits = 0;
+		}
+	}
+}
+
+CUnpackedDataCache::Shard_t &CUnpackedDataCache::GetShard( const PackedEntity *pEntity, Entry_t *&pSet )
+{
+	// packed entities come from a pool, so the low bits of the address carry little
+	uint32 nHash = (uint32)( (uintp)pEntity >> 4 ) * 2654435761U;
+
+	Shard_t &shard = m_Shards[ nHash >> ( 32 - 4 ) ];
+	COMPILE_TIME_ASSERT( UNPACKED_CACHE_SHARDS == ( 1 << 4 ) );
+
+	pSet = &shard.m_Entries[ ( ( nHash >> 8 ) % UNPACKED_CACHE_SETS ) * UNPACKED_CACHE_WAYS ];
+	return shard;
+}
+
+bool CUnpackedDataCache::Lookup( const PackedEntity *pEntity, void *pOut, int nOutBytes, int &nBits )
+{
+	Entry_t *pSet;
+	Shard_t &shard = GetShard( pEntity, pSet );
+
+	AUTO_LOCK( shard.m_Mutex );
+
+	for ( int i = 0; i < UNPACKED_CACHE_WAYS; i++ )
+	{
+		Entry_t &entry = pSet[i];
+		if ( entry.m_pEntity != pEntity )
+			continue;
+
+		int nBytes = Bits2Bytes( entry.m_nBits );
+		if ( nBytes > nOutBytes )
+			break;
+
+		entry.m_nLastUse = ++shard.m_nUseCounter;
+		++shard.m_nHits;
+
+		memcpy( pOut, entry.m_Data.Base(), nBytes );
+		nBits = entry.m_nBits;
+		return true;
+	}
+
+	++shard.m_nMisses;
+	return false;
+}
+
+void CUnpackedDataCache::Add( const PackedEntity *pEntity, const void *pData, int nBits )
 {
-	if ( m_PackedEntityCache.Count() == 0 )
+	Entry_t *pSet;
+	Shard_t &shard = GetShard( pEntity, pSet );
+
+	AUTO_LOCK( shard.m_Mutex );
+
+	// another client may have uncompressed it at the same time, else replace the oldest entry
+	Entry_t *pEntry = NULL;
+	for ( int i = 0; i < UNPACKED_CACHE_WAYS; i++ )
 	{
-		// ops, we have no cache yet, create one and reset counter
-		m_nPackedEntityCacheCounter = 0;
-		m_PackedEntityCache.SetCount( 128 );
+		if ( pSet[i].m_pEntity == pEntity )
+			return;
 
-		FOR_EACH_VEC( m_PackedEntityCache, i )
+		if ( !pEntry || !pSet[i].m_pEntity || ( pEntry->m_pEntity && pSet[i].m_nLastUse < pEntry->m_nLastUse ) )
 		{
-			m_PackedEntityCache[i].pEntity = NULL;
-			m_PackedEntityCache[i].counter = 0;
+			pEntry = &pSet[i];
 		}
 	}
 
-	m_nPackedEntityCacheCounter++;
+	if ( pEntry->m_pEntity )
+	{
+		++shard.m_nEvictions;
+	}
+
+	int nBytes = Bits2Bytes( nBits );
+	pEntry->m_Data.EnsureCapacity( nBytes );
+	memcpy( pEntry->m_Data.Base(), pData, nBytes );
+
+	pEntry->m_pEntity = pEntity;
+	pEntry->m_nBits = nBits;
+	pEntry->m_nLastUse = ++shard.m_nUseCounter;
+}
 
-	// remember oldest cache entry
-	UnpackedDataCache_t *pdcOldest = NULL;
-	int oldestValue = m_nPackedEntityCacheCounter;
+void CUnpackedDataCache::Remove( const PackedEntity *pEntity )
+{
+	Entry_t *pSet;
+	Shard_t &shard = GetShard( pEntity, pSet );
 
+	AUTO_LOCK( shard.m_Mutex );
 
-	FOR_EACH_VEC( m_PackedEntityCache, i )
+	for ( int i = 0; i < UNPACKED_CACHE_WAYS; i++ )
 	{
-		UnpackedDataCache_t *pdc = &m_PackedEntityCache[i];
+		if ( pSet[i].m_pEntity == pEntity )
+		{
+			pSet[i].m_pEntity = NULL;
+			break;
+		}
+	}
+}
+
+void CUnpackedDataCache::Purge()
+{
+	for ( int i = 0; i < UNPACKED_CACHE_SHARDS; i++ )
+	{
+		Shard_t &shard = m_Shards[i];
+		AUTO_LOCK( shard.m_Mutex );
 
-		if ( pdc->pEntity == packedEntity )
+		for ( int j = 0; j < ARRAYSIZE( shard.m_Entries ); j++ )
 		{
-			// hit, found it, update counter
-			pdc->counter = m_nPackedEntityCacheCounter;
-			return pdc;
+			shard.m_Entries[j].m_pEntity = NULL;
+			shard.m_Entries[j].m_Data.Purge();
 		}
+	}
+}
+
+void CUnpackedDataCache::PrintStats()
+{
+	int nHits = 0, nMisses = 0, nEvictions = 0, nEntries = 0, nBytes = 0;
 
-		if( pdc->counter < oldestValue )
+	for ( int i = 0; i < UNPACKED_CACHE_SHARDS; i++ )
+	{
+		Shard_t &shard = m_Shards[i];
+		AUTO_LOCK( shard.m_Mutex );
+
+		nHits += shard.m_nHits;
+		nMisses += shard.m_nMisses;
+		nEvictions += shard.m_nEvictions;
+
+		for ( int j = 0; j < ARRAYSIZE( shard.m_Entries ); j++ )
 		{
-			oldestValue = pdc->counter;
-			pdcOldest = pdc;
+			nEntries += shard.m_Entries[j].m_pEntity ? 1 : 0;
+			nBytes += shard.m_Entries[j].m_Data.NumAllocated();
 		}
 	}
 
-	Assert ( pdcOldest );
+	int nLookups = nHits + nMisses;
+	ConMsg( "Unpacked entity cache: %d lookups, %d hits (%.1f%%), %d misses, %d evicted, %d entries, %d KB allocated\n",
+		nLookups, nHits, nLookups ? ( 100.0f * nHits / nLookups ) : 0.0f, nMisses, nEvictions, nEntries, nBytes / 1024 );
+}
 
-	// hmm, not in cache, clear & return oldest one
-	pdcOldest->counter = m_nPackedEntityCacheCounter;
-	pdcOldest->bits = -1;	// important, this is the signal for the caller to fill this structure
-	pdcOldest->pEntity = packedEntity;
-	return pdcOldest;
+void CUnpackedDataCache::ResetStats()
+{
+	for ( int i = 0; i < UNPACKED_CACHE_SHARDS; i++ )
+	{
+		Shard_t &shard = m_Shards[i];
+		AUTO_LOCK( shard.m_Mutex );
+		shard.m_nHits = shard.m_nMisses = shard.m_nEvictions = 0;
+	}
 }
 
 
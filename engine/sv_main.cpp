@@ -32,7 +32,9 @@
 #include "vstdlib/random.h"
 #include "networkstringtable.h"
 #include "dt_send_eng.h"
+#include "dt_instrumentation_server.h"
 #include "sv_packedentities.h"
+#include "sv_phaseprofile.h"
 #include "testscriptmgr.h"
 #include "PlayerState.h"
 #include "saverestoretypes.h"
@@ -407,6 +409,11 @@ void CGameServer::Clear( void )
 
 	m_TempEntities.Purge();
 
+	DiscardPipelinedSnapshots();
+
+	m_DeltaCache.Flush();
+	m_DeltaCache.ResetStats();
+
 	CBaseServer::Clear();
 }
 
@@ -1055,6 +1062,8 @@ void CGameServer::Shutdown( void )
 {
 	m_bIsLevelMainMenuBackground = false;
 
+	DiscardPipelinedSnapshots();
+
 	CBaseServer::Shutdown();
 
 	// Actually performs a shutdown.
@@ -1293,6 +1302,7 @@ CGameServer::CGameServer()
 	m_pPureServerWhitelist = NULL;
 	m_bHibernating = false;
 	m_bLoadedPlugins = false;
+	m_pPipelinedSnapshot = NULL;
 	V_memset( m_szMapname, 0, sizeof( m_szMapname ) );
 	V_memset( m_szMapFilename, 0, sizeof( m_szMapFilename ) );
 }
@@ -1442,20 +1452,46 @@ crosses a waterline.
 =============================================================================
 */
 
-static int		s_FatBytes;
-static byte*	s_pFatPVS = 0;
+// The PVS being built and the areas networked are per thread, so client visibility
+// can be set up on several threads at once.
+struct FatPVS_t
+{
+	byte			*m_pFatPVS;
+	int				m_nFatBytes;
+	CUtlVector<int>	m_AreasNetworked;
+};
+
+static CTHREADLOCALPTR( FatPVS_t ) s_pFatPVS;
 
-CUtlVector<int> g_AreasNetworked;
+static FatPVS_t &SV_GetFatPVS()
+{
+	// threads setting up visibility live as long as the engine, so this isn't freed
+	FatPVS_t *pFatPVS = s_pFatPVS;
+	if ( !pFatPVS )
+	{
+		pFatPVS = new FatPVS_t;
+		pFatPVS->m_pFatPVS = NULL;
+		pFatPVS->m_nFatBytes = 0;
+		s_pFatPVS = pFatPVS;
+	}
+	return *pFatPVS;
+}
+
+CUtlVector<int> &SV_GetAreasNetworked()
+{
+	return SV_GetFatPVS().m_AreasNetworked;
+}
 
 static void SV_AddToFatPVS( const Vector& org )
 {
 	int		i;
 	byte	pvs[MAX_MAP_LEAFS/8];
+	FatPVS_t &fatPVS = SV_GetFatPVS();
 
 	CM_Vis( pvs, sizeof(pvs), CM_LeafCluster( CM_PointLeafnum( org ) ), DVIS_PVS );
-	for (i=0 ; i<s_FatBytes ; i++)
+	for (i=0 ; i<fatPVS.m_nFatBytes ; i++)
 	{
-		s_pFatPVS[i] |= pvs[i];
+		fatPVS.m_pFatPVS[i] |= pvs[i];
 	}
 }
 
@@ -1464,16 +1500,17 @@ static void SV_AddToFatPVS( const Vector& org )
 //-----------------------------------------------------------------------------
 void SV_ResetPVS( byte* pvs, int pvssize )
 {
-	s_pFatPVS = pvs;
-	s_FatBytes = Bits2Bytes(CM_NumClusters());
+	FatPVS_t &fatPVS = SV_GetFatPVS();
+	fatPVS.m_pFatPVS = pvs;
+	fatPVS.m_nFatBytes = Bits2Bytes(CM_NumClusters());
 
-	if ( s_FatBytes > pvssize )
+	if ( fatPVS.m_nFatBytes > pvssize )
 	{
-		Sys_Error( "SV_ResetPVS:  Size %i too big for buffer %i\n", s_FatBytes, pvssize );
+		Sys_Error( "SV_ResetPVS:  Size %i too big for buffer %i\n", fatPVS.m_nFatBytes, pvssize );
 	}
 
-	Q_memset (s_pFatPVS, 0, s_FatBytes);
-	g_AreasNetworked.RemoveAll();
+	Q_memset (fatPVS.m_pFatPVS, 0, fatPVS.m_nFatBytes);
+	fatPVS.m_AreasNetworked.RemoveAll();
 }
 
 /*
@@ -1487,14 +1524,15 @@ void SV_AddOriginToPVS( const Vector& origin )
 	SV_AddToFatPVS( origin );
 	int area = CM_LeafArea( CM_PointLeafnum( origin ) );
 	int i;
-	for( i = 0; i < g_AreasNetworked.Count(); i++ )
+	CUtlVector<int> &areasNetworked = SV_GetAreasNetworked();
+	for( i = 0; i < areasNetworked.Count(); i++ )
 	{
-		if( g_AreasNetworked[i] == area )
+		if( areasNetworked[i] == area )
 		{
 			return;
 		}
 	}
-	g_AreasNetworked.AddToTail( area );
+	areasNetworked.AddToTail( area );
 }
 
 void CGameServer::BroadcastSound( SoundInfo_t &sound, IRecipientFilter &filter )
@@ -1850,9 +1888,149 @@ static void SV_ParallelSendSnapshot( CGameClient *& pClient )
 	pClient = NULL;
 }
 
+static ConVar sv_parallel_writedeltaentities( "sv_parallel_writedeltaentities", "0", 0, "Write the packet entities of all clients on the job thread pool before sending snapshots." );
+
+static void SV_ParallelWriteDeltaEntities( CGameClient *& pClient )
+{
+	pClient->PrepareDeltaEntities( pClient->GetSendFrame() );
+}
+
+//-----------------------------------------------------------------------------
+// Writes delta entities for every client that can do so off the main thread. SendSnapshot
+// then only splices the prepared bits into its message. HLTV, replay and clients watching
+// a replay are skipped since building their deltas touches global or game DLL state.
+//-----------------------------------------------------------------------------
+static void SV_PrepareDeltaEntities( int clientCount, CGameClient **clients )
+{
+	if ( clientCount < 2 || !sv_parallel_writedeltaentities.GetBool() || g_bServerDTIEnabled || g_pLocalNetworkBackdoor )
+		return;
+
+	VPROF_BUDGET( "SV_PrepareDeltaEntities", VPROF_BUDGETGROUP_OTHER_NETWORKING );
+
+	int nWorkClients = 0;
+	CGameClient *pWorkClients[ABSOLUTE_PLAYER_LIMIT];
+	for ( int i = 0; i < clientCount; ++i )
+	{
+		CGameClient *pClient = clients[i];
+		if ( pClient->IsHLTV() || pClient->IsReplay() || pClient->m_bIsInReplayMode )
+			continue;
+
+		if ( !pClient->GetSendFrame() )
+			continue;
+
+		pWorkClients[nWorkClients++] = pClient;
+	}
+
+	if ( nWorkClients > 1 )
+	{
+		ParallelProcess( "SV_ParallelWriteDeltaEntities", pWorkClients, nWorkClients, &SV_ParallelWriteDeltaEntities );
+	}
+}
+
+static ConVar sv_pipeline_snapshots( "sv_pipeline_snapshots", "0", 0, "Write the packet entities of client snapshots on the job thread pool while the next tick simulates, and send them at the start of the next tick's client updates. Adds a tick of latency." );
+
+//-----------------------------------------------------------------------------
+// With sv_pipeline_snapshots, queues the delta entities of every client that can
+// have them written off the main thread and takes those clients out of the list.
+// Their snapshots go out with the next SendClientMessages, which is what lets the
+// encoding overlap the next tick's simulation. Returns the number of clients left.
+//-----------------------------------------------------------------------------
+int CGameServer::PipelineSnapshots( int clientCount, CGameClient **clients, CFrameSnapshot *pSnapshot )
+{
+	Assert( !m_pPipelinedSnapshot && !m_PipelinedSnapshots.Count() );
+
+	// replay picks the send frame in the game DLL and keeps frames around on its own
+	if ( !sv_pipeline_snapshots.GetBool() || !g_pThreadPool->NumThreads() || sv_maxreplay.GetFloat() > 0 ||
+		g_bServerDTIEnabled || g_pLocalNetworkBackdoor )
+		return clientCount;
+
+	VPROF_BUDGET( "PipelineSnapshots", VPROF_BUDGETGROUP_OTHER_NETWORKING );
+
+	int nRemaining = 0;
+	for ( int i = 0; i < clientCount; ++i )
+	{
+		CGameClient *pClient = clients[i];
+		CClientFrame *pFrame = pClient->GetSendFrame();
+
+		if ( pClient->IsHLTV() || pClient->IsReplay() || !pFrame || !pClient->QueuePrepareDeltaEntities( pFrame ) )
+		{
+			clients[nRemaining++] = pClient;
+			continue;
+		}
+
+		// the client is due an update this tick, it just leaves a bit later
+		pClient->UpdateSendState();
+
+		PipelinedSnapshot_t &pipelined = m_PipelinedSnapshots[ m_PipelinedSnapshots.AddToTail() ];
+		pipelined.m_pClient = pClient;
+		pipelined.m_pFrame = pFrame;
+	}
+
+	if ( m_PipelinedSnapshots.Count() )
+	{
+		// temp entities and m_pLastSnapshot of the clients still refer to it
+		pSnapshot->AddReference();
+		m_pPipelinedSnapshot = pSnapshot;
+	}
+
+	return nRemaining;
+}
+
+//-----------------------------------------------------------------------------
+// Sends the snapshots queued by PipelineSnapshots last tick
+//-----------------------------------------------------------------------------
+void CGameServer::SendPipelinedSnapshots()
+{
+	if ( !m_pPipelinedSnapshot )
+		return;
+
+	VPROF_BUDGET( "SendPipelinedSnapshots", VPROF_BUDGETGROUP_OTHER_NETWORKING );
+
+	for ( int i = 0; i < m_PipelinedSnapshots.Count(); ++i )
+	{
+		CGameClient *pClient = m_PipelinedSnapshots[i].m_pClient;
+		CClientFrame *pFrame = m_PipelinedSnapshots[i].m_pFrame;
+
+		// went inactive in between, its frames are gone
+		if ( !pClient->IsActive() || pClient->GetSendFrame() != pFrame )
+		{
+			pClient->FinishPrepareDeltaEntities( true );
+			continue;
+		}
+
+		pClient->SendSnapshot( pFrame );
+	}
+
+	m_PipelinedSnapshots.RemoveAll();
+
+	m_pPipelinedSnapshot->ReleaseReference();
+	m_pPipelinedSnapshot = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Drops the pipelined snapshots without sending them. The jobs themselves belong
+// to the clients, which drop them when they are cleared.
+//-----------------------------------------------------------------------------
+void CGameServer::DiscardPipelinedSnapshots()
+{
+	m_PipelinedSnapshots.RemoveAll();
+
+	if ( m_pPipelinedSnapshot )
+	{
+		m_pPipelinedSnapshot->ReleaseReference();
+		m_pPipelinedSnapshot = NULL;
+	}
+}
+
 void CGameServer::SendClientMessages ( bool bSendSnapshots )
 {
 	VPROF_BUDGET( "SendClientMessages", VPROF_BUDGETGROUP_OTHER_NETWORKING );
+
+	// send all client datagrams of this tick in one go at the end
+	NET_BeginBatchedSends();
+
+	// last tick's snapshots, written while this tick simulated
+	SendPipelinedSnapshots();
 	
 	// build individual updates
 	int receivingClientCount = 0;
@@ -1894,6 +2072,7 @@ void CGameServer::SendClientMessages ( bool bSendSnapshots )
 		}
 	}
 
+	int hSendPhase = -1;
 	if ( receivingClientCount )
 	{
 		// if any client wants an update, take new snapshot now
@@ -1905,6 +2084,14 @@ void CGameServer::SendClientMessages ( bool bSendSnapshots )
 		// Compute the client packs
 		SV_ComputeClientPacks( receivingClientCount, pReceivingClients, pSnapshot );
 
+		hSendPhase = SV_PhaseProfile_BeginPhase( SERVER_PHASE_SEND );
+
+		// Hand off what can be encoded during the next tick
+		receivingClientCount = PipelineSnapshots( receivingClientCount, pReceivingClients, pSnapshot );
+
+		// Encode the per-client entity deltas in parallel
+		SV_PrepareDeltaEntities( receivingClientCount, pReceivingClients );
+
 		if ( receivingClientCount > 1 && sv_parallel_sendsnapshot.GetBool() )
 		{
 			// SV_ParallelSendSnapshot will not process HLTV or Replay clients as they
@@ -1927,6 +2114,12 @@ void CGameServer::SendClientMessages ( bool bSendSnapshots )
 	
 		pSnapshot->ReleaseReference();
 	}
+
+	NET_FlushBatchedSends();
+
+	SV_PhaseProfile_EndPhase( hSendPhase );
+
+	SV_DeltaPrint();
 }
 
 void CGameServer::SetMaxClients( int number )
@@ -2948,10 +3141,12 @@ void SV_Frame( bool finalTick )
 			networkStringTableContainerServer->SetTick( sv.m_nTickCount );
 		}
 
+		SV_PHASE_SCOPE( SERVER_PHASE_GAME_FRAME );
 		SV_Think( bIsSimulating );
 	}
 	else if ( sv.IsMultiplayer() )
 	{
+		SV_PHASE_SCOPE( SERVER_PHASE_GAME_FRAME );
 		SV_Think( false );	// let the game.dll systems think
 	}
 
@@ -25,7 +25,8 @@ class CGameClient;
 // sv_main.c
 
 // Which areas are we going to transmit (usually 1, but with portals you can see into multiple other areas).
-extern CUtlVector<int> g_AreasNetworked;
+// Filled in by SV_ResetPVS/SV_AddOriginToPVS on the calling thread.
+CUtlVector<int> &SV_GetAreasNetworked();
 
 void SV_Frame( bool send_client_updates );
 void SV_FrameExecuteThreadDeferred();
@@ -94,6 +95,9 @@ class CClientFrame;
 void SV_InitSendTables( ServerClass *pClasses );
 void SV_TermSendTables( ServerClass *pClasses );
 
+// prints CalcDelta profiling and delta cache statistics while sv_deltaprint is set
+void SV_DeltaPrint();
+
 // send voice data from cl to other clients
 void SV_BroadcastVoiceData(IClient * cl, int nBytes, char * data, int64 xuid);
 void SV_SendRestoreMsg( bf_write &dest );
@@ -9,6 +9,7 @@
 #include "server_pch.h"
 #include "client.h"
 #include "sv_packedentities.h"
+#include "sv_phaseprofile.h"
 #include "bspfile.h"
 #include "eiface.h"
 #include "dt_send_eng.h"
@@ -467,6 +468,52 @@ void PackEntities_Normal(
 }
 
 
+static ConVar sv_parallel_checktransmit( "sv_parallel_checktransmit", "0", 0, "Run the game's CheckTransmit for all clients in parallel" );
+
+struct CheckTransmitWork_t
+{
+	CGameClient		*pClient;
+	CFrameSnapshot	*pSnapshot;
+
+	static void Process( CheckTransmitWork_t &item )
+	{
+		serverGameEnts->CheckTransmit( &item.pClient->m_PackInfo, item.pSnapshot->m_pValidEntities, item.pSnapshot->m_nValidEntities );
+		item.pClient->SetupPrevPackInfo();
+	}
+};
+
+//-----------------------------------------------------------------------------
+// Runs CheckTransmit for all clients on the job threads. Returns false if the
+// game can't do that, the caller does them one at a time then.
+//-----------------------------------------------------------------------------
+static bool SV_ParallelCheckTransmit( int clientCount, CGameClient **clients, CFrameSnapshot *snapshot )
+{
+	if ( !sv_parallel_checktransmit.GetBool() || clientCount < 2 || g_iServerGameEntsVersion < 2 )
+		return false;
+
+	if ( !serverGameEnts->PrepareParallelCheckTransmit( snapshot->m_pValidEntities, snapshot->m_nValidEntities ) )
+		return false;
+
+	// Visibility setup calls into the game which shares state between clients, so that stays
+	// on this thread. Each client's PVS and areas are copied into its pack info.
+	CUtlVectorFixed< CheckTransmitWork_t, ABSOLUTE_PLAYER_LIMIT > workItems;
+	for ( int iClient = 0; iClient < clientCount; ++iClient )
+	{
+		clients[iClient]->SetupPackInfo( snapshot );
+
+		CheckTransmitWork_t w;
+		w.pClient = clients[iClient];
+		w.pSnapshot = snapshot;
+		workItems.AddToTail( w );
+	}
+
+	ParallelProcess( "CheckTransmitWork_t::Process", workItems.Base(), workItems.Count(), &CheckTransmitWork_t::Process );
+
+	serverGameEnts->FinishParallelCheckTransmit();
+
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // Writes the compressed packet of entities to all clients
 //-----------------------------------------------------------------------------
@@ -482,17 +529,22 @@ void SV_ComputeClientPacks(
 	// Do some setup for each client
 	{
 		VPROF_BUDGET_FLAGS( "SV_ComputeClientPacks", "CheckTransmit", BUDGETFLAG_SERVER );
+		SV_PHASE_SCOPE( SERVER_PHASE_CHECK_TRANSMIT );
 
-		for (int iClient = 0; iClient < clientCount; ++iClient)
+		if ( !SV_ParallelCheckTransmit( clientCount, clients, snapshot ) )
 		{
-			CCheckTransmitInfo *pInfo = &clients[iClient]->m_PackInfo;
-			clients[iClient]->SetupPackInfo( snapshot );
-			serverGameEnts->CheckTransmit( pInfo, snapshot->m_pValidEntities, snapshot->m_nValidEntities );
-			clients[iClient]->SetupPrevPackInfo();
+			for (int iClient = 0; iClient < clientCount; ++iClient)
+			{
+				CCheckTransmitInfo *pInfo = &clients[iClient]->m_PackInfo;
+				clients[iClient]->SetupPackInfo( snapshot );
+				serverGameEnts->CheckTransmit( pInfo, snapshot->m_pValidEntities, snapshot->m_nValidEntities );
+				clients[iClient]->SetupPrevPackInfo();
+			}
 		}
 	}
 
 	VPROF_BUDGET_FLAGS( "SV_ComputeClientPacks", "ComputeClientPacks", BUDGETFLAG_SERVER );
+	SV_PHASE_SCOPE( SERVER_PHASE_PACK );
 
 	if ( g_pLocalNetworkBackdoor )
 	{
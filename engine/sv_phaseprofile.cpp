@@ -0,0 +1,286 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Per tick timeline of the server frame's phases
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "server_pch.h"
+#include "sv_phaseprofile.h"
+#include "filesystem.h"
+#include "filesystem_engine.h"
+#include "tier0/threadtools.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+static ConVar sv_phaseprofile( "sv_phaseprofile", "1", 0, "Record how long each phase of the server frame takes, see sv_phaseprofile_worst and sv_phaseprofile_export" );
+
+
+#define PHASEPROFILE_MAX_TICKS		2048	// must be a power of two
+#define PHASEPROFILE_MAX_SPANS		32		// per tick, once full runs are merged into their phase's last span
+
+static const char *s_pPhaseNames[SERVER_PHASE_COUNT] =
+{
+	"NetReceive",
+	"Usercmds",
+	"GameFrame",
+	"CheckTransmit",
+	"Pack",
+	"Send",
+};
+
+// Phases like usercmds run once per client packet, so each phase has one slot per
+// tick that adds up all the times it ran
+struct PhaseRecord_t
+{
+	float	m_flDuration;	// microseconds, summed over every time it ran
+	int		m_nCount;		// times it ran, 0 if it didn't
+};
+
+// When a phase ran, for the timeline
+struct PhaseSpan_t
+{
+	float	m_flStart;		// microseconds from the start of the tick
+	float	m_flEnd;
+	short	m_nPhase;
+	short	m_nRuns;		// more than one if later runs were merged into it, it then covers the time between them too
+};
+
+struct TickRecord_t
+{
+	int				m_nTick;
+	double			m_flStart;		// Plat_FloatTime
+	float			m_flDuration;	// microseconds
+	bool			m_bRecorded;	// any phase ran, the server was running
+	PhaseRecord_t	m_Phases[SERVER_PHASE_COUNT];
+	int				m_nSpans;
+	PhaseSpan_t		m_Spans[PHASEPROFILE_MAX_SPANS];
+};
+
+// The tick being recorded, only touched by the thread running it
+static TickRecord_t s_CurrentTick;
+static bool s_bInTick = false;
+static ThreadId_t s_TickThread;
+static float s_flPhaseBegin[SERVER_PHASE_COUNT];	// start of each phase while it runs, negative when it doesn't
+static int s_iPhaseSpan[SERVER_PHASE_COUNT];		// the phase's last span, -1 if it has none
+
+// Finished ticks, the console commands can run on another thread than the server frame
+static CThreadFastMutex s_RingMutex;
+static TickRecord_t s_Ring[PHASEPROFILE_MAX_TICKS];
+static int s_nRingHead = 0;
+static int s_nRingCount = 0;
+
+
+void SV_PhaseProfile_BeginTick()
+{
+	if ( !sv_phaseprofile.GetBool() )
+		return;
+
+	s_bInTick = true;
+	s_TickThread = ThreadGetCurrentId();
+	s_CurrentTick.m_flStart = Plat_FloatTime();
+	s_CurrentTick.m_bRecorded = false;
+	s_CurrentTick.m_nSpans = 0;
+	for ( int iPhase = 0; iPhase < SERVER_PHASE_COUNT; iPhase++ )
+	{
+		PhaseRecord_t &phase = s_CurrentTick.m_Phases[iPhase];
+		phase.m_flDuration = 0.0f;
+		phase.m_nCount = 0;
+		s_flPhaseBegin[iPhase] = -1.0f;
+		s_iPhaseSpan[iPhase] = -1;
+	}
+}
+
+void SV_PhaseProfile_EndTick( int nTick )
+{
+	if ( !s_bInTick )
+		return;
+
+	s_bInTick = false;
+
+	// The server wasn't running
+	if ( !s_CurrentTick.m_bRecorded )
+		return;
+
+	s_CurrentTick.m_nTick = nTick;
+	s_CurrentTick.m_flDuration = ( Plat_FloatTime() - s_CurrentTick.m_flStart ) * 1000000.0;
+
+	AUTO_LOCK( s_RingMutex );
+	s_Ring[s_nRingHead] = s_CurrentTick;
+
+	s_nRingHead = ( s_nRingHead + 1 ) & ( PHASEPROFILE_MAX_TICKS - 1 );
+	s_nRingCount = MIN( s_nRingCount + 1, PHASEPROFILE_MAX_TICKS );
+}
+
+int SV_PhaseProfile_BeginPhase( ServerPhase_t phase )
+{
+	// Already running further up the stack, which covers this time
+	if ( !s_bInTick || ThreadGetCurrentId() != s_TickThread || s_flPhaseBegin[phase] >= 0.0f )
+		return -1;
+
+	float flNow = ( Plat_FloatTime() - s_CurrentTick.m_flStart ) * 1000000.0;
+	s_CurrentTick.m_Phases[phase].m_nCount++;
+	s_CurrentTick.m_bRecorded = true;
+
+	if ( s_CurrentTick.m_nSpans < PHASEPROFILE_MAX_SPANS )
+	{
+		s_iPhaseSpan[phase] = s_CurrentTick.m_nSpans++;
+		PhaseSpan_t &span = s_CurrentTick.m_Spans[s_iPhaseSpan[phase]];
+		span.m_flStart = flNow;
+		span.m_flEnd = flNow;
+		span.m_nPhase = phase;
+		span.m_nRuns = 1;
+	}
+	else if ( s_iPhaseSpan[phase] >= 0 )
+	{
+		s_CurrentTick.m_Spans[s_iPhaseSpan[phase]].m_nRuns++;
+	}
+
+	s_flPhaseBegin[phase] = flNow;
+	return phase;
+}
+
+void SV_PhaseProfile_EndPhase( int hPhase )
+{
+	if ( hPhase < 0 || !s_bInTick )
+		return;
+
+	float flNow = ( Plat_FloatTime() - s_CurrentTick.m_flStart ) * 1000000.0;
+	s_CurrentTick.m_Phases[hPhase].m_flDuration += flNow - s_flPhaseBegin[hPhase];
+	s_flPhaseBegin[hPhase] = -1.0f;
+
+	if ( s_iPhaseSpan[hPhase] >= 0 )
+	{
+		s_CurrentTick.m_Spans[s_iPhaseSpan[hPhase]].m_flEnd = flNow;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Copies the finished ticks, oldest first
+//-----------------------------------------------------------------------------
+static void SV_PhaseProfile_CopyTicks( CUtlVector< TickRecord_t > &ticks )
+{
+	AUTO_LOCK( s_RingMutex );
+
+	ticks.SetCount( s_nRingCount );
+	for ( int i = 0; i < s_nRingCount; i++ )
+	{
+		ticks[i] = s_Ring[( s_nRingHead - s_nRingCount + i ) & ( PHASEPROFILE_MAX_TICKS - 1 )];
+	}
+}
+
+static int __cdecl TickDurationSortFunc( const TickRecord_t * const *a, const TickRecord_t * const *b )
+{
+	if ( (*a)->m_flDuration > (*b)->m_flDuration )
+		return -1;
+	if ( (*a)->m_flDuration < (*b)->m_flDuration )
+		return 1;
+	return 0;
+}
+
+CON_COMMAND( sv_phaseprofile_worst, "Prints the phases of the slowest recorded server ticks. Arguments: [count]" )
+{
+	int nCount = ( args.ArgC() > 1 ) ? Q_atoi( args[1] ) : 10;
+
+	CUtlVector< TickRecord_t > ticks;
+	SV_PhaseProfile_CopyTicks( ticks );
+	if ( !ticks.Count() )
+	{
+		ConMsg( "No server ticks recorded\n" );
+		return;
+	}
+
+	double flTotal = 0.0;
+	CUtlVector< const TickRecord_t * > sorted;
+	sorted.EnsureCapacity( ticks.Count() );
+	for ( int i = 0; i < ticks.Count(); i++ )
+	{
+		flTotal += ticks[i].m_flDuration;
+		sorted.AddToTail( &ticks[i] );
+	}
+	sorted.Sort( TickDurationSortFunc );
+
+	ConMsg( "%d ticks recorded, %.2f ms average, times in ms\n", ticks.Count(), flTotal / ticks.Count() / 1000.0 );
+	ConMsg( "%10s %8s", "tick", "total" );
+	for ( int iPhase = 0; iPhase < SERVER_PHASE_COUNT; iPhase++ )
+	{
+		ConMsg( " %13s", s_pPhaseNames[iPhase] );
+	}
+	ConMsg( "\n" );
+
+	nCount = clamp( nCount, 1, sorted.Count() );
+	for ( int i = 0; i < nCount; i++ )
+	{
+		const TickRecord_t *pTick = sorted[i];
+
+		ConMsg( "%10d %8.2f", pTick->m_nTick, pTick->m_flDuration / 1000.0f );
+		for ( int iPhase = 0; iPhase < SERVER_PHASE_COUNT; iPhase++ )
+		{
+			ConMsg( " %13.2f", pTick->m_Phases[iPhase].m_flDuration / 1000.0f );
+		}
+		ConMsg( "\n" );
+	}
+}
+
+CON_COMMAND( sv_phaseprofile_export, "Writes the recorded server ticks as a Chrome trace (chrome://tracing). Arguments: <filename>" )
+{
+	if ( args.ArgC() < 2 )
+	{
+		ConMsg( "Usage: sv_phaseprofile_export <filename>\n" );
+		return;
+	}
+
+	CUtlVector< TickRecord_t > ticks;
+	SV_PhaseProfile_CopyTicks( ticks );
+	if ( !ticks.Count() )
+	{
+		ConMsg( "No server ticks recorded\n" );
+		return;
+	}
+
+	CUtlBuffer buf( 0, 0, CUtlBuffer::TEXT_BUFFER );
+	buf.PutString( "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+
+	// Timestamps in microseconds from the oldest tick
+	double flBase = ticks[0].m_flStart;
+	for ( int i = 0; i < ticks.Count(); i++ )
+	{
+		const TickRecord_t &tick = ticks[i];
+		double flTickStart = ( tick.m_flStart - flBase ) * 1000000.0;
+
+		buf.Printf( "%s{\"name\":\"Tick\",\"cat\":\"server\",\"ph\":\"X\",\"ts\":%.1f,\"dur\":%.1f,\"pid\":1,\"tid\":1,\"args\":{\"tick\":%d}}",
+			i ? ",\n" : "", flTickStart, tick.m_flDuration, tick.m_nTick );
+
+		// Each run of a phase as it happened, except that runs past the span limit are merged
+		// into their phase's last span, which is then named for how many runs it covers
+		for ( int iSpan = 0; iSpan < tick.m_nSpans; iSpan++ )
+		{
+			const PhaseSpan_t &span = tick.m_Spans[iSpan];
+
+			CFmtStrN<64> name;
+			if ( span.m_nRuns > 1 )
+			{
+				name.sprintf( "%s (%d runs merged)", s_pPhaseNames[span.m_nPhase], span.m_nRuns );
+			}
+			else
+			{
+				name.sprintf( "%s", s_pPhaseNames[span.m_nPhase] );
+			}
+
+			buf.Printf( ",\n{\"name\":\"%s\",\"cat\":\"server\",\"ph\":\"X\",\"ts\":%.1f,\"dur\":%.1f,\"pid\":1,\"tid\":1,\"args\":{\"tick\":%d,\"runs\":%d}}",
+				name.Get(), flTickStart + span.m_flStart, span.m_flEnd - span.m_flStart, tick.m_nTick, span.m_nRuns );
+		}
+	}
+
+	buf.PutString( "\n]}\n" );
+
+	if ( !g_pFileSystem->WriteFile( args[1], "DEFAULT_WRITE_PATH", buf ) )
+	{
+		ConMsg( "Couldn't write %s\n", args[1] );
+		return;
+	}
+
+	ConMsg( "Wrote %d ticks to %s\n", ticks.Count(), args[1] );
+}
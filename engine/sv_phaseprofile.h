@@ -0,0 +1,52 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Per tick timeline of the server frame's phases, kept in a ring
+//			so a slow tick can be looked at after the fact.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef SV_PHASEPROFILE_H
+#define SV_PHASEPROFILE_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+
+enum ServerPhase_t
+{
+	SERVER_PHASE_NET_RECEIVE = 0,	// NET_ProcessSocket, includes the usercmds it hands to the game
+	SERVER_PHASE_USERCMDS,			// IServerGameClients::ProcessUsercmds
+	SERVER_PHASE_GAME_FRAME,		// SV_Think
+	SERVER_PHASE_CHECK_TRANSMIT,	// SV_ComputeClientPacks, CheckTransmit
+	SERVER_PHASE_PACK,				// SV_ComputeClientPacks, packing entities
+	SERVER_PHASE_SEND,				// encoding and sending snapshots
+
+	SERVER_PHASE_COUNT
+};
+
+
+// Brackets one server tick. Phases are only recorded between these, on the
+// thread that began the tick.
+void	SV_PhaseProfile_BeginTick();
+void	SV_PhaseProfile_EndTick( int nTick );
+
+// Returns a handle for SV_PhaseProfile_EndPhase, -1 if nothing is recorded
+int		SV_PhaseProfile_BeginPhase( ServerPhase_t phase );
+void	SV_PhaseProfile_EndPhase( int hPhase );
+
+
+class CServerPhaseScope
+{
+public:
+	CServerPhaseScope( ServerPhase_t phase ) : m_hPhase( SV_PhaseProfile_BeginPhase( phase ) ) {}
+	~CServerPhaseScope() { SV_PhaseProfile_EndPhase( m_hPhase ); }
+
+private:
+	int		m_hPhase;
+};
+
+#define SV_PHASE_SCOPE( phase )		CServerPhaseScope serverPhaseScope( phase )
+
+
+#endif // SV_PHASEPROFILE_H
@@ -128,6 +128,7 @@ typedef void (DLLEXPORT * PFN_GlobalMethod)( edict_t *pEntity );
 IServerGameDLL	*serverGameDLL = NULL;
 int g_iServerGameDLLVersion = 0;
 IServerGameEnts *serverGameEnts = NULL;
+int g_iServerGameEntsVersion = 0;	// This matches the number at the end of the interface name (so for "ServerGameEnts002", this would be 2).
 
 IServerGameClients *serverGameClients = NULL;
 int g_iServerGameClientsVersion = 0;	// This matches the number at the end of the interface name (so for "ServerGameClients004", this would be 4).
@@ -1165,10 +1166,23 @@ static bool LoadThisDll( char *szDllFilename, bool bIsServerOnly )
 		}
 
 		serverGameEnts = (IServerGameEnts*)g_ServerFactory(INTERFACEVERSION_SERVERGAMEENTS, NULL);
-		if ( !serverGameEnts )
+		if ( serverGameEnts )
 		{
-			ConMsg( "Could not get IServerGameEnts interface from library %s", szDllFilename );
-			goto IgnoreThisDLL;
+			g_iServerGameEntsVersion = 2;
+		}
+		else
+		{
+			// Try the previous version, it only lacks the parallel CheckTransmit calls.
+			serverGameEnts = (IServerGameEnts*)g_ServerFactory(INTERFACEVERSION_SERVERGAMEENTS_VERSION_1, NULL);
+			if ( serverGameEnts )
+			{
+				g_iServerGameEntsVersion = 1;
+			}
+			else
+			{
+				ConMsg( "Could not get IServerGameEnts interface from library %s", szDllFilename );
+				goto IgnoreThisDLL;
+			}
 		}
 		
 		serverGameClients = (IServerGameClients*)g_ServerFactory(INTERFACEVERSION_SERVERGAMECLIENTS, NULL);
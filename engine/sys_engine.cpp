@@ -35,6 +35,14 @@
 #include "vgui_baseui_interface.h"
 #endif
 #include "tier0/etwprof.h"
+#include "net.h"
+
+#if defined( LINUX )
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -104,6 +112,155 @@ extern ConVar host_timer_spin_ms;
 extern float host_nexttick;
 extern IVEngineClient *engineClient;
 
+#if defined( LINUX )
+static ConVar host_timer_epoll( "host_timer_epoll", "0", FCVAR_NONE, "Wait for the next tick on a timerfd and the server sockets instead of sleeping or spinning (dedicated only)" );
+static ConVar host_timer_epoll_hibernate_ms( "host_timer_epoll_hibernate_ms", "100", FCVAR_NONE, "With host_timer_epoll, longest time between frames while the server is hibernating. Packets wake it up earlier." );
+
+#define FRAME_WAIT_MAX_SOCKETS	4
+
+//-----------------------------------------------------------------------------
+// Waits for the next dedicated server frame on an epoll set holding a timerfd,
+// armed for the frame deadline, and optionally the server sockets. The timer
+// has nanosecond resolution, unlike ThreadSleep.
+//-----------------------------------------------------------------------------
+class CFrameWaiter
+{
+public:
+	CFrameWaiter()
+	{
+		m_hEpoll = -1;
+		m_hTimer = -1;
+		m_nSockets = 0;
+		m_bFailed = false;
+	}
+
+	~CFrameWaiter()
+	{
+		Shutdown();
+	}
+
+	bool Init()
+	{
+		if ( m_hEpoll >= 0 )
+			return true;
+
+		if ( m_bFailed )
+			return false;
+
+		m_hEpoll = epoll_create1( EPOLL_CLOEXEC );
+		m_hTimer = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.fd = m_hTimer;
+
+		if ( m_hEpoll < 0 || m_hTimer < 0 || epoll_ctl( m_hEpoll, EPOLL_CTL_ADD, m_hTimer, &ev ) != 0 )
+		{
+			Warning( "host_timer_epoll: couldn't set up epoll/timerfd (%s), sleeping instead.\n", strerror( errno ) );
+			Shutdown();
+			m_bFailed = true;
+			return false;
+		}
+
+		return true;
+	}
+
+	void Shutdown()
+	{
+		if ( m_hTimer >= 0 )
+			close( m_hTimer );
+		if ( m_hEpoll >= 0 )
+			close( m_hEpoll );
+
+		m_hEpoll = -1;
+		m_hTimer = -1;
+		m_nSockets = 0;
+	}
+
+	// Blocks until flSeconds passed, or a packet arrived if bWakeOnPackets is set.
+	// Returns true if a packet woke us up.
+	bool Wait( double flSeconds, bool bWakeOnPackets )
+	{
+		UpdateSockets( bWakeOnPackets );
+
+		// an all zero it_value disarms the timer
+		int64 nNanosecs = MAX( (int64)( flSeconds * 1e9 ), (int64)1 );
+
+		struct itimerspec spec;
+		memset( &spec, 0, sizeof( spec ) );
+		spec.it_value.tv_sec = nNanosecs / 1000000000;
+		spec.it_value.tv_nsec = nNanosecs % 1000000000;
+		timerfd_settime( m_hTimer, 0, &spec, NULL );
+
+		// the timeout only matters if the timer couldn't be armed
+		int nTimeoutMS = (int)( nNanosecs / 1000000 ) + 1;
+
+		struct epoll_event events[ FRAME_WAIT_MAX_SOCKETS + 1 ];
+		int nEvents = epoll_wait( m_hEpoll, events, ARRAYSIZE( events ), nTimeoutMS );
+
+		bool bPackets = false;
+		for ( int i = 0; i < nEvents; i++ )
+		{
+			if ( events[i].data.fd == m_hTimer )
+			{
+				uint64 nExpirations;
+				(void) read( m_hTimer, &nExpirations, sizeof( nExpirations ) );
+			}
+			else
+			{
+				bPackets = true;
+			}
+		}
+
+		return bPackets;
+	}
+
+private:
+	void UpdateSockets( bool bWakeOnPackets )
+	{
+		int hSockets[ FRAME_WAIT_MAX_SOCKETS ];
+		int nSockets = bWakeOnPackets ? NET_GetServerSocketHandles( hSockets, ARRAYSIZE( hSockets ) ) : 0;
+
+		for ( int i = 0; i < m_nSockets; i++ )
+		{
+			bool bStillWanted = false;
+			for ( int j = 0; j < nSockets && !bStillWanted; j++ )
+			{
+				bStillWanted = ( hSockets[j] == m_hSockets[i] );
+			}
+
+			// closed sockets drop out of the set by themselves, so this may fail
+			if ( !bStillWanted )
+			{
+				epoll_ctl( m_hEpoll, EPOLL_CTL_DEL, m_hSockets[i], NULL );
+			}
+		}
+
+		// Always add the sockets we want, a socket reopened with the same handle isn't
+		// in the set anymore. Already registered ones fail with EEXIST.
+		for ( int i = 0; i < nSockets; i++ )
+		{
+			struct epoll_event ev;
+			ev.events = EPOLLIN;
+			ev.data.fd = hSockets[i];
+			epoll_ctl( m_hEpoll, EPOLL_CTL_ADD, hSockets[i], &ev );
+
+			m_hSockets[i] = hSockets[i];
+		}
+
+		m_nSockets = nSockets;
+	}
+
+	int		m_hEpoll;
+	int		m_hTimer;
+	int		m_hSockets[ FRAME_WAIT_MAX_SOCKETS ];
+	int		m_nSockets;
+	bool	m_bFailed;
+};
+
+static CFrameWaiter s_FrameWaiter;
+#endif
+
 #ifdef WIN32
 static void cpu_frequency_monitoring_callback( IConVar *var, const char *pOldValue, float flOldValue )
 {
@@ -316,6 +473,10 @@ void CEngine::Frame( void )
 					frequency.m_GHz, frequency.m_percentage, frequency.m_lowestPercentage );
 	}
 
+#if defined( LINUX )
+	bool bWokeOnPackets = false;
+#endif
+
 	// Loop until it is time for our frame. Don't return early because pumping messages
 	// and processing console input is expensive (0.1 ms for each call to ProcessConsoleInput).
 	for (;;)
@@ -342,6 +503,26 @@ void CEngine::Frame( void )
 			break;
 		}
 
+#if defined( LINUX )
+		if ( sv.IsDedicated() && host_timer_epoll.GetBool() && s_FrameWaiter.Init() )
+		{
+			VPROF_BUDGET( "Sleep", VPROF_BUDGETGROUP_SLEEPING );
+
+			double flWait = m_flMinFrameTime - m_flFrameTime;
+
+			// Nobody is playing, so there's no need to tick on time. Wait longer, but
+			// let a connecting client wake us up.
+			bool bHibernating = sv.IsHibernating() && !bWokeOnPackets;
+			if ( bHibernating )
+			{
+				flWait = MAX( flWait, host_timer_epoll_hibernate_ms.GetFloat() * 0.001 - m_flFrameTime );
+			}
+
+			bWokeOnPackets = s_FrameWaiter.Wait( flWait, bHibernating );
+			continue;
+		}
+#endif
+
 		if ( IsPC() && ( !sv.IsDedicated() || host_timer_spin_ms.GetFloat() != 0 ) )
 		{
 			// ThreadSleep may be imprecise. On non-dedicated servers, we busy-sleep
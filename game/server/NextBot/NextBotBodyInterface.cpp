@@ -33,20 +33,16 @@ bool IBody::SetPosition( const Vector &pos )
 
 const Vector &IBody::GetEyePosition( void ) const
 {
-	static Vector eye;
+	m_eyePosition = GetBot()->GetEntity()->WorldSpaceCenter();
 
-	eye = GetBot()->GetEntity()->WorldSpaceCenter();
-
-	return eye;
+	return m_eyePosition;
 }
 
 const Vector &IBody::GetViewVector( void ) const
 {
-	static Vector view;
-	
-	AngleVectors( GetBot()->GetEntity()->EyeAngles(), &view );
+	AngleVectors( GetBot()->GetEntity()->EyeAngles(), &m_viewVector );
 
-	return view;
+	return m_viewVector;
 }
 
 bool IBody::IsHeadAimingOnTarget( void ) const
@@ -128,6 +128,11 @@ class IBody : public INextBotComponent
 
 	virtual unsigned int GetSolidMask( void ) const;					// return the bot's collision mask (hack until we get a general hull trace abstraction here or in the locomotion interface)
 	virtual unsigned int GetCollisionGroup( void ) const;
+
+private:
+	// per body, so bots can be looked through on several threads at once
+	mutable Vector m_eyePosition;
+	mutable Vector m_viewVector;
 };
 
 
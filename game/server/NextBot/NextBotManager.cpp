@@ -6,6 +6,11 @@
 
 #include "NextBotManager.h"
 #include "NextBotInterface.h"
+#include "NextBotVisionInterface.h"
+#include "nav_mesh.h"
+#include "Path/NextBotPath.h"
+#include "functorutils.h"
+#include "vstdlib/jobthread.h"
 
 #ifdef TERROR
 #include "ZombieBot/Infected/Infected.h"
@@ -25,6 +30,7 @@ ConVar nb_update_frequency( "nb_update_frequency", ".1", FCVAR_CHEAT );
 ConVar nb_update_framelimit( "nb_update_framelimit", ( IsDebug() ) ? "30" : "15", FCVAR_CHEAT );
 ConVar nb_update_maxslide( "nb_update_maxslide", "2", FCVAR_CHEAT );
 ConVar nb_update_debug( "nb_update_debug", "0", FCVAR_CHEAT );
+ConVar nb_update_parallel_vision( "nb_update_parallel_vision", "1", FCVAR_CHEAT, "If nonzero, the vision traces of the bots updating each tick run in parallel on the job pool before any of them update." );
 
 //---------------------------------------------------------------------------------------------
 //---------------------------------------------------------------------------------------------
@@ -234,6 +240,29 @@ void CC_WarpSelectedHere( const CCommand &args )
 static ConCommand WarpSelectedHere( "nb_warp_selected_here", CC_WarpSelectedHere, "Teleport the selected bot to your cursor position", FCVAR_CHEAT );
 
 
+//---------------------------------------------------------------------------------------------
+static const char *updatePhaseName[ NextBotManager::NUM_UPDATE_PHASES ] =
+{
+	"PATHS",
+	"UPKEEP",
+	"SENSE",
+	"BEHAVIOR",
+};
+
+
+static void CC_UpdatePhases( const CCommand &args )
+{
+	Msg( "NextBot update phases for %d bots, ms per frame (last/average):\n", TheNextBots().GetNextBotCount() );
+
+	for( int i=0; i<NextBotManager::NUM_UPDATE_PHASES; ++i )
+	{
+		NextBotManager::UpdatePhaseType phase = (NextBotManager::UpdatePhaseType)i;
+		Msg( "  %-10s %7.3f %7.3f\n", updatePhaseName[i], 1000.0f * TheNextBots().GetPhaseTime( phase ), 1000.0f * TheNextBots().GetAveragePhaseTime( phase ) );
+	}
+}
+static ConCommand UpdatePhases( "nb_update_phases", CC_UpdatePhases, "Show the time spent in each phase of the NextBot update." );
+
+
 //---------------------------------------------------------------------------------------------
 //---------------------------------------------------------------------------------------------
 NextBotManager::NextBotManager( void )
@@ -242,6 +271,14 @@ NextBotManager::NextBotManager( void )
 	m_selectedBot = NULL;
 	
 	m_iUpdateTickrate = 0;
+	m_CurUpdateStartTime = 0.0;
+	m_SumFrameTime = 0.0;
+
+	for( int i=0; i<NUM_UPDATE_PHASES; ++i )
+	{
+		m_phaseTime[i] = 0.0f;
+		m_averagePhaseTime[i] = 0.0f;
+	}
 }
 
 //---------------------------------------------------------------------------------------------
@@ -307,12 +344,22 @@ static int g_nBlockedSlides;
 
 void NextBotManager::Update( void )
 {
+	double phaseStartTime = Plat_FloatTime();
+
+	// deliver the paths requested during the last tick before anyone looks at them again
+	Path::UpdateComputeRequests();
+
+	RecordPhaseTime( UPDATE_PATHS, Plat_FloatTime() - phaseStartTime );
+	phaseStartTime = Plat_FloatTime();
+
 	// do lightweight upkeep every tick
 	for( int u=m_botList.Head(); u != m_botList.InvalidIndex(); u = m_botList.Next( u ) )
 	{
 		m_botList[ u ]->Upkeep();
 	}
 
+	RecordPhaseTime( UPDATE_UPKEEP, Plat_FloatTime() - phaseStartTime );
+
 	// schedule full updates
 	if ( m_botList.Count() )
 	{
@@ -320,6 +367,9 @@ void NextBotManager::Update( void )
 		if ( iCurFrame != gpGlobals->framecount )
 		{
 			iCurFrame = gpGlobals->framecount;
+
+			// the bots that updated during the last frame
+			RecordPhaseTime( UPDATE_BEHAVIOR, m_SumFrameTime );
 			m_SumFrameTime = 0;
 		}
 		else
@@ -391,6 +441,12 @@ void NextBotManager::Update( void )
 			nScheduled = m_botList.Count();
 		}
 
+		phaseStartTime = Plat_FloatTime();
+
+		SenseScheduledBots();
+
+		RecordPhaseTime( UPDATE_SENSE, Plat_FloatTime() - phaseStartTime );
+
 		if ( nb_update_debug.GetBool() )
 		{
 			int nIntentionalSliders = 0;
@@ -406,12 +462,81 @@ void NextBotManager::Update( void )
 			}
 
 			Msg( "Frame %8d/tick %8d: %3d run of %3d, %3d sliders, %3d blocked slides, scheduled %3d for next tick, %3d intentional sliders, %d nonresponsive, %d dead\n", gpGlobals->framecount - 1, gpGlobals->tickcount - 1, g_nRun, m_botList.Count() - nDead, g_nSlid, g_nBlockedSlides, nScheduled, nIntentionalSliders, nNonResponsive, nDead );
+			Msg( "Frame %8d/tick %8d: %.2fms paths, %.2fms upkeep, %.2fms sense, %.2fms behavior\n", gpGlobals->framecount - 1, gpGlobals->tickcount - 1, 1000.0f * m_phaseTime[ UPDATE_PATHS ], 1000.0f * m_phaseTime[ UPDATE_UPKEEP ], 1000.0f * m_phaseTime[ UPDATE_SENSE ], 1000.0f * m_phaseTime[ UPDATE_BEHAVIOR ] );
 			g_nRun = g_nSlid = g_nBlockedSlides = 0;
 		}
 
 	}
 }
 
+//---------------------------------------------------------------------------------------------
+class MakeAbsPositionCurrent
+{
+public:
+	bool operator() ( CBaseEntity *actor )
+	{
+		actor->GetAbsOrigin();
+		return true;
+	}
+};
+
+
+static void SenseVisibleEntities( INextBot *&bot )
+{
+	bot->GetVisionInterface()->SenseVisibleEntities();
+}
+
+
+//---------------------------------------------------------------------------------------------
+/**
+ * Run the line-of-sight traces of the bots that update this tick all at once on the job threads.
+ * Their visions use the results when the bots update, and commit them as usual, one bot at a time.
+ */
+void NextBotManager::SenseScheduledBots( void )
+{
+	if ( !nb_update_parallel_vision.GetBool() )
+		return;
+
+	VPROF_BUDGET( "NextBotManager::SenseScheduledBots", "NextBot" );
+
+	CUtlVector< INextBot * > sensing;
+
+	for( int i=m_botList.Head(); i != m_botList.InvalidIndex(); i = m_botList.Next( i ) )
+	{
+		INextBot *bot = m_botList[i];
+
+		if ( m_iUpdateTickrate > 0 && !bot->IsFlaggedForUpdate() )
+			continue;
+
+		if ( IsDead( bot ) )
+			continue;
+
+		IVision *vision = bot->GetVisionInterface();
+		if ( vision && vision->IsSenseThreadSafe() )
+		{
+			sensing.AddToTail( bot );
+		}
+	}
+
+	if ( sensing.Count() == 0 )
+		return;
+
+	// computing a stale absolute position writes it back, do that here and not on the job threads
+	MakeAbsPositionCurrent makeCurrent;
+	ForEachActor( makeCurrent );
+
+	ParallelProcess( "NextBotManager::SenseScheduledBots", sensing.Base(), sensing.Count(), &SenseVisibleEntities );
+}
+
+
+//---------------------------------------------------------------------------------------------
+void NextBotManager::RecordPhaseTime( UpdatePhaseType phase, float time )
+{
+	m_phaseTime[ phase ] = time;
+	m_averagePhaseTime[ phase ] += 0.1f * ( time - m_averagePhaseTime[ phase ] );
+}
+
+
 //---------------------------------------------------------------------------------------------
 bool NextBotManager::ShouldUpdate( INextBot *bot )
 {
@@ -489,6 +614,8 @@ void NextBotManager::NotifyEndUpdate( INextBot *bot )
  */
 void NextBotManager::OnMapLoaded( void )
 {
+	Path::DiscardComputeRequests();
+
 	Reset();
 }
 
@@ -26,6 +26,21 @@ class NextBotManager
 	void NotifyBeginUpdate( INextBot *bot );
 	void NotifyEndUpdate( INextBot *bot );
 
+	/**
+	 * The phases of updating the bots, for timing
+	 */
+	enum UpdatePhaseType
+	{
+		UPDATE_PATHS,								// delivering the paths computed since the last update
+		UPDATE_UPKEEP,								// lightweight upkeep of every bot
+		UPDATE_SENSE,								// vision of the bots updating this tick, on the job threads
+		UPDATE_BEHAVIOR,							// full updates of the bots, run from their think functions
+
+		NUM_UPDATE_PHASES
+	};
+	float GetPhaseTime( UpdatePhaseType phase ) const;			// seconds spent in the phase during the last frame
+	float GetAveragePhaseTime( UpdatePhaseType phase ) const;	// seconds spent in the phase, smoothed over recent frames
+
 	int GetNextBotCount( void ) const;				// How many nextbots are alive right now?
 
 
@@ -145,12 +160,18 @@ class NextBotManager
 	int Register( INextBot *bot );
 	void UnRegister( INextBot *bot );
 
+	void SenseScheduledBots( void );				// run the vision traces of the bots updating this tick, in parallel
+	void RecordPhaseTime( UpdatePhaseType phase, float time );
+
 	CUtlLinkedList< INextBot * > m_botList;				// list of all active NextBots
 
 	int m_iUpdateTickrate;
 	double m_CurUpdateStartTime;
 	double m_SumFrameTime;
 
+	float m_phaseTime[ NUM_UPDATE_PHASES ];
+	float m_averagePhaseTime[ NUM_UPDATE_PHASES ];
+
 	unsigned int m_debugType;						// debug flags
 
 	struct DebugFilter
@@ -169,6 +190,16 @@ inline int NextBotManager::GetNextBotCount( void ) const
 	return m_botList.Count();
 }
 
+inline float NextBotManager::GetPhaseTime( UpdatePhaseType phase ) const
+{
+	return m_phaseTime[ phase ];
+}
+
+inline float NextBotManager::GetAveragePhaseTime( UpdatePhaseType phase ) const
+{
+	return m_averagePhaseTime[ phase ];
+}
+
 inline bool NextBotManager::IsDebugging( unsigned int type ) const
 {
 	if ( type & m_debugType )
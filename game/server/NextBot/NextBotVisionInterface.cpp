@@ -46,6 +46,10 @@ void IVision::Reset( void )
 	m_lastVisionUpdateTimestamp = 0.0f;
 	m_primaryThreat = NULL;
 
+	m_sensedTick = -1;
+	m_sensedVisible.RemoveAll();
+	m_sensedLastKnownPositions.RemoveAll();
+
 	m_FOV = GetDefaultFieldOfView();
 	m_cosHalfFOV = cos( 0.5f * m_FOV * M_PI / 180.0f );
 	
@@ -364,23 +368,93 @@ class CollectVisible
 
 
 //------------------------------------------------------------------------------------------
-void IVision::UpdateKnownEntities( void )
+/**
+ * Do the line-of-sight checks of UpdateKnownEntities() ahead of time.
+ * Must not change anything but our own sensed state, it may run on a job thread.
+ */
+void IVision::SenseVisibleEntities( void )
 {
-	VPROF_BUDGET( "IVision::UpdateKnownEntities", "NextBot" );
+	VPROF_BUDGET( "IVision::SenseVisibleEntities", "NextBotExpensive" );
+
+	m_sensedTick = -1;
+	m_sensedVisible.RemoveAll();
+	m_sensedLastKnownPositions.RemoveAll();
+
+	if ( nb_blind.GetBool() )
+		return;
 
-	// construct set of potentially visible objects
 	CUtlVector< CBaseEntity * > potentiallyVisible;
 	CollectPotentiallyVisibleEntities( &potentiallyVisible );
 
-	// collect set of visible and recognized entities at this moment
 	CollectVisible visibleNow( this );
 	FOR_EACH_VEC( potentiallyVisible, pit )
 	{
-		VPROF_BUDGET( "IVision::UpdateKnownEntities( collect visible )", "NextBot" );
-
 		if ( visibleNow( potentiallyVisible[ pit ] ) == false )
 			break;
 	}
+
+	FOR_EACH_VEC( visibleNow.m_recognized, rit )
+	{
+		m_sensedVisible.AddToTail( visibleNow.m_recognized[ rit ] );
+	}
+
+	FOR_EACH_VEC( m_knownEntityVector, kit )
+	{
+		const CKnownEntity &known = m_knownEntityVector[ kit ];
+
+		if ( known.GetEntity() == NULL || known.IsObsolete() || known.HasLastKnownPositionBeenSeen() )
+			continue;
+
+		if ( visibleNow.Contains( known.GetEntity() ) )
+			continue;
+
+		if ( IsAbleToSee( known.GetLastKnownPosition(), IVision::USE_FOV ) )
+		{
+			m_sensedLastKnownPositions.AddToTail( known.GetEntity() );
+		}
+	}
+
+	m_sensedTick = gpGlobals->tickcount;
+}
+
+
+//------------------------------------------------------------------------------------------
+void IVision::UpdateKnownEntities( void )
+{
+	VPROF_BUDGET( "IVision::UpdateKnownEntities", "NextBot" );
+
+	// collect set of visible and recognized entities at this moment
+	CollectVisible visibleNow( this );
+
+	bool isSensed = ( m_sensedTick == gpGlobals->tickcount );
+	m_sensedTick = -1;
+
+	if ( isSensed )
+	{
+		// SenseVisibleEntities() already did the traces this tick, drop whatever died since
+		FOR_EACH_VEC( m_sensedVisible, sit )
+		{
+			CBaseEntity *entity = m_sensedVisible[ sit ];
+			if ( entity && entity->IsAlive() )
+			{
+				visibleNow.m_recognized.AddToTail( entity );
+			}
+		}
+	}
+	else
+	{
+		// construct set of potentially visible objects
+		CUtlVector< CBaseEntity * > potentiallyVisible;
+		CollectPotentiallyVisibleEntities( &potentiallyVisible );
+
+		FOR_EACH_VEC( potentiallyVisible, pit )
+		{
+			VPROF_BUDGET( "IVision::UpdateKnownEntities( collect visible )", "NextBot" );
+
+			if ( visibleNow( potentiallyVisible[ pit ] ) == false )
+				break;
+		}
+	}
 	
 	// update known set with new data
 	{	VPROF_BUDGET( "IVision::UpdateKnownEntities( update status )", "NextBot" );
@@ -448,7 +522,17 @@ void IVision::UpdateKnownEntities( void )
 				if ( !known.HasLastKnownPositionBeenSeen() )
 				{
 					// can we see the entity's last know position?
-					if ( IsAbleToSee( known.GetLastKnownPosition(), IVision::USE_FOV ) )
+					bool isLastKnownPositionVisible;
+					if ( isSensed )
+					{
+						isLastKnownPositionVisible = m_sensedLastKnownPositions.HasElement( EHANDLE( known.GetEntity() ) );
+					}
+					else
+					{
+						isLastKnownPositionVisible = IsAbleToSee( known.GetLastKnownPosition(), IVision::USE_FOV );
+					}
+
+					if ( isLastKnownPositionVisible )
 					{
 						known.MarkLastKnownPositionAsSeen();
 					}
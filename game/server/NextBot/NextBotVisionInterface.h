@@ -26,6 +26,14 @@ class IVision : public INextBotComponent
 	virtual void Reset( void );									// reset to initial state
 	virtual void Update( void );								// update internal state
 
+	/**
+	 * Find the entities visible right now, for this tick's Update() to use instead of tracing
+	 * to them itself. Only reads the world and other entities, so NextBotManager::Update()
+	 * runs it for many bots at once on the job threads.
+	 */
+	virtual void SenseVisibleEntities( void );
+	virtual bool IsSenseThreadSafe( void ) const;				// return false if overrides used by SenseVisibleEntities() change shared state
+
 	//-- attention/short term memory interface follows ------------------------------------------
 
 	//
@@ -121,6 +129,10 @@ class IVision : public INextBotComponent
 
 	float m_lastVisionUpdateTimestamp;
 	IntervalTimer m_notVisibleTimer[ MAX_TEAMS ];		// for tracking interval since last saw a member of the given team
+
+	int m_sensedTick;									// tick of the last SenseVisibleEntities(), its results are only used during that tick
+	CUtlVector< EHANDLE > m_sensedVisible;				// entities we can see
+	CUtlVector< EHANDLE > m_sensedLastKnownPositions;	// known entities out of sight whose last known position we can see
 };
 
 inline void IVision::CollectKnownEntities( CUtlVector< CKnownEntity > *knownVector )
@@ -202,6 +214,11 @@ inline bool IVision::ForEachKnownEntity( IVision::IForEachKnownEntity &func )
 	return true;
 }
 
+inline bool IVision::IsSenseThreadSafe( void ) const
+{
+	return true;
+}
+
 inline bool IVision::IsVisibleEntityNoticed( CBaseEntity *subject ) const
 {
 	return true;
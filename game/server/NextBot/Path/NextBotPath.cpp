@@ -15,6 +15,7 @@
 #include "NextBotUtil.h"
 
 #include "tier0/vprof.h"
+#include "vstdlib/jobthread.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -22,6 +23,59 @@
 ConVar NextBotPathDrawIncrement( "nb_path_draw_inc", "100", FCVAR_CHEAT );
 ConVar NextBotPathDrawSegmentCount( "nb_path_draw_segment_count", "100", FCVAR_CHEAT );
 ConVar NextBotPathSegmentInfluenceRadius( "nb_path_segment_influence_radius", "100", FCVAR_CHEAT );
+ConVar NextBotPathComputeAsync( "nb_path_compute_async", "1", FCVAR_CHEAT, "If nonzero, Path::ComputeAsync() searches run in parallel on the job pool and deliver the path on the next tick." );
+
+// requests queued by Path::ComputeAsync() since the last UpdateComputeRequests()
+static CUtlVector< PathComputeRequest * > s_computeRequests;
+
+
+//--------------------------------------------------------------------------------------------------------------
+PathComputeRequest::PathComputeRequest( void )
+{
+	m_path = NULL;
+	m_bot = NULL;
+	m_startArea = NULL;
+	m_goalArea = NULL;
+	m_goal = vec3_origin;
+	m_pathEnd = vec3_origin;
+	m_subject = NULL;
+	m_maxPathLength = 0.0f;
+	m_teamID = TEAM_ANY;
+	m_maxAreas = 0;
+	m_includeGoalIfPathFails = true;
+	m_pathResult = false;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Run the A* search in a search state of our own, so any number of requests can search at once
+ */
+void PathComputeRequest::Search( void )
+{
+	CNavPathSearch search;
+	CNavPathSearchScope scope( search );
+
+	CNavArea *closestArea = NULL;
+	m_pathResult = BuildPath( &closestArea );
+
+	// the parent links only exist in our search state, collect them before it goes away
+	for( CNavArea *area = closestArea; area; area = area->GetParent() )
+	{
+		int i = m_areas.AddToTail();
+		m_areas[ i ].area = area;
+		m_areas[ i ].how = area->GetParentHow();
+
+		if ( area == m_startArea )
+		{
+			// startArea can be re-evaluated during the pathfind and given a parent...
+			break;
+		}
+		if ( m_areas.Count() >= m_maxAreas )
+			break;
+	}
+}
+
 
 //--------------------------------------------------------------------------------------------------------------
 Path::Path( void )
@@ -33,6 +87,176 @@ Path::Path( void )
 	m_cursorData.segmentPrior = NULL;
 	m_ageTimer.Invalidate();
 	m_subject = NULL;
+	m_computeRequest = NULL;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+Path::~Path()
+{
+	CancelCompute();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+bool Path::IsComputeAsyncEnabled( void )
+{
+	return NextBotPathComputeAsync.GetBool();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void Path::QueueCompute( INextBot *bot, PathComputeRequest *request, float maxPathLength, bool includeGoalIfPathFails )
+{
+	request->m_path = this;
+	request->m_bot = bot;
+	request->m_maxPathLength = maxPathLength;
+	request->m_teamID = bot->GetEntity()->GetTeamNumber();
+	request->m_maxAreas = MAX_PATH_SEGMENTS-1;		// save room for endpoint
+	request->m_includeGoalIfPathFails = includeGoalIfPathFails;
+
+	s_computeRequests.AddToTail( request );
+	m_computeRequest = request;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void Path::CancelCompute( void )
+{
+	if ( m_computeRequest == NULL )
+		return;
+
+	// a request already taken off the queue by UpdateComputeRequests() is deleted there
+	m_computeRequest->m_path = NULL;
+	if ( s_computeRequests.FindAndRemove( m_computeRequest ) )
+	{
+		delete m_computeRequest;
+	}
+
+	m_computeRequest = NULL;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+static void SearchComputeRequest( PathComputeRequest *&request )
+{
+	request->Search();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Run the searches queued since the last call in parallel, then build their paths.
+ * The searches only read the nav mesh and nothing else runs while they do.
+ */
+void Path::UpdateComputeRequests( void )
+{
+	if ( s_computeRequests.Count() == 0 )
+		return;
+
+	VPROF_BUDGET( "Path::UpdateComputeRequests", "NextBot" );
+
+	// building a path invokes OnPathChanged(), which may queue requests for the next update
+	CUtlVector< PathComputeRequest * > requests;
+	requests.Swap( s_computeRequests );
+
+	ParallelProcess( "Path::UpdateComputeRequests", requests.Base(), requests.Count(), &SearchComputeRequest );
+
+	FOR_EACH_VEC( requests, i )
+	{
+		PathComputeRequest *request = requests[i];
+
+		Path *path = request->m_path;
+		if ( path )
+		{
+			path->m_computeRequest = NULL;
+			path->FinishCompute( request );
+		}
+
+		delete request;
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void Path::DiscardComputeRequests( void )
+{
+	FOR_EACH_VEC( s_computeRequests, i )
+	{
+		if ( s_computeRequests[i]->m_path )
+		{
+			s_computeRequests[i]->m_path->m_computeRequest = NULL;
+		}
+
+		delete s_computeRequests[i];
+	}
+
+	s_computeRequests.RemoveAll();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Build the actual path from the parent links a ComputeAsync() search found
+ */
+void Path::FinishCompute( PathComputeRequest *request )
+{
+	VPROF_BUDGET( "Path::FinishCompute", "NextBot" );
+
+	INextBot *bot = request->m_bot;
+
+	Invalidate();
+
+	m_subject = request->m_subject;
+
+	int count = request->m_areas.Count();
+	if ( count == 0 )
+	{
+		OnPathChanged( bot, NO_PATH );
+		return;
+	}
+
+	if ( count == 1 )
+	{
+		BuildTrivialPath( bot, request->m_pathEnd );
+		return;
+	}
+
+	// assemble path, the links run from the closest area back to the start
+	m_segmentCount = count;
+	for( int i=0; i<count; ++i )
+	{
+		Segment &segment = m_path[ count-1 - i ];
+		segment.area = request->m_areas[i].area;
+		segment.how = request->m_areas[i].how;
+		segment.type = ON_GROUND;
+	}
+
+	if ( request->m_pathResult || request->m_includeGoalIfPathFails )
+	{
+		// append actual goal position
+		m_path[ m_segmentCount ].area = request->m_areas[0].area;
+		m_path[ m_segmentCount ].pos = request->m_pathEnd;
+		m_path[ m_segmentCount ].ladder = NULL;
+		m_path[ m_segmentCount ].how = NUM_TRAVERSE_TYPES;
+		m_path[ m_segmentCount ].type = ON_GROUND;
+		++m_segmentCount;
+	}
+
+	// compute path positions from where the bot is now
+	if ( ComputePathDetails( bot, bot->GetPosition() ) == false )
+	{
+		Invalidate();
+		OnPathChanged( bot, NO_PATH );
+		return;
+	}
+
+	// remove redundant nodes and clean up path
+	Optimize( bot );
+
+	PostProcess();
+
+	OnPathChanged( bot, request->m_pathResult ? COMPLETE_PATH : PARTIAL_PATH );
 }
 
 
@@ -16,6 +16,7 @@
 class INextBot;
 class CNavArea;
 class CNavLadder;
+class Path;
 
 
 //---------------------------------------------------------------------------------------------------------------
@@ -42,6 +43,63 @@ class IPathOpenGoalSelector
 };
 
 
+//---------------------------------------------------------------------------------------------------------------
+/**
+ * A path compute queued by Path::ComputeAsync().
+ * The A* search runs on the job pool in the request's own CNavPathSearch, the
+ * path itself is built from the search result on the main thread afterwards.
+ */
+class PathComputeRequest
+{
+public:
+	PathComputeRequest( void );
+	virtual ~PathComputeRequest() { }
+
+	void Search( void );								// run the A* search, safe on any thread
+
+	Path *m_path;										// the path to build, NULL if the request was cancelled
+	INextBot *m_bot;
+	CNavArea *m_startArea;
+	CNavArea *m_goalArea;
+	Vector m_goal;										// position the search heads for
+	Vector m_pathEnd;									// position the path ends at
+	CHandle< CBaseCombatCharacter > m_subject;
+	float m_maxPathLength;
+	int m_teamID;
+	int m_maxAreas;
+	bool m_includeGoalIfPathFails;
+
+	// search result
+	struct AreaLink
+	{
+		CNavArea *area;
+		NavTraverseType how;
+	};
+	CUtlVector< AreaLink > m_areas;						// parent links from the closest area back to the start area
+	bool m_pathResult;
+
+protected:
+	virtual bool BuildPath( CNavArea **closestArea ) = 0;	// NavAreaBuildPathClustered() with the request's cost functor
+};
+
+
+//---------------------------------------------------------------------------------------------------------------
+template< typename CostFunctor >
+class PathComputeRequestT : public PathComputeRequest
+{
+public:
+	PathComputeRequestT( const CostFunctor &costFunc ) : m_costFunc( costFunc ) { }
+
+protected:
+	virtual bool BuildPath( CNavArea **closestArea )
+	{
+		return NavAreaBuildPathClustered( m_startArea, m_goalArea, &m_goal, m_costFunc, closestArea, m_maxPathLength, m_teamID );
+	}
+
+	CostFunctor m_costFunc;								// a copy, the caller's functor is long gone when the search runs
+};
+
+
 //---------------------------------------------------------------------------------------------------------------
 /**
  * A Path through the world.
@@ -52,7 +110,7 @@ class Path
 {
 public:
 	Path( void );
-	virtual ~Path() { }
+	virtual ~Path();
 	
 	enum SegmentType
 	{
@@ -157,6 +215,8 @@ class Path
 	{
 		VPROF_BUDGET( "Path::Compute(subject)", "NextBot" );
 
+		CancelCompute();
+
 		Invalidate();
 
 		m_subject = subject;
@@ -190,7 +250,7 @@ class Path
 		// Compute shortest path to subject
 		//
 		CNavArea *closestArea = NULL;
-		bool pathResult = NavAreaBuildPath( startArea, subjectArea, &subjectPos, costFunc, &closestArea, maxPathLength, bot->GetEntity()->GetTeamNumber() );
+		bool pathResult = NavAreaBuildPathClustered( startArea, subjectArea, &subjectPos, costFunc, &closestArea, maxPathLength, bot->GetEntity()->GetTeamNumber() );
 
 		// Failed?
 		if ( closestArea == NULL )
@@ -274,6 +334,8 @@ class Path
 	{
 		VPROF_BUDGET( "Path::Compute(goal)", "NextBotSpiky" );
 
+		CancelCompute();
+
 		Invalidate();
 		
 		const Vector &start = bot->GetPosition();
@@ -311,7 +373,7 @@ class Path
 		// Compute shortest path to goal
 		//
 		CNavArea *closestArea = NULL;
-		bool pathResult = NavAreaBuildPath( startArea, goalArea, &goal, costFunc, &closestArea, maxPathLength, bot->GetEntity()->GetTeamNumber() );
+		bool pathResult = NavAreaBuildPathClustered( startArea, goalArea, &goal, costFunc, &closestArea, maxPathLength, bot->GetEntity()->GetTeamNumber() );
 
 		// Failed?
 		if ( closestArea == NULL )
@@ -383,6 +445,122 @@ class Path
 	}
 
 
+	//-----------------------------------------------------------------------------------------------------------------
+	/**
+	 * Queue a compute of the shortest path from bot to 'goal'. The A* search runs on the job pool
+	 * before the next NextBot update and the result replaces this path then, OnPathChanged()
+	 * is invoked as usual. Until then IsComputePending() is true and the path keeps its old contents.
+	 * The cost functor is copied and called from worker threads, so it may only read the nav mesh
+	 * and the bot. With nb_path_compute_async 0 the path is computed right away.
+	 */
+	template< typename CostFunctor >
+	void ComputeAsync( INextBot *bot, const Vector &goal, const CostFunctor &costFunc, float maxPathLength = 0.0f, bool includeGoalIfPathFails = true )
+	{
+		VPROF_BUDGET( "Path::ComputeAsync(goal)", "NextBot" );
+
+		if ( !IsComputeAsyncEnabled() )
+		{
+			CostFunctor cost( costFunc );
+			Compute( bot, goal, cost, maxPathLength, includeGoalIfPathFails );
+			return;
+		}
+
+		CancelCompute();
+
+		CNavArea *startArea = bot->GetEntity()->GetLastKnownArea();
+		if ( !startArea )
+		{
+			Invalidate();
+			OnPathChanged( bot, NO_PATH );
+			return;
+		}
+
+		// check line-of-sight to the goal position when finding it's nav area
+		const float maxDistanceToArea = 200.0f;
+		CNavArea *goalArea = TheNavMesh->GetNearestNavArea( goal, true, maxDistanceToArea, true );
+
+		// if we are already in the goal area, build trivial path
+		if ( startArea == goalArea )
+		{
+			Invalidate();
+			BuildTrivialPath( bot, goal );
+			return;
+		}
+
+		// make sure path end position is on the ground
+		Vector pathEndPosition = goal;
+		if ( goalArea )
+		{
+			pathEndPosition.z = goalArea->GetZ( pathEndPosition );
+		}
+		else
+		{
+			TheNavMesh->GetGroundHeight( pathEndPosition, &pathEndPosition.z );
+		}
+
+		PathComputeRequest *request = new PathComputeRequestT< CostFunctor >( costFunc );
+		request->m_startArea = startArea;
+		request->m_goalArea = goalArea;
+		request->m_goal = goal;
+		request->m_pathEnd = pathEndPosition;
+		QueueCompute( bot, request, maxPathLength, includeGoalIfPathFails );
+	}
+
+
+	//-----------------------------------------------------------------------------------------------------------------
+	/**
+	 * Queue a compute of the shortest path from bot to given actor, see ComputeAsync() above.
+	 */
+	template< typename CostFunctor >
+	void ComputeAsync( INextBot *bot, CBaseCombatCharacter *subject, const CostFunctor &costFunc, float maxPathLength = 0.0f, bool includeGoalIfPathFails = true )
+	{
+		VPROF_BUDGET( "Path::ComputeAsync(subject)", "NextBot" );
+
+		if ( !IsComputeAsyncEnabled() )
+		{
+			CostFunctor cost( costFunc );
+			Compute( bot, subject, cost, maxPathLength, includeGoalIfPathFails );
+			return;
+		}
+
+		CancelCompute();
+
+		CNavArea *startArea = bot->GetEntity()->GetLastKnownArea();
+		CNavArea *subjectArea = subject->GetLastKnownArea();
+		if ( !startArea || !subjectArea )
+		{
+			Invalidate();
+			OnPathChanged( bot, NO_PATH );
+			return;
+		}
+
+		Vector subjectPos = subject->GetAbsOrigin();
+
+		// if we are already in the subject area, build trivial path
+		if ( startArea == subjectArea )
+		{
+			Invalidate();
+			m_subject = subject;
+			BuildTrivialPath( bot, subjectPos );
+			return;
+		}
+
+		PathComputeRequest *request = new PathComputeRequestT< CostFunctor >( costFunc );
+		request->m_startArea = startArea;
+		request->m_goalArea = subjectArea;
+		request->m_goal = subjectPos;
+		request->m_pathEnd = subjectPos;
+		request->m_subject = subject;
+		QueueCompute( bot, request, maxPathLength, includeGoalIfPathFails );
+	}
+
+	bool IsComputePending( void ) const;				// true while a ComputeAsync() result hasn't arrived yet
+	void CancelCompute( void );							// drop the pending ComputeAsync() request, if any
+
+	static void UpdateComputeRequests( void );			// run the queued searches in parallel and build their paths, once per tick
+	static void DiscardComputeRequests( void );			// drop all queued requests, the nav mesh they refer to is going away
+
+
 	//-----------------------------------------------------------------------------------------------------------------
 	/**
 	 * Build a path from bot's current location to an undetermined goal area
@@ -393,6 +571,8 @@ class Path
 	{
 		VPROF_BUDGET( "ComputeWithOpenGoal", "NextBot" );
 
+		CancelCompute();
+
 		int teamID = bot->GetEntity()->GetTeamNumber();
 
 		CNavArea *startArea = bot->GetEntity()->GetLastKnownArea();
@@ -603,6 +783,12 @@ class Path
 	IntervalTimer m_ageTimer;					// how old is this path?
 	CHandle< CBaseCombatCharacter > m_subject;	// the subject this path leads to
 
+	PathComputeRequest *m_computeRequest;		// queued by ComputeAsync(), NULL if none is pending
+
+	static bool IsComputeAsyncEnabled( void );
+	void QueueCompute( INextBot *bot, PathComputeRequest *request, float maxPathLength, bool includeGoalIfPathFails );
+	void FinishCompute( PathComputeRequest *request );	// build this path from the request's search result
+
 	/**
 	 * Build a vector of adjacent areas reachable from the given area
 	 */
@@ -736,6 +922,11 @@ inline bool Path::IsValid( void ) const
 	return (m_segmentCount > 0);
 }
 
+inline bool Path::IsComputePending( void ) const
+{
+	return ( m_computeRequest != NULL );
+}
+
 inline void Path::Invalidate( void )
 {
 	m_segmentCount = 0;
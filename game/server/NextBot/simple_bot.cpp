@@ -149,20 +149,22 @@ class CSimpleBotRoam : public Action< CSimpleBot >
 	// Update is called repeatedly (usually once per server frame) while the Action is active
 	virtual ActionResult< CSimpleBot >	Update( CSimpleBot *me, float interval )
 	{
-		if ( m_path.IsValid() && !m_timer.IsElapsed() ) 
+		if ( m_path.IsValid() && ( !m_timer.IsElapsed() || m_path.IsComputePending() ) ) 
 		{
 			// PathFollower::Update() moves the bot along the path using the bot's ILocomotion and IBody interfaces
+			// (keep following the old path until the new one arrives)
 			m_path.Update( me );
 		}
-		else
+		else if ( !m_path.IsComputePending() )
 		{
 			SelectNthAreaFunctor pick( RandomInt( 0, TheNavMesh->GetNavAreaCount() - 1 ) );
 			TheNavMesh->ForAllAreas( pick );
 
 			if ( pick.m_area )
 			{
+				// the cost functor only reads the nav mesh and our locomotor, so it can search on another thread
 				CSimpleBotPathCost cost( me );
-				m_path.Compute( me, pick.m_area->GetCenter(), cost );
+				m_path.ComputeAsync( me, pick.m_area->GetCenter(), cost );
 			}
 
 			// follow this path for a random duration (or until we reach the end)
@@ -31,6 +31,9 @@ DECLARE_CLASS( CCSPlayerMove, CPlayerMove );
 	virtual void	StartCommand( CBasePlayer *player, CUserCmd *cmd );
 	virtual void	SetupMove( CBasePlayer *player, CUserCmd *ucmd, IMoveHelper *pHelper, CMoveData *move );
 	virtual void	FinishMove( CBasePlayer *player, CUserCmd *ucmd, CMoveData *move );
+
+protected:
+	virtual CGameMovement *CreateParallelGameMovement( void );
 };
 
 // PlayerMove Interface
@@ -48,6 +51,13 @@ CPlayerMove *PlayerMove()
 // Main setup, finish
 //-----------------------------------------------------------------------------
 
+extern CGameMovement *CreateCSGameMovement();
+
+CGameMovement *CCSPlayerMove::CreateParallelGameMovement( void )
+{
+	return CreateCSGameMovement();
+}
+
 void CCSPlayerMove::StartCommand( CBasePlayer *player, CUserCmd *cmd )
 {
 	CCSPlayer *pPlayer = ToCSPlayer( player );
@@ -2374,8 +2374,21 @@ class CServerGameEnts : public IServerGameEnts
 	virtual edict_t*		BaseEntityToEdict( CBaseEntity *pEnt );
 	virtual CBaseEntity*	EdictToBaseEntity( edict_t *pEdict );
 	virtual void			CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned short *pEdictIndices, int nEdicts );
+	virtual bool			PrepareParallelCheckTransmit( const unsigned short *pEdictIndices, int nEdicts );
+	virtual void			FinishParallelCheckTransmit();
+
+	CServerGameEnts() : m_bParallelCheckTransmit( false ) {}
+
+private:
+	void					CheckTransmitInternal( CCheckTransmitInfo *pInfo, const unsigned short *pEdictIndices, int nEdicts );
+
+	// Set while the engine runs CheckTransmit for several clients at once
+	bool					m_bParallelCheckTransmit;
 };
-EXPOSE_SINGLE_INTERFACE(CServerGameEnts, IServerGameEnts, INTERFACEVERSION_SERVERGAMEENTS);
+CServerGameEnts g_ServerGameEnts;
+// INTERFACEVERSION_SERVERGAMEENTS_VERSION_1 is compatible with the latest since we're only adding things to the end, so expose that as well.
+EXPOSE_SINGLE_INTERFACE_GLOBALVAR(CServerGameEnts, IServerGameEnts001, INTERFACEVERSION_SERVERGAMEENTS_VERSION_1, g_ServerGameEnts );
+EXPOSE_SINGLE_INTERFACE_GLOBALVAR(CServerGameEnts, IServerGameEnts, INTERFACEVERSION_SERVERGAMEENTS, g_ServerGameEnts );
 
 void CServerGameEnts::SetDebugEdictBase(edict_t *base)
 {
@@ -2439,7 +2452,67 @@ inline void CServerNetworkProperty::CheckTransmit( CCheckTransmitInfo *pInfo )
 	}
 } */
 
+//-----------------------------------------------------------------------------
+// Purpose: Gets the entities ready for CheckTransmit to be called for several
+//			clients at once. The per client checks only read entity state after this,
+//			the abs transforms GetAbsOrigin() and the PVS information AreaNum() and
+//			IsInPVS() update lazily are brought up to date here instead.
+//-----------------------------------------------------------------------------
+bool CServerGameEnts::PrepareParallelCheckTransmit( const unsigned short *pEdictIndices, int nEdicts )
+{
+	edict_t *pBaseEdict = engine->PEntityOfEntIndex( 0 );
+	if ( !pBaseEdict )
+		return false;
+
+	// ShouldTransmit reads the positions of other entities too, like owners and parents,
+	// so every entity is made current before any PVS information is computed
+	for ( int i=0; i < nEdicts; i++ )
+	{
+		edict_t *pEdict = &pBaseEdict[ pEdictIndices[i] ];
+		CBaseEntity *pEntity = GetContainingEntity( pEdict );
+		if ( pEntity )
+		{
+			pEntity->GetAbsOrigin();
+		}
+	}
+
+	for ( int i=0; i < nEdicts; i++ )
+	{
+		edict_t *pEdict = &pBaseEdict[ pEdictIndices[i] ];
+		if ( pEdict->m_fStateFlags & FL_EDICT_DONTSEND )
+			continue;
+
+		CServerNetworkProperty *netProp = static_cast<CServerNetworkProperty*>( pEdict->GetNetworkable() );
+		if ( netProp )
+		{
+			netProp->RecomputePVSInformation();
+		}
+	}
+
+	m_bParallelCheckTransmit = true;
+	return true;
+}
+
+void CServerGameEnts::FinishParallelCheckTransmit()
+{
+	m_bParallelCheckTransmit = false;
+}
+
 void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned short *pEdictIndices, int nEdicts )
+{
+	// the engine already holds the model cache for the parallel checks, and taking the
+	// critical section on every worker would just serialize them again
+	if ( m_bParallelCheckTransmit )
+	{
+		CheckTransmitInternal( pInfo, pEdictIndices, nEdicts );
+		return;
+	}
+
+	MDLCACHE_CRITICAL_SECTION();
+	CheckTransmitInternal( pInfo, pEdictIndices, nEdicts );
+}
+
+void CServerGameEnts::CheckTransmitInternal( CCheckTransmitInfo *pInfo, const unsigned short *pEdictIndices, int nEdicts )
 {
 	// NOTE: for speed's sake, this assumes that all networkables are CBaseEntities and that the edict list
 	// is consecutive in memory. If either of these things change, then this routine needs to change, but
@@ -2454,7 +2527,6 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 	if ( !pRecipientEntity )
 		return;
 	
-	MDLCACHE_CRITICAL_SECTION();
 	CBasePlayer *pRecipientPlayer = static_cast<CBasePlayer*>( pRecipientEntity );
 	const int skyBoxArea = pRecipientPlayer->m_Local.m_skybox3d.area;
 
@@ -585,8 +585,11 @@ void CHL2MP_Player::PlayerDeathThink()
 
 void CHL2MP_Player::FireBullets ( const FireBulletsInfo_t &info )
 {
-	// Move other players back to history positions based on local player's lag
-	lagcompensation->StartLagCompensation( this, this->GetCurrentCommand() );
+	// Move other players the bullets can reach back to history positions based on local player's lag
+	Vector vecDirection = info.m_vecDirShooting;
+	VectorNormalize( vecDirection );
+	LagCompensationShot_t shot( info.m_vecSrc, vecDirection, info.m_vecSpread.Length(), info.m_flDistance );
+	lagcompensation->StartLagCompensation( this, this->GetCurrentCommand(), &shot );
 
 	FireBulletsInfo_t modinfo = info;
 
@@ -11,17 +11,37 @@
 #pragma once
 #endif
 
+#include "mathlib/vector.h"
+
 class CBasePlayer;
 class CUserCmd;
 
+//-----------------------------------------------------------------------------
+// Purpose: The cone an attack's traces stay in. Players that can't be inside it,
+//			at their lag compensated position or their current one, aren't moved.
+//-----------------------------------------------------------------------------
+struct LagCompensationShot_t
+{
+	LagCompensationShot_t( const Vector &vecSrc, const Vector &vecDirection, float flSpread, float flRange ) :
+		m_vecSrc( vecSrc ), m_vecDirection( vecDirection ), m_flSpread( flSpread ), m_flRange( flRange )
+	{
+	}
+
+	Vector	m_vecSrc;
+	Vector	m_vecDirection;		// normalized
+	float	m_flSpread;			// tangent of the cone's half angle, 0 for a single ray
+	float	m_flRange;
+};
+
 //-----------------------------------------------------------------------------
 // Purpose: This is also an IServerSystem
 //-----------------------------------------------------------------------------
 abstract_class ILagCompensationManager
 {
 public:
-	// Called during player movement to set up/restore after lag compensation
-	virtual void	StartLagCompensation( CBasePlayer *player, CUserCmd *cmd ) = 0;
+	// Called during player movement to set up/restore after lag compensation.
+	// Without a shot every player the cmd's owner wants compensated is moved.
+	virtual void	StartLagCompensation( CBasePlayer *player, CUserCmd *cmd, const LagCompensationShot_t *pShot = NULL ) = 0;
 	virtual void	FinishLagCompensation( CBasePlayer *player ) = 0;
 };
 
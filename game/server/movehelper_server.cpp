@@ -13,6 +13,7 @@
 #include "movehelper_server.h"
 #include "shake.h"				// For screen fade constants
 #include "engine/IEngineSound.h"
+#include "tier1/functors.h"
 
 //=============================================================================
 // HPE_BEGIN
@@ -41,7 +42,7 @@ extern IPhysicsCollision *physcollision;
 class CMoveHelperServer : public IMoveHelperServer
 {
 public:
-	CMoveHelperServer( void );
+	CMoveHelperServer( CUtlVector< CFunctor * > *pDeferredCalls = NULL );
 	virtual ~CMoveHelperServer();
 
 	// Methods associated with a particular entity
@@ -70,8 +71,15 @@ class CMoveHelperServer : public IMoveHelperServer
 	virtual bool IsWorldEntity( const CBaseHandle &handle );
 
 private:
+	void			EmitHostSound( Vector origin, const char *soundname );
+	void			EmitHostSound( Vector origin, int channel, const char *sample, float volume, soundlevel_t soundlevel, int fFlags, int pitch );
+	bool			ApplyFallingDamage( float flFallDamage );
+
 	CBasePlayer*	m_pHostPlayer;
 
+	// Set for helpers of moves that run off the main thread, calls with side effects are queued here
+	CUtlVector< CFunctor * > *m_pDeferredCalls;
+
 	// results, tallied on client and server, but only used by server to run SV_Impact.
 	// we store off our velocity in the trace_t structure so that we can determine results
 	// of shoving boxes etc. around.
@@ -97,6 +105,17 @@ IMoveHelperServer* MoveHelperServer()
 	return &s_MoveHelperServer;
 }
 
+IMoveHelperServer* CreateDeferredMoveHelperServer( CUtlVector< CFunctor * > *pDeferredCalls )
+{
+	Assert( pDeferredCalls );
+	return new CMoveHelperServer( pDeferredCalls );
+}
+
+void DestroyDeferredMoveHelperServer( IMoveHelperServer *pMoveHelper )
+{
+	delete static_cast< CMoveHelperServer * >( pMoveHelper );
+}
+
 
 //-----------------------------------------------------------------------------
 // Converts the entity handle into a edict_t
@@ -112,15 +131,24 @@ static inline edict_t* GetEdict( EntityHandle_t handle )
 // Constructor
 //-----------------------------------------------------------------------------
 
-CMoveHelperServer::CMoveHelperServer( void ) : m_TouchList( 0, 128 )
+CMoveHelperServer::CMoveHelperServer( CUtlVector< CFunctor * > *pDeferredCalls ) : m_TouchList( 0, 128 )
 {
 	m_pHostPlayer = 0;
-	SetSingleton( this );
+	m_pDeferredCalls = pDeferredCalls;
+
+	// Deferred helpers are only used by the moves they're handed to
+	if ( !m_pDeferredCalls )
+	{
+		SetSingleton( this );
+	}
 }
 
 CMoveHelperServer::~CMoveHelperServer( void )
 {
-	SetSingleton( 0 );
+	if ( !m_pDeferredCalls )
+	{
+		SetSingleton( 0 );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -268,6 +296,17 @@ void CMoveHelperServer::ProcessImpacts( void )
 //			*soundname - 
 //-----------------------------------------------------------------------------
 void CMoveHelperServer::StartSound( const Vector& origin, const char *soundname )
+{
+	if ( m_pDeferredCalls )
+	{
+		m_pDeferredCalls->AddToTail( CreateFunctor( this, static_cast< void (CMoveHelperServer::*)( Vector, const char * ) >( &CMoveHelperServer::EmitHostSound ), origin, soundname ) );
+		return;
+	}
+
+	EmitHostSound( origin, soundname );
+}
+
+void CMoveHelperServer::EmitHostSound( Vector origin, const char *soundname )
 {
 	//MDB - Changing this to send to PAS, as the overloaded function below has done.
 	//Also removed the UsePredictionRules, client does not yet play the equivalent sound
@@ -283,6 +322,18 @@ void CMoveHelperServer::StartSound( const Vector& origin, const char *soundname
 //-----------------------------------------------------------------------------
 void CMoveHelperServer::StartSound( const Vector& origin, int channel, char const* sample, 
 						float volume, soundlevel_t soundlevel, int fFlags, int pitch )
+{
+	if ( m_pDeferredCalls )
+	{
+		m_pDeferredCalls->AddToTail( CreateFunctor( this, static_cast< void (CMoveHelperServer::*)( Vector, int, const char *, float, soundlevel_t, int, int ) >( &CMoveHelperServer::EmitHostSound ),
+			origin, channel, sample, volume, soundlevel, fFlags, pitch ) );
+		return;
+	}
+
+	EmitHostSound( origin, channel, sample, volume, soundlevel, fFlags, pitch );
+}
+
+void CMoveHelperServer::EmitHostSound( Vector origin, int channel, const char *sample, float volume, soundlevel_t soundlevel, int fFlags, int pitch )
 {
 
 	CRecipientFilter filter;
@@ -360,10 +411,24 @@ void CMoveHelperServer::Con_NPrintf( int idx, char const* pFormat, ...)
 bool CMoveHelperServer::PlayerFallingDamage( void )
 {
 	float flFallDamage = g_pGameRules->FlPlayerFallDamage( m_pHostPlayer );	
+	if ( m_pDeferredCalls )
+	{
+		// CPlayerMove keeps moves that can land this hard on the main thread, this is only a
+		// fallback if one gets here anyway. The damage is done after the move, guess whether
+		// the player survives it.
+		m_pDeferredCalls->AddToTail( CreateFunctor( this, &CMoveHelperServer::ApplyFallingDamage, flFallDamage ) );
+		return ( m_pHostPlayer->m_iHealth > flFallDamage );
+	}
+
+	return ApplyFallingDamage( flFallDamage );
+}
+
+bool CMoveHelperServer::ApplyFallingDamage( float flFallDamage )
+{
 	if ( flFallDamage > 0 )
 	{
 		m_pHostPlayer->TakeDamage( CTakeDamageInfo( GetContainingEntity(INDEXENT(0)), GetContainingEntity(INDEXENT(0)), flFallDamage, DMG_FALL ) ); 
-		StartSound( m_pHostPlayer->GetAbsOrigin(), "Player.FallDamage" );
+		EmitHostSound( m_pHostPlayer->GetAbsOrigin(), "Player.FallDamage" );
 
         //=============================================================================
         // HPE_BEGIN:
@@ -407,6 +472,12 @@ bool CMoveHelperServer::PlayerFallingDamage( void )
 //-----------------------------------------------------------------------------
 void CMoveHelperServer::PlayerSetAnimation( PLAYER_ANIM eAnim )
 {
+	if ( m_pDeferredCalls )
+	{
+		m_pDeferredCalls->AddToTail( CreateFunctor( m_pHostPlayer, &CBasePlayer::SetAnimation, eAnim ) );
+		return;
+	}
+
 	m_pHostPlayer->SetAnimation( eAnim );
 }
 
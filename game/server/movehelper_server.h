@@ -21,6 +21,7 @@
 
 class CBasePlayer;
 class CBaseEntity;
+class CFunctor;
 
 
 //-----------------------------------------------------------------------------
@@ -39,5 +40,10 @@ abstract_class IMoveHelperServer : public IMoveHelper
 
 IMoveHelperServer* MoveHelperServer();
 
+// Helpers for moves that run off the main thread. Sounds, animations and damage
+// are queued to pDeferredCalls for the main thread to run after the move.
+IMoveHelperServer* CreateDeferredMoveHelperServer( CUtlVector< CFunctor * > *pDeferredCalls );
+void DestroyDeferredMoveHelperServer( IMoveHelperServer *pMoveHelper );
+
 
 #endif // MOVEHELPER_SERVER_H
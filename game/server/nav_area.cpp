@@ -188,6 +188,7 @@ CNavArea::CNavArea( void )
 	m_parentHow = GO_NORTH;
 	m_attributeFlags = 0;
 	m_place = TheNavMesh->GetNavPlace();
+	m_cluster = -1;
 	m_isUnderwater = false;
 	m_avoidanceObstacleHeight = 0.0f;
 
@@ -3359,6 +3360,13 @@ void CNavArea::DrawConnectedAreas( void ) const
  */
 void CNavArea::AddToOpenList( void )
 {
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	if ( search )
+	{
+		search->AddToOpenList( this );
+		return;
+	}
+
 	Assert( (m_openList && m_openList->m_prevOpen == NULL) || m_openList == NULL );
 
 	if ( IsOpen() )
@@ -3435,6 +3443,13 @@ void CNavArea::AddToOpenList( void )
  */
 void CNavArea::AddToOpenListTail( void )
 {
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	if ( search )
+	{
+		search->AddToOpenListTail( this );
+		return;
+	}
+
 	Assert( (m_openList && m_openList->m_prevOpen == NULL) || m_openList == NULL );
 
 	if ( IsOpen() )
@@ -3476,6 +3491,13 @@ void CNavArea::AddToOpenListTail( void )
  */
 void CNavArea::UpdateOnOpenList( void )
 {
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	if ( search )
+	{
+		search->UpdateOnOpenList( this );
+		return;
+	}
+
 	// since value can only decrease, bubble this area up from current spot
 	while( m_prevOpen && this->GetTotalCost() < m_prevOpen->GetTotalCost() )
 	{
@@ -3513,6 +3535,13 @@ void CNavArea::UpdateOnOpenList( void )
 //--------------------------------------------------------------------------------------------------------------
 void CNavArea::RemoveFromOpenList( void )
 {
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	if ( search )
+	{
+		search->RemoveFromOpenList( this );
+		return;
+	}
+
 	if ( m_openMarker == 0 )
 	{
 		// not on the list
@@ -3547,6 +3576,13 @@ void CNavArea::RemoveFromOpenList( void )
  */
 void CNavArea::ClearSearchLists( void )
 {
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	if ( search )
+	{
+		search->Reset();
+		return;
+	}
+
 	// effectively clears all open list pointers and closed flags
 	CNavArea::MakeNewMarker();
 
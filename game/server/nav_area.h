@@ -13,6 +13,7 @@
 #define _NAV_AREA_H_
 
 #include "nav_ladder.h"
+#include "nav_pathsearch.h"
 #include "tier1/memstack.h"
 
 // BOTPORT: Clean up relationship between team index and danger storage in nav areas
@@ -301,6 +302,9 @@ class CNavArea : protected CNavAreaCriticalData
 	void SetPlace( Place place )		{ m_place = place; }	// set place descriptor
 	Place GetPlace( void ) const		{ return m_place; }		// get place descriptor
 
+	void SetCluster( int cluster )		{ m_cluster = cluster; }	// set the path cluster this area belongs to (see CNavClusterGraph)
+	int GetCluster( void ) const		{ return m_cluster; }		// return the path cluster of this area, or -1 if it has none
+
 	void MarkAsBlocked( int teamID, CBaseEntity *blocker, bool bGenerateEvent = true );	// An entity can force a nav area to be blocked
 	virtual void UpdateBlocked( bool force = false, int teamID = TEAM_ANY );		// Updates the (un)blocked status of the nav area (throttled)
 	virtual bool IsBlocked( int teamID, bool ignoreNavBlockers = false ) const;
@@ -427,9 +431,10 @@ class CNavArea : protected CNavAreaCriticalData
 	void Mark( void )					{ m_marker = m_masterMarker; }
 	BOOL IsMarked( void ) const			{ return (m_marker == m_masterMarker) ? true : false; }
 	
-	void SetParent( CNavArea *parent, NavTraverseType how = NUM_TRAVERSE_TYPES )	{ m_parent = parent; m_parentHow = how; }
-	CNavArea *GetParent( void ) const	{ return m_parent; }
-	NavTraverseType GetParentHow( void ) const	{ return m_parentHow; }
+	// while a CNavPathSearch is active on the calling thread, the search state below is kept in it instead
+	void SetParent( CNavArea *parent, NavTraverseType how = NUM_TRAVERSE_TYPES );
+	CNavArea *GetParent( void ) const;
+	NavTraverseType GetParentHow( void ) const;
 
 	bool IsOpen( void ) const;									// true if on "open list"
 	void AddToOpenList( void );									// add to open list in decreasing value order
@@ -445,14 +450,14 @@ class CNavArea : protected CNavAreaCriticalData
 
 	static void ClearSearchLists( void );						// clears the open and closed lists for a new search
 
-	void SetTotalCost( float value )	{ Assert( value >= 0.0 && !IS_NAN(value) ); m_totalCost = value; }
-	float GetTotalCost( void ) const	{ return m_totalCost; }
+	void SetTotalCost( float value );
+	float GetTotalCost( void ) const;
 
-	void SetCostSoFar( float value )	{ Assert( value >= 0.0 && !IS_NAN(value) ); m_costSoFar = value; }
-	float GetCostSoFar( void ) const	{ return m_costSoFar; }
+	void SetCostSoFar( float value );
+	float GetCostSoFar( void ) const;
 
-	void SetPathLengthSoFar( float value )	{ Assert( value >= 0.0 && !IS_NAN(value) ); m_pathLengthSoFar = value; }
-	float GetPathLengthSoFar( void ) const	{ return m_pathLengthSoFar; }
+	void SetPathLengthSoFar( float value );
+	float GetPathLengthSoFar( void ) const;
 
 	//- editing -----------------------------------------------------------------------------------------
 	virtual void Draw( void ) const;							// draw area for debugging & editing
@@ -665,6 +670,7 @@ class CNavArea : protected CNavAreaCriticalData
 	unsigned int m_debugid;
 
 	Place m_place;												// place descriptor
+	int m_cluster;												// path cluster this area belongs to, -1 if none
 
 	CountdownTimer m_blockedTimer;								// Throttle checks on our blocked state while blocked
 	void UpdateBlockedFromNavBlockers( void );					// checks if nav blockers are still blocking the area
@@ -824,15 +830,117 @@ inline CNavArea *CNavArea::GetAdjacentArea( NavDirType dir, int i ) const
 	return NULL;
 }
 
+//--------------------------------------------------------------------------------------------------------------
+inline void CNavArea::SetParent( CNavArea *parent, NavTraverseType how )
+{
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	if ( search )
+	{
+		search->SetParent( this, parent, how );
+		return;
+	}
+
+	m_parent = parent;
+	m_parentHow = how;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline CNavArea *CNavArea::GetParent( void ) const
+{
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	return search ? search->GetParent( this ) : m_parent;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline NavTraverseType CNavArea::GetParentHow( void ) const
+{
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	return search ? search->GetParentHow( this ) : m_parentHow;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline void CNavArea::SetTotalCost( float value )
+{
+	Assert( value >= 0.0 && !IS_NAN(value) );
+
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	if ( search )
+	{
+		search->SetTotalCost( this, value );
+		return;
+	}
+
+	m_totalCost = value;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline float CNavArea::GetTotalCost( void ) const
+{
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	return search ? search->GetTotalCost( this ) : m_totalCost;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline void CNavArea::SetCostSoFar( float value )
+{
+	Assert( value >= 0.0 && !IS_NAN(value) );
+
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	if ( search )
+	{
+		search->SetCostSoFar( this, value );
+		return;
+	}
+
+	m_costSoFar = value;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline float CNavArea::GetCostSoFar( void ) const
+{
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	return search ? search->GetCostSoFar( this ) : m_costSoFar;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline void CNavArea::SetPathLengthSoFar( float value )
+{
+	Assert( value >= 0.0 && !IS_NAN(value) );
+
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	if ( search )
+	{
+		search->SetPathLengthSoFar( this, value );
+		return;
+	}
+
+	m_pathLengthSoFar = value;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline float CNavArea::GetPathLengthSoFar( void ) const
+{
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	return search ? search->GetPathLengthSoFar( this ) : m_pathLengthSoFar;
+}
+
 //--------------------------------------------------------------------------------------------------------------
 inline bool CNavArea::IsOpen( void ) const
 {
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	if ( search )
+		return search->IsOpen( this );
+
 	return (m_openMarker == m_masterMarker) ? true : false;
 }
 
 //--------------------------------------------------------------------------------------------------------------
 inline bool CNavArea::IsOpenListEmpty( void )
 {
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	if ( search )
+		return search->IsOpenListEmpty();
+
 	Assert( (m_openList && m_openList->m_prevOpen == NULL) || m_openList == NULL );
 	return (m_openList) ? false : true;
 }
@@ -840,6 +948,10 @@ inline bool CNavArea::IsOpenListEmpty( void )
 //--------------------------------------------------------------------------------------------------------------
 inline CNavArea *CNavArea::PopOpenList( void )
 {
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	if ( search )
+		return search->PopOpenList();
+
 	Assert( (m_openList && m_openList->m_prevOpen == NULL) || m_openList == NULL );
 
 	if ( m_openList )
@@ -864,6 +976,10 @@ inline CNavArea *CNavArea::PopOpenList( void )
 //--------------------------------------------------------------------------------------------------------------
 inline bool CNavArea::IsClosed( void ) const
 {
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	if ( search )
+		return search->IsClosed( this );
+
 	if (IsMarked() && !IsOpen())
 		return true;
 
@@ -873,6 +989,13 @@ inline bool CNavArea::IsClosed( void ) const
 //--------------------------------------------------------------------------------------------------------------
 inline void CNavArea::AddToClosedList( void )
 {
+	CNavPathSearch *search = CNavPathSearch::GetActive();
+	if ( search )
+	{
+		search->AddToClosedList( this );
+		return;
+	}
+
 	Mark();
 }
 
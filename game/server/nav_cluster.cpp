@@ -0,0 +1,514 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose:
+//
+// $NoKeywords: $
+//
+//=============================================================================//
+// nav_cluster.cpp
+// A coarse graph of nav area clusters, used to narrow long path searches down to a corridor
+
+#include "cbase.h"
+#include "nav_mesh.h"
+#include "nav_cluster.h"
+#include "tier1/utlpriorityqueue.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+ConVar nav_cluster_paths( "nav_cluster_paths", "1", FCVAR_CHEAT, "If nonzero, long paths only search the nav areas along a cached route through the mesh's area clusters." );
+ConVar nav_cluster_size( "nav_cluster_size", "1024", FCVAR_CHEAT, "Maximum distance from the first area of a nav area cluster to the others, used when the clusters are built." );
+
+#define MAX_CACHED_ROUTE_CLUSTERS	65536	// total length of the cached routes before the cache is flushed
+
+CNavClusterGraph TheNavClusters;
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Collect the areas a path search can move to from the given area
+ */
+static void GetExitAreas( const CNavArea *area, CUtlVector< CNavArea * > *exits )
+{
+	exits->RemoveAll();
+
+	for ( int dir=0; dir<NUM_DIRECTIONS; ++dir )
+	{
+		const NavConnectVector *floorList = area->GetAdjacentAreas( (NavDirType)dir );
+		FOR_EACH_VEC( (*floorList), it )
+		{
+			exits->AddToTail( floorList->Element( it ).area );
+		}
+	}
+
+	// the searches don't use the area behind the top of a ladder, so neither do the routes
+	const NavLadderConnectVector *ladderList = area->GetLadders( CNavLadder::LADDER_UP );
+	FOR_EACH_VEC( (*ladderList), lit )
+	{
+		const CNavLadder *ladder = ladderList->Element( lit ).ladder;
+		CNavArea *top[] = { ladder->m_topForwardArea, ladder->m_topLeftArea, ladder->m_topRightArea };
+		for ( unsigned int i=0; i<V_ARRAYSIZE( top ); ++i )
+		{
+			if ( top[i] )
+			{
+				exits->AddToTail( top[i] );
+			}
+		}
+	}
+
+	ladderList = area->GetLadders( CNavLadder::LADDER_DOWN );
+	FOR_EACH_VEC( (*ladderList), lit )
+	{
+		CNavArea *bottom = ladderList->Element( lit ).ladder->m_bottomArea;
+		if ( bottom )
+		{
+			exits->AddToTail( bottom );
+		}
+	}
+
+	if ( area->GetElevator() )
+	{
+		const NavConnectVector &elevatorAreas = area->GetElevatorAreas();
+		FOR_EACH_VEC( elevatorAreas, eit )
+		{
+			exits->AddToTail( elevatorAreas[ eit ].area );
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+CNavClusterGraph::CNavClusterGraph( void )
+{
+	m_isValid = false;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavClusterGraph::Reset( void )
+{
+	m_isValid = false;
+	m_clusters.RemoveAll();
+	m_portals.RemoveAll();
+	m_crossings.RemoveAll();
+
+	OnBlockedChanged();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Grow each cluster from the first area not yet in one, across floor connections,
+ * taking in every area within nav_cluster_size of that first area
+ */
+void CNavClusterGraph::Build( void )
+{
+	Reset();
+
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		TheNavAreas[ it ]->SetCluster( -1 );
+	}
+
+	const float maxRangeSq = nav_cluster_size.GetFloat() * nav_cluster_size.GetFloat();
+	CUtlVector< CNavArea * > queue;
+	int clusterCount = 0;
+
+	FOR_EACH_VEC( TheNavAreas, sit )
+	{
+		CNavArea *seed = TheNavAreas[ sit ];
+		if ( seed->GetCluster() >= 0 )
+			continue;
+
+		int cluster = clusterCount++;
+		seed->SetCluster( cluster );
+
+		queue.RemoveAll();
+		queue.AddToTail( seed );
+
+		for ( int q=0; q<queue.Count(); ++q )
+		{
+			CNavArea *area = queue[ q ];
+
+			for ( int dir=0; dir<NUM_DIRECTIONS; ++dir )
+			{
+				const NavConnectVector *floorList = area->GetAdjacentAreas( (NavDirType)dir );
+				FOR_EACH_VEC( (*floorList), it )
+				{
+					CNavArea *adjArea = floorList->Element( it ).area;
+					if ( adjArea->GetCluster() >= 0 )
+						continue;
+
+					if ( ( adjArea->GetCenter() - seed->GetCenter() ).LengthSqr() > maxRangeSq )
+						continue;
+
+					adjArea->SetCluster( cluster );
+					queue.AddToTail( adjArea );
+				}
+			}
+		}
+	}
+
+	m_clusters.SetCount( clusterCount );
+	ConnectClusters();
+
+	DevMsg( "Built %d nav area clusters with %d portals.\n", m_clusters.Count(), m_portals.Count() );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Find each cluster's center and the portals between clusters, from the areas' cluster assignments
+ */
+void CNavClusterGraph::ConnectClusters( void )
+{
+	m_portals.RemoveAll();
+	m_crossings.RemoveAll();
+	m_isValid = false;
+
+	// bit vectors of clusters are used for the search corridors
+	if ( m_clusters.Count() == 0 || m_clusters.Count() > 0xffff )
+		return;
+
+	FOR_EACH_VEC( m_clusters, cit )
+	{
+		m_clusters[ cit ].center = vec3_origin;
+		m_clusters[ cit ].areaCount = 0;
+		m_clusters[ cit ].firstPortal = 0;
+		m_clusters[ cit ].portalCount = 0;
+	}
+
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		const CNavArea *area = TheNavAreas[ it ];
+		int cluster = area->GetCluster();
+		if ( cluster < 0 || cluster >= m_clusters.Count() )
+			return;
+
+		m_clusters[ cluster ].center += area->GetCenter();
+		++m_clusters[ cluster ].areaCount;
+	}
+
+	FOR_EACH_VEC( m_clusters, cit )
+	{
+		if ( m_clusters[ cit ].areaCount )
+		{
+			m_clusters[ cit ].center /= m_clusters[ cit ].areaCount;
+		}
+	}
+
+	// gather every connection that leaves a cluster, grouped by the pair of clusters it joins
+	struct Link
+	{
+		int fromCluster;
+		int toCluster;
+		Crossing crossing;
+
+		static int Compare( const Link *lhs, const Link *rhs )
+		{
+			if ( lhs->fromCluster != rhs->fromCluster )
+				return lhs->fromCluster - rhs->fromCluster;
+
+			return lhs->toCluster - rhs->toCluster;
+		}
+	};
+
+	CUtlVector< Link > links;
+	CUtlVector< CNavArea * > exits;
+
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		CNavArea *area = TheNavAreas[ it ];
+		GetExitAreas( area, &exits );
+
+		FOR_EACH_VEC( exits, eit )
+		{
+			if ( exits[ eit ]->GetCluster() == area->GetCluster() )
+				continue;
+
+			Link &link = links[ links.AddToTail() ];
+			link.fromCluster = area->GetCluster();
+			link.toCluster = exits[ eit ]->GetCluster();
+			link.crossing.from = area;
+			link.crossing.to = exits[ eit ];
+		}
+	}
+
+	links.Sort( &Link::Compare );
+
+	m_crossings.EnsureCapacity( links.Count() );
+	FOR_EACH_VEC( links, lit )
+	{
+		const Link &link = links[ lit ];
+
+		if ( lit == 0 || Link::Compare( &links[ lit-1 ], &link ) != 0 )
+		{
+			Cluster &from = m_clusters[ link.fromCluster ];
+			if ( from.portalCount == 0 )
+			{
+				from.firstPortal = m_portals.Count();
+			}
+			++from.portalCount;
+
+			Portal &portal = m_portals[ m_portals.AddToTail() ];
+			portal.toCluster = link.toCluster;
+			portal.cost = ( m_clusters[ link.toCluster ].center - from.center ).Length();
+			portal.firstCrossing = m_crossings.Count();
+			portal.crossingCount = 0;
+		}
+
+		m_crossings.AddToTail( link.crossing );
+		++m_portals.Tail().crossingCount;
+	}
+
+	m_isValid = true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavClusterGraph::Save( CUtlBuffer &fileBuffer ) const
+{
+	fileBuffer.PutUnsignedInt( m_clusters.Count() );
+
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		fileBuffer.PutInt( TheNavAreas[ it ]->GetCluster() );
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Read the cluster of each area. The clusters are connected in PostLoad(), once the areas are.
+ */
+bool CNavClusterGraph::Load( CUtlBuffer &fileBuffer, unsigned int version )
+{
+	Reset();
+
+	if ( version < 17 )
+		return false;
+
+	int clusterCount = fileBuffer.GetUnsignedInt();
+	if ( !fileBuffer.IsValid() )
+		return false;
+
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		int cluster = fileBuffer.GetInt();
+		if ( !fileBuffer.IsValid() || cluster < 0 || cluster >= clusterCount )
+		{
+			// rebuilt in PostLoad()
+			return false;
+		}
+
+		TheNavAreas[ it ]->SetCluster( cluster );
+	}
+
+	m_clusters.SetCount( clusterCount );
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavClusterGraph::PostLoad( void )
+{
+	if ( m_clusters.Count() )
+	{
+		ConnectClusters();
+	}
+
+	if ( !m_isValid )
+	{
+		Build();
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavClusterGraph::OnBlockedChanged( void )
+{
+	AUTO_LOCK( m_routeMutex );
+
+	m_routes.RemoveAll();
+	m_routeClusters.RemoveAll();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * A portal can be used if any of its crossings is between two areas that aren't blocked
+ */
+bool CNavClusterGraph::IsPortalOpen( const Portal &portal, int teamID ) const
+{
+	for ( int i=0; i<portal.crossingCount; ++i )
+	{
+		const Crossing &crossing = m_crossings[ portal.firstCrossing + i ];
+		if ( !crossing.from->IsBlocked( teamID ) && !crossing.to->IsBlocked( teamID ) )
+			return true;
+	}
+
+	return false;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * A* search through the clusters. Uses only local state, so several can run at once.
+ */
+bool CNavClusterGraph::SearchRoute( int startCluster, int goalCluster, int teamID, CUtlVector< int > *route ) const
+{
+	struct OpenCluster
+	{
+		float totalCost;
+		int cluster;
+
+		static bool LessFunc( const OpenCluster &lhs, const OpenCluster &rhs )
+		{
+			// lower total cost is higher priority
+			return lhs.totalCost > rhs.totalCost;
+		}
+	};
+
+	CUtlVector< float > costSoFar;
+	CUtlVector< int > parent;
+	costSoFar.SetCount( m_clusters.Count() );
+	parent.SetCount( m_clusters.Count() );
+	FOR_EACH_VEC( m_clusters, it )
+	{
+		costSoFar[ it ] = FLT_MAX;
+		parent[ it ] = -1;
+	}
+
+	const Vector &goalCenter = m_clusters[ goalCluster ].center;
+
+	CUtlPriorityQueue< OpenCluster > openList( 0, 0, OpenCluster::LessFunc );
+
+	OpenCluster start;
+	start.totalCost = ( m_clusters[ startCluster ].center - goalCenter ).Length();
+	start.cluster = startCluster;
+	openList.Insert( start );
+	costSoFar[ startCluster ] = 0.0f;
+
+	while ( openList.Count() )
+	{
+		OpenCluster current = openList.ElementAtHead();
+		openList.RemoveAtHead();
+
+		if ( current.cluster == goalCluster )
+		{
+			route->RemoveAll();
+			for ( int cluster = goalCluster; cluster >= 0; cluster = parent[ cluster ] )
+			{
+				route->AddToHead( cluster );
+			}
+			return true;
+		}
+
+		const Cluster &cluster = m_clusters[ current.cluster ];
+
+		// skip stale entries, the cluster was reached more cheaply since
+		float heuristic = ( cluster.center - goalCenter ).Length();
+		if ( current.totalCost > costSoFar[ current.cluster ] + heuristic )
+			continue;
+
+		for ( int i=0; i<cluster.portalCount; ++i )
+		{
+			const Portal &portal = m_portals[ cluster.firstPortal + i ];
+
+			float newCostSoFar = costSoFar[ current.cluster ] + portal.cost;
+			if ( newCostSoFar >= costSoFar[ portal.toCluster ] )
+				continue;
+
+			if ( !IsPortalOpen( portal, teamID ) )
+				continue;
+
+			costSoFar[ portal.toCluster ] = newCostSoFar;
+			parent[ portal.toCluster ] = current.cluster;
+
+			OpenCluster next;
+			next.totalCost = newCostSoFar + ( m_clusters[ portal.toCluster ].center - goalCenter ).Length();
+			next.cluster = portal.toCluster;
+			openList.Insert( next );
+		}
+	}
+
+	return false;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+bool CNavClusterGraph::FindRoute( const CNavArea *startArea, const CNavArea *goalArea, int teamID, CVarBitVec *corridor )
+{
+	if ( !nav_cluster_paths.GetBool() || !m_isValid || startArea == NULL || goalArea == NULL )
+		return false;
+
+	int startCluster = startArea->GetCluster();
+	int goalCluster = goalArea->GetCluster();
+
+	// areas created since the clusters were built have none
+	if ( startCluster < 0 || goalCluster < 0 || startCluster == goalCluster )
+		return false;
+
+	uint64 key = ( (uint64)startCluster << 40 ) | ( (uint64)goalCluster << 16 ) | (uint16)teamID;
+
+	CUtlVector< int > route;
+	bool isCached = false;
+	{
+		AUTO_LOCK( m_routeMutex );
+
+		UtlHashHandle_t h = m_routes.Find( key );
+		if ( h != m_routes.InvalidHandle() )
+		{
+			const CachedRoute &cached = m_routes[ h ];
+			if ( cached.firstCluster < 0 )
+				return false;
+
+			route.CopyArray( m_routeClusters.Base() + cached.firstCluster, cached.clusterCount );
+			isCached = true;
+		}
+	}
+
+	if ( !isCached )
+	{
+		bool isFound = SearchRoute( startCluster, goalCluster, teamID, &route );
+
+		AUTO_LOCK( m_routeMutex );
+
+		if ( m_routeClusters.Count() + route.Count() > MAX_CACHED_ROUTE_CLUSTERS )
+		{
+			m_routes.RemoveAll();
+			m_routeClusters.RemoveAll();
+		}
+
+		if ( m_routes.Find( key ) == m_routes.InvalidHandle() )
+		{
+			CachedRoute cached;
+			cached.firstCluster = isFound ? m_routeClusters.AddMultipleToTail( route.Count(), route.Base() ) : -1;
+			cached.clusterCount = isFound ? route.Count() : 0;
+			m_routes.Insert( key, cached );
+		}
+
+		if ( !isFound )
+			return false;
+	}
+
+	corridor->Resize( m_clusters.Count(), true );
+	FOR_EACH_VEC( route, it )
+	{
+		corridor->Set( route[ it ] );
+	}
+
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+CON_COMMAND_F( nav_cluster_rebuild, "Rebuilds the nav area clusters used to speed up long path searches.", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	TheNavClusters.Build();
+	Msg( "%d nav area clusters, %d portals.\n", TheNavClusters.GetClusterCount(), TheNavClusters.GetPortalCount() );
+}
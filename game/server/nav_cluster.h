@@ -0,0 +1,105 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose:
+//
+// $NoKeywords: $
+//
+//=============================================================================//
+// nav_cluster.h
+// A coarse graph of nav area clusters, used to narrow long path searches down to a corridor
+
+#ifndef _NAV_CLUSTER_H_
+#define _NAV_CLUSTER_H_
+
+#include "nav.h"
+#include "bitvec.h"
+#include "tier0/threadtools.h"
+#include "tier1/utlbuffer.h"
+#include "tier1/utlhashtable.h"
+
+class CNavArea;
+
+extern ConVar nav_cluster_paths;
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * The nav areas of the mesh grouped into clusters of nearby, connected areas, with a portal
+ * between every pair of clusters an area of one connects to an area of the other.
+ * Long paths first find a route through the clusters, which is cheap and cached, then
+ * run the real A* search over the areas of the clusters on that route only.
+ * The cluster of each area is stored in the .nav file, the portals are found at load time.
+ */
+class CNavClusterGraph
+{
+public:
+	CNavClusterGraph( void );
+
+	void Reset( void );										// forget all clusters, searches use the whole mesh until rebuilt
+	void Build( void );										// group TheNavAreas into clusters and connect them
+	bool IsValid( void ) const			{ return m_isValid; }
+
+	int GetClusterCount( void ) const	{ return m_clusters.Count(); }
+	int GetPortalCount( void ) const	{ return m_portals.Count(); }
+
+	void Save( CUtlBuffer &fileBuffer ) const;				// store the cluster of each area, in TheNavAreas order
+	bool Load( CUtlBuffer &fileBuffer, unsigned int version );
+	void PostLoad( void );									// connect the loaded clusters, or build them if the file had none
+
+	void OnBlockedChanged( void );							// an area's blocked state changed, flush the cached routes
+
+	/**
+	 * Find the clusters a path from startArea to goalArea passes through, and mark them in 'corridor'.
+	 * Returns false if there is no route, or if the areas are in the same cluster or have none,
+	 * in which case the path search should use the whole mesh.
+	 * Safe to call from several threads at once.
+	 */
+	bool FindRoute( const CNavArea *startArea, const CNavArea *goalArea, int teamID, CVarBitVec *corridor );
+
+private:
+	struct Cluster
+	{
+		Vector center;										// average of its areas' centers
+		int areaCount;
+		int firstPortal;									// index into m_portals
+		int portalCount;
+	};
+
+	struct Portal
+	{
+		int toCluster;
+		float cost;											// distance between the cluster centers
+		int firstCrossing;									// index into m_crossings
+		int crossingCount;
+	};
+
+	struct Crossing											// one connection from an area of a cluster to an area of another
+	{
+		CNavArea *from;
+		CNavArea *to;
+	};
+
+	void ConnectClusters( void );
+	bool IsPortalOpen( const Portal &portal, int teamID ) const;
+	bool SearchRoute( int startCluster, int goalCluster, int teamID, CUtlVector< int > *route ) const;
+
+	bool m_isValid;
+	CUtlVector< Cluster > m_clusters;
+	CUtlVector< Portal > m_portals;
+	CUtlVector< Crossing > m_crossings;
+
+	// Routes already searched for, by start cluster, goal cluster and team
+	struct CachedRoute
+	{
+		int firstCluster;									// index into m_routeClusters, -1 if there is no route
+		int clusterCount;
+	};
+	CThreadFastMutex m_routeMutex;
+	CUtlHashtable< uint64, CachedRoute > m_routes;
+	CUtlVector< int > m_routeClusters;
+};
+
+extern CNavClusterGraph TheNavClusters;
+
+
+#endif // _NAV_CLUSTER_H_
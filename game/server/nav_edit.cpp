@@ -13,6 +13,7 @@
 #include "nav_mesh.h"
 #include "nav_pathfind.h"
 #include "nav_node.h"
+#include "nav_cluster.h"
 #include "nav_colors.h"
 #include "Color.h"
 #include "tier0/vprof.h"
@@ -20,6 +21,9 @@
 #include "world.h"
 #include "functorutils.h"
 #include "team.h"
+#ifdef NEXT_BOT
+#include "NextBot/Path/NextBotPath.h"
+#endif
 #ifdef TERROR
 #include "TerrorShared.h"
 #endif
@@ -617,6 +621,9 @@ class PlaceFloodFillFunctor
  */
 void CNavMesh::OnEditModeStart( void )
 {
+	// edits can connect areas any which way, search the whole mesh until done
+	TheNavClusters.Reset();
+
 	ClearSelectedSet();
 	m_isContinuouslySelecting = false;
 	m_isContinuouslyDeselecting = false;
@@ -629,6 +636,7 @@ void CNavMesh::OnEditModeStart( void )
  */
 void CNavMesh::OnEditModeEnd( void )
 {
+	TheNavClusters.Build();
 }
 
 
@@ -3916,6 +3924,8 @@ bool CNavMesh::IsInSelectedSet( const CNavArea *area ) const
  */
 void CNavMesh::OnEditCreateNotify( CNavArea *newArea )
 {
+	TheNavClusters.Reset();
+
 	FOR_EACH_VEC( TheNavAreas, it )
 	{
 		TheNavAreas[ it ]->OnEditCreateNotify( newArea );
@@ -3940,6 +3950,13 @@ void CNavMesh::OnEditDestroyNotify( CNavArea *deadArea )
 	m_avoidanceObstacleAreas.FindAndRemove( deadArea );
 	m_blockedAreas.FindAndRemove( deadArea );
 
+	TheNavClusters.Reset();
+
+#ifdef NEXT_BOT
+	// queued path searches may start or end in the dead area
+	Path::DiscardComputeRequests();
+#endif
+
 	FOR_EACH_VEC( TheNavAreas, it )
 	{
 		TheNavAreas[ it ]->OnEditDestroyNotify( deadArea );
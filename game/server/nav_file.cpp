@@ -11,6 +11,7 @@
 
 #include "cbase.h"
 #include "nav_mesh.h"
+#include "nav_cluster.h"
 #include "gamerules.h"
 #include "datacache/imdlcache.h"
 
@@ -36,7 +37,7 @@
 /// IMPORTANT: If this version changes, the swap function in makegamedata 
 /// must be updated to match. If not, this will break the Xbox 360.
 // TODO: Was changed from 15, update when latest 360 code is integrated (MSB 5/5/09)
-const int NavCurrentVersion = 16;
+const int NavCurrentVersion = 17;
 
 //--------------------------------------------------------------------------------------------------------------
 //
@@ -1114,6 +1115,7 @@ bool CNavMesh::Save( void ) const
 	// 14 - Added a bool for if the nav needs analysis
 	// 15 - removed approach areas
 	// 16 - Added visibility data to the base mesh
+	// 17 - Added the path cluster of each area
 	fileBuffer.PutUnsignedInt( NavCurrentVersion );
 
 	// The sub-version number is maintained and owned by classes derived from CNavMesh and CNavArea
@@ -1185,6 +1187,15 @@ bool CNavMesh::Save( void ) const
 	//
 	SaveCustomData( fileBuffer );
 
+	//
+	// Store the path clusters
+	//
+	if ( !TheNavClusters.IsValid() )
+	{
+		TheNavClusters.Build();
+	}
+	TheNavClusters.Save( fileBuffer );
+
 	if ( !filesystem->WriteFile( filename, "MOD", fileBuffer ) )
 	{
 		Warning( "Unable to save %d bytes to %s\n", fileBuffer.Size(), filename );
@@ -1568,11 +1579,21 @@ NavErrorType CNavMesh::Load( void )
 	//
 	LoadCustomData( fileBuffer, subVersion );
 
+	//
+	// Load the path clusters, they are built once the areas are connected if the file has none
+	//
+	TheNavClusters.Load( fileBuffer, version );
+
 	//
 	// Bind pointers, etc
 	//
 	NavErrorType loadResult = PostLoad( version );
 
+	if ( loadResult == NAV_OK )
+	{
+		TheNavClusters.PostLoad();
+	}
+
 	WarnIfMeshNeedsAnalysis( version );
 
 	return loadResult;
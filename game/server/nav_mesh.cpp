@@ -13,6 +13,7 @@
 #include "filesystem.h"
 #include "nav_mesh.h"
 #include "nav_node.h"
+#include "nav_cluster.h"
 #include "fmtstr.h"
 #include "utlbuffer.h"
 #include "tier0/vprof.h"
@@ -23,6 +24,7 @@
 
 #ifdef NEXT_BOT
 #include "NextBot/NavMeshEntities/func_nav_prerequisite.h"
+#include "NextBot/Path/NextBotPath.h"
 #endif
 
 // NOTE: This has to be the last file included!
@@ -160,6 +162,13 @@ void CNavMesh::DestroyNavigationMesh( bool incremental )
 	m_avoidanceObstacleAreas.RemoveAll();
 	m_transientAreas.RemoveAll();
 
+	TheNavClusters.Reset();
+
+#ifdef NEXT_BOT
+	// queued path searches hold the areas about to be freed
+	Path::DiscardComputeRequests();
+#endif
+
 	if ( !incremental )
 	{
 		// destroy all areas
@@ -3115,6 +3124,8 @@ void CNavMesh::OnAreaBlocked( CNavArea *area )
 	{
 		m_blockedAreas.AddToTail( area );
 	}
+
+	TheNavClusters.OnBlockedChanged();
 }
 
 
@@ -3123,6 +3134,8 @@ void CNavMesh::OnAreaBlocked( CNavArea *area )
 void CNavMesh::OnAreaUnblocked( CNavArea *area )
 {
 	m_blockedAreas.FindAndRemove( area );
+
+	TheNavClusters.OnBlockedChanged();
 }
 
 
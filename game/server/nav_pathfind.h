@@ -15,6 +15,7 @@
 #include "tier0/vprof.h"
 #include "mathlib/ssemath.h"
 #include "nav_area.h"
+#include "nav_cluster.h"
 
 extern int g_DebugPathfindCounter;
 
@@ -96,6 +97,8 @@ class ShortestPathCost
  * If 'goalPos' is NULL, will use the center of 'goalArea' as the goal position.
  * If 'maxPathLength' is nonzero, path building will stop when this length is reached.
  * Returns true if a path exists.
+ * Searches run in the areas' own state unless a CNavPathSearch is active on the calling thread,
+ * which lets any number of them run at once as long as the cost functor only reads.
  */
 #define IGNORE_NAV_BLOCKERS true
 template< typename CostFunctor >
@@ -108,7 +111,8 @@ bool NavAreaBuildPath( CNavArea *startArea, CNavArea *goalArea, const Vector *go
 		*closestArea = startArea;
 	}
 
-	bool isDebug = ( g_DebugPathfindCounter-- > 0 );
+	// only the search run in the areas' own state draws, others may be on a worker thread
+	bool isDebug = ( CNavPathSearch::GetActive() == NULL && g_DebugPathfindCounter-- > 0 );
 
 	if (startArea == NULL)
 		return false;
@@ -415,6 +419,57 @@ bool NavAreaBuildPath( CNavArea *startArea, CNavArea *goalArea, const Vector *go
 }
 
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Wraps a cost functor so areas outside the given clusters are dead ends
+ */
+template< typename CostFunctor >
+class NavClusterCorridorCost
+{
+public:
+	NavClusterCorridorCost( CostFunctor &costFunc, const CVarBitVec &corridor ) : m_costFunc( costFunc ), m_corridor( corridor )
+	{
+	}
+
+	float operator() ( CNavArea *area, CNavArea *fromArea, const CNavLadder *ladder, const CFuncElevator *elevator, float length )
+	{
+		int cluster = area->GetCluster();
+		if ( cluster < 0 || cluster >= m_corridor.GetNumBits() || !m_corridor.IsBitSet( cluster ) )
+			return -1.0f;
+
+		return m_costFunc( area, fromArea, ladder, elevator, length );
+	}
+
+private:
+	CostFunctor &m_costFunc;
+	const CVarBitVec &m_corridor;
+};
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * NavAreaBuildPath() for paths that may cross much of the mesh. The route through the
+ * area clusters (see CNavClusterGraph) is found first, then only the areas of the clusters
+ * on that route are searched. If that finds no path, the whole mesh is searched as usual.
+ */
+template< typename CostFunctor >
+bool NavAreaBuildPathClustered( CNavArea *startArea, CNavArea *goalArea, const Vector *goalPos, CostFunctor &costFunc, CNavArea **closestArea = NULL, float maxPathLength = 0.0f, int teamID = TEAM_ANY, bool ignoreNavBlockers = false )
+{
+	if ( goalArea && !ignoreNavBlockers && !goalArea->IsBlocked( teamID ) )
+	{
+		CVarBitVec corridor;
+		if ( TheNavClusters.FindRoute( startArea, goalArea, teamID, &corridor ) )
+		{
+			NavClusterCorridorCost< CostFunctor > corridorCost( costFunc, corridor );
+			if ( NavAreaBuildPath( startArea, goalArea, goalPos, corridorCost, closestArea, maxPathLength, teamID ) )
+				return true;
+		}
+	}
+
+	return NavAreaBuildPath( startArea, goalArea, goalPos, costFunc, closestArea, maxPathLength, teamID, ignoreNavBlockers );
+}
+
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Compute distance between two areas. Return -1 if can't reach 'endArea' from 'startArea'.
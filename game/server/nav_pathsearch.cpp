@@ -0,0 +1,292 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose:
+//
+// $NoKeywords: $
+//
+//=============================================================================//
+// nav_pathsearch.cpp
+// Per-query A* search state, so several NavAreaBuildPath() searches can run at once
+
+#include "cbase.h"
+#include "nav_area.h"
+#include "nav_pathsearch.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+CInterlockedInt CNavPathSearch::m_activeCount;
+
+static CTHREADLOCALPTR( CNavPathSearch ) s_activeSearch;
+
+
+//--------------------------------------------------------------------------------------------------------------
+CNavPathSearch::CNavPathSearch( void ) : m_openList( 0, 0, OpenEntryLessFunc )
+{
+	m_openOrder = 0;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+CNavPathSearch *CNavPathSearch::GetThreadActive( void )
+{
+	return s_activeSearch;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Lower total cost is higher priority, ties go to the area added first
+ */
+bool CNavPathSearch::OpenEntryLessFunc( const OpenEntry &lhs, const OpenEntry &rhs )
+{
+	if ( lhs.totalCost != rhs.totalCost )
+		return lhs.totalCost > rhs.totalCost;
+
+	return lhs.order > rhs.order;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavPathSearch::Reset( void )
+{
+	m_nodes.RemoveAll();
+	m_nodeIndex.RemoveAll();
+	m_openList.RemoveAll();
+	m_openOrder = 0;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return the search state of the given area, adding it if this search hasn't reached it yet
+ */
+CNavPathSearch::Node &CNavPathSearch::GetNode( CNavArea *area )
+{
+	UtlHashHandle_t h = m_nodeIndex.Find( area );
+	if ( h != m_nodeIndex.InvalidHandle() )
+		return m_nodes[ m_nodeIndex[ h ] ];
+
+	int i = m_nodes.AddToTail();
+	Node &node = m_nodes[ i ];
+	node.area = area;
+	node.parent = NULL;
+	node.parentHow = NUM_TRAVERSE_TYPES;
+	node.totalCost = 0.0f;
+	node.costSoFar = 0.0f;
+	node.pathLengthSoFar = 0.0f;
+	node.openOrder = 0;
+	node.isOpen = false;
+	node.isMarked = false;
+
+	m_nodeIndex.Insert( area, i );
+	return node;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+const CNavPathSearch::Node *CNavPathSearch::FindNode( const CNavArea *area ) const
+{
+	UtlHashHandle_t h = m_nodeIndex.Find( area );
+	if ( h == m_nodeIndex.InvalidHandle() )
+		return NULL;
+
+	return &m_nodes[ m_nodeIndex[ h ] ];
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavPathSearch::SetParent( CNavArea *area, CNavArea *parent, NavTraverseType how )
+{
+	Node &node = GetNode( area );
+	node.parent = parent;
+	node.parentHow = how;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+CNavArea *CNavPathSearch::GetParent( const CNavArea *area ) const
+{
+	const Node *node = FindNode( area );
+	return node ? node->parent : NULL;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+NavTraverseType CNavPathSearch::GetParentHow( const CNavArea *area ) const
+{
+	const Node *node = FindNode( area );
+	return node ? node->parentHow : NUM_TRAVERSE_TYPES;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+float CNavPathSearch::GetTotalCost( const CNavArea *area ) const
+{
+	const Node *node = FindNode( area );
+	return node ? node->totalCost : 0.0f;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+float CNavPathSearch::GetCostSoFar( const CNavArea *area ) const
+{
+	const Node *node = FindNode( area );
+	return node ? node->costSoFar : 0.0f;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+float CNavPathSearch::GetPathLengthSoFar( const CNavArea *area ) const
+{
+	const Node *node = FindNode( area );
+	return node ? node->pathLengthSoFar : 0.0f;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+bool CNavPathSearch::IsOpen( const CNavArea *area ) const
+{
+	const Node *node = FindNode( area );
+	return node && node->isOpen;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavPathSearch::PushOpen( int node, float totalCost )
+{
+	OpenEntry entry;
+	entry.totalCost = totalCost;
+	entry.order = m_openOrder++;
+	entry.node = node;
+
+	m_nodes[ node ].openOrder = entry.order;
+	m_openList.Insert( entry );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavPathSearch::AddToOpenList( CNavArea *area )
+{
+	Node &node = GetNode( area );
+	if ( node.isOpen )
+	{
+		// already on list
+		return;
+	}
+
+	node.isOpen = true;
+	PushOpen( &node - m_nodes.Base(), node.totalCost );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Add behind everything already on the open list, regardless of cost
+ */
+void CNavPathSearch::AddToOpenListTail( CNavArea *area )
+{
+	Node &node = GetNode( area );
+	if ( node.isOpen )
+	{
+		// already on list
+		return;
+	}
+
+	node.isOpen = true;
+	PushOpen( &node - m_nodes.Base(), FLT_MAX );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * A smaller value has been found, the old entry stays in the queue and is skipped when the area is popped
+ */
+void CNavPathSearch::UpdateOnOpenList( CNavArea *area )
+{
+	Node &node = GetNode( area );
+	if ( node.isOpen )
+	{
+		PushOpen( &node - m_nodes.Base(), node.totalCost );
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavPathSearch::RemoveFromOpenList( CNavArea *area )
+{
+	GetNode( area ).isOpen = false;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+bool CNavPathSearch::IsOpenListEmpty( void )
+{
+	// drop entries of areas that have left the open list or been pushed again since
+	while ( m_openList.Count() )
+	{
+		const OpenEntry &entry = m_openList.ElementAtHead();
+		const Node &node = m_nodes[ entry.node ];
+		if ( node.isOpen && node.openOrder == entry.order )
+			break;
+
+		m_openList.RemoveAtHead();
+	}
+
+	return m_openList.Count() == 0;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+CNavArea *CNavPathSearch::PopOpenList( void )
+{
+	if ( IsOpenListEmpty() )
+		return NULL;
+
+	Node &node = m_nodes[ m_openList.ElementAtHead().node ];
+	m_openList.RemoveAtHead();
+
+	node.isOpen = false;
+	return node.area;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+bool CNavPathSearch::IsClosed( const CNavArea *area ) const
+{
+	const Node *node = FindNode( area );
+	return node && node->isMarked && !node->isOpen;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavPathSearch::AddToClosedList( CNavArea *area )
+{
+	GetNode( area ).isMarked = true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+CNavPathSearchScope::CNavPathSearchScope( CNavPathSearch &search )
+{
+	m_prior = s_activeSearch;
+	s_activeSearch = &search;
+
+	if ( m_prior == NULL )
+	{
+		++CNavPathSearch::m_activeCount;
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+CNavPathSearchScope::~CNavPathSearchScope()
+{
+	s_activeSearch = m_prior;
+
+	if ( m_prior == NULL )
+	{
+		--CNavPathSearch::m_activeCount;
+	}
+}
@@ -0,0 +1,126 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose:
+//
+// $NoKeywords: $
+//
+//=============================================================================//
+// nav_pathsearch.h
+// Per-query A* search state, so several NavAreaBuildPath() searches can run at once
+
+#ifndef _NAV_PATHSEARCH_H_
+#define _NAV_PATHSEARCH_H_
+
+#include "nav.h"
+#include "tier0/threadtools.h"
+#include "tier1/utlhashtable.h"
+#include "tier1/utlpriorityqueue.h"
+
+class CNavArea;
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * The open list, parent links and costs of one A* search.
+ * Normally a search keeps this state in the CNavArea's themselves, which allows only one
+ * search at a time. While a CNavPathSearch is active on a thread (see CNavPathSearchScope),
+ * the CNavArea pathfinding accessors on that thread read and write it instead, so
+ * NavAreaBuildPath() and the cost functors it calls work unchanged on any thread.
+ */
+class CNavPathSearch
+{
+public:
+	CNavPathSearch( void );
+
+	static CNavPathSearch *GetActive( void );				// the search active on this thread, or NULL if searches use the areas' own state
+
+	void Reset( void );										// clears the open and closed lists for a new search
+
+	void SetParent( CNavArea *area, CNavArea *parent, NavTraverseType how );
+	CNavArea *GetParent( const CNavArea *area ) const;
+	NavTraverseType GetParentHow( const CNavArea *area ) const;
+
+	bool IsOpen( const CNavArea *area ) const;
+	void AddToOpenList( CNavArea *area );
+	void AddToOpenListTail( CNavArea *area );
+	void UpdateOnOpenList( CNavArea *area );
+	void RemoveFromOpenList( CNavArea *area );
+	bool IsOpenListEmpty( void );
+	CNavArea *PopOpenList( void );
+
+	bool IsClosed( const CNavArea *area ) const;
+	void AddToClosedList( CNavArea *area );
+
+	void SetTotalCost( CNavArea *area, float value )		{ GetNode( area ).totalCost = value; }
+	float GetTotalCost( const CNavArea *area ) const;
+
+	void SetCostSoFar( CNavArea *area, float value )		{ GetNode( area ).costSoFar = value; }
+	float GetCostSoFar( const CNavArea *area ) const;
+
+	void SetPathLengthSoFar( CNavArea *area, float value )	{ GetNode( area ).pathLengthSoFar = value; }
+	float GetPathLengthSoFar( const CNavArea *area ) const;
+
+private:
+	friend class CNavPathSearchScope;
+
+	static CNavPathSearch *GetThreadActive( void );
+	static CInterlockedInt m_activeCount;					// number of threads with an active search
+
+	struct Node
+	{
+		CNavArea *area;
+		CNavArea *parent;
+		NavTraverseType parentHow;
+		float totalCost;
+		float costSoFar;
+		float pathLengthSoFar;
+		unsigned int openOrder;								// order of the area's latest open list entry, older ones are stale
+		bool isOpen;
+		bool isMarked;										// visited, "closed" if not also open
+	};
+
+	struct OpenEntry
+	{
+		float totalCost;
+		unsigned int order;									// keeps areas with equal cost in the order they were added
+		int node;
+	};
+	static bool OpenEntryLessFunc( const OpenEntry &lhs, const OpenEntry &rhs );
+
+	Node &GetNode( CNavArea *area );
+	const Node *FindNode( const CNavArea *area ) const;
+	void PushOpen( int node, float totalCost );
+
+	CUtlVector< Node > m_nodes;
+	CUtlHashtable< const CNavArea *, int, PointerHashFunctor, PointerEqualFunctor > m_nodeIndex;
+
+	// Updating an area's cost pushes it again, stale entries are skipped when popped
+	CUtlPriorityQueue< OpenEntry > m_openList;
+	unsigned int m_openOrder;
+};
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Makes a search the active one on the calling thread for the scope's lifetime
+ */
+class CNavPathSearchScope
+{
+public:
+	CNavPathSearchScope( CNavPathSearch &search );
+	~CNavPathSearchScope();
+
+private:
+	CNavPathSearch *m_prior;
+};
+
+
+//--------------------------------------------------------------------------------------------------------------
+inline CNavPathSearch *CNavPathSearch::GetActive( void )
+{
+	// the thread local is only read while some thread runs a search of its own
+	return ( m_activeCount > 0 ) ? GetThreadActive() : NULL;
+}
+
+
+#endif // _NAV_PATHSEARCH_H_
@@ -3196,6 +3196,58 @@ void CBasePlayer::PhysicsSimulate( void )
 {
 	VPROF_BUDGET( "CBasePlayer::PhysicsSimulate", VPROF_BUDGETGROUP_PLAYER );
 
+	// Store off true server timestamps
+	float savetime		= gpGlobals->curtime;
+	float saveframetime = gpGlobals->frametime;
+
+	// Build a list of all available commands
+	CUtlVector< CUserCmd >	vecAvailCommands;
+	int commandsToRun = PrepareSimulationCommands( vecAvailCommands );
+
+	// Now run the commands
+	if ( commandsToRun > 0 )
+	{
+		StartSimulationCommands();
+
+		float vphysicsArrivalTime = TICK_INTERVAL;
+		for ( int i = 0; i < commandsToRun; ++i )
+		{
+			PlayerRunCommand( &vecAvailCommands[ i ], MoveHelperServer() );
+			FinishSimulationCommand( vphysicsArrivalTime );
+		}
+
+		FinishSimulationCommands( commandsToRun );
+	}
+
+	// Restore the true server clock
+	// FIXME:  Should this occur after simulation of children so
+	//  that they are in the timespace of the player?
+	gpGlobals->curtime		= savetime;
+	gpGlobals->frametime	= saveframetime;	
+
+// 	// Kick the player if they haven't sent a user command in awhile in order to prevent clients
+// 	// from using packet-level manipulation to mess with gamestate.  Not sending usercommands seems
+// 	// to have all kinds of bad effects, such as stalling a bunch of Think()'s and gamestate handling.
+// 	// An example from TF: A medic stops sending commands after deploying an uber on another player.
+// 	// As a result, invuln is permanently on the heal target because the maintenance code is stalled.
+// 	if ( GetTimeSinceLastUserCommand() > player_usercommand_timeout.GetFloat() )
+// 	{
+// 		// If they have an active netchan, they're almost certainly messing with usercommands?
+// 		INetChannelInfo *pNetChanInfo = engine->GetPlayerNetInfo( entindex() );
+// 		if ( pNetChanInfo && pNetChanInfo->GetTimeSinceLastReceived() < 5.f )
+// 		{
+// 			engine->ServerCommand( UTIL_VarArgs( "kickid %d %s\n", GetUserID(), "UserCommand Timeout" ) );
+// 		}
+// 	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: First part of PhysicsSimulate, gathers the commands to run this tick.
+//			Returns how many of them to run, -1 if the player has already been
+//			simulated this tick or doesn't run commands.
+//-----------------------------------------------------------------------------
+int CBasePlayer::PrepareSimulationCommands( CUtlVector< CUserCmd > &vecAvailCommands )
+{
 	// If we've got a moveparent, we must simulate that first.
 	CBaseEntity *pMoveParent = GetMoveParent();
 	if (pMoveParent)
@@ -3206,7 +3258,7 @@ void CBasePlayer::PhysicsSimulate( void )
 	// Make sure not to simulate this guy twice per frame
 	if ( m_nSimulationTick == gpGlobals->tickcount )
 	{
-		return;
+		return -1;
 	}
 	
 	m_nSimulationTick = gpGlobals->tickcount;
@@ -3227,18 +3279,10 @@ void CBasePlayer::PhysicsSimulate( void )
 		Assert ( GetCommandContextCount() == 0 );
 		RunNullCommand();
 		RemoveAllCommandContexts();
-		return;
+		return -1;
 	}
 
-	// Store off true server timestamps
-	float savetime		= gpGlobals->curtime;
-	float saveframetime = gpGlobals->frametime;
-
 	int command_context_count = GetCommandContextCount();
-	
-
-	// Build a list of all available commands
-	CUtlVector< CUserCmd >	vecAvailCommands;
 
 	// Contexts go from oldest to newest
 	for ( int context_number = 0; context_number < command_context_count; context_number++ )
@@ -3315,8 +3359,6 @@ void CBasePlayer::PhysicsSimulate( void )
 		RemoveAllCommandContexts();
 	}
 
-	float vphysicsArrivalTime = TICK_INTERVAL;
-
 #ifdef _DEBUG
 	if ( sv_player_net_suppress_usercommands.GetBool() )
 	{
@@ -3340,70 +3382,60 @@ void CBasePlayer::PhysicsSimulate( void )
 		m_flMovementTimeForUserCmdProcessingRemaining = FLT_MAX;
 	}
 
-	// Now run the commands
-	if ( commandsToRun > 0 )
-	{
-		m_flLastUserCommandTime = savetime;
+	return commandsToRun;
+}
 
-		MoveHelperServer()->SetHost( this );
+//-----------------------------------------------------------------------------
+// Purpose: Called before running the commands PrepareSimulationCommands returned
+//-----------------------------------------------------------------------------
+void CBasePlayer::StartSimulationCommands()
+{
+	m_flLastUserCommandTime = gpGlobals->curtime;
 
-		// Suppress predicted events, etc.
-		if ( IsPredictingWeapons() )
-		{
-			IPredictionSystem::SuppressHostEvents( this );
-		}
+	MoveHelperServer()->SetHost( this );
 
-		for ( int i = 0; i < commandsToRun; ++i )
-		{
-			PlayerRunCommand( &vecAvailCommands[ i ], MoveHelperServer() );
+	// Suppress predicted events, etc.
+	if ( IsPredictingWeapons() )
+	{
+		IPredictionSystem::SuppressHostEvents( this );
+	}
+}
 
-			// Update our vphysics object.
-			if ( m_pPhysicsController )
-			{
-				VPROF( "CBasePlayer::PhysicsSimulate-UpdateVPhysicsPosition" );
-				// If simulating at 2 * TICK_INTERVAL, add an extra TICK_INTERVAL to position arrival computation
-				UpdateVPhysicsPosition( m_vNewVPhysicsPosition, m_vNewVPhysicsVelocity, vphysicsArrivalTime );
-				vphysicsArrivalTime += TICK_INTERVAL;
-			}
-		}
+//-----------------------------------------------------------------------------
+// Purpose: Called after each command has run
+//-----------------------------------------------------------------------------
+void CBasePlayer::FinishSimulationCommand( float &vphysicsArrivalTime )
+{
+	// Update our vphysics object.
+	if ( m_pPhysicsController )
+	{
+		VPROF( "CBasePlayer::PhysicsSimulate-UpdateVPhysicsPosition" );
+		// If simulating at 2 * TICK_INTERVAL, add an extra TICK_INTERVAL to position arrival computation
+		UpdateVPhysicsPosition( m_vNewVPhysicsPosition, m_vNewVPhysicsVelocity, vphysicsArrivalTime );
+		vphysicsArrivalTime += TICK_INTERVAL;
+	}
+}
 
-		// Always reset after running commands
-		IPredictionSystem::SuppressHostEvents( NULL );
+//-----------------------------------------------------------------------------
+// Purpose: Called once all the commands have run
+//-----------------------------------------------------------------------------
+void CBasePlayer::FinishSimulationCommands( int commandsToRun )
+{
+	// Always reset after running commands
+	IPredictionSystem::SuppressHostEvents( NULL );
 
-		MoveHelperServer()->SetHost( NULL );
+	MoveHelperServer()->SetHost( NULL );
 
-		// Copy in final origin from simulation
-		CPlayerSimInfo *pi = NULL;
-		if ( m_vecPlayerSimInfo.Count() > 0 )
-		{
-			pi = &m_vecPlayerSimInfo[ m_vecPlayerSimInfo.Tail() ];
-			pi->m_flTime = Plat_FloatTime();
-			pi->m_vecAbsOrigin = GetAbsOrigin();
-			pi->m_flGameSimulationTime = gpGlobals->curtime;
-			pi->m_nNumCmds = commandsToRun;
-		}
+	// Copy in final origin from simulation
+	CPlayerSimInfo *pi = NULL;
+	if ( m_vecPlayerSimInfo.Count() > 0 )
+	{
+		pi = &m_vecPlayerSimInfo[ m_vecPlayerSimInfo.Tail() ];
+		pi->m_flTime = Plat_FloatTime();
+		pi->m_vecAbsOrigin = GetAbsOrigin();
+		pi->m_flGameSimulationTime = gpGlobals->curtime;
+		pi->m_nNumCmds = commandsToRun;
 	}
-
-	// Restore the true server clock
-	// FIXME:  Should this occur after simulation of children so
-	//  that they are in the timespace of the player?
-	gpGlobals->curtime		= savetime;
-	gpGlobals->frametime	= saveframetime;	
-
-// 	// Kick the player if they haven't sent a user command in awhile in order to prevent clients
-// 	// from using packet-level manipulation to mess with gamestate.  Not sending usercommands seems
-// 	// to have all kinds of bad effects, such as stalling a bunch of Think()'s and gamestate handling.
-// 	// An example from TF: A medic stops sending commands after deploying an uber on another player.
-// 	// As a result, invuln is permanently on the heal target because the maintenance code is stalled.
-// 	if ( GetTimeSinceLastUserCommand() > player_usercommand_timeout.GetFloat() )
-// 	{
-// 		// If they have an active netchan, they're almost certainly messing with usercommands?
-// 		INetChannelInfo *pNetChanInfo = engine->GetPlayerNetInfo( entindex() );
-// 		if ( pNetChanInfo && pNetChanInfo->GetTimeSinceLastReceived() < 5.f )
-// 		{
-// 			engine->ServerCommand( UTIL_VarArgs( "kickid %d %s\n", GetUserID(), "UserCommand Timeout" ) );
-// 		}
-// 	}
 }
 
 unsigned int CBasePlayer::PhysicsSolidMaskForEntity() const
@@ -312,6 +312,12 @@ class CBasePlayer : public CBaseCombatCharacter
 	// Physics simulation (player executes it's usercmd's here)
 	virtual void			PhysicsSimulate( void );
 
+	// The stages of PhysicsSimulate, CPlayerMove::SimulatePlayers runs them for all players at once
+	int						PrepareSimulationCommands( CUtlVector< CUserCmd > &vecAvailCommands );
+	void					StartSimulationCommands();
+	void					FinishSimulationCommand( float &vphysicsArrivalTime );
+	void					FinishSimulationCommands( int commandsToRun );
+
 	// Forces processing of usercmds (e.g., even if game is paused, etc.)
 	void					ForceSimulation();
 
@@ -13,7 +13,13 @@
 #include "player_command.h"
 #include "movehelper_server.h"
 #include "iservervehicle.h"
+#include "datacache/imdlcache.h"
+#include "gamemovement.h"
+#include "ipredictionsystem.h"
 #include "tier0/vprof.h"
+#include "tier1/functors.h"
+#include "vstdlib/jobthread.h"
+#include "movevars_shared.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -23,12 +29,47 @@ extern CMoveData *g_pMoveData;	// This is a global because it is subclassed by e
 extern ConVar sv_noclipduringpause;
 
 ConVar sv_maxusrcmdprocessticks_warning( "sv_maxusrcmdprocessticks_warning", "-1", FCVAR_NONE, "Print a warning when user commands get dropped due to insufficient usrcmd ticks allocated, number of seconds to throttle, negative disabled" );
+ConVar sv_parallel_usercmds( "sv_parallel_usercmds", "0", FCVAR_NONE, "Move players in parallel while running their usercmds. Touches, sounds and other side effects of the moves are run on the main thread afterwards." );
+
+//-----------------------------------------------------------------------------
+// A player's move between the stages of CPlayerMove::SimulatePlayers
+//-----------------------------------------------------------------------------
+struct ParallelMove_t
+{
+	CBasePlayer					*m_pPlayer;
+	CGameMovement				*m_pGameMovement;
+	IMoveHelperServer			*m_pMoveHelper;
+	CUtlVector< CFunctor * >	m_DeferredCalls;
+
+	CMoveData					m_MoveData;
+	CUserCmd					m_Cmd;
+	float						m_flCurtime;
+	float						m_flFrametime;
+	Vector						m_vecStartOrigin;
+	bool						m_bQueued;
+};
 
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
 CPlayerMove::CPlayerMove( void )
 {
+	m_pQueueMovePlayer = NULL;
+	m_bParallelUnsupported = false;
+}
+
+CPlayerMove::~CPlayerMove( void )
+{
+	for ( int i = 0; i < m_ParallelMoves.Count(); i++ )
+	{
+		ParallelMove_t *pMove = m_ParallelMoves[i];
+		if ( !pMove )
+			continue;
+
+		delete pMove->m_pGameMovement;
+		DestroyDeferredMoveHelperServer( pMove->m_pMoveHelper );
+		delete pMove;
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -304,6 +345,23 @@ void CPlayerMove::RunPostThink( CBasePlayer *player )
 
 void CommentarySystem_PePlayerRunCommand( CBasePlayer *player, CUserCmd *ucmd );
 
+//-----------------------------------------------------------------------------
+// Purpose: Returns true if the move about to run from pMoveData could land fast
+//			enough for CheckFalling to apply falling damage. Whether the player
+//			survives that decides the rest of the landing, which needs the damage
+//			to be done right away on the main thread.
+//-----------------------------------------------------------------------------
+static bool CanTakeFallingDamage( CBasePlayer *player, CMoveData *pMoveData )
+{
+	float flGravity = player->GetGravity() ? player->GetGravity() : 1.0f;
+
+	// the fastest the player can be falling by the end of this move
+	float flFallSpeed = MAX( player->m_Local.m_flFallVelocity.Get(), -pMoveData->m_vecVelocity.z );
+	flFallSpeed += flGravity * GetCurrentGravity() * gpGlobals->frametime + fabs( player->GetBaseVelocity().z );
+
+	return ( flFallSpeed > PLAYER_MAX_SAFE_FALL_SPEED );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Runs movement commands for the player
 // Input  : *player - 
@@ -312,6 +370,45 @@ void CommentarySystem_PePlayerRunCommand( CBasePlayer *player, CUserCmd *ucmd );
 // Output : void CPlayerMove::RunCommand
 //-----------------------------------------------------------------------------
 void CPlayerMove::RunCommand ( CBasePlayer *player, CUserCmd *ucmd, IMoveHelper *moveHelper )
+{
+	IServerVehicle *pVehicle = NULL;
+	if ( !StartRunCommand( player, ucmd, moveHelper, pVehicle ) )
+		return;
+
+	// SimulatePlayers moves the players in parallel after each round of commands. The vehicle
+	// code, slowed down players (who scale gpGlobals->frametime) and players that may take
+	// falling damage stay on the main thread.
+	if ( player == m_pQueueMovePlayer && !pVehicle && player->GetLaggedMovementValue() == 1.0f && 
+		 !CanTakeFallingDamage( player, g_pMoveData ) )
+	{
+		ParallelMove_t *pMove = GetParallelMove( player );
+		if ( pMove )
+		{
+			QueueParallelMove( pMove, ucmd );
+			return;
+		}
+	}
+
+	// Let the game do the movement.
+	if ( !pVehicle )
+	{
+		VPROF( "g_pGameMovement->ProcessMovement()" );
+		Assert( g_pGameMovement );
+		g_pGameMovement->ProcessMovement( player, g_pMoveData );
+	}
+	else
+	{
+		VPROF( "pVehicle->ProcessMovement()" );
+		pVehicle->ProcessMovement( player, g_pMoveData );
+	}
+
+	FinishRunCommand( player, ucmd, moveHelper );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Runs the command up to the movement, returns false if it's dropped
+//-----------------------------------------------------------------------------
+bool CPlayerMove::StartRunCommand( CBasePlayer *player, CUserCmd *ucmd, IMoveHelper *moveHelper, IServerVehicle *&pVehicle )
 {
 	const float playerCurTime = player->m_nTickBase * TICK_INTERVAL; 
 	const float playerFrameTime = player->m_bGamePaused ? 0 : TICK_INTERVAL;
@@ -330,7 +427,7 @@ void CPlayerMove::RunCommand ( CBasePlayer *player, CUserCmd *ucmd, IMoveHelper
 				Warning( "sv_maxusrcmdprocessticks_warning at server tick %u: Ignored client %s usrcmd (%.6f < %.6f)!\n", gpGlobals->tickcount, player->GetPlayerName(), flTimeAllowedForProcessing, playerFrameTime );
 			}
 		}
-		return; // Don't process this command
+		return false; // Don't process this command
 	}
 
 	StartCommand( player, ucmd );
@@ -385,7 +482,7 @@ void CPlayerMove::RunCommand ( CBasePlayer *player, CUserCmd *ucmd, IMoveHelper
 		}
 	}
 
-	IServerVehicle *pVehicle = player->GetVehicle();
+	pVehicle = player->GetVehicle();
 
 	// Latch in impulse.
 	if ( ucmd->impulse )
@@ -426,19 +523,14 @@ void CPlayerMove::RunCommand ( CBasePlayer *player, CUserCmd *ucmd, IMoveHelper
 	// Setup input.
 	SetupMove( player, ucmd, moveHelper, g_pMoveData );
 
-	// Let the game do the movement.
-	if ( !pVehicle )
-	{
-		VPROF( "g_pGameMovement->ProcessMovement()" );
-		Assert( g_pGameMovement );
-		g_pGameMovement->ProcessMovement( player, g_pMoveData );
-	}
-	else
-	{
-		VPROF( "pVehicle->ProcessMovement()" );
-		pVehicle->ProcessMovement( player, g_pMoveData );
-	}
-			
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Runs the command after the movement, the results are in g_pMoveData
+//-----------------------------------------------------------------------------
+void CPlayerMove::FinishRunCommand( CBasePlayer *player, CUserCmd *ucmd, IMoveHelper *moveHelper )
+{
 	// Copy output
 	FinishMove( player, ucmd, g_pMoveData );
 
@@ -459,3 +551,285 @@ void CPlayerMove::RunCommand ( CBasePlayer *player, CUserCmd *ucmd, IMoveHelper
 		player->m_nTickBase++;
 	}
 }
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the state SimulatePlayers keeps for the player, NULL if the
+//			mod's movement can't run in parallel
+//-----------------------------------------------------------------------------
+ParallelMove_t *CPlayerMove::GetParallelMove( CBasePlayer *player )
+{
+	int iSlot = player->entindex() - 1;
+	if ( iSlot < 0 || iSlot >= MAX_PLAYERS )
+		return NULL;
+
+	if ( iSlot >= m_ParallelMoves.Count() )
+	{
+		int nOldCount = m_ParallelMoves.Count();
+		m_ParallelMoves.SetCount( iSlot + 1 );
+		for ( int i = nOldCount; i <= iSlot; i++ )
+		{
+			m_ParallelMoves[i] = NULL;
+		}
+	}
+
+	ParallelMove_t *pMove = m_ParallelMoves[iSlot];
+	if ( !pMove )
+	{
+		// Each player gets its own instance so the per player timers in it stay consistent
+		CGameMovement *pGameMovement = CreateParallelGameMovement();
+		if ( !pGameMovement )
+		{
+			m_bParallelUnsupported = true;
+			return NULL;
+		}
+
+		pMove = new ParallelMove_t;
+		pMove->m_bQueued = false;
+		pMove->m_pGameMovement = pGameMovement;
+		pMove->m_pMoveHelper = CreateDeferredMoveHelperServer( &pMove->m_DeferredCalls );
+		pMove->m_pGameMovement->SetParallelMove( pMove->m_pMoveHelper, &pMove->m_DeferredCalls );
+		m_ParallelMoves[iSlot] = pMove;
+	}
+
+	pMove->m_pPlayer = player;
+	return pMove;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Stashes a command that StartRunCommand ran up to the movement
+//-----------------------------------------------------------------------------
+void CPlayerMove::QueueParallelMove( ParallelMove_t *pMove, CUserCmd *ucmd )
+{
+	CBasePlayer *player = pMove->m_pPlayer;
+
+	// The command may live on the caller's stack
+	pMove->m_Cmd = *ucmd;
+	pMove->m_MoveData = *g_pMoveData;
+	pMove->m_flCurtime = gpGlobals->curtime;
+	pMove->m_flFrametime = gpGlobals->frametime;
+	pMove->m_vecStartOrigin = player->GetAbsOrigin();
+	pMove->m_pMoveHelper->SetHost( player );
+	pMove->m_bQueued = true;
+
+	// What PlayerMove does for serial moves, before a rough landing in the move resets the timer
+	player->UpdateStepSound( player->m_pSurfaceData, g_pMoveData->GetAbsOrigin(), g_pMoveData->m_vecVelocity );
+	Assert( !pMove->m_DeferredCalls.Count() );
+
+	// Nothing refers to the command until FinishParallelMove
+	FinishCommand( player );
+
+	m_QueuedMoves.AddToTail( pMove );
+}
+
+static int __cdecl ParallelMoveTimeSortFunc( ParallelMove_t * const *a, ParallelMove_t * const *b )
+{
+	if ( (*a)->m_flCurtime != (*b)->m_flCurtime )
+		return ( (*a)->m_flCurtime < (*b)->m_flCurtime ) ? -1 : 1;
+	if ( (*a)->m_flFrametime != (*b)->m_flFrametime )
+		return ( (*a)->m_flFrametime < (*b)->m_flFrametime ) ? -1 : 1;
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Runs the movement of the queued moves on the job threads
+//-----------------------------------------------------------------------------
+void CPlayerMove::RunParallelMoves( void )
+{
+	VPROF( "CPlayerMove::RunParallelMoves" );
+
+	for ( int i = 0; i < m_QueuedMoves.Count(); i++ )
+	{
+		CBasePlayer *player = m_QueuedMoves[i]->m_pPlayer;
+
+		// With the whole edict marked as changed, the network vars the move writes don't touch
+		// the change info shared by all edicts
+		player->NetworkStateChanged();
+
+		// Settle cached transforms the moves read from several threads
+		player->GetAbsVelocity();
+		if ( player->GetGroundEntity() )
+		{
+			player->GetGroundEntity()->GetAbsOrigin();
+			player->GetGroundEntity()->GetAbsVelocity();
+		}
+	}
+
+	// The moves read the time from gpGlobals, run the players on the same tick base together
+	m_QueuedMoves.Sort( ParallelMoveTimeSortFunc );
+
+	int iFirst = 0;
+	while ( iFirst < m_QueuedMoves.Count() )
+	{
+		int iEnd = iFirst + 1;
+		while ( iEnd < m_QueuedMoves.Count() && !ParallelMoveTimeSortFunc( &m_QueuedMoves[iFirst], &m_QueuedMoves[iEnd] ) )
+		{
+			iEnd++;
+		}
+
+		gpGlobals->curtime = m_QueuedMoves[iFirst]->m_flCurtime;
+		gpGlobals->frametime = m_QueuedMoves[iFirst]->m_flFrametime;
+		ParallelProcess( "CPlayerMove::RunParallelMoves", m_QueuedMoves.Base() + iFirst, iEnd - iFirst, this, &CPlayerMove::ProcessParallelMove );
+
+		iFirst = iEnd;
+	}
+}
+
+void CPlayerMove::ProcessParallelMove( ParallelMove_t *&pMove )
+{
+	pMove->m_pGameMovement->StartTrackPredictionErrors( pMove->m_pPlayer );
+	pMove->m_pGameMovement->ProcessMovement( pMove->m_pPlayer, &pMove->m_MoveData );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Runs the rest of a queued command on the main thread
+//-----------------------------------------------------------------------------
+void CPlayerMove::FinishParallelMove( ParallelMove_t *pMove )
+{
+	CBasePlayer *player = pMove->m_pPlayer;
+	pMove->m_bQueued = false;
+
+	// What StartCommand set up
+	player->m_pCurrentCommand = &pMove->m_Cmd;
+	CBaseEntity::SetPredictionRandomSeed( &pMove->m_Cmd );
+	CBaseEntity::SetPredictionPlayer( player );
+
+	gpGlobals->curtime = pMove->m_flCurtime;
+	gpGlobals->frametime = pMove->m_flFrametime;
+
+	// Game code teleported the player while the move ran, that wins
+	if ( player->GetAbsOrigin() != pMove->m_vecStartOrigin )
+	{
+		pMove->m_MoveData.SetAbsOrigin( player->GetAbsOrigin() );
+		pMove->m_MoveData.m_vecVelocity = player->GetAbsVelocity();
+	}
+
+	// Sounds, animation events and damage from the move
+	for ( int i = 0; i < pMove->m_DeferredCalls.Count(); i++ )
+	{
+		CFunctor *pCall = pMove->m_DeferredCalls[i];
+		(*pCall)();
+		delete pCall;
+	}
+	pMove->m_DeferredCalls.RemoveAll();
+
+	*g_pMoveData = pMove->m_MoveData;
+	FinishRunCommand( player, &pMove->m_Cmd, pMove->m_pMoveHelper );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Sets up what PhysicsSimulate sets up for the player it runs commands for
+//-----------------------------------------------------------------------------
+static void SetCommandPlayer( CBasePlayer *player )
+{
+	MoveHelperServer()->SetHost( player );
+	IPredictionSystem::SuppressHostEvents( ( player && player->IsPredictingWeapons() ) ? player : NULL );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Does CBasePlayer::PhysicsSimulate for all players. The players' commands
+//			run in rounds, the first command of every player, then the second and
+//			so on. Each round runs the commands up to the movement one player at a
+//			time, moves all players in parallel, and then runs the rest of the
+//			commands in player order.
+//-----------------------------------------------------------------------------
+bool CPlayerMove::SimulatePlayers( void )
+{
+	if ( !sv_parallel_usercmds.GetBool() || m_bParallelUnsupported )
+		return false;
+
+	VPROF( "CPlayerMove::SimulatePlayers" );
+
+	MDLCACHE_CRITICAL_SECTION();
+
+	float savetime = gpGlobals->curtime;
+	float saveframetime = gpGlobals->frametime;
+
+	CBasePlayer *pPlayers[MAX_PLAYERS];
+	CUtlVector< CUserCmd > commands[MAX_PLAYERS];
+	int nCommands[MAX_PLAYERS];
+	float flVPhysicsArrivalTime[MAX_PLAYERS];
+	float flCommandTime[MAX_PLAYERS][2];
+	int nPlayers = 0;
+	int nRounds = 0;
+
+	for ( int i = 1; i <= gpGlobals->maxClients && nPlayers < MAX_PLAYERS; i++ )
+	{
+		CBasePlayer *pPlayer = UTIL_PlayerByIndex( i );
+		if ( !pPlayer )
+			continue;
+
+		gpGlobals->curtime = savetime;
+		gpGlobals->frametime = saveframetime;
+
+		int nPlayerCommands = pPlayer->PrepareSimulationCommands( commands[nPlayers] );
+		if ( nPlayerCommands <= 0 )
+		{
+			commands[nPlayers].Purge();
+			continue;
+		}
+
+		pPlayer->StartSimulationCommands();
+
+		pPlayers[nPlayers] = pPlayer;
+		nCommands[nPlayers] = nPlayerCommands;
+		flVPhysicsArrivalTime[nPlayers] = TICK_INTERVAL;
+		nRounds = MAX( nRounds, nPlayerCommands );
+		nPlayers++;
+	}
+
+	for ( int iRound = 0; iRound < nRounds; iRound++ )
+	{
+		m_QueuedMoves.RemoveAll();
+
+		for ( int i = 0; i < nPlayers; i++ )
+		{
+			if ( iRound >= nCommands[i] )
+				continue;
+
+			SetCommandPlayer( pPlayers[i] );
+
+			m_pQueueMovePlayer = pPlayers[i];
+			pPlayers[i]->PlayerRunCommand( &commands[i][iRound], MoveHelperServer() );
+			m_pQueueMovePlayer = NULL;
+
+			flCommandTime[i][0] = gpGlobals->curtime;
+			flCommandTime[i][1] = gpGlobals->frametime;
+		}
+
+		if ( m_QueuedMoves.Count() )
+		{
+			SetCommandPlayer( NULL );
+			RunParallelMoves();
+		}
+
+		for ( int i = 0; i < nPlayers; i++ )
+		{
+			if ( iRound >= nCommands[i] )
+				continue;
+
+			SetCommandPlayer( pPlayers[i] );
+
+			ParallelMove_t *pMove = GetParallelMove( pPlayers[i] );
+			if ( pMove && pMove->m_bQueued )
+			{
+				FinishParallelMove( pMove );
+			}
+
+			gpGlobals->curtime = flCommandTime[i][0];
+			gpGlobals->frametime = flCommandTime[i][1];
+			pPlayers[i]->FinishSimulationCommand( flVPhysicsArrivalTime[i] );
+		}
+	}
+	m_QueuedMoves.RemoveAll();
+
+	for ( int i = 0; i < nPlayers; i++ )
+	{
+		gpGlobals->curtime = flCommandTime[i][0];
+		gpGlobals->frametime = flCommandTime[i][1];
+		pPlayers[i]->FinishSimulationCommands( nCommands[i] );
+	}
+
+	gpGlobals->curtime = savetime;
+	gpGlobals->frametime = saveframetime;
+	return true;
+}
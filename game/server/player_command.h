@@ -17,6 +17,9 @@
 class IMoveHelper;
 class CMoveData;
 class CBasePlayer;
+class CGameMovement;
+class IServerVehicle;
+struct ParallelMove_t;
 
 //-----------------------------------------------------------------------------
 // Purpose: Server side player movement
@@ -28,13 +31,20 @@ class CPlayerMove
 	
 	// Construction/destruction
 					CPlayerMove( void );
-	virtual			~CPlayerMove( void ) {}
+	virtual			~CPlayerMove( void );
 
 	// Public interfaces:
 	// Run a movement command from the player
 	void			RunCommand ( CBasePlayer *player, CUserCmd *ucmd, IMoveHelper *moveHelper );
 
+	// Runs the usercmds of all players, moving them in parallel when sv_parallel_usercmds
+	// is set. Returns false if it didn't, the players then simulate one at a time.
+	bool			SimulatePlayers( void );
+
 protected:
+	// Mods whose movement can run off the main thread return a new instance of it here
+	virtual CGameMovement *CreateParallelGameMovement( void ) { return NULL; }
+
 	// Prepare for running movement
 	virtual void	SetupMove( CBasePlayer *player, CUserCmd *ucmd, IMoveHelper *pHelper, CMoveData *move );
 
@@ -52,6 +62,25 @@ class CPlayerMove
 	void			RunPreThink( CBasePlayer *player );
 	void			RunThink (CBasePlayer *ent, double frametime );
 	void			RunPostThink( CBasePlayer *player );
+
+private:
+	// RunCommand up to and after the movement itself
+	bool			StartRunCommand( CBasePlayer *player, CUserCmd *ucmd, IMoveHelper *moveHelper, IServerVehicle *&pVehicle );
+	void			FinishRunCommand( CBasePlayer *player, CUserCmd *ucmd, IMoveHelper *moveHelper );
+
+	ParallelMove_t	*GetParallelMove( CBasePlayer *player );
+	void			QueueParallelMove( ParallelMove_t *pMove, CUserCmd *ucmd );
+	void			RunParallelMoves( void );
+	void			ProcessParallelMove( ParallelMove_t *&pMove );
+	void			FinishParallelMove( ParallelMove_t *pMove );
+
+	// Per player state for SimulatePlayers, indexed by entindex - 1
+	CUtlVector< ParallelMove_t * >	m_ParallelMoves;
+
+	// Moves RunCommand queued for the current round of SimulatePlayers
+	CUtlVector< ParallelMove_t * >	m_QueuedMoves;
+	CBasePlayer		*m_pQueueMovePlayer;
+	bool			m_bParallelUnsupported;
 };
 
 
@@ -10,9 +10,9 @@
 #include "igamesystem.h"
 #include "ilagcompensationmanager.h"
 #include "inetchannelinfo.h"
-#include "utllinkedlist.h"
 #include "BaseAnimatingOverlay.h"
 #include "tier0/vprof.h"
+#include "mathlib/ssemath.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -37,6 +37,9 @@ ConVar sv_showlagcompensation( "sv_showlagcompensation", "0", FCVAR_CHEAT, "Show
 
 ConVar sv_unlag_fixstuck( "sv_unlag_fixstuck", "0", FCVAR_DEVELOPMENTONLY, "Disallow backtracking a player for lag compensation if it will cause them to become stuck" );
 
+ConVar sv_unlag_cull( "sv_unlag_cull", "1", FCVAR_DEVELOPMENTONLY, "Don't lag compensate players a shot can't reach" );
+ConVar sv_unlag_cull_tolerance( "sv_unlag_cull_tolerance", "24", FCVAR_DEVELOPMENTONLY, "How far hitboxes can stick out of a player's bounding box when culling lag compensation" );
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
@@ -114,6 +117,82 @@ struct LagRecord
 	float					m_masterCycle;
 };
 
+//-----------------------------------------------------------------------------
+// Purpose: History of one player's lag records in a fixed size ring, newest first.
+//			Each field has its own array so walking times and positions doesn't
+//			pull the animation layers through the cache.
+//-----------------------------------------------------------------------------
+#define MAX_LAG_RECORDS		128		// must be a power of two, a second of history at 128 ticks/s
+
+struct LagAnimationRecord
+{
+	LayerRecord				m_layerRecords[MAX_LAYER_RECORDS];
+	int						m_masterSequence;
+	float					m_masterCycle;
+};
+
+class CLagRecordHistory
+{
+public:
+	CLagRecordHistory() : m_nHead( 0 ), m_nCount( 0 )
+	{
+	}
+
+	int		Count() const	{ return m_nCount; }
+	void	RemoveAll()		{ m_nCount = 0; }
+	void	RemoveOldest()	{ Assert( m_nCount > 0 ); m_nCount--; }
+
+	// Slot of the record i steps back from the newest one
+	int		Slot( int i ) const
+	{
+		Assert( i >= 0 && i < m_nCount );
+		return ( m_nHead - i ) & ( MAX_LAG_RECORDS - 1 );
+	}
+
+	// Returns the slot for a new newest record, overwriting the oldest one when full
+	int		AddToHead()
+	{
+		m_nHead = ( m_nHead + 1 ) & ( MAX_LAG_RECORDS - 1 );
+		m_nCount = MIN( m_nCount + 1, MAX_LAG_RECORDS );
+		return m_nHead;
+	}
+
+	// Steps back to the newest record at or before flTime, the oldest record if there is none
+	int		FindRecord( float flTime ) const
+	{
+		Assert( m_nCount > 0 );
+
+		// Simulation times only go down from the head
+		int low = 0;
+		int high = m_nCount - 1;
+		while ( low < high )
+		{
+			int mid = ( low + high ) / 2;
+			if ( m_flSimulationTime[ Slot( mid ) ] <= flTime )
+			{
+				high = mid;
+			}
+			else
+			{
+				low = mid + 1;
+			}
+		}
+		return low;
+	}
+
+	float					m_flSimulationTime[MAX_LAG_RECORDS];
+	int						m_fFlags[MAX_LAG_RECORDS];
+	Vector					m_vecOrigin[MAX_LAG_RECORDS];
+	QAngle					m_vecAngles[MAX_LAG_RECORDS];
+	Vector					m_vecMinsPreScaled[MAX_LAG_RECORDS];
+	Vector					m_vecMaxsPreScaled[MAX_LAG_RECORDS];
+	LagAnimationRecord		m_Animation[MAX_LAG_RECORDS];
+
+private:
+	int						m_nHead;
+	int						m_nCount;
+};
+
 
 //
 // Try to take the player from his current origin to vWantedPos.
@@ -191,20 +270,21 @@ class CLagCompensationManager : public CAutoGameSystemPerFrame, public ILagCompe
 	// ILagCompensationManager stuff
 
 	// Called during player movement to set up/restore after lag compensation
-	void			StartLagCompensation( CBasePlayer *player, CUserCmd *cmd );
+	void			StartLagCompensation( CBasePlayer *player, CUserCmd *cmd, const LagCompensationShot_t *pShot );
 	void			FinishLagCompensation( CBasePlayer *player );
 
 private:
 	void			BacktrackPlayer( CBasePlayer *player, float flTargetTime );
+	int				CullPlayers( const LagCompensationShot_t &shot, float flTargetTime, CBasePlayer **ppPlayers, int nPlayers );
 
 	void ClearHistory()
 	{
 		for ( int i=0; i<MAX_PLAYERS; i++ )
-			m_PlayerTrack[i].Purge();
+			m_PlayerTrack[i].RemoveAll();
 	}
 
-	// keep a list of lag records for each player
-	CUtlFixedLinkedList< LagRecord >	m_PlayerTrack[ MAX_PLAYERS ];
+	// keep a history of lag records for each player
+	CLagRecordHistory		m_PlayerTrack[ MAX_PLAYERS ];
 
 	// Scratchpad for determining what needs to be restored
 	CBitVec<MAX_PLAYERS>	m_RestorePlayer;
@@ -245,64 +325,53 @@ void CLagCompensationManager::FrameUpdatePostEntityThink()
 	{
 		CBasePlayer *pPlayer = UTIL_PlayerByIndex( i );
 
-		CUtlFixedLinkedList< LagRecord > *track = &m_PlayerTrack[i-1];
+		CLagRecordHistory *track = &m_PlayerTrack[i-1];
 
 		if ( !pPlayer )
 		{
-			if ( track->Count() > 0 )
-			{
-				track->RemoveAll();
-			}
-
+			track->RemoveAll();
 			continue;
 		}
 
-		Assert( track->Count() < 1000 ); // insanity check
-
 		// remove tail records that are too old
-		intp tailIndex = track->Tail();
-		while ( track->IsValidIndex( tailIndex ) )
+		while ( track->Count() > 0 )
 		{
-			LagRecord &tail = track->Element( tailIndex );
-
 			// if tail is within limits, stop
-			if ( tail.m_flSimulationTime >= flDeadtime )
+			if ( track->m_flSimulationTime[ track->Slot( track->Count() - 1 ) ] >= flDeadtime )
 				break;
-			
-			// remove tail, get new tail
-			track->Remove( tailIndex );
-			tailIndex = track->Tail();
+
+			track->RemoveOldest();
 		}
 
 		// check if head has same simulation time
 		if ( track->Count() > 0 )
 		{
-			LagRecord &head = track->Element( track->Head() );
-
 			// check if player changed simulation time since last time updated
-			if ( head.m_flSimulationTime >= pPlayer->GetSimulationTime() )
+			if ( track->m_flSimulationTime[ track->Slot( 0 ) ] >= pPlayer->GetSimulationTime() )
 				continue; // don't add new entry for same or older time
 		}
 
 		// add new record to player track
-		LagRecord &record = track->Element( track->AddToHead() );
+		int slot = track->AddToHead();
 
-		record.m_fFlags = 0;
+		track->m_fFlags[slot] = 0;
 		if ( pPlayer->IsAlive() )
 		{
-			record.m_fFlags |= LC_ALIVE;
+			track->m_fFlags[slot] |= LC_ALIVE;
 		}
 
-		record.m_flSimulationTime	= pPlayer->GetSimulationTime();
-		record.m_vecAngles			= pPlayer->GetLocalAngles();
-		record.m_vecOrigin			= pPlayer->GetLocalOrigin();
-		record.m_vecMinsPreScaled	= pPlayer->CollisionProp()->OBBMinsPreScaled();
-		record.m_vecMaxsPreScaled	= pPlayer->CollisionProp()->OBBMaxsPreScaled();
+		track->m_flSimulationTime[slot]	= pPlayer->GetSimulationTime();
+		track->m_vecAngles[slot]		= pPlayer->GetLocalAngles();
+		track->m_vecOrigin[slot]		= pPlayer->GetLocalOrigin();
+		track->m_vecMinsPreScaled[slot]	= pPlayer->CollisionProp()->OBBMinsPreScaled();
+		track->m_vecMaxsPreScaled[slot]	= pPlayer->CollisionProp()->OBBMaxsPreScaled();
 
+		// the slot is reused, layers the player doesn't have must not keep old values
+		LagAnimationRecord &record = track->m_Animation[slot];
 		int layerCount = pPlayer->GetNumAnimOverlays();
-		for( int layerIndex = 0; layerIndex < layerCount; ++layerIndex )
+		for( int layerIndex = 0; layerIndex < MAX_LAYER_RECORDS; ++layerIndex )
 		{
-			CAnimationLayer *currentLayer = pPlayer->GetAnimOverlay(layerIndex);
+			CAnimationLayer *currentLayer = ( layerIndex < layerCount ) ? pPlayer->GetAnimOverlay(layerIndex) : NULL;
 			if( currentLayer )
 			{
 				record.m_layerRecords[layerIndex].m_cycle = currentLayer->m_flCycle;
@@ -310,6 +379,10 @@ void CLagCompensationManager::FrameUpdatePostEntityThink()
 				record.m_layerRecords[layerIndex].m_sequence = currentLayer->m_nSequence;
 				record.m_layerRecords[layerIndex].m_weight = currentLayer->m_flWeight;
 			}
+			else
+			{
+				record.m_layerRecords[layerIndex] = LayerRecord();
+			}
 		}
 		record.m_masterSequence = pPlayer->GetSequence();
 		record.m_masterCycle = pPlayer->GetCycle();
@@ -320,7 +393,7 @@ void CLagCompensationManager::FrameUpdatePostEntityThink()
 }
 
 // Called during player movement to set up/restore after lag compensation
-void CLagCompensationManager::StartLagCompensation( CBasePlayer *player, CUserCmd *cmd )
+void CLagCompensationManager::StartLagCompensation( CBasePlayer *player, CUserCmd *cmd, const LagCompensationShot_t *pShot )
 {
 	//DONT LAG COMP AGAIN THIS FRAME IF THERES ALREADY ONE IN PROGRESS
 	//IF YOU'RE HITTING THIS THEN IT MEANS THERES A CODE BUG
@@ -385,6 +458,11 @@ void CLagCompensationManager::StartLagCompensation( CBasePlayer *player, CUserCm
 		targettick = gpGlobals->tickcount - TIME_TO_TICKS( correct );
 	}
 	
+	float flTargetTime = TICKS_TO_TIME( targettick );
+
+	CBasePlayer *pPlayers[MAX_PLAYERS];
+	int nPlayers = 0;
+
 	// Iterate all active players
 	const CBitVec<MAX_EDICTS> *pEntityTransmitBits = engine->GetEntityTransmitBitsForClient( player->entindex() - 1 );
 	for ( int i = 1; i <= gpGlobals->maxClients; i++ )
@@ -406,11 +484,128 @@ void CLagCompensationManager::StartLagCompensation( CBasePlayer *player, CUserCm
 		if ( !player->WantsLagCompensationOnEntity( pPlayer, cmd, pEntityTransmitBits ) )
 			continue;
 
+		pPlayers[nPlayers++] = pPlayer;
+	}
+
+	// Players the shot can't hit don't need to be moved
+	if ( pShot && sv_unlag_cull.GetBool() )
+	{
+		nPlayers = CullPlayers( *pShot, flTargetTime, pPlayers, nPlayers );
+	}
+
+	for ( int i = 0; i < nPlayers; i++ )
+	{
 		// Move other player back in time
-		BacktrackPlayer( pPlayer, TICKS_TO_TIME( targettick ) );
+		BacktrackPlayer( pPlayers[i], flTargetTime );
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Removes the players a shot can't reach from the list, wherever lag
+//			compensation would put them. A player is bounded by a sphere around
+//			the box it sweeps from its current position to the two records around
+//			the target time, then four spheres at a time are tested against the
+//			shot's cone. Returns the number of players left.
+//-----------------------------------------------------------------------------
+static inline void AddRecordBounds( const CLagRecordHistory &track, int slot, float flScale, Vector &mins, Vector &maxs )
+{
+	VectorMin( mins, track.m_vecOrigin[slot] + track.m_vecMinsPreScaled[slot] * flScale, mins );
+	VectorMax( maxs, track.m_vecOrigin[slot] + track.m_vecMaxsPreScaled[slot] * flScale, maxs );
+}
+
+int CLagCompensationManager::CullPlayers( const LagCompensationShot_t &shot, float flTargetTime, CBasePlayer **ppPlayers, int nPlayers )
+{
+	VPROF_BUDGET( "CullPlayers", "CLagCompensationManager" );
+
+	// Padded to a multiple of four
+	ALIGN16 float centerX[MAX_PLAYERS + 3] ALIGN16_POST;
+	ALIGN16 float centerY[MAX_PLAYERS + 3] ALIGN16_POST;
+	ALIGN16 float centerZ[MAX_PLAYERS + 3] ALIGN16_POST;
+	ALIGN16 float radius[MAX_PLAYERS + 3] ALIGN16_POST;
+
+	float flTolerance = sv_unlag_cull_tolerance.GetFloat();
+
+	for ( int i = 0; i < nPlayers; i++ )
+	{
+		CBasePlayer *pPlayer = ppPlayers[i];
+
+		Vector mins, maxs;
+		pPlayer->CollisionProp()->WorldSpaceAABB( &mins, &maxs );
+
+		const CLagRecordHistory &track = m_PlayerTrack[ pPlayer->entindex() - 1 ];
+		if ( track.Count() > 0 )
+		{
+			// BacktrackPlayer interpolates between this record and the next newer one
+			int iRecord = track.FindRecord( flTargetTime );
+			AddRecordBounds( track, track.Slot( iRecord ), pPlayer->GetModelScale(), mins, maxs );
+			if ( iRecord > 0 )
+			{
+				AddRecordBounds( track, track.Slot( iRecord - 1 ), pPlayer->GetModelScale(), mins, maxs );
+			}
+		}
+
+		Vector center = ( mins + maxs ) * 0.5f;
+		centerX[i] = center.x;
+		centerY[i] = center.y;
+		centerZ[i] = center.z;
+		radius[i] = ( maxs - mins ).Length() * 0.5f + flTolerance;
+	}
+
+	// Padding sits behind the shooter, so it's always rejected
+	for ( int i = nPlayers; i < ( ( nPlayers + 3 ) & ~3 ); i++ )
+	{
+		centerX[i] = shot.m_vecSrc.x - shot.m_vecDirection.x;
+		centerY[i] = shot.m_vecSrc.y - shot.m_vecDirection.y;
+		centerZ[i] = shot.m_vecSrc.z - shot.m_vecDirection.z;
+		radius[i] = 0.0f;
+	}
+
+	// The cone's surface leans out from its axis by the spread angle
+	float flCos = 1.0f / sqrtf( 1.0f + shot.m_flSpread * shot.m_flSpread );
+	float flSin = shot.m_flSpread * flCos;
+
+	fltx4 srcX = ReplicateX4( shot.m_vecSrc.x );
+	fltx4 srcY = ReplicateX4( shot.m_vecSrc.y );
+	fltx4 srcZ = ReplicateX4( shot.m_vecSrc.z );
+	fltx4 dirX = ReplicateX4( shot.m_vecDirection.x );
+	fltx4 dirY = ReplicateX4( shot.m_vecDirection.y );
+	fltx4 dirZ = ReplicateX4( shot.m_vecDirection.z );
+	fltx4 cosAngle = ReplicateX4( flCos );
+	fltx4 sinAngle = ReplicateX4( flSin );
+	fltx4 range = ReplicateX4( shot.m_flRange );
+
+	int nKept = 0;
+	for ( int i = 0; i < nPlayers; i += 4 )
+	{
+		fltx4 dx = SubSIMD( LoadAlignedSIMD( centerX + i ), srcX );
+		fltx4 dy = SubSIMD( LoadAlignedSIMD( centerY + i ), srcY );
+		fltx4 dz = SubSIMD( LoadAlignedSIMD( centerZ + i ), srcZ );
+		fltx4 r = LoadAlignedSIMD( radius + i );
+
+		// Distance along the shot and away from it
+		fltx4 along = MaddSIMD( dx, dirX, MaddSIMD( dy, dirY, MulSIMD( dz, dirZ ) ) );
+		fltx4 distSqr = MaddSIMD( dx, dx, MaddSIMD( dy, dy, MulSIMD( dz, dz ) ) );
+		fltx4 away = SqrtSIMD( MaxSIMD( Four_Zeros, MsubSIMD( along, along, distSqr ) ) );
+
+		// Rejected if behind the shooter, out of range, or further than the radius outside
+		// the plane that touches the cone along the side facing the sphere
+		fltx4 behind = CmpGtSIMD( NegSIMD( along ), r );
+		fltx4 beyond = CmpGtSIMD( SubSIMD( along, r ), range );
+		fltx4 outside = CmpGtSIMD( MsubSIMD( along, sinAngle, MulSIMD( away, cosAngle ) ), r );
+		int rejected = TestSignSIMD( OrSIMD( behind, OrSIMD( beyond, outside ) ) );
+
+		for ( int j = 0; j < 4 && i + j < nPlayers; j++ )
+		{
+			if ( !( rejected & ( 1 << j ) ) )
+			{
+				ppPlayers[nKept++] = ppPlayers[i + j];
+			}
+		}
+	}
+
+	return nKept;
+}
+
 void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTargetTime )
 {
 	Vector org;
@@ -422,35 +617,33 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 	int pl_index = pPlayer->entindex() - 1;
 
 	// get track history of this player
-	CUtlFixedLinkedList< LagRecord > *track = &m_PlayerTrack[ pl_index ];
+	const CLagRecordHistory *track = &m_PlayerTrack[ pl_index ];
 
 	// check if we have at leat one entry
 	if ( track->Count() <= 0 )
 		return;
 
-    intp curr = track->Head();
-
-	LagRecord *prevRecord = NULL;
-	LagRecord *record = NULL;
+	int prevRecord = -1;
+	int record = -1;
 
 	Vector prevOrg = pPlayer->GetLocalOrigin();
 	
 	// Walk context looking for any invalidating event
-	while( track->IsValidIndex(curr) )
+	for ( int i = 0; i < track->Count(); i++ )
 	{
 		// remember last record
 		prevRecord = record;
 
 		// get next record
-		record = &track->Element( curr );
+		record = track->Slot( i );
 
-		if ( !(record->m_fFlags & LC_ALIVE) )
+		if ( !(track->m_fFlags[record] & LC_ALIVE) )
 		{
 			// player most be alive, lost track
 			return;
 		}
 
-		Vector delta = record->m_vecOrigin - prevOrg;
+		Vector delta = track->m_vecOrigin[record] - prevOrg;
 		if ( delta.Length2DSqr() > m_flTeleportDistanceSqr )
 		{
 			// lost track, too much difference
@@ -458,57 +651,44 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 		}
 
 		// did we find a context smaller than target time ?
-		if ( record->m_flSimulationTime <= flTargetTime )
+		if ( track->m_flSimulationTime[record] <= flTargetTime )
 			break; // hurra, stop
 
-		prevOrg = record->m_vecOrigin;
-
-		// go one step back
-		curr = track->Next( curr );
+		prevOrg = track->m_vecOrigin[record];
 	}
 
-	Assert( record );
-
-	if ( !record )
-	{
-		if ( sv_unlag_debug.GetBool() )
-		{
-			DevMsg( "No valid positions in history for BacktrackPlayer client ( %s )\n", pPlayer->GetPlayerName() );
-		}
-
-		return; // that should never happen
-	}
+	Assert( record >= 0 );
 
 	float frac = 0.0f;
-	if ( prevRecord && 
-		 (record->m_flSimulationTime < flTargetTime) &&
-		 (record->m_flSimulationTime < prevRecord->m_flSimulationTime) )
+	if ( prevRecord >= 0 && 
+		 (track->m_flSimulationTime[record] < flTargetTime) &&
+		 (track->m_flSimulationTime[record] < track->m_flSimulationTime[prevRecord]) )
 	{
 		// we didn't find the exact time but have a valid previous record
 		// so interpolate between these two records;
 
-		Assert( prevRecord->m_flSimulationTime > record->m_flSimulationTime );
-		Assert( flTargetTime < prevRecord->m_flSimulationTime );
+		Assert( track->m_flSimulationTime[prevRecord] > track->m_flSimulationTime[record] );
+		Assert( flTargetTime < track->m_flSimulationTime[prevRecord] );
 
 		// calc fraction between both records
-		frac = ( flTargetTime - record->m_flSimulationTime ) / 
-			( prevRecord->m_flSimulationTime - record->m_flSimulationTime );
+		frac = ( flTargetTime - track->m_flSimulationTime[record] ) / 
+			( track->m_flSimulationTime[prevRecord] - track->m_flSimulationTime[record] );
 
 		Assert( frac > 0 && frac < 1 ); // should never extrapolate
 
-		ang				= Lerp( frac, record->m_vecAngles, prevRecord->m_vecAngles );
-		org				= Lerp( frac, record->m_vecOrigin, prevRecord->m_vecOrigin );
-		minsPreScaled	= Lerp( frac, record->m_vecMinsPreScaled, prevRecord->m_vecMinsPreScaled );
-		maxsPreScaled	= Lerp( frac, record->m_vecMaxsPreScaled, prevRecord->m_vecMaxsPreScaled );
+		ang				= Lerp( frac, track->m_vecAngles[record], track->m_vecAngles[prevRecord] );
+		org				= Lerp( frac, track->m_vecOrigin[record], track->m_vecOrigin[prevRecord] );
+		minsPreScaled	= Lerp( frac, track->m_vecMinsPreScaled[record], track->m_vecMinsPreScaled[prevRecord] );
+		maxsPreScaled	= Lerp( frac, track->m_vecMaxsPreScaled[record], track->m_vecMaxsPreScaled[prevRecord] );
 	}
 	else
 	{
 		// we found the exact record or no other record to interpolate with
 		// just copy these values since they are the best we have
-		org				= record->m_vecOrigin;
-		ang				= record->m_vecAngles;
-		minsPreScaled	= record->m_vecMinsPreScaled;
-		maxsPreScaled	= record->m_vecMaxsPreScaled;
+		org				= track->m_vecOrigin[record];
+		ang				= track->m_vecAngles[record];
+		minsPreScaled	= track->m_vecMinsPreScaled[record];
+		maxsPreScaled	= track->m_vecMaxsPreScaled[record];
 	}
 
 	// See if this is still a valid position for us to teleport to
@@ -619,8 +799,11 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 	restore->m_masterSequence = pPlayer->GetSequence();
 	restore->m_masterCycle = pPlayer->GetCycle();
 
+	const LagAnimationRecord *recordAnim = &track->m_Animation[record];
+	const LagAnimationRecord *prevRecordAnim = ( prevRecord >= 0 ) ? &track->m_Animation[prevRecord] : NULL;
+
 	bool interpolationAllowed = false;
-	if( prevRecord && (record->m_masterSequence == prevRecord->m_masterSequence) )
+	if( prevRecordAnim && (recordAnim->m_masterSequence == prevRecordAnim->m_masterSequence) )
 	{
 		// If the master state changes, all layers will be invalid too, so don't interp (ya know, interp barely ever happens anyway)
 		interpolationAllowed = true;
@@ -632,25 +815,25 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 	if( frac > 0.0f && interpolationAllowed )
 	{
 		interpolatedMasters = true;
-		pPlayer->SetSequence( Lerp( frac, record->m_masterSequence, prevRecord->m_masterSequence ) );
-		pPlayer->SetCycle( Lerp( frac, record->m_masterCycle, prevRecord->m_masterCycle ) );
+		pPlayer->SetSequence( Lerp( frac, recordAnim->m_masterSequence, prevRecordAnim->m_masterSequence ) );
+		pPlayer->SetCycle( Lerp( frac, recordAnim->m_masterCycle, prevRecordAnim->m_masterCycle ) );
 
-		if( record->m_masterCycle > prevRecord->m_masterCycle )
+		if( recordAnim->m_masterCycle > prevRecordAnim->m_masterCycle )
 		{
 			// the older record is higher in frame than the newer, it must have wrapped around from 1 back to 0
 			// add one to the newer so it is lerping from .9 to 1.1 instead of .9 to .1, for example.
-			float newCycle = Lerp( frac, record->m_masterCycle, prevRecord->m_masterCycle + 1 );
+			float newCycle = Lerp( frac, recordAnim->m_masterCycle, prevRecordAnim->m_masterCycle + 1 );
 			pPlayer->SetCycle(newCycle < 1 ? newCycle : newCycle - 1 );// and make sure .9 to 1.2 does not end up 1.05
 		}
 		else
 		{
-			pPlayer->SetCycle( Lerp( frac, record->m_masterCycle, prevRecord->m_masterCycle ) );
+			pPlayer->SetCycle( Lerp( frac, recordAnim->m_masterCycle, prevRecordAnim->m_masterCycle ) );
 		}
 	}
 	if( !interpolatedMasters )
 	{
-		pPlayer->SetSequence(record->m_masterSequence);
-		pPlayer->SetCycle(record->m_masterCycle);
+		pPlayer->SetSequence(recordAnim->m_masterSequence);
+		pPlayer->SetCycle(recordAnim->m_masterCycle);
 	}
 
 	////////////////////////
@@ -669,8 +852,8 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 			bool interpolated = false;
 			if( (frac > 0.0f)  &&  interpolationAllowed )
 			{
-				LayerRecord &recordsLayerRecord = record->m_layerRecords[layerIndex];
-				LayerRecord &prevRecordsLayerRecord = prevRecord->m_layerRecords[layerIndex];
+				const LayerRecord &recordsLayerRecord = recordAnim->m_layerRecords[layerIndex];
+				const LayerRecord &prevRecordsLayerRecord = prevRecordAnim->m_layerRecords[layerIndex];
 				if( (recordsLayerRecord.m_order == prevRecordsLayerRecord.m_order)
 					&& (recordsLayerRecord.m_sequence == prevRecordsLayerRecord.m_sequence)
 					)
@@ -696,10 +879,10 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 			if( !interpolated )
 			{
 				//Either no interp, or interp failed.  Just use record.
-				currentLayer->m_flCycle = record->m_layerRecords[layerIndex].m_cycle;
-				currentLayer->m_nOrder = record->m_layerRecords[layerIndex].m_order;
-				currentLayer->m_nSequence = record->m_layerRecords[layerIndex].m_sequence;
-				currentLayer->m_flWeight = record->m_layerRecords[layerIndex].m_weight;
+				currentLayer->m_flCycle = recordAnim->m_layerRecords[layerIndex].m_cycle;
+				currentLayer->m_nOrder = recordAnim->m_layerRecords[layerIndex].m_order;
+				currentLayer->m_nSequence = recordAnim->m_layerRecords[layerIndex].m_sequence;
+				currentLayer->m_flWeight = recordAnim->m_layerRecords[layerIndex].m_weight;
 			}
 		}
 	}
@@ -11,6 +11,7 @@
 #include "in_buttons.h"
 #include "movevars_shared.h"
 #include "weapon_csbase.h"
+#include "tier1/functors.h"
 
 #ifdef CLIENT_DLL
 	#include "c_cs_player.h"
@@ -107,12 +108,35 @@ bool CheckForStandable( IHandleEntity *pHandleEntity, int contentsMask )
 }
 
 
+#ifndef CLIENT_DLL
+static void FirePlayerJumpEvent( int userid )
+{
+	IGameEvent * event = gameeventmanager->CreateEvent( "player_jump" );
+	if ( event )
+	{
+		event->SetInt( "userid", userid );
+		gameeventmanager->FireEvent( event );
+	}
+}
+#endif
+
+
 // Expose our interface.
 static CCSGameMovement g_GameMovement;
 IGameMovement *g_pGameMovement = ( IGameMovement * )&g_GameMovement;
 
 EXPOSE_SINGLE_INTERFACE_GLOBALVAR(CGameMovement, IGameMovement,INTERFACENAME_GAMEMOVEMENT, g_GameMovement );
 
+#ifndef CLIENT_DLL
+//-----------------------------------------------------------------------------
+// Purpose: Extra instances for CPlayerMove to run players' moves in parallel
+//-----------------------------------------------------------------------------
+CGameMovement *CreateCSGameMovement()
+{
+	return new CCSGameMovement;
+}
+#endif
+
 
 // ---------------------------------------------------------------------------------------- //
 // CCSGameMovement.
@@ -571,8 +595,7 @@ void CCSGameMovement::CheckForLadders( bool wasOnGround )
 		{
 			if ( m_pCSPlayer->CanGrabLadder( trace.endpos, trace.plane.normal ) )
 			{
-				player->SetMoveType( MOVETYPE_LADDER );
-				player->SetMoveCollide( MOVECOLLIDE_DEFAULT );
+				SetPlayerMoveType( MOVETYPE_LADDER );
 
 				player->SetLadderNormal( trace.plane.normal );
 				mv->m_vecVelocity.Init();
@@ -705,10 +728,17 @@ bool CCSGameMovement::CheckJumpButton( void )
 	// In the air now.
 	SetGroundEntity( NULL );
 	
-	m_pCSPlayer->PlayStepSound( (Vector &)mv->GetAbsOrigin(), player->m_pSurfaceData, 1.0, true );
+	PlayerStepSound( 1.0f );
 	
 	//MoveHelper()->PlayerSetAnimation( PLAYER_JUMP );
-	m_pCSPlayer->DoAnimationEvent( PLAYERANIMEVENT_JUMP );
+	if ( IsParallelMove() )
+	{
+		DeferCall( CreateFunctor( m_pCSPlayer, &CCSPlayer::DoAnimationEvent, PLAYERANIMEVENT_JUMP, 0 ) );
+	}
+	else
+	{
+		m_pCSPlayer->DoAnimationEvent( PLAYERANIMEVENT_JUMP );
+	}
 
 	float flGroundFactor = 1.0f;
 	if (player->m_pSurfaceData)
@@ -762,11 +792,13 @@ bool CCSGameMovement::CheckJumpButton( void )
 
 #ifndef CLIENT_DLL
 	// allow bots to react
-	IGameEvent * event = gameeventmanager->CreateEvent( "player_jump" );
-	if ( event )
+	if ( IsParallelMove() )
 	{
-		event->SetInt( "userid", m_pCSPlayer->GetUserID() );
-		gameeventmanager->FireEvent( event );
+		DeferCall( CreateFunctor( &FirePlayerJumpEvent, m_pCSPlayer->GetUserID() ) );
+	}
+	else
+	{
+		FirePlayerJumpEvent( m_pCSPlayer->GetUserID() );
 	}
 #endif
 
@@ -1121,11 +1153,24 @@ void CCSGameMovement::Duck( void )
 
 void CCSGameMovement::OnJump( float fImpulse )
 {
+	// These change the active weapon
+	if ( IsParallelMove() )
+	{
+		DeferCall( CreateFunctor( m_pCSPlayer, &CCSPlayer::OnJump, fImpulse ) );
+		return;
+	}
+
 	m_pCSPlayer->OnJump( fImpulse );
 }	
 
 void CCSGameMovement::OnLand( float fVelocity )
 {
+	if ( IsParallelMove() )
+	{
+		DeferCall( CreateFunctor( m_pCSPlayer, &CCSPlayer::OnLand, fVelocity ) );
+		return;
+	}
+
 	m_pCSPlayer->OnLand( fVelocity );
 }
 
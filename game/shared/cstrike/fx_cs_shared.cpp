@@ -259,8 +259,11 @@ void FX_FireBullets(
 #endif
 
 #if !defined (CLIENT_DLL)
-	// Move other players back to history positions based on local player's lag
-	lagcompensation->StartLagCompensation( pPlayer, pPlayer->GetCurrentCommand() );
+	// Move other players the bullets can reach back to history positions based on local player's lag
+	Vector vecForward;
+	AngleVectors( vAngles, &vecForward );
+	LagCompensationShot_t shot( vOrigin, vecForward, fInaccuracy + fSpread, flRange );
+	lagcompensation->StartLagCompensation( pPlayer, pPlayer->GetCurrentCommand(), &shot );
 #endif
 
 	RandomSeed( iSeed );	// init random system with this seed
@@ -14,6 +14,7 @@
 #include "decals.h"
 #include "coordsize.h"
 #include "rumble_shared.h"
+#include "tier1/functors.h"
 
 #if defined(HL2_DLL) || defined(HL2_CLIENT_DLL)
 	#include "hl_movedata.h"
@@ -625,6 +626,9 @@ CGameMovement::CGameMovement( void )
 	mv					= NULL;
 
 	memset( m_flStuckCheckTime, 0, sizeof(m_flStuckCheckTime) );
+
+	m_pMoveHelper		= NULL;
+	m_pDeferredCalls	= NULL;
 }
 
 //-----------------------------------------------------------------------------
@@ -634,6 +638,75 @@ CGameMovement::~CGameMovement( void )
 {
 }
 
+//-----------------------------------------------------------------------------
+// Serializes the parts of parallel moves that change entities other moves can see
+//-----------------------------------------------------------------------------
+static CThreadFastMutex s_ParallelMoveMutex;
+
+class CParallelMoveLock
+{
+public:
+	CParallelMoveLock( bool bLock ) : m_bLocked( bLock )
+	{
+		if ( m_bLocked )
+			s_ParallelMoveMutex.Lock();
+	}
+
+	~CParallelMoveLock()
+	{
+		if ( m_bLocked )
+			s_ParallelMoveMutex.Unlock();
+	}
+
+private:
+	bool	m_bLocked;
+};
+
+void CreateStuckTable( void );
+
+//-----------------------------------------------------------------------------
+// Purpose: Sets this instance up to run moves off the main thread
+//-----------------------------------------------------------------------------
+void CGameMovement::SetParallelMove( IMoveHelper *pMoveHelper, CUtlVector< CFunctor * > *pDeferredCalls )
+{
+	m_pMoveHelper = pMoveHelper;
+	m_pDeferredCalls = pDeferredCalls;
+
+	// CheckStuck builds this on first use
+	CreateStuckTable();
+}
+
+static void PlayDeferredStepSound( CBasePlayer *pPlayer, Vector vecOrigin, surfacedata_t *psurface, float fvol )
+{
+	pPlayer->PlayStepSound( vecOrigin, psurface, fvol, true );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Plays the step sound for the surface the player is on
+//-----------------------------------------------------------------------------
+void CGameMovement::PlayerStepSound( float fvol )
+{
+	if ( IsParallelMove() )
+	{
+		DeferCall( CreateFunctor( &PlayDeferredStepSound, player, mv->GetAbsOrigin(), player->m_pSurfaceData, fvol ) );
+		return;
+	}
+
+	player->PlayStepSound( (Vector &)mv->GetAbsOrigin(), player->m_pSurfaceData, fvol, true );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Changing the move type updates the collision rules and simulation
+//			lists, parallel moves take turns
+//-----------------------------------------------------------------------------
+void CGameMovement::SetPlayerMoveType( MoveType_t moveType )
+{
+	CParallelMoveLock lock( IsParallelMove() );
+
+	player->SetMoveType( moveType );
+	player->SetMoveCollide( MOVECOLLIDE_DEFAULT );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Allow bots etc to use slightly different solid masks
 //-----------------------------------------------------------------------------
@@ -1138,7 +1211,11 @@ void CGameMovement::ProcessMovement( CBasePlayer *pPlayer, CMoveData *pMove )
 
 	//!!HACK HACK: Adrian - slow down all player movement by this factor.
 	//!!Blame Yahn for this one.
-	gpGlobals->frametime *= pPlayer->GetLaggedMovementValue();
+	// Parallel moves share gpGlobals, they're only run for players that aren't slowed down
+	if ( !IsParallelMove() )
+	{
+		gpGlobals->frametime *= pPlayer->GetLaggedMovementValue();
+	}
 
 	ResetGetPointContentsCache();
 
@@ -1168,7 +1245,10 @@ void CGameMovement::ProcessMovement( CBasePlayer *pPlayer, CMoveData *pMove )
 	// CheckV( player->CurrentCommandNumber(), "EndPos", mv->GetAbsOrigin() );
 
 	//This is probably not needed, but just in case.
-	gpGlobals->frametime = flStoreFrametime;
+	if ( !IsParallelMove() )
+	{
+		gpGlobals->frametime = flStoreFrametime;
+	}
 
 // 	player = NULL;
 }
@@ -2135,7 +2215,14 @@ void CGameMovement::FullWalkMove( )
 	{
 		PlaySwimSound();
 #if !defined( CLIENT_DLL )
-		player->Splash();
+		if ( IsParallelMove() )
+		{
+			DeferCall( CreateFunctor( player, &CBasePlayer::Splash ) );
+		}
+		else
+		{
+			player->Splash();
+		}
 #endif
 	}
 }
@@ -2419,7 +2506,7 @@ bool CGameMovement::CheckJumpButton( void )
 	// In the air now.
     SetGroundEntity( NULL );
 	
-	player->PlayStepSound( (Vector &)mv->GetAbsOrigin(), player->m_pSurfaceData, 1.0, true );
+	PlayerStepSound( 1.0f );
 	
 	MoveHelper()->PlayerSetAnimation( PLAYER_JUMP );
 
@@ -2895,8 +2982,7 @@ bool CGameMovement::LadderMove( void )
 	if ( pm.fraction == 1.0f || !OnLadder( pm ) )
 		return false;
 
-	player->SetMoveType( MOVETYPE_LADDER );
-	player->SetMoveCollide( MOVECOLLIDE_DEFAULT );
+	SetPlayerMoveType( MOVETYPE_LADDER );
 
 	player->m_vecLadderNormal = pm.plane.normal;
 
@@ -2933,8 +3019,7 @@ bool CGameMovement::LadderMove( void )
 
 	if ( mv->m_nButtons & IN_JUMP )
 	{
-		player->SetMoveType( MOVETYPE_WALK );
-		player->SetMoveCollide( MOVECOLLIDE_DEFAULT );
+		SetPlayerMoveType( MOVETYPE_WALK );
 
 		VectorScale( pm.plane.normal, 270, mv->m_vecVelocity );
 	}
@@ -3590,6 +3675,9 @@ bool CGameMovement::CheckWater( void )
 
 void CGameMovement::SetGroundEntity( trace_t *pm )
 {
+	// Reads the ground entities and changes their ground lists, which parallel moves share
+	CParallelMoveLock lock( IsParallelMove() );
+
 	CBaseEntity *newGround = pm ? pm->m_pEnt : NULL;
 
 	CBaseEntity *oldGround = player->GetGroundEntity();
@@ -3973,7 +4061,7 @@ void CGameMovement::PlayerRoughLandingEffects( float fvol )
 		player->m_flStepSoundTime = 400;
 
 		// Play step sound for current texture.
-		player->PlayStepSound( (Vector &)mv->GetAbsOrigin(), player->m_pSurfaceData, fvol, true );
+		PlayerStepSound( fvol );
 
 		//
 		// Knock the screen around a little bit, temporary effect.
@@ -3986,7 +4074,15 @@ void CGameMovement::PlayerRoughLandingEffects( float fvol )
 		}
 
 #if !defined( CLIENT_DLL )
-		player->RumbleEffect( ( fvol > 0.85f ) ? ( RUMBLE_FALL_LONG ) : ( RUMBLE_FALL_SHORT ), 0, RUMBLE_FLAGS_NONE );
+		unsigned char rumbleEffect = ( fvol > 0.85f ) ? ( RUMBLE_FALL_LONG ) : ( RUMBLE_FALL_SHORT );
+		if ( IsParallelMove() )
+		{
+			DeferCall( CreateFunctor( player, &CBasePlayer::RumbleEffect, rumbleEffect, (unsigned char)0, (unsigned char)RUMBLE_FLAGS_NONE ) );
+		}
+		else
+		{
+			player->RumbleEffect( rumbleEffect, 0, RUMBLE_FLAGS_NONE );
+		}
 #endif
 	}
 }
@@ -4604,7 +4700,12 @@ void CGameMovement::PlayerMove( void )
 
 	m_nOnLadder = 0;
 
-	player->UpdateStepSound( player->m_pSurfaceData, mv->GetAbsOrigin(), mv->m_vecVelocity );
+	// Parallel moves had this run on the main thread before they were queued, it has to see
+	// the step sound time as it was before the move lands
+	if ( !IsParallelMove() )
+	{
+		player->UpdateStepSound( player->m_pSurfaceData, mv->GetAbsOrigin(), mv->m_vecVelocity );
+	}
 
 	UpdateDuckJumpEyeOffset();
 	Duck();
@@ -4624,8 +4725,7 @@ void CGameMovement::PlayerMove( void )
 			{
 				// Clear ladder stuff unless player is dead or riding a train
 				// It will be reset immediately again next frame if necessary
-				player->SetMoveType( MOVETYPE_WALK );
-				player->SetMoveCollide( MOVECOLLIDE_DEFAULT );
+				SetPlayerMoveType( MOVETYPE_WALK );
 			}
 		}
 	}
@@ -35,6 +35,7 @@ enum
 struct surfacedata_t;
 
 class CBasePlayer;
+class CFunctor;
 
 class CGameMovement : public IGameMovement
 {
@@ -64,7 +65,21 @@ class CGameMovement : public IGameMovement
 	virtual unsigned int PlayerSolidMask( bool brushOnly = false );	///< returns the solid mask for the given player, so bots can have a more-restrictive set
 	CBasePlayer		*player;
 	CMoveData *GetMoveData() { return mv; }
+
+	// Makes this instance run moves off the main thread (see CPlayerMove::SimulatePlayers).
+	// Touches go to pMoveHelper, calls that affect other entities are queued to pDeferredCalls.
+	void			SetParallelMove( IMoveHelper *pMoveHelper, CUtlVector< CFunctor * > *pDeferredCalls );
+
 protected:
+	bool			IsParallelMove() const { return m_pDeferredCalls != NULL; }
+	void			DeferCall( CFunctor *pFunctor ) { m_pDeferredCalls->AddToTail( pFunctor ); }
+
+	// Parallel moves have their own move helper
+	IMoveHelper		*MoveHelper() const { return m_pMoveHelper ? m_pMoveHelper : ::MoveHelper(); }
+
+	void			SetPlayerMoveType( MoveType_t moveType );
+	void			PlayerStepSound( float fvol );
+
 	// Input/Output for this movement
 	CMoveData		*mv;
 	
@@ -278,6 +293,9 @@ class CGameMovement : public IGameMovement
 
 	float			m_flStuckCheckTime[MAX_PLAYERS+1][2]; // Last time we did a full test
 
+	IMoveHelper		*m_pMoveHelper;
+	CUtlVector< CFunctor * > *m_pDeferredCalls;
+
 	// special function for teleport-with-duck for episodic
 #ifdef HL2_EPISODIC
 public:
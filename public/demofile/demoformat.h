@@ -15,8 +15,20 @@
 #include "tier0/platform.h"
 
 #define DEMO_HEADER_ID		"HL2DEMO"
+
+// Compressed demos start with the same header, stamped with this ID, followed by snappy
+// compressed blocks of the regular demo data. Each block is a little endian int with the
+// uncompressed size, an int with the compressed size and the compressed bytes.
+#define DEMO_HEADER_ID_COMPRESSED	"HL2DEMZ"
 #define DEMO_PROTOCOL		3
 
+// Demos can end with an index of keyframes after dem_stop. A keyframe is a full string
+// table dump and a full (non delta) packet for the tick of the packet just before it, so
+// playback can jump there without parsing anything in between. The index is an int
+// count followed by count demoindexentry_t, then the file offset of the count and this ID
+// as the last bytes of the file. All ints are little endian.
+#define DEMO_INDEX_ID		"HL2DIDX"
+
 #if !defined( MAX_OSPATH )
 #define	MAX_OSPATH		260			// max length of a filesystem pathname
 #endif
@@ -70,6 +82,13 @@ inline void ByteSwap_demoheader_t( demoheader_t &swap )
 	swap.signonlength = LittleDWord( swap.signonlength );
 }
 
+struct demoindexentry_t
+{
+	int		tick;							// Tick of the keyframe packet
+	int		offset;							// File offset of the keyframe's first command
+	int		length;							// Bytes up to the next regular command
+};
+
 #define FDEMO_NORMAL		0
 #define FDEMO_USE_ORIGIN2	(1<<0)
 #define FDEMO_USE_ANGLES2	(1<<1)
@@ -642,7 +642,8 @@ typedef IServerGameDLL IServerGameDLL008;
 //-----------------------------------------------------------------------------
 #define VENGINE_SERVER_RANDOM_INTERFACE_VERSION	"VEngineRandom001"
 
-#define INTERFACEVERSION_SERVERGAMEENTS			"ServerGameEnts001"
+#define INTERFACEVERSION_SERVERGAMEENTS_VERSION_1	"ServerGameEnts001"
+#define INTERFACEVERSION_SERVERGAMEENTS				"ServerGameEnts002"
 //-----------------------------------------------------------------------------
 // Purpose: Interface to get at server entities
 //-----------------------------------------------------------------------------
@@ -670,8 +671,17 @@ abstract_class IServerGameEnts
 	// This is also where an entity can force other entities to be transmitted if it refers to them
 	// with ehandles.
 	virtual void			CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned short *pEdictIndices, int nEdicts ) = 0;
+
+	// Lets the engine call CheckTransmit for several clients at once from the job pool. Called on the
+	// main thread with the edicts about to be checked, before any CheckTransmit call of the batch. If it
+	// returns false the engine checks one client after another as usual. FinishParallelCheckTransmit is
+	// called on the main thread once all clients of the batch are done.
+	virtual bool			PrepareParallelCheckTransmit( const unsigned short *pEdictIndices, int nEdicts ) = 0;
+	virtual void			FinishParallelCheckTransmit() = 0;
 };
 
+typedef IServerGameEnts IServerGameEnts001;
+
 #define INTERFACEVERSION_SERVERGAMECLIENTS_VERSION_3	"ServerGameClients003"
 #define INTERFACEVERSION_SERVERGAMECLIENTS				"ServerGameClients004"
 
@@ -185,6 +185,10 @@ abstract_class IEngineTrace
 
 	// Walks bsp to find the leaf containing the specified point
 	virtual int GetLeafContainingPoint( const Vector &ptTest ) = 0;
+
+	// Traces several rays with the same mask and filter, walking the world for four of them
+	// at a time. Each result is the same as TraceRay gives for that ray.
+	virtual void	TraceRays( int nRays, const Ray_t *pRays, unsigned int fMask, ITraceFilter *pTraceFilter, trace_t *pTraces ) = 0;
 };
 
 
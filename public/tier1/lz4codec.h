@@ -0,0 +1,38 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+//	LZ4 block format codec. Trades some compression ratio for very cheap encoding
+//	and decoding, meant for network payloads that are compressed every frame.
+//
+//=====================================================================================//
+
+#ifndef LZ4CODEC_H
+#define LZ4CODEC_H
+#pragma once
+
+#define LZ4_ID	uint32( BigLong( ('L'<<24)|('Z'<<16)|('4'<<8)|('B') ) )
+
+// bind the buffer for correct identification
+struct lz4_header_t
+{
+	unsigned int	id;
+	unsigned int	actualSize;	// always little endian
+};
+
+class CLZ4
+{
+public:
+	// Worst case size of the output for inputSize bytes, including the header
+	static unsigned int	GetMaxCompressedSize( unsigned int inputSize );
+
+	// Compresses into pOutput, which has *pOutputSize bytes of room. Returns false if the
+	// output doesn't fit, otherwise *pOutputSize is the compressed size including the header.
+	static bool			Compress( const unsigned char *pInput, unsigned int inputSize, unsigned char *pOutput, unsigned int *pOutputSize );
+
+	// Returns the uncompressed size or 0 if the input is corrupt or doesn't fit into pOutput.
+	static unsigned int	SafeUncompress( const unsigned char *pInput, unsigned int inputSize, unsigned char *pOutput, unsigned int unBufSize );
+
+	static bool			IsCompressed( const unsigned char *pInput );
+	static unsigned int	GetActualSize( const unsigned char *pInput );
+};
+
+#endif // LZ4CODEC_H
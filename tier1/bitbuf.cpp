@@ -13,6 +13,14 @@
 #include "tier1/strtools.h"
 #include "bitvec.h"
 
+#if VALVE_LITTLE_ENDIAN
+#if defined(__arm__) || defined(__aarch64__)
+#include "sse2neon.h"
+#else
+#include <emmintrin.h>
+#endif
+#endif
+
 // FIXME: Can't use this until we get multithreaded allocations in tier0 working for tools
 // This is used by VVIS and fails to link
 // NOTE: This must be the last file included!!!
@@ -444,79 +452,123 @@ void bf_write::WriteBitLong(unsigned int data, int numbits, bool bSigned)
 		WriteUBitLong(data, numbits);
 }
 
-bool bf_write::WriteBits(const void *pInData, int nBits)
+#if VALVE_LITTLE_ENDIAN
+
+//-----------------------------------------------------------------------------
+// Bulk bit copies. The bit stream is little endian, so once the output is
+// byte aligned a run of bits is just the input bytes shifted down by the input's
+// bit offset.
+//-----------------------------------------------------------------------------
+
+// Reads up to 32 bits starting at iBit, only touching the bytes that hold them
+static FORCEINLINE uint32 LoadBitsFromBytes( const unsigned char *pSrc, int iBit, int nBits )
 {
-#if defined( BB_PROFILING )
-	VPROF( "bf_write::WriteBits" );
-#endif
+	const unsigned char *pIn = pSrc + ( iBit >> 3 );
+	int nBytes = ( ( iBit & 7 ) + nBits + 7 ) >> 3;
 
-	unsigned char *pOut = (unsigned char*)pInData;
-	int nBitsLeft = nBits;
+	uint64 data = 0;
+	for ( int i = 0; i < nBytes; i++ )
+	{
+		data |= (uint64)pIn[i] << ( i * 8 );
+	}
 
-	// Bounds checking..
-	if ( (m_iCurBit+nBits) > m_nDataBits )
+	return (uint32)( data >> ( iBit & 7 ) ) & g_ExtraMasks[nBits];
+}
+
+// Copies nBytes * 8 bits starting at bit iSrcBit of pSrc to pDest. When the source isn't byte
+// aligned every output byte straddles two input bytes, so the loads never go past the
+// last input byte holding wanted bits.
+static void CopyShiftedBytes( unsigned char *pDest, const unsigned char *pSrc, int iSrcBit, int nBytes )
+{
+	const unsigned char *pIn = pSrc + ( iSrcBit >> 3 );
+	int nShift = iSrcBit & 7;
+
+	if ( nShift == 0 )
 	{
-		SetOverflowFlag();
-		CallErrorHandler( BITBUFERROR_BUFFER_OVERRUN, GetDebugName() );
-		return false;
+		memcpy( pDest, pIn, nBytes );
+		return;
 	}
 
-	// Align output to dword boundary
-	while (((uintp)pOut & 3) != 0 && nBitsLeft >= 8)
+	int i = 0;
+
+	// 16 bytes at a time. Each 64 bit lane is the input shifted right, with the bits
+	// shifted out at the top refilled from the same lane loaded one byte later.
+	__m128i shiftRight = _mm_cvtsi32_si128( nShift );
+	__m128i shiftLeft = _mm_cvtsi32_si128( 8 - nShift );
+	for ( ; i + 16 <= nBytes; i += 16 )
 	{
+		__m128i lo = _mm_loadu_si128( (const __m128i *)( pIn + i ) );
+		__m128i hi = _mm_loadu_si128( (const __m128i *)( pIn + i + 1 ) );
+		_mm_storeu_si128( (__m128i *)( pDest + i ), _mm_or_si128( _mm_srl_epi64( lo, shiftRight ), _mm_sll_epi64( hi, shiftLeft ) ) );
+	}
 
-		WriteUBitLong( *pOut, 8, false );
-		++pOut;
-		nBitsLeft -= 8;
+	// then through a 64 bit accumulator
+	for ( ; i + 8 <= nBytes; i += 8 )
+	{
+		uint64 data;
+		memcpy( &data, pIn + i, sizeof( data ) );
+		data = ( data >> nShift ) | ( (uint64)pIn[i + 8] << ( 64 - nShift ) );
+		memcpy( pDest + i, &data, sizeof( data ) );
 	}
-	
-	if ( IsPC() && (nBitsLeft >= 32) && (m_iCurBit & 7) == 0 )
+
+	for ( ; i < nBytes; i++ )
 	{
-		// current bit is byte aligned, do block copy
-		int numbytes = nBitsLeft >> 3; 
-		int numbits = numbytes << 3;
-		
-		Q_memcpy( (char*)m_pData+(m_iCurBit>>3), pOut, numbytes );
-		pOut += numbytes;
-		nBitsLeft -= numbits;
-		m_iCurBit += numbits;
+		pDest[i] = (unsigned char)( ( pIn[i] >> nShift ) | ( pIn[i + 1] << ( 8 - nShift ) ) );
 	}
+}
 
-	// X360TBD: Can't write dwords in WriteBits because they'll get swapped
-	if ( IsPC() && nBitsLeft >= 32 )
+// Appends nBits starting at bit iSrcBit of pSrc. The caller checks that both buffers have room.
+static void WriteBitsFromBytes( bf_write *pOut, const unsigned char *pSrc, int iSrcBit, int nBits )
+{
+	// bring the output up to a dword boundary so the bulk copy doesn't have to merge
+	// with bits already in the buffer
+	int nHeadBits = MIN( nBits, ( 32 - ( pOut->m_iCurBit & 31 ) ) & 31 );
+	if ( nHeadBits )
 	{
-		uint32 iBitsRight = (m_iCurBit & 31);
-        uint32 iBitsLeft = 32 - iBitsRight;
-        uint32 bitMaskLeft = g_BitWriteMasks[iBitsRight][32];
-        uint32 bitMaskRight = g_BitWriteMasks[0][iBitsRight];
+		pOut->WriteUBitLong( LoadBitsFromBytes( pSrc, iSrcBit, nHeadBits ), nHeadBits, false );
+		iSrcBit += nHeadBits;
+		nBits -= nHeadBits;
+	}
 
-        uint32 *pData = &m_pData[m_iCurBit>>5];
+	int nBytes = ( nBits >> 5 ) << 2;
+	if ( nBytes )
+	{
+		CopyShiftedBytes( (unsigned char *)pOut->m_pData + ( pOut->m_iCurBit >> 3 ), pSrc, iSrcBit, nBytes );
+		pOut->m_iCurBit += nBytes << 3;
+		iSrcBit += nBytes << 3;
+		nBits -= nBytes << 3;
+	}
 
-		// Read dwords.
-		while(nBitsLeft >= 32)
-		{
-            uint32 curData = *(uint32*)pOut;
-			pOut += sizeof(uint32);
+	if ( nBits )
+	{
+		pOut->WriteUBitLong( LoadBitsFromBytes( pSrc, iSrcBit, nBits ), nBits, false );
+	}
+}
 
-			*pData &= bitMaskLeft;
-			*pData |= curData << iBitsRight;
+#endif // VALVE_LITTLE_ENDIAN
 
-			pData++; 
 
-			if ( iBitsLeft < 32 )
-			{
-				curData >>= iBitsLeft;
-				*pData &= bitMaskRight;
-				*pData |= curData;
-			}
+bool bf_write::WriteBits(const void *pInData, int nBits)
+{
+#if defined( BB_PROFILING )
+	VPROF( "bf_write::WriteBits" );
+#endif
 
-			nBitsLeft -= 32;
-			m_iCurBit += 32;
-		}
-	}
+	unsigned char *pOut = (unsigned char*)pInData;
+	int nBitsLeft = nBits;
 
+	// Bounds checking..
+	if ( (m_iCurBit+nBits) > m_nDataBits )
+	{
+		SetOverflowFlag();
+		CallErrorHandler( BITBUFERROR_BUFFER_OVERRUN, GetDebugName() );
+		return false;
+	}
 
-	// write remaining bytes
+#if VALVE_LITTLE_ENDIAN
+	WriteBitsFromBytes( this, pOut, 0, nBitsLeft );
+#else
+	// write bytes
 	while ( nBitsLeft >= 8 )
 	{
 		WriteUBitLong( *pOut, 8, false );
@@ -529,6 +581,7 @@ bool bf_write::WriteBits(const void *pInData, int nBits)
 	{
 		WriteUBitLong( *pOut, nBitsLeft, false );
 	}
+#endif
 
 	return !IsOverflowed();
 }
@@ -536,7 +589,32 @@ bool bf_write::WriteBits(const void *pInData, int nBits)
 
 bool bf_write::WriteBitsFromBuffer( bf_read *pIn, int nBits )
 {
-	// This could be optimized a little by
+#if VALVE_LITTLE_ENDIAN
+	// Longer runs are copied in bulk when neither buffer would overflow. Otherwise go through
+	// the checked reads and writes below so the overflow flags get set as before.
+	if ( nBits > 32 && nBits <= GetNumBitsLeft() && nBits <= pIn->GetNumBitsLeft() )
+	{
+		int nHeadBits = ( 32 - ( m_iCurBit & 31 ) ) & 31;
+		if ( nHeadBits )
+		{
+			WriteUBitLong( pIn->ReadUBitLong( nHeadBits ), nHeadBits, false );
+			nBits -= nHeadBits;
+		}
+
+		int nBytes = ( nBits >> 5 ) << 2;
+		CopyShiftedBytes( (unsigned char *)m_pData + ( m_iCurBit >> 3 ), pIn->m_pData, pIn->m_iCurBit, nBytes );
+		m_iCurBit += nBytes << 3;
+		pIn->m_iCurBit += nBytes << 3;
+		nBits -= nBytes << 3;
+
+		if ( nBits )
+		{
+			WriteUBitLong( pIn->ReadUBitLong( nBits ), nBits, false );
+		}
+		return !IsOverflowed() && !pIn->IsOverflowed();
+	}
+#endif
+
 	while ( nBits > 32 )
 	{
 		WriteUBitLong( pIn->ReadUBitLong( 32 ), 32 );
@@ -883,6 +961,25 @@ void bf_read::ReadBits(void *pOutData, int nBits)
 	unsigned char *pOut = (unsigned char*)pOutData;
 	int nBitsLeft = nBits;
 
+#if VALVE_LITTLE_ENDIAN
+	// Copy in bulk unless this overflows, then the reads below set the overflow flag
+	// and zero fill the rest like before.
+	if ( nBitsLeft <= GetNumBitsLeft() )
+	{
+		int nBytes = nBitsLeft >> 3;
+		CopyShiftedBytes( pOut, m_pData, m_iCurBit, nBytes );
+		m_iCurBit += nBytes << 3;
+		pOut += nBytes;
+		nBitsLeft -= nBytes << 3;
+
+		if ( nBitsLeft )
+		{
+			*pOut = (unsigned char)LoadBitsFromBytes( m_pData, m_iCurBit, nBitsLeft );
+			m_iCurBit += nBitsLeft;
+		}
+		return;
+	}
+#endif
 	
 	// align output to dword boundary
 	while( ((size_t)pOut & 3) != 0 && nBitsLeft >= 8 )
@@ -0,0 +1,323 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+//	LZ4 block format codec. Trades some compression ratio for very cheap encoding
+//	and decoding, meant for network payloads that are compressed every frame.
+//
+//	Each sequence is a token byte (literal count in the high nibble, match length - 4
+//	in the low nibble, 15 meaning more length bytes follow), the literals, and a 16 bit
+//	little endian match offset. The last sequence only has literals.
+//
+//=====================================================================================//
+
+#include "tier0/platform.h"
+#include "tier0/dbg.h"
+#include "tier0/vprof.h"
+#include "tier0/threadtools.h"
+#include "tier1/lz4codec.h"
+#include <string.h>
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+#define LZ4_MINMATCH		4
+#define LZ4_LASTLITERALS	5		// the last bytes are always literals
+#define LZ4_MFLIMIT			12		// a match can't start closer than this to the end
+#define LZ4_MAX_OFFSET		65535
+#define LZ4_RUN_MASK		15
+
+// Small inputs use a small hash table so clearing it doesn't dominate, big ones a larger
+// table for a better match rate
+#define LZ4_HASH_BITS_MIN	10
+#define LZ4_HASH_BITS_MAX	14
+
+static FORCEINLINE uint32 LZ4_Read32( const unsigned char *p )
+{
+	uint32 v;
+	memcpy( &v, p, sizeof( v ) );
+	return v;
+}
+
+static FORCEINLINE uint32 LZ4_Hash( uint32 v, int nHashBits )
+{
+	return ( v * 2654435761U ) >> ( 32 - nHashBits );
+}
+
+// Too big for the stack of a job thread, so every thread that compresses keeps one. Those
+// threads live as long as the process, so it isn't freed.
+static CTHREADLOCALPTR( uint32 ) s_pHashTable;
+
+static uint32 *LZ4_GetHashTable()
+{
+	uint32 *pHashTable = s_pHashTable;
+	if ( !pHashTable )
+	{
+		pHashTable = new uint32[ 1 << LZ4_HASH_BITS_MAX ];
+		s_pHashTable = pHashTable;
+	}
+	return pHashTable;
+}
+
+static FORCEINLINE unsigned char *LZ4_WriteLength( unsigned char *pOutput, unsigned int len )
+{
+	while ( len >= 255 )
+	{
+		*pOutput++ = 255;
+		len -= 255;
+	}
+	*pOutput++ = (unsigned char)len;
+	return pOutput;
+}
+
+//-----------------------------------------------------------------------------
+// Returns true if buffer is compressed.
+//-----------------------------------------------------------------------------
+bool CLZ4::IsCompressed( const unsigned char *pInput )
+{
+	const lz4_header_t *pHeader = (const lz4_header_t *)pInput;
+	return pHeader && pHeader->id == LZ4_ID;
+}
+
+//-----------------------------------------------------------------------------
+// Returns uncompressed size of compressed input buffer. Returns 0 if input
+// buffer is not compressed.
+//-----------------------------------------------------------------------------
+unsigned int CLZ4::GetActualSize( const unsigned char *pInput )
+{
+	const lz4_header_t *pHeader = (const lz4_header_t *)pInput;
+	if ( pHeader && pHeader->id == LZ4_ID )
+	{
+		return LittleLong( pHeader->actualSize );
+	}
+
+	// unrecognized
+	return 0;
+}
+
+unsigned int CLZ4::GetMaxCompressedSize( unsigned int inputSize )
+{
+	return sizeof( lz4_header_t ) + inputSize + inputSize / 255 + 16;
+}
+
+bool CLZ4::Compress( const unsigned char *pInput, unsigned int inputSize, unsigned char *pOutput, unsigned int *pOutputSize )
+{
+	VPROF( "CLZ4::Compress" );
+
+	if ( *pOutputSize < sizeof( lz4_header_t ) + 1 )
+		return false;
+
+	int nHashBits = LZ4_HASH_BITS_MIN;
+	while ( nHashBits < LZ4_HASH_BITS_MAX && ( 1u << ( nHashBits + 2 ) ) < inputSize )
+	{
+		nHashBits++;
+	}
+
+	// input positions by hash of the 4 bytes there
+	uint32 *hashTable = LZ4_GetHashTable();
+	memset( hashTable, 0, ( 1 << nHashBits ) * sizeof( uint32 ) );
+
+	const unsigned char *ip = pInput;
+	const unsigned char *pAnchor = pInput;
+	const unsigned char *pInputEnd = pInput + inputSize;
+
+	unsigned char *op = pOutput + sizeof( lz4_header_t );
+	unsigned char *pOutputEnd = pOutput + *pOutputSize;
+
+	if ( inputSize > LZ4_MFLIMIT )
+	{
+		const unsigned char *pMatchStartLimit = pInputEnd - LZ4_MFLIMIT;
+		const unsigned char *pMatchEndLimit = pInputEnd - LZ4_LASTLITERALS;
+
+		while ( ip < pMatchStartLimit )
+		{
+			uint32 seq = LZ4_Read32( ip );
+			uint32 h = LZ4_Hash( seq, nHashBits );
+			const unsigned char *pRef = pInput + hashTable[h];
+			hashTable[h] = (uint32)( ip - pInput );
+
+			if ( pRef >= ip || ip - pRef > LZ4_MAX_OFFSET || LZ4_Read32( pRef ) != seq )
+			{
+				ip++;
+				continue;
+			}
+
+			// extend the match backwards into pending literals
+			while ( ip > pAnchor && pRef > pInput && ip[-1] == pRef[-1] )
+			{
+				ip--;
+				pRef--;
+			}
+
+			// and forwards
+			const unsigned char *pMatchEnd = ip + LZ4_MINMATCH;
+			const unsigned char *pRefEnd = pRef + LZ4_MINMATCH;
+			while ( pMatchEnd < pMatchEndLimit && *pMatchEnd == *pRefEnd )
+			{
+				pMatchEnd++;
+				pRefEnd++;
+			}
+
+			unsigned int litLen = (unsigned int)( ip - pAnchor );
+			unsigned int matchLen = (unsigned int)( pMatchEnd - ip ) - LZ4_MINMATCH;
+
+			// token, lengths, literals, offset and the final literals token must still fit
+			if ( (size_t)( pOutputEnd - op ) < 1 + litLen / 255 + 1 + litLen + 2 + matchLen / 255 + 1 + 1 )
+				return false;
+
+			unsigned char *pToken = op++;
+
+			if ( litLen >= LZ4_RUN_MASK )
+			{
+				*pToken = LZ4_RUN_MASK << 4;
+				op = LZ4_WriteLength( op, litLen - LZ4_RUN_MASK );
+			}
+			else
+			{
+				*pToken = (unsigned char)( litLen << 4 );
+			}
+
+			memcpy( op, pAnchor, litLen );
+			op += litLen;
+
+			unsigned int offset = (unsigned int)( ip - pRef );
+			*op++ = (unsigned char)( offset & 0xff );
+			*op++ = (unsigned char)( offset >> 8 );
+
+			if ( matchLen >= LZ4_RUN_MASK )
+			{
+				*pToken |= LZ4_RUN_MASK;
+				op = LZ4_WriteLength( op, matchLen - LZ4_RUN_MASK );
+			}
+			else
+			{
+				*pToken |= (unsigned char)matchLen;
+			}
+
+			ip = pMatchEnd;
+			pAnchor = ip;
+
+			// remember a position inside the match, helps with repeating data
+			if ( ip - 2 > pInput )
+			{
+				hashTable[ LZ4_Hash( LZ4_Read32( ip - 2 ), nHashBits ) ] = (uint32)( ip - 2 - pInput );
+			}
+		}
+	}
+
+	// last literals
+	unsigned int litLen = (unsigned int)( pInputEnd - pAnchor );
+	if ( (size_t)( pOutputEnd - op ) < 1 + litLen / 255 + 1 + litLen )
+		return false;
+
+	if ( litLen >= LZ4_RUN_MASK )
+	{
+		*op++ = LZ4_RUN_MASK << 4;
+		op = LZ4_WriteLength( op, litLen - LZ4_RUN_MASK );
+	}
+	else
+	{
+		*op++ = (unsigned char)( litLen << 4 );
+	}
+
+	memcpy( op, pAnchor, litLen );
+	op += litLen;
+
+	lz4_header_t *pHeader = (lz4_header_t *)pOutput;
+	pHeader->id = LZ4_ID;
+	pHeader->actualSize = LittleLong( inputSize );
+
+	*pOutputSize = (unsigned int)( op - pOutput );
+	return true;
+}
+
+unsigned int CLZ4::SafeUncompress( const unsigned char *pInput, unsigned int inputSize, unsigned char *pOutput, unsigned int unBufSize )
+{
+	VPROF( "CLZ4::SafeUncompress" );
+
+	if ( inputSize < sizeof( lz4_header_t ) || !IsCompressed( pInput ) )
+		return 0;
+
+	unsigned int actualSize = GetActualSize( pInput );
+	if ( actualSize > unBufSize )
+		return 0;
+
+	const unsigned char *ip = pInput + sizeof( lz4_header_t );
+	const unsigned char *pInputEnd = pInput + inputSize;
+	unsigned char *op = pOutput;
+	unsigned char *pOutputEnd = pOutput + actualSize;
+
+	while ( ip < pInputEnd )
+	{
+		unsigned int token = *ip++;
+
+		// literals
+		unsigned int len = token >> 4;
+		if ( len == LZ4_RUN_MASK )
+		{
+			unsigned int s;
+			do
+			{
+				if ( ip >= pInputEnd )
+					return 0;
+				s = *ip++;
+				len += s;
+			} while ( s == 255 );
+		}
+
+		if ( len > (size_t)( pInputEnd - ip ) || len > (size_t)( pOutputEnd - op ) )
+			return 0;
+
+		memcpy( op, ip, len );
+		op += len;
+		ip += len;
+
+		// the last sequence has no match
+		if ( ip >= pInputEnd )
+			break;
+
+		if ( pInputEnd - ip < 2 )
+			return 0;
+
+		unsigned int offset = ip[0] | ( ip[1] << 8 );
+		ip += 2;
+
+		if ( offset == 0 || offset > (size_t)( op - pOutput ) )
+			return 0;
+
+		len = token & LZ4_RUN_MASK;
+		if ( len == LZ4_RUN_MASK )
+		{
+			unsigned int s;
+			do
+			{
+				if ( ip >= pInputEnd )
+					return 0;
+				s = *ip++;
+				len += s;
+			} while ( s == 255 );
+		}
+		len += LZ4_MINMATCH;
+
+		if ( len > (size_t)( pOutputEnd - op ) )
+			return 0;
+
+		const unsigned char *pMatch = op - offset;
+		if ( offset >= len )
+		{
+			memcpy( op, pMatch, len );
+			op += len;
+		}
+		else
+		{
+			// overlapping copy repeats the last offset bytes
+			while ( len-- )
+			{
+				*op++ = *pMatch++;
+			}
+		}
+	}
+
+	if ( op != pOutputEnd )
+		return 0;
+
+	return actualSize;
+}
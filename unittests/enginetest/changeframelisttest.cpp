@@ -0,0 +1,215 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Unit test and benchmark for the engine's IChangeFrameList
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "unitlib/unitlib.h"
+#include "changeframelist.h"
+#include "dt_common.h"
+#include "tier1/utlvector.h"
+#include "tier0/fasttimer.h"
+#include <stdlib.h>
+
+
+DEFINE_TESTSUITE( ChangeFrameListTestSuite )
+
+//-----------------------------------------------------------------------------
+// The plain per property scan the engine used before, to check results and
+// timings against
+//-----------------------------------------------------------------------------
+class CLinearChangeFrameList
+{
+public:
+	CLinearChangeFrameList( int nProperties, int iCurTick )
+	{
+		m_ChangeTicks.SetSize( nProperties );
+		for ( int i=0; i < nProperties; i++ )
+			m_ChangeTicks[i] = iCurTick;
+	}
+
+	void SetChangeTick( const int *pPropIndices, int nPropIndices, const int iTick )
+	{
+		for ( int i=0; i < nPropIndices; i++ )
+			m_ChangeTicks[ pPropIndices[i] ] = iTick;
+	}
+
+	int GetPropsChangedAfterTick( int iTick, int *iOutProps, int nMaxOutProps )
+	{
+		int nOutProps = 0;
+		for ( int i=0; i < m_ChangeTicks.Count(); i++ )
+		{
+			if ( m_ChangeTicks[i] > iTick )
+				iOutProps[nOutProps++] = i;
+		}
+		return nOutProps;
+	}
+
+private:
+	CUtlVector<int> m_ChangeTicks;
+};
+
+
+// Changes a few random props per tick, like a typical networked entity
+static int PickChangedProps( int nProperties, int nMaxChanged, int *pProps )
+{
+	int nChanged = rand() % ( nMaxChanged + 1 );
+	for ( int i=0; i < nChanged; i++ )
+		pProps[i] = rand() % nProperties;
+	return nChanged;
+}
+
+static bool CompareProps( const int *pA, int nA, const int *pB, int nB )
+{
+	if ( nA != nB )
+		return false;
+	for ( int i=0; i < nA; i++ )
+	{
+		if ( pA[i] != pB[i] )
+			return false;
+	}
+	return true;
+}
+
+DEFINE_TESTCASE( ChangeFrameListTest, ChangeFrameListTestSuite )
+{
+	static const int s_nPropCounts[] = { 0, 1, 3, 15, 16, 17, 31, 64, 100, 255, 1000, MAX_DATATABLE_PROPS };
+
+	int changedProps[MAX_DATATABLE_PROPS];
+	int outProps[MAX_DATATABLE_PROPS];
+	int refProps[MAX_DATATABLE_PROPS];
+
+	srand( 1234 );
+
+	for ( int iCount=0; iCount < (int)ARRAYSIZE( s_nPropCounts ); iCount++ )
+	{
+		int nProperties = s_nPropCounts[iCount];
+
+		IChangeFrameList *pList = AllocChangeFrameList( nProperties, 100 );
+		CLinearChangeFrameList ref( nProperties, 100 );
+
+		Shipping_Assert( pList->GetNumProps() == nProperties );
+
+		for ( int iTick=101; iTick < 200; iTick++ )
+		{
+			if ( nProperties )
+			{
+				int nChanged = PickChangedProps( nProperties, 8, changedProps );
+				pList->SetChangeTick( changedProps, nChanged, iTick );
+				ref.SetChangeTick( changedProps, nChanged, iTick );
+			}
+
+			// every tick a client could still be acking
+			for ( int iAck=95; iAck <= iTick; iAck++ )
+			{
+				int nOut = pList->GetPropsChangedAfterTick( iAck, outProps, ARRAYSIZE( outProps ) );
+				int nRef = ref.GetPropsChangedAfterTick( iAck, refProps, ARRAYSIZE( refProps ) );
+				Shipping_Assert( CompareProps( outProps, nOut, refProps, nRef ) );
+			}
+
+			// copies must carry the same ticks, and mustn't share them with the original
+			if ( ( iTick % 10 ) == 0 )
+			{
+				IChangeFrameList *pCopy = pList->Copy();
+				pList->Release();
+				pList = pCopy;
+
+				Shipping_Assert( pList->GetNumProps() == nProperties );
+			}
+		}
+
+		pList->Release();
+	}
+
+	// released lists are recycled, make sure a recycled list is fully reinitialized
+	IChangeFrameList *pList = AllocChangeFrameList( 40, 10 );
+	int iProp = 39;
+	pList->SetChangeTick( &iProp, 1, 500 );
+	pList->Release();
+
+	pList = AllocChangeFrameList( 40, 10 );
+	Shipping_Assert( pList->GetPropsChangedAfterTick( 10, outProps, ARRAYSIZE( outProps ) ) == 0 );
+	Shipping_Assert( pList->GetPropsChangedAfterTick( 9, outProps, ARRAYSIZE( outProps ) ) == 40 );
+	pList->Release();
+}
+
+DEFINE_TESTCASE( ChangeFrameListPerformance, ChangeFrameListTestSuite )
+{
+	const int nProperties = 300;
+	const int nEntities = 512;
+	const int nTicks = 200;
+
+	int changedProps[16];
+	int outProps[MAX_DATATABLE_PROPS];
+
+	IChangeFrameList **ppLists = new IChangeFrameList*[nEntities];
+	CLinearChangeFrameList **ppRefs = new CLinearChangeFrameList*[nEntities];
+
+	for ( int i=0; i < nEntities; i++ )
+	{
+		ppLists[i] = AllocChangeFrameList( nProperties, 0 );
+		ppRefs[i] = new CLinearChangeFrameList( nProperties, 0 );
+	}
+
+	srand( 5678 );
+
+	// a few props change on some entities each tick and clients ack a few ticks back
+	CFastTimer linearTimer, groupedTimer;
+	CCycleCount linearTime, groupedTime;
+	int nLinearProps = 0, nGroupedProps = 0;
+
+	for ( int iTick=1; iTick <= nTicks; iTick++ )
+	{
+		for ( int i=0; i < nEntities; i++ )
+		{
+			if ( rand() % 4 )
+				continue;
+
+			int nChanged = PickChangedProps( nProperties, ARRAYSIZE( changedProps ), changedProps );
+			ppLists[i]->SetChangeTick( changedProps, nChanged, iTick );
+			ppRefs[i]->SetChangeTick( changedProps, nChanged, iTick );
+		}
+
+		int iAck = iTick - 1 - ( iTick % 3 );
+
+		linearTimer.Start();
+		for ( int i=0; i < nEntities; i++ )
+			nLinearProps += ppRefs[i]->GetPropsChangedAfterTick( iAck, outProps, ARRAYSIZE( outProps ) );
+		linearTimer.End();
+		linearTime += linearTimer.GetDuration();
+
+		groupedTimer.Start();
+		for ( int i=0; i < nEntities; i++ )
+			nGroupedProps += ppLists[i]->GetPropsChangedAfterTick( iAck, outProps, ARRAYSIZE( outProps ) );
+		groupedTimer.End();
+		groupedTime += groupedTimer.GetDuration();
+	}
+
+	Shipping_Assert( nLinearProps == nGroupedProps );
+
+	Msg( "GetPropsChangedAfterTick linear Cycles: %llu\n", linearTime.GetLongCycles() );
+	Msg( "GetPropsChangedAfterTick grouped Cycles: %llu\n", groupedTime.GetLongCycles() );
+	Msg( "props changed - %d\n", nGroupedProps );
+
+	CFastTimer copyTimer;
+	copyTimer.Start();
+	for ( int i=0; i < nEntities; i++ )
+	{
+		IChangeFrameList *pCopy = ppLists[i]->Copy();
+		ppLists[i]->Release();
+		ppLists[i] = pCopy;
+	}
+	copyTimer.End();
+
+	Msg( "Copy Cycles: %llu\n", copyTimer.GetDuration().GetLongCycles() );
+
+	for ( int i=0; i < nEntities; i++ )
+	{
+		ppLists[i]->Release();
+		delete ppRefs[i];
+	}
+
+	delete[] ppLists;
+	delete[] ppRefs;
+}
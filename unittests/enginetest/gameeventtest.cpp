@@ -0,0 +1,52 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Unit test for the slot storage of CGameEvent
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "unitlib/unitlib.h"
+#include "GameEventManager.h"
+
+
+DEFINE_TESTSUITE( GameEventTestSuite )
+
+DEFINE_TESTCASE( GameEventStringPointers, GameEventTestSuite )
+{
+	Msg( "Running CGameEvent string pointer tests\n" );
+
+	CGameEventDescriptor descriptor;
+	Q_strncpy( descriptor.name, "player_death", sizeof( descriptor.name ) );
+	descriptor.keys = new KeyValues( "descriptor" );
+	descriptor.keys->SetInt( "weapon", CGameEventManager::TYPE_STRING );
+	descriptor.keys->SetInt( "userid", CGameEventManager::TYPE_SHORT );
+	descriptor.keys->SetInt( "damage", CGameEventManager::TYPE_FLOAT );
+	descriptor.CompileKeys();
+
+	CGameEvent *pEvent = new CGameEvent( &descriptor );
+
+	// Fill the inline string storage so anything added to it has to grow it
+	char szWeapon[EVENT_STRING_BYTES];
+	Q_memset( szWeapon, 'w', sizeof( szWeapon ) - 8 );
+	szWeapon[sizeof( szWeapon ) - 8] = 0;
+	pEvent->SetString( "weapon", szWeapon );
+	pEvent->SetInt( "userid", 42 );
+	pEvent->SetFloat( "damage", 12.5f );
+
+	// Listeners hold strings of an event while they read others
+	const char *pszWeapon = pEvent->GetString( "weapon" );
+	const char *pszUserId = pEvent->GetString( "userid" );
+	const char *pszDamage = pEvent->GetString( "damage" );
+
+	Shipping_Assert( pszWeapon == pEvent->GetString( "weapon" ) );
+	Shipping_Assert( !Q_strcmp( pszWeapon, szWeapon ) );
+	Shipping_Assert( !Q_strcmp( pszUserId, "42" ) );
+	Shipping_Assert( !Q_strcmp( pszDamage, "12.500000" ) );
+
+	// Reading a number as a string leaves the number alone
+	Shipping_Assert( pEvent->GetInt( "userid" ) == 42 );
+	Shipping_Assert( pEvent->GetFloat( "damage" ) == 12.5f );
+
+	delete pEvent;
+	descriptor.keys->deleteThis();
+}
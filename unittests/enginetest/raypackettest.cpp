@@ -0,0 +1,322 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Unit test and benchmark for walking a bsp tree with packets of rays
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "unitlib/unitlib.h"
+#include "cmodel_raypacket.h"
+#include "tier1/utlvector.h"
+#include "tier0/fasttimer.h"
+#include <stdlib.h>
+
+
+DEFINE_TESTSUITE( RayPacketTestSuite )
+
+//-----------------------------------------------------------------------------
+// A random bsp tree, leaves are solid or empty
+//-----------------------------------------------------------------------------
+struct TestNode_t
+{
+	cplane_t	plane;
+	int			children[2];		// negative numbers are leafs
+};
+
+static float RandomFloat01()
+{
+	return (float)rand() / (float)RAND_MAX;
+}
+
+class CTestTree
+{
+public:
+	void Build( int nMaxDepth, float flLeafChance )
+	{
+		m_Nodes.RemoveAll();
+		m_LeafSolid.RemoveAll();
+		BuildNode( 0, nMaxDepth, flLeafChance );
+	}
+
+	const TestNode_t &GetNode( int num ) const	{ return m_Nodes[num]; }
+	bool IsSolid( int leaf ) const				{ return m_LeafSolid[leaf]; }
+
+private:
+	int BuildNode( int nDepth, int nMaxDepth, float flLeafChance )
+	{
+		if ( nDepth == nMaxDepth || ( nDepth > 2 && RandomFloat01() < flLeafChance ) )
+		{
+			int leaf = m_LeafSolid.AddToTail( ( rand() % 5 ) == 0 );
+			return -1 - leaf;
+		}
+
+		int num = m_Nodes.AddToTail();
+		cplane_t &plane = m_Nodes[num].plane;
+		if ( rand() % 2 )
+		{
+			// axial planes on whole units, so rays on whole units lie on some of them
+			plane.type = rand() % 3;
+			plane.normal.Init();
+			plane.normal[plane.type] = 1.0f;
+			plane.dist = (float)( rand() % 129 - 64 );
+		}
+		else
+		{
+			plane.type = PLANE_ANYX;
+			plane.normal.Init( RandomFloat01() - 0.5f, RandomFloat01() - 0.5f, RandomFloat01() - 0.5f );
+			VectorNormalize( plane.normal );
+			plane.dist = RandomFloat01() * 128.0f - 64.0f;
+		}
+
+		int front = BuildNode( nDepth + 1, nMaxDepth, flLeafChance );
+		int back = BuildNode( nDepth + 1, nMaxDepth, flLeafChance );
+		m_Nodes[num].children[0] = front;
+		m_Nodes[num].children[1] = back;
+		return num;
+	}
+
+	CUtlVector< TestNode_t > m_Nodes;
+	CUtlVector< bool > m_LeafSolid;
+};
+
+
+//-----------------------------------------------------------------------------
+// One ray's trace, the leaves it visited and where it hit
+//-----------------------------------------------------------------------------
+struct LeafVisit_t
+{
+	int		leaf;
+	float	p1f;
+	float	p2f;
+};
+
+struct TestTrace_t
+{
+	float fraction;
+	bool bRecord;
+	CUtlVector< LeafVisit_t > visits;
+	int nVisits;
+
+	void Reset( bool bRecordVisits )
+	{
+		fraction = 1.0f;
+		bRecord = bRecordVisits;
+		visits.RemoveAll();
+		nVisits = 0;
+	}
+
+	// a solid leaf stops the ray a quarter of the way through it
+	void TraceToLeaf( const CTestTree &tree, int leaf, float p1f, float p2f )
+	{
+		nVisits++;
+		if ( bRecord )
+		{
+			LeafVisit_t &visit = visits[visits.AddToTail()];
+			visit.leaf = leaf;
+			visit.p1f = p1f;
+			visit.p2f = p2f;
+		}
+
+		if ( tree.IsSolid( leaf ) )
+		{
+			fraction = MIN( fraction, p1f + ( p2f - p1f ) * 0.25f );
+		}
+	}
+};
+
+
+//-----------------------------------------------------------------------------
+// Lets CM_RecursiveRayCheck and CM_RecursiveRayPacketCheck walk the test tree,
+// each lane tracing into its own TestTrace_t
+//-----------------------------------------------------------------------------
+class CTestRayPacketTree
+{
+public:
+	CTestRayPacketTree( const CTestTree &tree, TestTrace_t *pTraces ) : m_Tree( tree ), m_pTraces( pTraces ) {}
+
+	const cplane_t *GetPlane( int num ) const	{ return &m_Tree.GetNode( num ).plane; }
+	int GetChild( int num, int side ) const		{ return m_Tree.GetNode( num ).children[side]; }
+	bool HitBefore( int lane, float frac ) const	{ return m_pTraces[lane].fraction <= frac; }
+
+	void TraceToLeaf( int lane, int leaf, float p1f, float p2f )
+	{
+		m_pTraces[lane].TraceToLeaf( m_Tree, leaf, p1f, p2f );
+	}
+
+	float GetOffset( int lane, const cplane_t *plane ) const	{ return 0.0f; }
+
+private:
+	const CTestTree &m_Tree;
+	TestTrace_t *m_pTraces;
+};
+
+// The lone ray walk CM_RecursiveHullCheck does, to check the packets against
+static void TraceRay( const CTestTree &tree, const Vector &start, const Vector &end, TestTrace_t &trace )
+{
+	CTestRayPacketTree rayTree( tree, &trace );
+	CM_RecursiveRayCheck( rayTree, 0, 0, 0.0f, 1.0f, start, end );
+}
+
+static void TracePacket( const CTestTree &tree, const Vector *pStarts, const Vector *pEnds, int nRays, TestTrace_t *pTraces )
+{
+	RayPacket_t packet;
+	for ( int i = 0; i < RAYPACKET_SIZE; i++ )
+	{
+		int iRay = ( i < nRays ) ? i : 0;
+		packet.SetLane( i, 0.0f, 1.0f, pStarts[iRay], pEnds[iRay] );
+	}
+
+	CTestRayPacketTree packetTree( tree, pTraces );
+	CM_RecursiveRayPacketCheck( packetTree, 0, packet, ( 1 << nRays ) - 1 );
+}
+
+
+//-----------------------------------------------------------------------------
+// Rays of the kinds traced in bulk
+//-----------------------------------------------------------------------------
+enum RaySetType_t
+{
+	RAYSET_SHARED_ORIGIN = 0,		// a bot looking around
+	RAYSET_CONE,					// shotgun pellets
+	RAYSET_RANDOM,
+	RAYSET_WHOLE_UNITS,				// lying on axial planes, and parallel to them
+
+	RAYSET_COUNT
+};
+
+static void PickRays( RaySetType_t type, Vector *pStarts, Vector *pEnds, int nRays )
+{
+	Vector origin( RandomFloat01() * 160.0f - 80.0f, RandomFloat01() * 160.0f - 80.0f, RandomFloat01() * 160.0f - 80.0f );
+	Vector aim( RandomFloat01() - 0.5f, RandomFloat01() - 0.5f, RandomFloat01() - 0.5f );
+	VectorNormalize( aim );
+	for ( int i = 0; i < nRays; i++ )
+	{
+		switch ( type )
+		{
+		case RAYSET_SHARED_ORIGIN:
+			pStarts[i] = origin;
+			pEnds[i].Init( RandomFloat01() * 200.0f - 100.0f, RandomFloat01() * 200.0f - 100.0f, RandomFloat01() * 200.0f - 100.0f );
+			break;
+
+		case RAYSET_CONE:
+			pStarts[i] = origin;
+			pEnds[i].Init( aim.x + ( RandomFloat01() - 0.5f ) * 0.1f, aim.y + ( RandomFloat01() - 0.5f ) * 0.1f, aim.z + ( RandomFloat01() - 0.5f ) * 0.1f );
+			pEnds[i] = origin + pEnds[i] * 200.0f;
+			break;
+
+		case RAYSET_RANDOM:
+			pStarts[i].Init( RandomFloat01() * 160.0f - 80.0f, RandomFloat01() * 160.0f - 80.0f, RandomFloat01() * 160.0f - 80.0f );
+			pEnds[i].Init( RandomFloat01() * 160.0f - 80.0f, RandomFloat01() * 160.0f - 80.0f, RandomFloat01() * 160.0f - 80.0f );
+			break;
+
+		default:
+			pStarts[i].Init( (float)( rand() % 129 - 64 ), (float)( rand() % 129 - 64 ), (float)( rand() % 129 - 64 ) );
+			pEnds[i] = pStarts[i];
+			pEnds[i][rand() % 3] = (float)( rand() % 129 - 64 );
+			break;
+		}
+	}
+}
+
+static bool CompareTraces( const TestTrace_t &a, const TestTrace_t &b )
+{
+	if ( a.fraction != b.fraction || a.visits.Count() != b.visits.Count() )
+		return false;
+
+	for ( int i = 0; i < a.visits.Count(); i++ )
+	{
+		const LeafVisit_t &va = a.visits[i];
+		const LeafVisit_t &vb = b.visits[i];
+		if ( va.leaf != vb.leaf || va.p1f != vb.p1f || va.p2f != vb.p2f )
+			return false;
+	}
+	return true;
+}
+
+DEFINE_TESTCASE( RayPacketTest, RayPacketTestSuite )
+{
+	CTestTree tree;
+	TestTrace_t refTraces[RAYPACKET_SIZE];
+	TestTrace_t packetTraces[RAYPACKET_SIZE];
+	Vector starts[RAYPACKET_SIZE];
+	Vector ends[RAYPACKET_SIZE];
+
+	srand( 4321 );
+
+	for ( int iTree = 0; iTree < 20; iTree++ )
+	{
+		tree.Build( 6 + ( iTree % 10 ), 0.1f );
+
+		for ( int iPacket = 0; iPacket < 500; iPacket++ )
+		{
+			RaySetType_t type = (RaySetType_t)( iPacket % RAYSET_COUNT );
+			int nRays = 1 + ( iPacket / RAYSET_COUNT ) % RAYPACKET_SIZE;
+			PickRays( type, starts, ends, nRays );
+
+			for ( int i = 0; i < nRays; i++ )
+			{
+				refTraces[i].Reset( true );
+				TraceRay( tree, starts[i], ends[i], refTraces[i] );
+				packetTraces[i].Reset( true );
+			}
+
+			TracePacket( tree, starts, ends, nRays, packetTraces );
+
+			for ( int i = 0; i < nRays; i++ )
+			{
+				Shipping_Assert( CompareTraces( refTraces[i], packetTraces[i] ) );
+			}
+		}
+	}
+}
+
+DEFINE_TESTCASE( RayPacketPerformance, RayPacketTestSuite )
+{
+	const int nPackets = 50000;
+
+	CTestTree tree;
+	TestTrace_t traces[RAYPACKET_SIZE];
+	Vector starts[RAYPACKET_SIZE];
+	Vector ends[RAYPACKET_SIZE];
+
+	srand( 8765 );
+	tree.Build( 18, 0.05f );
+
+	CFastTimer singleTimer, packetTimer;
+	CCycleCount singleTime, packetTime;
+	int nSingleVisits = 0, nPacketVisits = 0;
+
+	for ( int iPacket = 0; iPacket < nPackets; iPacket++ )
+	{
+		PickRays( RAYSET_CONE, starts, ends, RAYPACKET_SIZE );
+
+		singleTimer.Start();
+		for ( int i = 0; i < RAYPACKET_SIZE; i++ )
+		{
+			traces[i].Reset( false );
+			TraceRay( tree, starts[i], ends[i], traces[i] );
+			nSingleVisits += traces[i].nVisits;
+		}
+		singleTimer.End();
+		singleTime += singleTimer.GetDuration();
+
+		packetTimer.Start();
+		for ( int i = 0; i < RAYPACKET_SIZE; i++ )
+		{
+			traces[i].Reset( false );
+		}
+		TracePacket( tree, starts, ends, RAYPACKET_SIZE, traces );
+		for ( int i = 0; i < RAYPACKET_SIZE; i++ )
+		{
+			nPacketVisits += traces[i].nVisits;
+		}
+		packetTimer.End();
+		packetTime += packetTimer.GetDuration();
+	}
+
+	Shipping_Assert( nSingleVisits == nPacketVisits );
+
+	Msg( "RecursiveRayCheck single Cycles: %llu\n", singleTime.GetLongCycles() );
+	Msg( "RecursiveRayCheck packet Cycles: %llu\n", packetTime.GetLongCycles() );
+	Msg( "leaves visited - %d\n", nPacketVisits );
+}
@@ -0,0 +1,251 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Unit test and benchmark for the bf_write / bf_read bulk bit copies
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "tier0/dbg.h"
+#include "tier0/fasttimer.h"
+#include "unitlib/unitlib.h"
+#include "tier1/bitbuf.h"
+#include <stdlib.h>
+#include <string.h>
+
+DEFINE_TESTSUITE( BitBufTestSuite )
+
+#define BITBUF_TEST_BYTES	1024
+
+static void FillRandom( unsigned char *pData, int nBytes )
+{
+	for ( int i = 0; i < nBytes; i++ )
+		pData[i] = (unsigned char)( rand() & 0xff );
+}
+
+static int GetBit( const unsigned char *pData, int iBit )
+{
+	return ( pData[iBit >> 3] >> ( iBit & 7 ) ) & 1;
+}
+
+static bool CompareBits( const unsigned char *pA, int iBitA, const unsigned char *pB, int iBitB, int nBits )
+{
+	for ( int i = 0; i < nBits; i++ )
+	{
+		if ( GetBit( pA, iBitA + i ) != GetBit( pB, iBitB + i ) )
+			return false;
+	}
+	return true;
+}
+
+// Bits around the written range must be left alone
+static bool CheckGuardBits( const unsigned char *pOut, const unsigned char *pGuard, int iStartBit, int nBits, int nTotalBits )
+{
+	return CompareBits( pOut, 0, pGuard, 0, iStartBit ) &&
+		CompareBits( pOut, iStartBit + nBits, pGuard, iStartBit + nBits, nTotalBits - iStartBit - nBits );
+}
+
+DEFINE_TESTCASE( BitBufBulkCopyTest, BitBufTestSuite )
+{
+	Msg( "Running bf_write / bf_read bulk copy tests\n" );
+
+	static const int s_nLengths[] = { 1, 7, 8, 9, 31, 32, 33, 63, 64, 65, 127, 128, 129, 200, 255, 256, 257, 1000, 4000 };
+
+	uint32 src[BITBUF_TEST_BYTES / 4];
+	uint32 dest[BITBUF_TEST_BYTES / 4];
+	uint32 guard[BITBUF_TEST_BYTES / 4];
+	unsigned char *pSrc = (unsigned char *)src;
+	unsigned char *pDest = (unsigned char *)dest;
+	unsigned char *pGuard = (unsigned char *)guard;
+
+	srand( 1234 );
+
+	for ( int iLength = 0; iLength < ARRAYSIZE( s_nLengths ); iLength++ )
+	{
+		int nBits = s_nLengths[iLength];
+
+		for ( int iReadBit = 0; iReadBit < 40; iReadBit += 3 )
+		{
+			for ( int iWriteBit = 0; iWriteBit < 40; iWriteBit += 5 )
+			{
+				FillRandom( pSrc, sizeof( src ) );
+				FillRandom( pGuard, sizeof( guard ) );
+
+				// WriteBitsFromBuffer at any read and write offset
+				memcpy( dest, guard, sizeof( dest ) );
+				{
+					bf_read in( src, sizeof( src ) );
+					in.Seek( iReadBit );
+					bf_write out( dest, sizeof( dest ) );
+					out.SeekToBit( iWriteBit );
+
+					Shipping_Assert( out.WriteBitsFromBuffer( &in, nBits ) );
+					Shipping_Assert( in.GetNumBitsRead() == iReadBit + nBits );
+					Shipping_Assert( out.GetNumBitsWritten() == iWriteBit + nBits );
+					Shipping_Assert( CompareBits( pDest, iWriteBit, pSrc, iReadBit, nBits ) );
+					Shipping_Assert( CheckGuardBits( pDest, pGuard, iWriteBit, nBits, sizeof( dest ) * 8 ) );
+				}
+
+				// WriteBits from a byte buffer that isn't dword aligned
+				memcpy( dest, guard, sizeof( dest ) );
+				{
+					const unsigned char *pIn = pSrc + ( iReadBit & 3 );
+					bf_write out( dest, sizeof( dest ) );
+					out.SeekToBit( iWriteBit );
+
+					Shipping_Assert( out.WriteBits( pIn, nBits ) );
+					Shipping_Assert( out.GetNumBitsWritten() == iWriteBit + nBits );
+					Shipping_Assert( CompareBits( pDest, iWriteBit, pIn, 0, nBits ) );
+					Shipping_Assert( CheckGuardBits( pDest, pGuard, iWriteBit, nBits, sizeof( dest ) * 8 ) );
+				}
+
+				// ReadBits into a byte buffer that isn't dword aligned. The last partial byte
+				// is zero filled, everything past it is left alone.
+				memcpy( dest, guard, sizeof( dest ) );
+				{
+					unsigned char *pOut = pDest + ( iWriteBit & 3 );
+					bf_read in( src, sizeof( src ) );
+					in.Seek( iReadBit );
+
+					in.ReadBits( pOut, nBits );
+					Shipping_Assert( !in.IsOverflowed() );
+					Shipping_Assert( in.GetNumBitsRead() == iReadBit + nBits );
+					Shipping_Assert( CompareBits( pOut, 0, pSrc, iReadBit, nBits ) );
+
+					int nOutBytes = ( nBits + 7 ) >> 3;
+					for ( int i = nBits; i < nOutBytes * 8; i++ )
+						Shipping_Assert( GetBit( pOut, i ) == 0 );
+					Shipping_Assert( memcmp( pOut + nOutBytes, pGuard + ( pOut - pDest ) + nOutBytes, sizeof( dest ) - ( pOut - pDest ) - nOutBytes ) == 0 );
+				}
+			}
+		}
+	}
+
+	// Copies that run off the end of either buffer must still set the overflow flag
+	{
+		bf_read in( src, 16 );
+		in.Seek( 5 );
+		bf_write out( dest, sizeof( dest ) );
+		out.SetAssertOnOverflow( false );
+		in.SetAssertOnOverflow( false );
+		Shipping_Assert( !out.WriteBitsFromBuffer( &in, 128 ) );
+		Shipping_Assert( in.IsOverflowed() );
+	}
+
+	{
+		bf_read in( src, sizeof( src ) );
+		bf_write out( dest, 16 );
+		out.SetAssertOnOverflow( false );
+		out.SeekToBit( 3 );
+		Shipping_Assert( !out.WriteBitsFromBuffer( &in, 128 ) );
+		Shipping_Assert( out.IsOverflowed() );
+	}
+
+	{
+		bf_write out( dest, 16 );
+		out.SetAssertOnOverflow( false );
+		out.SeekToBit( 3 );
+		Shipping_Assert( !out.WriteBits( src, 128 ) );
+		Shipping_Assert( out.IsOverflowed() );
+	}
+
+	{
+		bf_read in( src, 16 );
+		in.SetAssertOnOverflow( false );
+		in.Seek( 9 );
+		in.ReadBits( dest, 128 );
+		Shipping_Assert( in.IsOverflowed() );
+	}
+}
+
+DEFINE_TESTCASE( BitBufBulkCopyPerformance, BitBufTestSuite )
+{
+	// about what a big snapshot or a demo packet moves around
+	const int nBufferBytes = 64 * 1024;
+	const int nRuns = 64;
+
+	uint32 *pSrc = new uint32[nBufferBytes / 4];
+	uint32 *pDest = new uint32[nBufferBytes / 4];
+	FillRandom( (unsigned char *)pSrc, nBufferBytes );
+
+	// Prop payloads are copied at arbitrary offsets in both buffers, the copy lengths here
+	// are a mix of small props and bigger arrays and strings
+	srand( 5678 );
+	int nTotalBits = 0;
+	int nCopies = 0;
+	int copyLengths[4096];
+	while ( nCopies < ARRAYSIZE( copyLengths ) )
+	{
+		int nBits = ( rand() % 4 ) ? 33 + rand() % 96 : 33 + rand() % 1024;
+		if ( nTotalBits + nBits + 64 > nBufferBytes * 8 )
+			break;
+		copyLengths[nCopies++] = nBits;
+		nTotalBits += nBits;
+	}
+
+	CFastTimer timer;
+	CCycleCount dwordTime, bulkTime, readTime;
+
+	// what WriteBitsFromBuffer did before, one dword at a time through ReadUBitLong
+	for ( int iRun = 0; iRun < nRuns; iRun++ )
+	{
+		bf_read in( pSrc, nBufferBytes );
+		in.Seek( 3 );
+		bf_write out( pDest, nBufferBytes );
+		out.SeekToBit( 11 );
+
+		timer.Start();
+		for ( int i = 0; i < nCopies; i++ )
+		{
+			int nBits = copyLengths[i];
+			while ( nBits > 32 )
+			{
+				out.WriteUBitLong( in.ReadUBitLong( 32 ), 32 );
+				nBits -= 32;
+			}
+			out.WriteUBitLong( in.ReadUBitLong( nBits ), nBits );
+		}
+		timer.End();
+		dwordTime += timer.GetDuration();
+	}
+
+	for ( int iRun = 0; iRun < nRuns; iRun++ )
+	{
+		bf_read in( pSrc, nBufferBytes );
+		in.Seek( 3 );
+		bf_write out( pDest, nBufferBytes );
+		out.SeekToBit( 11 );
+
+		timer.Start();
+		for ( int i = 0; i < nCopies; i++ )
+		{
+			out.WriteBitsFromBuffer( &in, copyLengths[i] );
+		}
+		timer.End();
+		bulkTime += timer.GetDuration();
+
+		Shipping_Assert( !out.IsOverflowed() && !in.IsOverflowed() );
+	}
+
+	Shipping_Assert( CompareBits( (unsigned char *)pDest, 11, (unsigned char *)pSrc, 3, nTotalBits ) );
+
+	for ( int iRun = 0; iRun < nRuns; iRun++ )
+	{
+		bf_read in( pSrc, nBufferBytes );
+		in.Seek( 5 );
+
+		timer.Start();
+		in.ReadBits( pDest, nTotalBits );
+		timer.End();
+		readTime += timer.GetDuration();
+	}
+
+	Shipping_Assert( CompareBits( (unsigned char *)pDest, 0, (unsigned char *)pSrc, 5, nTotalBits ) );
+
+	Msg( "%d copies, %d bits\n", nCopies, nTotalBits );
+	Msg( "WriteBitsFromBuffer dword loop Cycles: %llu\n", dwordTime.GetLongCycles() );
+	Msg( "WriteBitsFromBuffer bulk Cycles: %llu\n", bulkTime.GetLongCycles() );
+	Msg( "ReadBits Cycles: %llu\n", readTime.GetLongCycles() );
+
+	delete[] pSrc;
+	delete[] pDest;
+}
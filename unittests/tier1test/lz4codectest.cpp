@@ -0,0 +1,157 @@
+#include "tier0/dbg.h"
+#include "tier0/platform.h"
+#include "tier0/fasttimer.h"
+#include "unitlib/unitlib.h"
+#include "tier1/lz4codec.h"
+#include "tier1/lzss.h"
+#include "tier1/utlvector.h"
+#include <stdlib.h>
+
+DEFINE_TESTSUITE( LZ4CodecTestSuite )
+
+// Round trips pInput and checks the result, returns the compressed size
+static unsigned int RoundTrip( const unsigned char *pInput, unsigned int size )
+{
+	CUtlVector< unsigned char > compressed;
+	compressed.SetCount( CLZ4::GetMaxCompressedSize( size ) );
+
+	unsigned int compressedSize = compressed.Count();
+	Shipping_Assert( CLZ4::Compress( pInput, size, compressed.Base(), &compressedSize ) );
+	Shipping_Assert( compressedSize <= CLZ4::GetMaxCompressedSize( size ) );
+	Shipping_Assert( CLZ4::IsCompressed( compressed.Base() ) );
+	Shipping_Assert( CLZ4::GetActualSize( compressed.Base() ) == size );
+
+	CUtlVector< unsigned char > out;
+	out.SetCount( size + 1 );
+
+	unsigned int result = CLZ4::SafeUncompress( compressed.Base(), compressedSize, out.Base(), size );
+	Shipping_Assert( result == size );
+	Shipping_Assert( size == 0 || memcmp( pInput, out.Base(), size ) == 0 );
+
+	// output buffer too small
+	if ( size > 0 )
+	{
+		Shipping_Assert( CLZ4::SafeUncompress( compressed.Base(), compressedSize, out.Base(), size - 1 ) == 0 );
+	}
+
+	// truncated input must fail, never read or write out of bounds
+	for ( unsigned int i = 0; size > 0 && i < compressedSize; i += 1 + compressedSize / 64 )
+	{
+		Shipping_Assert( CLZ4::SafeUncompress( compressed.Base(), i, out.Base(), size ) == 0 );
+	}
+
+	return compressedSize;
+}
+
+static void RoundTripTests()
+{
+	CUtlVector< unsigned char > data;
+	data.SetCount( 256 * 1024 );
+
+	srand( 1234 );
+
+	// empty and tiny inputs are all literals
+	RoundTrip( data.Base(), 0 );
+	for ( int i = 0; i < 32; i++ )
+	{
+		data[i] = (unsigned char)i;
+		RoundTrip( data.Base(), i );
+	}
+
+	// random data doesn't compress but must not overflow GetMaxCompressedSize
+	for ( int i = 0; i < data.Count(); i++ )
+		data[i] = (unsigned char)rand();
+	RoundTrip( data.Base(), data.Count() );
+
+	// runs, with overlapping matches
+	memset( data.Base(), 'a', data.Count() );
+	unsigned int nRunSize = RoundTrip( data.Base(), data.Count() );
+	Shipping_Assert( nRunSize < 2048 );
+
+	// text like data with few symbols and repeats at various distances
+	static const char *s_pWords[] = { "m_vecOrigin ", "m_angRotation ", "m_iHealth ", "CBaseEntity ", "\n", "player ", "0.000000 " };
+	int nPos = 0;
+	while ( nPos < data.Count() )
+	{
+		const char *pWord = s_pWords[ rand() % ARRAYSIZE( s_pWords ) ];
+		while ( *pWord && nPos < data.Count() )
+			data[nPos++] = *pWord++;
+	}
+
+	for ( int size = 1; size <= data.Count(); size *= 3 )
+	{
+		RoundTrip( data.Base(), size );
+	}
+
+	unsigned int nTextSize = RoundTrip( data.Base(), data.Count() );
+	Shipping_Assert( nTextSize < (unsigned int)data.Count() / 2 );
+
+	// corrupt data is rejected
+	CUtlVector< unsigned char > compressed;
+	compressed.SetCount( CLZ4::GetMaxCompressedSize( 4096 ) );
+	unsigned int compressedSize = compressed.Count();
+	Shipping_Assert( CLZ4::Compress( data.Base(), 4096, compressed.Base(), &compressedSize ) );
+
+	CUtlVector< unsigned char > out;
+	out.SetCount( 4096 );
+	for ( int i = 0; i < 1000; i++ )
+	{
+		int nByte = sizeof( lz4_header_t ) + rand() % ( compressedSize - sizeof( lz4_header_t ) );
+		unsigned char original = compressed[nByte];
+		compressed[nByte] = (unsigned char)rand();
+
+		// may decode to garbage, but has to stay in bounds
+		CLZ4::SafeUncompress( compressed.Base(), compressedSize, out.Base(), out.Count() );
+
+		compressed[nByte] = original;
+	}
+
+	// output that doesn't fit fails instead of overflowing
+	unsigned int smallSize = 64;
+	Shipping_Assert( !CLZ4::Compress( data.Base(), 4096, compressed.Base(), &smallSize ) );
+}
+
+static void PerformanceTests()
+{
+	CUtlVector< unsigned char > data;
+	data.SetCount( 64 * 1024 );
+
+	// something like a signon packet, mostly small numbers and repeated strings
+	srand( 5678 );
+	for ( int i = 0; i < data.Count(); i++ )
+		data[i] = ( rand() % 4 ) ? (unsigned char)( rand() % 8 ) : (unsigned char)( 'a' + i % 26 );
+
+	CUtlVector< unsigned char > compressed;
+	compressed.SetCount( CLZ4::GetMaxCompressedSize( data.Count() ) );
+
+	CFastTimer timer;
+
+	timer.Start();
+	unsigned int lz4Size = 0;
+	for ( int i = 0; i < 16; i++ )
+	{
+		lz4Size = compressed.Count();
+		CLZ4::Compress( data.Base(), data.Count(), compressed.Base(), &lz4Size );
+	}
+	timer.End();
+	Msg( "LZ4 compress Cycles: %llu (%d -> %u bytes)\n", timer.GetDuration().GetLongCycles(), data.Count(), lz4Size );
+
+	timer.Start();
+	unsigned int lzssSize = 0;
+	for ( int i = 0; i < 16; i++ )
+	{
+		CLZSS lzss;
+		lzssSize = 0;
+		lzss.CompressNoAlloc( data.Base(), data.Count(), compressed.Base(), &lzssSize );
+	}
+	timer.End();
+	Msg( "LZSS compress Cycles: %llu (%d -> %u bytes)\n", timer.GetDuration().GetLongCycles(), data.Count(), lzssSize );
+}
+
+DEFINE_TESTCASE( LZ4CodecTest, LZ4CodecTestSuite )
+{
+	Msg( "Running CLZ4 tests\n" );
+
+	RoundTripTests();
+	PerformanceTests();
+}
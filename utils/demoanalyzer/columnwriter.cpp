@@ -0,0 +1,161 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Column oriented output tables for the demo analyzer.
+//
+//=============================================================================//
+
+#include "columnwriter.h"
+#include "tier0/dbg.h"
+#include "tier1/strtools.h"
+#include <stdio.h>
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+CColumnTable::CColumnTable( const char *pName ) : m_Name( pName ), m_nRows( 0 )
+{
+}
+
+CColumnTable::~CColumnTable()
+{
+	m_Columns.PurgeAndDeleteElements();
+}
+
+int CColumnTable::AddColumn( const char *pName, ColumnType_t type )
+{
+	Assert( m_nRows == 0 );
+
+	Column_t *pColumn = new Column_t;
+	pColumn->m_Name = pName;
+	pColumn->m_Type = type;
+	pColumn->m_bSet = false;
+	pColumn->m_Data.SetBigEndian( false );
+	return m_Columns.AddToTail( pColumn );
+}
+
+void CColumnTable::SetInt( int iColumn, int nValue )
+{
+	Column_t *pColumn = m_Columns[iColumn];
+	Assert( pColumn->m_Type == COLUMN_INT && !pColumn->m_bSet );
+	pColumn->m_Data.PutInt( nValue );
+	pColumn->m_bSet = true;
+}
+
+void CColumnTable::SetFloat( int iColumn, float flValue )
+{
+	Column_t *pColumn = m_Columns[iColumn];
+	Assert( pColumn->m_Type == COLUMN_FLOAT && !pColumn->m_bSet );
+	pColumn->m_Data.PutFloat( flValue );
+	pColumn->m_bSet = true;
+}
+
+void CColumnTable::SetString( int iColumn, const char *pValue )
+{
+	Column_t *pColumn = m_Columns[iColumn];
+	Assert( pColumn->m_Type == COLUMN_STRING && !pColumn->m_bSet );
+	pColumn->m_Data.PutString( pValue );
+	pColumn->m_Data.PutChar( 0 );
+	pColumn->m_bSet = true;
+}
+
+void CColumnTable::EndRow()
+{
+	for ( int i = 0; i < m_Columns.Count(); i++ )
+	{
+		Column_t *pColumn = m_Columns[i];
+		if ( !pColumn->m_bSet )
+		{
+			switch ( pColumn->m_Type )
+			{
+			case COLUMN_INT:	pColumn->m_Data.PutInt( 0 ); break;
+			case COLUMN_FLOAT:	pColumn->m_Data.PutFloat( 0.0f ); break;
+			case COLUMN_STRING:	pColumn->m_Data.PutChar( 0 ); break;
+			}
+		}
+		pColumn->m_bSet = false;
+	}
+
+	m_nRows++;
+}
+
+void CColumnTable::Write( CUtlBuffer &buf ) const
+{
+	buf.PutString( m_Name.String() );
+	buf.PutChar( 0 );
+	buf.PutInt( m_nRows );
+	buf.PutInt( m_Columns.Count() );
+
+	for ( int i = 0; i < m_Columns.Count(); i++ )
+	{
+		const Column_t *pColumn = m_Columns[i];
+		buf.PutString( pColumn->m_Name.String() );
+		buf.PutChar( 0 );
+		buf.PutUnsignedChar( (unsigned char)pColumn->m_Type );
+		buf.PutInt( pColumn->m_Data.TellPut() );
+		buf.Put( pColumn->m_Data.Base(), pColumn->m_Data.TellPut() );
+	}
+}
+
+
+CColumnFile::~CColumnFile()
+{
+	Purge();
+}
+
+CColumnTable *CColumnFile::FindOrAddTable( const char *pName, bool *pbCreated )
+{
+	if ( pbCreated )
+		*pbCreated = false;
+
+	for ( int i = 0; i < m_Tables.Count(); i++ )
+	{
+		if ( !Q_strcmp( m_Tables[i]->GetName(), pName ) )
+			return m_Tables[i];
+	}
+
+	if ( pbCreated )
+		*pbCreated = true;
+
+	return m_Tables[ m_Tables.AddToTail( new CColumnTable( pName ) ) ];
+}
+
+int CColumnFile::GetTotalRows() const
+{
+	int nRows = 0;
+	for ( int i = 0; i < m_Tables.Count(); i++ )
+		nRows += m_Tables[i]->GetNumRows();
+	return nRows;
+}
+
+bool CColumnFile::WriteToFile( const char *pFileName ) const
+{
+	CUtlBuffer buf;
+	buf.SetBigEndian( false );
+	buf.Put( DEMOCOL_FILE_ID, 8 );
+	buf.PutInt( m_Tables.Count() );
+
+	for ( int i = 0; i < m_Tables.Count(); i++ )
+		m_Tables[i]->Write( buf );
+
+	FILE *fp = fopen( pFileName, "wb" );
+	if ( !fp )
+	{
+		Warning( "Couldn't open %s for writing\n", pFileName );
+		return false;
+	}
+
+	bool bOk = fwrite( buf.Base(), 1, buf.TellPut(), fp ) == (size_t)buf.TellPut();
+	fclose( fp );
+
+	if ( !bOk )
+	{
+		Warning( "Error writing %s\n", pFileName );
+	}
+	return bOk;
+}
+
+void CColumnFile::Purge()
+{
+	m_Tables.PurgeAndDeleteElements();
+}
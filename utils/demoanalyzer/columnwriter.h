@@ -0,0 +1,92 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Column oriented output tables for the demo analyzer.
+//
+//			A .dcol file holds all tables of one demo, little endian:
+//
+//			"DEMOCOL1"
+//			int		number of tables
+//			for each table:
+//				string	table name (zero terminated)
+//				int		number of rows
+//				int		number of columns
+//				for each column:
+//					string	column name
+//					byte	type (COLUMN_INT, COLUMN_FLOAT, COLUMN_STRING)
+//					int		data size in bytes
+//					data	int32 or float32 per row, or a zero terminated string per row
+//
+//=============================================================================//
+
+#ifndef COLUMNWRITER_H
+#define COLUMNWRITER_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier1/utlbuffer.h"
+#include "tier1/utlvector.h"
+#include "tier1/utlstring.h"
+
+#define DEMOCOL_FILE_ID		"DEMOCOL1"
+
+enum ColumnType_t
+{
+	COLUMN_INT = 0,
+	COLUMN_FLOAT,
+	COLUMN_STRING,
+};
+
+class CColumnTable
+{
+public:
+	CColumnTable( const char *pName );
+	~CColumnTable();
+
+	const char	*GetName() const { return m_Name.String(); }
+	int			GetNumRows() const { return m_nRows; }
+	int			GetNumColumns() const { return m_Columns.Count(); }
+
+	// Columns can only be added while the table has no rows
+	int			AddColumn( const char *pName, ColumnType_t type );
+
+	// Values go into the current row, columns not set before EndRow get 0 or ""
+	void		SetInt( int iColumn, int nValue );
+	void		SetFloat( int iColumn, float flValue );
+	void		SetString( int iColumn, const char *pValue );
+	void		EndRow();
+
+	void		Write( CUtlBuffer &buf ) const;
+
+private:
+	struct Column_t
+	{
+		CUtlString		m_Name;
+		ColumnType_t	m_Type;
+		CUtlBuffer		m_Data;
+		bool			m_bSet;		// written in the current row
+	};
+
+	CUtlString					m_Name;
+	CUtlVector< Column_t * >	m_Columns;
+	int							m_nRows;
+};
+
+class CColumnFile
+{
+public:
+	~CColumnFile();
+
+	// Returns the table with this name, creating it if needed
+	CColumnTable	*FindOrAddTable( const char *pName, bool *pbCreated = NULL );
+	int				GetNumTables() const { return m_Tables.Count(); }
+	int				GetTotalRows() const;
+
+	bool			WriteToFile( const char *pFileName ) const;
+	void			Purge();
+
+private:
+	CUtlVector< CColumnTable * >	m_Tables;
+};
+
+#endif // COLUMNWRITER_H
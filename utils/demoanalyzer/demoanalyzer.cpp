@@ -0,0 +1,306 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Headless demo analyzer. Decodes the entities and game events of
+//			demo files into column tables, one .dcol file per demo.
+//
+//			demoanalyzer [-o <outdir>] [-j <jobs>] [-props <name,name,...|*>] <demo> [<demo> ...]
+//
+//			Run it from the game's install directory, the filesystem module is
+//			loaded from bin/ there like the dedicated server does.
+//
+//			The recv table decoder keeps its state in globals, so demos are decoded
+//			in parallel by forking one worker process per demo, up to -j at a time.
+//
+//=============================================================================//
+
+#include "demodecoder.h"
+#include "filesystem.h"
+#include "tier0/dbg.h"
+#include "tier0/icommandline.h"
+#include "tier1/interface.h"
+#include "tier1/strtools.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <setjmp.h>
+
+#ifdef POSIX
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+// Used by the engine code this tool links
+IFileSystem *g_pFileSystem = NULL;
+
+static DemoAnalyzerOptions_t g_Options;
+static char g_OutputDir[MAX_PATH] = ".";
+
+// Where DemoAnalyzer_AbortDemo jumps to while a demo is decoded, like host_abortserver
+static jmp_buf *s_pDemoAbort = NULL;
+
+void DemoAnalyzer_AbortDemo()
+{
+	if ( s_pDemoAbort )
+	{
+		longjmp( *s_pDemoAbort, 1 );
+	}
+
+	exit( 1 );
+}
+
+
+static SpewRetval_t DemoAnalyzerSpew( SpewType_t type, const char *pMsg )
+{
+	FILE *fp = ( type == SPEW_MESSAGE || type == SPEW_LOG ) ? stdout : stderr;
+	fprintf( fp, "%s", pMsg );
+	fflush( fp );
+
+	// Error() doesn't return, only the demo it happened in is lost
+	if ( type == SPEW_ERROR )
+	{
+		DemoAnalyzer_AbortDemo();
+	}
+	return SPEW_CONTINUE;
+}
+
+static void PrintUsage()
+{
+	Msg( "usage: demoanalyzer [-o <outdir>] [-j <jobs>] [-props <name,name,...|*>] <demo> [<demo> ...]\n" );
+	Msg( "  -o      directory the .dcol files are written to (default: current directory)\n" );
+	Msg( "  -j      number of demos decoded at the same time (default: number of cores)\n" );
+	Msg( "  -props  entity props written to the per class tables, * for all of them\n" );
+}
+
+static bool InitFileSystem()
+{
+	// Dedicated server installs have the stdio filesystem built into the dedicated module
+	static const char *s_pModules[] = { "filesystem_stdio", "dedicated" };
+
+	CSysModule *pModule = NULL;
+	IFileSystem *pFileSystem = NULL;
+	for ( int i = 0; i < (int)ARRAYSIZE( s_pModules ) && !pFileSystem; i++ )
+	{
+		Sys_LoadInterface( s_pModules[i], FILESYSTEM_INTERFACE_VERSION, &pModule, (void **)&pFileSystem );
+	}
+
+	if ( !pFileSystem )
+	{
+		Warning( "Can't load the filesystem\n" );
+		return false;
+	}
+
+	if ( !pFileSystem->Connect( Sys_GetFactoryThis() ) || pFileSystem->Init() != INIT_OK )
+	{
+		Warning( "Can't initialize the filesystem\n" );
+		return false;
+	}
+
+	// Demos are opened by absolute path, GAME only has to exist
+	char cwd[MAX_PATH];
+	if ( !V_GetCurrentDirectory( cwd, sizeof( cwd ) ) )
+	{
+		V_strcpy_safe( cwd, "." );
+	}
+	pFileSystem->RemoveAllSearchPaths();
+	pFileSystem->AddSearchPath( cwd, "GAME" );
+
+	g_pFileSystem = g_pFullFileSystem = pFileSystem;
+	return true;
+}
+
+static void ParsePropList( const char *pList )
+{
+	if ( !Q_strcmp( pList, "*" ) )
+	{
+		g_Options.m_bAllProps = true;
+		return;
+	}
+
+	CUtlStringList names;
+	V_SplitString( pList, ",", names );
+	for ( int i = 0; i < names.Count(); i++ )
+	{
+		if ( names[i][0] )
+		{
+			g_Options.m_Props.AddToTail( names[i] );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Runs DecodeDemo, returns false if it failed or the engine code hit a
+//			fatal error. Whatever the aborted decode allocated on the way is leaked.
+//-----------------------------------------------------------------------------
+static bool DecodeDemoCatchErrors( CDemoDecoder *pDecoder, const char *pFileName, CColumnFile &output )
+{
+	jmp_buf demoAbort;
+	if ( setjmp( demoAbort ) )
+	{
+		s_pDemoAbort = NULL;
+		return false;
+	}
+
+	s_pDemoAbort = &demoAbort;
+	bool bOk = pDecoder->DecodeDemo( pFileName, output );
+	s_pDemoAbort = NULL;
+	return bOk;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Decodes one demo and writes its tables, returns false on any error
+//-----------------------------------------------------------------------------
+static bool AnalyzeDemo( const char *pFileName )
+{
+	CColumnFile output;
+
+	// Entity state for MAX_EDICTS slots, too large for the stack
+	CDemoDecoder *pDecoder = new CDemoDecoder( g_Options );
+	bool bOk = DecodeDemoCatchErrors( pDecoder, pFileName, output );
+	delete pDecoder;
+
+	if ( !bOk )
+	{
+		Warning( "%s: decoding failed\n", pFileName );
+		return false;
+	}
+
+	char baseName[MAX_PATH];
+	V_FileBase( pFileName, baseName, sizeof( baseName ) );
+
+	char outputName[MAX_PATH];
+	V_ComposeFileName( g_OutputDir, baseName, outputName, sizeof( outputName ) );
+	V_strncat( outputName, ".dcol", sizeof( outputName ) );
+
+	if ( !output.WriteToFile( outputName ) )
+		return false;
+
+	Msg( "%s: %d tables, %d rows -> %s\n", pFileName, output.GetNumTables(), output.GetTotalRows(), outputName );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Runs AnalyzeDemo for all demos, in up to nJobs child processes.
+//			Returns the number of demos that failed.
+//-----------------------------------------------------------------------------
+static int AnalyzeDemos( const CUtlVector< CUtlString > &demos, int nJobs )
+{
+	int nFailed = 0;
+
+#ifdef POSIX
+	if ( nJobs > 1 && demos.Count() > 1 )
+	{
+		int iNext = 0;
+		int nRunning = 0;
+
+		while ( iNext < demos.Count() || nRunning > 0 )
+		{
+			if ( iNext < demos.Count() && nRunning < nJobs )
+			{
+				pid_t pid = fork();
+				if ( pid == 0 )
+				{
+					bool bOk = AnalyzeDemo( demos[iNext].String() );
+					fflush( stdout );
+					_exit( bOk ? 0 : 1 );
+				}
+
+				if ( pid < 0 )
+				{
+					Warning( "fork failed, decoding %s in this process\n", demos[iNext].String() );
+					if ( !AnalyzeDemo( demos[iNext].String() ) )
+					{
+						nFailed++;
+					}
+				}
+				else
+				{
+					nRunning++;
+				}
+				iNext++;
+				continue;
+			}
+
+			int status;
+			if ( wait( &status ) < 0 )
+				break;
+
+			nRunning--;
+			if ( !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 )
+			{
+				nFailed++;
+			}
+		}
+
+		return nFailed;
+	}
+#endif
+
+	for ( int i = 0; i < demos.Count(); i++ )
+	{
+		if ( !AnalyzeDemo( demos[i].String() ) )
+		{
+			nFailed++;
+		}
+	}
+	return nFailed;
+}
+
+int main( int argc, char **argv )
+{
+	SpewOutputFunc( DemoAnalyzerSpew );
+	CommandLine()->CreateCmdLine( argc, argv );
+
+	const CPUInformation *pi = GetCPUInformation();
+	int nJobs = pi ? pi->m_nLogicalProcessors : 1;
+
+	CUtlVector< CUtlString > demos;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( !Q_stricmp( argv[i], "-o" ) && i + 1 < argc )
+		{
+			V_strcpy_safe( g_OutputDir, argv[++i] );
+		}
+		else if ( !Q_stricmp( argv[i], "-j" ) && i + 1 < argc )
+		{
+			nJobs = atoi( argv[++i] );
+			nJobs = MAX( nJobs, 1 );
+		}
+		else if ( !Q_stricmp( argv[i], "-props" ) && i + 1 < argc )
+		{
+			ParsePropList( argv[++i] );
+		}
+		else if ( argv[i][0] == '-' )
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+		{
+			char fullPath[MAX_PATH];
+			V_MakeAbsolutePath( fullPath, sizeof( fullPath ), argv[i] );
+			demos.AddToTail( fullPath );
+		}
+	}
+
+	if ( !demos.Count() )
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if ( !InitFileSystem() )
+		return 1;
+
+	int nFailed = AnalyzeDemos( demos, nJobs );
+	if ( nFailed )
+	{
+		Warning( "%d of %d demos failed\n", nFailed, demos.Count() );
+	}
+
+	g_pFileSystem->Shutdown();
+	return nFailed ? 1 : 0;
+}
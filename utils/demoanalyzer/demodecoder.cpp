@@ -0,0 +1,1297 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Decodes a demo file into column tables without a client.
+//
+//			The entity parsing follows CBaseClientState::ReadPacketEntities and
+//			CL_CopyNewEntity, minus everything that needs client entities.
+//
+//=============================================================================//
+
+#include "demodecoder.h"
+#include "demofile.h"
+#include "demorecvtables.h"
+#include "dt_recv_eng.h"
+#include "dt_recv_decoder.h"
+#include "net.h"
+#include "common.h"
+#include "packed_entity.h"
+#include "GameEventManager.h"
+#include "demofile/demoformat.h"
+#include "tier1/strtools.h"
+#include "tier1/fmtstr.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+#define DEMO_DATATABLES_BUFFER_SIZE		( 256 * 1024 )
+#define DEMO_STRINGTABLES_BUFFER_SIZE	( 512 * 1024 )
+
+// Frames kept for delta decoding, the server never deltas from older ones
+#define MAX_DEMO_FRAMES		128
+
+
+//-----------------------------------------------------------------------------
+// DemoAnalyzerOptions_t
+//-----------------------------------------------------------------------------
+bool DemoAnalyzerOptions_t::WantsProp( const char *pName ) const
+{
+	if ( m_bAllProps )
+		return true;
+
+	for ( int i = 0; i < m_Props.Count(); i++ )
+	{
+		if ( !Q_stricmp( m_Props[i].String(), pName ) )
+			return true;
+	}
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------
+// CDemoNetChannel
+//-----------------------------------------------------------------------------
+CDemoNetChannel::CDemoNetChannel() : m_nProtocol( PROTOCOL_VERSION )
+{
+}
+
+CDemoNetChannel::~CDemoNetChannel()
+{
+	m_NetMessages.PurgeAndDeleteElements();
+}
+
+bool CDemoNetChannel::RegisterMessage( INetMessage *msg )
+{
+	if ( FindMessage( msg->GetType() ) )
+		return false;
+
+	m_NetMessages.AddToTail( msg );
+	msg->SetNetChannel( this );
+	return true;
+}
+
+INetMessage *CDemoNetChannel::FindMessage( int type )
+{
+	for ( int i = 0; i < m_NetMessages.Count(); i++ )
+	{
+		if ( m_NetMessages[i]->GetType() == type )
+			return m_NetMessages[i];
+	}
+	return NULL;
+}
+
+const netadr_t &CDemoNetChannel::GetRemoteAddress( void ) const
+{
+	static netadr_t s_Address;
+	return s_Address;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Same loop as CNetChan::ProcessMessages without the stats and debug output
+//-----------------------------------------------------------------------------
+bool CDemoNetChannel::ProcessMessages( bf_read &buf )
+{
+	while ( true )
+	{
+		if ( buf.IsOverflowed() )
+		{
+			Warning( "Buffer overflow in net message\n" );
+			return false;
+		}
+
+		if ( buf.GetNumBitsLeft() < NETMSG_TYPE_BITS )
+			break;
+
+		int cmd = buf.ReadUBitLong( NETMSG_TYPE_BITS );
+
+		if ( cmd <= net_File )
+		{
+			char string[1024];
+
+			switch ( cmd )
+			{
+			case net_NOP:
+				break;
+
+			case net_Disconnect:
+				buf.ReadString( string, sizeof( string ) );
+				return false;
+
+			case net_File:
+				buf.ReadUBitLong( 32 );
+				buf.ReadString( string, sizeof( string ) );
+				buf.ReadOneBit();
+				break;
+			}
+			continue;
+		}
+
+		INetMessage *netmsg = FindMessage( cmd );
+		if ( !netmsg )
+		{
+			Warning( "Unknown net message %i\n", cmd );
+			return false;
+		}
+
+		if ( !netmsg->ReadFromBuffer( buf ) )
+		{
+			Warning( "Failed reading message %s\n", netmsg->GetName() );
+			return false;
+		}
+
+		if ( !netmsg->Process() )
+		{
+			Warning( "Failed processing message %s\n", netmsg->GetName() );
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// CDemoDecoder::EntityReadInfo_t
+//-----------------------------------------------------------------------------
+void CDemoDecoder::EntityReadInfo_t::NextOldEntity()
+{
+	if ( m_pFrom )
+	{
+		m_nOldEntity = m_pFrom->m_Transmit.FindNextSetBit( m_nOldEntity + 1 );
+		if ( m_nOldEntity < 0 )
+		{
+			m_nOldEntity = ENTITY_SENTINEL;
+		}
+	}
+	else
+	{
+		m_nOldEntity = ENTITY_SENTINEL;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// CDemoDecoder
+//-----------------------------------------------------------------------------
+CDemoDecoder::CDemoDecoder( const DemoAnalyzerOptions_t &options ) : m_Options( options )
+{
+	m_pStringTables = NULL;
+	m_pOutput = NULL;
+	m_pEntityOutput = NULL;
+	m_nDemoProtocol = DEMO_PROTOCOL;
+	m_nServerTick = 0;
+	m_nServerClassBits = 0;
+	m_bDecodersReady = false;
+
+	// The REGISTER macros use these
+	INetChannel *chan = &m_NetChannel;
+
+	REGISTER_NET_MSG( Tick );
+	REGISTER_NET_MSG( StringCmd );
+	REGISTER_NET_MSG( SetConVar );
+	REGISTER_NET_MSG( SignonState );
+
+	REGISTER_SVC_MSG( Print );
+	REGISTER_SVC_MSG( ServerInfo );
+	REGISTER_SVC_MSG( SendTable );
+	REGISTER_SVC_MSG( ClassInfo );
+	REGISTER_SVC_MSG( SetPause );
+	REGISTER_SVC_MSG( CreateStringTable );
+	REGISTER_SVC_MSG( UpdateStringTable );
+	REGISTER_SVC_MSG( VoiceInit );
+	REGISTER_SVC_MSG( VoiceData );
+	REGISTER_SVC_MSG( Sounds );
+	REGISTER_SVC_MSG( SetView );
+	REGISTER_SVC_MSG( FixAngle );
+	REGISTER_SVC_MSG( CrosshairAngle );
+	REGISTER_SVC_MSG( BSPDecal );
+	REGISTER_SVC_MSG( GameEvent );
+	REGISTER_SVC_MSG( UserMessage );
+	REGISTER_SVC_MSG( EntityMessage );
+	REGISTER_SVC_MSG( PacketEntities );
+	REGISTER_SVC_MSG( TempEntities );
+	REGISTER_SVC_MSG( Prefetch );
+	REGISTER_SVC_MSG( Menu );
+	REGISTER_SVC_MSG( GameEventList );
+	REGISTER_SVC_MSG( GetCvarValue );
+	REGISTER_SVC_MSG( CmdKeyValues );
+	REGISTER_SVC_MSG( SetPauseTimed );
+
+	Reset();
+}
+
+CDemoDecoder::~CDemoDecoder()
+{
+	Reset();
+}
+
+void CDemoDecoder::Reset()
+{
+	if ( m_bDecodersReady )
+	{
+		DemoRecvTables_Term();
+		m_bDecodersReady = false;
+	}
+
+	delete m_pStringTables;
+	m_pStringTables = NULL;
+
+	m_pOutput = NULL;
+	m_pEntityOutput = NULL;
+	m_nServerTick = 0;
+	m_nServerClassBits = 0;
+
+	m_ServerClasses.Purge();
+	m_Events.Purge();
+	m_Frames.Purge();
+
+	for ( int i = 0; i < (int)ARRAYSIZE( m_EventLookup ); i++ )
+	{
+		m_EventLookup[i] = -1;
+	}
+
+	for ( int i = 0; i < MAX_EDICTS; i++ )
+	{
+		Entity_t &ent = m_Entities[i];
+		ent.m_iClass = -1;
+		ent.m_nSerial = 0;
+		ent.m_bChanged = false;
+		ent.m_bWritten = false;
+		ent.m_Data.Purge();
+		ent.m_WrittenData.Purge();
+
+		for ( int j = 0; j < 2; j++ )
+		{
+			m_Baselines[j][i].m_iClass = -1;
+			m_Baselines[j][i].m_Data.Purge();
+			m_Baselines[j][i].m_nBits = 0;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Plays back a demo like CDemoPlayer::ReadPacket, as fast as it can be read
+//-----------------------------------------------------------------------------
+bool CDemoDecoder::DecodeDemo( const char *pFileName, CColumnFile &output )
+{
+	Reset();
+
+	CDemoFile demoFile;
+	if ( !demoFile.Open( pFileName, true ) )
+	{
+		Warning( "Couldn't open %s\n", pFileName );
+		return false;
+	}
+
+	demoheader_t *pHeader = demoFile.ReadDemoHeader();
+	if ( !pHeader )
+	{
+		Warning( "%s isn't a valid demo file\n", pFileName );
+		return false;
+	}
+
+	m_pStringTables = new CNetworkStringTableContainer;
+	m_pOutput = &output;
+	m_nDemoProtocol = pHeader->demoprotocol;
+	m_NetChannel.SetProtocolVersion( pHeader->networkprotocol );
+
+	m_pEntityOutput = output.FindOrAddTable( "entities" );
+	m_pEntityOutput->AddColumn( "tick", COLUMN_INT );
+	m_pEntityOutput->AddColumn( "entity", COLUMN_INT );
+	m_pEntityOutput->AddColumn( "serial", COLUMN_INT );
+	m_pEntityOutput->AddColumn( "class", COLUMN_STRING );
+	m_pEntityOutput->AddColumn( "action", COLUMN_STRING );
+
+	// Keyframes repeat state that was already read from the stream, skip them
+	demoFile.ReadIndex();
+
+	CUtlVector< unsigned char > packet;
+	packet.SetCount( NET_MAX_PAYLOAD );
+
+	bool bOk = true;
+	bool bDone = false;
+
+	while ( bOk && !bDone )
+	{
+		int nCurPos = demoFile.GetCurPos( true );
+		const demoindexentry_t *pKeyframe = demoFile.FindKeyframeAtPos( nCurPos );
+		if ( pKeyframe )
+		{
+			demoFile.SeekTo( nCurPos + pKeyframe->length, true );
+			continue;
+		}
+
+		unsigned char cmd;
+		int tick;
+		demoFile.ReadCmdHeader( cmd, tick );
+
+		switch ( cmd )
+		{
+		case dem_stop:
+			bDone = true;
+			break;
+
+		case dem_synctick:
+			break;
+
+		case dem_consolecmd:
+			demoFile.ReadConsoleCommand();
+			break;
+
+		case dem_usercmd:
+			{
+				char buffer[256];
+				int length = sizeof( buffer );
+				demoFile.ReadUserCmd( buffer, length );
+			}
+			break;
+
+		case dem_datatables:
+			{
+				CUtlVector< unsigned char > data;
+				data.SetCount( DEMO_DATATABLES_BUFFER_SIZE );
+				bf_read buf( "dem_datatables", data.Base(), data.Count() );
+				demoFile.ReadNetworkDataTables( &buf );
+				buf.Seek( 0 );
+				bOk = ReadDataTables( buf );
+			}
+			break;
+
+		case dem_stringtables:
+			{
+				CUtlVector< unsigned char > data;
+				int nSize = DEMO_STRINGTABLES_BUFFER_SIZE;
+				while ( true )
+				{
+					data.SetCount( nSize );
+					bf_read buf( "dem_stringtables", data.Base(), data.Count() );
+					if ( demoFile.ReadStringTables( &buf ) > 0 )
+					{
+						buf.Seek( 0 );
+						bOk = m_pStringTables->ReadStringTables( buf );
+						break;
+					}
+
+					if ( nSize >= DEMO_FILE_MAX_STRINGTABLE_SIZE )
+					{
+						Warning( "%s: string tables too large\n", pFileName );
+						bOk = false;
+						break;
+					}
+					nSize = MIN( nSize * 2, DEMO_FILE_MAX_STRINGTABLE_SIZE );
+				}
+			}
+			break;
+
+		case dem_signon:
+		case dem_packet:
+			{
+				democmdinfo_t info;
+				int nSeqNrIn, nSeqNrOutAck;
+				demoFile.ReadCmdInfo( info );
+				demoFile.ReadSequenceInfo( nSeqNrIn, nSeqNrOutAck );
+
+				int length = demoFile.ReadRawData( (char *)packet.Base(), packet.Count() );
+				if ( length > 0 )
+				{
+					bf_read buf( "dem_packet", packet.Base(), length );
+					bOk = m_NetChannel.ProcessMessages( buf );
+				}
+			}
+			break;
+
+		default:
+			Warning( "%s: unknown demo command %i\n", pFileName, cmd );
+			bOk = false;
+			break;
+		}
+	}
+
+	Reset();
+	return bOk;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Parses what CDemoRecorder::RecordServerClasses wrote and sets up the decoders
+//-----------------------------------------------------------------------------
+bool CDemoDecoder::ReadDataTables( bf_read &buf )
+{
+	if ( m_bDecodersReady )
+	{
+		Warning( "Demo contains more than one set of data tables\n" );
+		return false;
+	}
+
+	while ( buf.ReadOneBit() != 0 )
+	{
+		bool bNeedsDecoder = buf.ReadOneBit() != 0;
+		if ( !RecvTable_RecvClassInfos( &buf, bNeedsDecoder, m_nDemoProtocol ) )
+		{
+			Warning( "Error parsing send tables\n" );
+			return false;
+		}
+	}
+
+	int nClasses = buf.ReadShort();
+	if ( nClasses <= 0 || nClasses > MAX_SERVER_CLASSES )
+	{
+		Warning( "Bad number of server classes (%i)\n", nClasses );
+		return false;
+	}
+
+	m_ServerClasses.SetCount( nClasses );
+	for ( int i = 0; i < nClasses; i++ )
+	{
+		ServerClass_t &cls = m_ServerClasses[i];
+		cls.m_pTable = NULL;
+		cls.m_nSize = 0;
+		cls.m_iBaseline = INVALID_STRING_INDEX;
+		cls.m_bOutputSetup = false;
+		cls.m_pOutput = NULL;
+	}
+
+	for ( int i = 0; i < nClasses; i++ )
+	{
+		int iClass = buf.ReadShort();
+		if ( iClass < 0 || iClass >= nClasses )
+		{
+			Warning( "Bad server class id (%i)\n", iClass );
+			return false;
+		}
+
+		char name[256];
+		buf.ReadString( name, sizeof( name ) );
+		m_ServerClasses[iClass].m_ClassName = name;
+		buf.ReadString( name, sizeof( name ) );
+		m_ServerClasses[iClass].m_DataTableName = name;
+	}
+
+	if ( buf.IsOverflowed() )
+	{
+		Warning( "Data tables are truncated\n" );
+		return false;
+	}
+
+	// Term undoes a partial init too
+	m_bDecodersReady = true;
+
+	if ( !DemoRecvTables_Init() )
+	{
+		Warning( "Couldn't create decoders for the data tables\n" );
+		return false;
+	}
+
+	for ( int i = 0; i < nClasses; i++ )
+	{
+		ServerClass_t &cls = m_ServerClasses[i];
+		cls.m_pTable = DemoRecvTables_Find( cls.m_DataTableName.String() );
+		if ( !cls.m_pTable || !cls.m_pTable->m_pDecoder )
+		{
+			Warning( "No data table %s for class %s\n", cls.m_DataTableName.String(), cls.m_ClassName.String() );
+			return false;
+		}
+		cls.m_nSize = DemoRecvTables_GetSize( cls.m_pTable );
+	}
+
+	return true;
+}
+
+bool CDemoDecoder::ProcessTick( NET_Tick *msg )
+{
+	m_nServerTick = msg->m_nTick;
+	return true;
+}
+
+bool CDemoDecoder::ProcessServerInfo( SVC_ServerInfo *msg )
+{
+	if ( msg->m_nMaxClasses <= 0 || msg->m_nMaxClasses > MAX_SERVER_CLASSES )
+	{
+		Warning( "Bad number of server classes (%i)\n", msg->m_nMaxClasses );
+		return false;
+	}
+
+	m_nServerClassBits = Q_log2( msg->m_nMaxClasses ) + 1;
+	return true;
+}
+
+bool CDemoDecoder::ProcessCreateStringTable( SVC_CreateStringTable *msg )
+{
+	m_pStringTables->AllowCreation( true );
+	CNetworkStringTable *table = (CNetworkStringTable *)m_pStringTables->CreateStringTableEx( msg->m_szTableName, msg->m_nMaxEntries, msg->m_nUserDataSize, msg->m_nUserDataSizeBits, msg->m_bIsFilenames );
+	m_pStringTables->AllowCreation( false );
+
+	table->SetTick( m_nServerTick );
+
+	if ( msg->m_bDataCompressed )
+	{
+		unsigned int nUncompressedSize = msg->m_DataIn.ReadLong();
+		unsigned int nCompressedSize = msg->m_DataIn.ReadLong();
+
+		if ( msg->m_DataIn.TotalBytesAvailable() <= 0 ||
+			 nCompressedSize > (unsigned int)msg->m_DataIn.TotalBytesAvailable() ||
+			 nUncompressedSize > DEMO_FILE_MAX_STRINGTABLE_SIZE )
+		{
+			Warning( "Malformed string table %s\n", msg->m_szTableName );
+			return false;
+		}
+
+		CUtlVector< char > uncompressed, compressed;
+		uncompressed.SetCount( PAD_NUMBER( nUncompressedSize, 4 ) );
+		compressed.SetCount( PAD_NUMBER( nCompressedSize, 4 ) );
+
+		msg->m_DataIn.ReadBits( compressed.Base(), nCompressedSize * 8 );
+
+		unsigned int nDecompressedSize = nUncompressedSize;
+		if ( !COM_BufferToBufferDecompress( uncompressed.Base(), &nDecompressedSize, compressed.Base(), nCompressedSize ) ||
+			 nDecompressedSize != nUncompressedSize )
+		{
+			Warning( "Couldn't decompress string table %s\n", msg->m_szTableName );
+			return false;
+		}
+
+		bf_read data( uncompressed.Base(), nUncompressedSize );
+		table->ParseUpdate( data, msg->m_nNumEntries );
+	}
+	else
+	{
+		table->ParseUpdate( msg->m_DataIn, msg->m_nNumEntries );
+	}
+
+	return true;
+}
+
+bool CDemoDecoder::ProcessUpdateStringTable( SVC_UpdateStringTable *msg )
+{
+	CNetworkStringTable *table = (CNetworkStringTable *)m_pStringTables->GetTable( msg->m_nTableID );
+	if ( !table )
+	{
+		Warning( "Update for unknown string table %i\n", msg->m_nTableID );
+		return false;
+	}
+
+	table->ParseUpdate( msg->m_DataIn, msg->m_nChangedEntries );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Reads the event descriptors like CGameEventManager::ParseEventList and
+//			sets up one output table per event
+//-----------------------------------------------------------------------------
+bool CDemoDecoder::ProcessGameEventList( SVC_GameEventList *msg )
+{
+	m_Events.Purge();
+	for ( int i = 0; i < (int)ARRAYSIZE( m_EventLookup ); i++ )
+	{
+		m_EventLookup[i] = -1;
+	}
+
+	for ( int i = 0; i < msg->m_nNumEvents; i++ )
+	{
+		EventDescriptor_t &desc = m_Events[ m_Events.AddToTail() ];
+		desc.m_nEventID = msg->m_DataIn.ReadUBitLong( MAX_EVENT_BITS );
+		desc.m_pOutput = NULL;
+
+		char name[MAX_EVENT_NAME_LENGTH];
+		msg->m_DataIn.ReadString( name, sizeof( name ) );
+		desc.m_Name = name;
+
+		int type = msg->m_DataIn.ReadUBitLong( 3 );
+		while ( type != CGameEventManager::TYPE_LOCAL )
+		{
+			char keyName[MAX_EVENT_NAME_LENGTH];
+			msg->m_DataIn.ReadString( keyName, sizeof( keyName ) );
+
+			EventKey_t &key = desc.m_Keys[ desc.m_Keys.AddToTail() ];
+			key.m_Name = keyName;
+			key.m_Type = type;
+
+			type = msg->m_DataIn.ReadUBitLong( 3 );
+		}
+
+		if ( msg->m_DataIn.IsOverflowed() )
+		{
+			Warning( "Game event list is truncated\n" );
+			return false;
+		}
+
+		m_EventLookup[desc.m_nEventID] = m_Events.Count() - 1;
+
+		bool bCreated;
+		CColumnTable *pTable = m_pOutput->FindOrAddTable( CFmtStr( "event:%s", name ), &bCreated );
+		if ( bCreated )
+		{
+			pTable->AddColumn( "tick", COLUMN_INT );
+			for ( int j = 0; j < desc.m_Keys.Count(); j++ )
+			{
+				ColumnType_t columnType = COLUMN_INT;
+				if ( desc.m_Keys[j].m_Type == CGameEventManager::TYPE_STRING )
+					columnType = COLUMN_STRING;
+				else if ( desc.m_Keys[j].m_Type == CGameEventManager::TYPE_FLOAT )
+					columnType = COLUMN_FLOAT;
+
+				pTable->AddColumn( desc.m_Keys[j].m_Name.String(), columnType );
+			}
+		}
+		else if ( pTable->GetNumColumns() != desc.m_Keys.Count() + 1 )
+		{
+			Warning( "Event %s changed its keys, not writing it\n", name );
+			pTable = NULL;
+		}
+		desc.m_pOutput = pTable;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Reads the event values like CGameEventManager::UnserializeEvent
+//-----------------------------------------------------------------------------
+bool CDemoDecoder::ProcessGameEvent( SVC_GameEvent *msg )
+{
+	bf_read &buf = msg->m_DataIn;
+
+	int nEventID = buf.ReadUBitLong( MAX_EVENT_BITS );
+	if ( m_EventLookup[nEventID] < 0 )
+	{
+		Warning( "Unknown game event id %i\n", nEventID );
+		return true;
+	}
+
+	const EventDescriptor_t &desc = m_Events[ m_EventLookup[nEventID] ];
+	CColumnTable *pTable = desc.m_pOutput;
+	if ( !pTable )
+		return true;
+
+	pTable->SetInt( 0, m_nServerTick );
+
+	for ( int i = 0; i < desc.m_Keys.Count(); i++ )
+	{
+		int iColumn = i + 1;
+		switch ( desc.m_Keys[i].m_Type )
+		{
+		case CGameEventManager::TYPE_STRING:
+			{
+				char data[MAX_EVENT_BYTES];
+				buf.ReadString( data, sizeof( data ) );
+				pTable->SetString( iColumn, data );
+			}
+			break;
+		case CGameEventManager::TYPE_FLOAT:	pTable->SetFloat( iColumn, buf.ReadFloat() ); break;
+		case CGameEventManager::TYPE_LONG:	pTable->SetInt( iColumn, buf.ReadLong() ); break;
+		case CGameEventManager::TYPE_SHORT:	pTable->SetInt( iColumn, buf.ReadShort() ); break;
+		case CGameEventManager::TYPE_BYTE:	pTable->SetInt( iColumn, buf.ReadByte() ); break;
+		case CGameEventManager::TYPE_BOOL:	pTable->SetInt( iColumn, buf.ReadOneBit() ); break;
+		default:
+			Warning( "Event %s has unknown key type %i\n", desc.m_Name.String(), desc.m_Keys[i].m_Type );
+			break;
+		}
+	}
+
+	pTable->EndRow();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Same as CBaseClientState::ProcessPacketEntities, with frames reduced to
+//			the transmit bits the next delta needs
+//-----------------------------------------------------------------------------
+bool CDemoDecoder::ProcessPacketEntities( SVC_PacketEntities *msg )
+{
+	if ( !m_bDecodersReady || !m_nServerClassBits )
+	{
+		Warning( "Packet entities before server info and data tables\n" );
+		return false;
+	}
+
+	Frame_t *pFrom = NULL;
+	if ( msg->m_bIsDelta )
+	{
+		if ( m_nServerTick == msg->m_nDeltaFrom )
+		{
+			Warning( "Update self-referencing tick %i\n", m_nServerTick );
+			return false;
+		}
+
+		pFrom = FindFrame( msg->m_nDeltaFrom );
+		if ( !pFrom )
+		{
+			// Same as the client, the next full update will fix it
+			DevWarning( "Tick %i: delta from unknown tick %i\n", m_nServerTick, msg->m_nDeltaFrom );
+			return true;
+		}
+	}
+	else
+	{
+		for ( int i = 0; i < MAX_EDICTS; i++ )
+		{
+			DeleteEntity( i );
+		}
+	}
+
+	if ( msg->m_bUpdateBaseline )
+	{
+		// Server switches to the other baseline, start it as a copy of the current one
+		int iFrom = msg->m_nBaseline;
+		int iTo = iFrom == 0 ? 1 : 0;
+		for ( int i = 0; i < MAX_EDICTS; i++ )
+		{
+			m_Baselines[iTo][i].m_iClass = m_Baselines[iFrom][i].m_iClass;
+			m_Baselines[iTo][i].m_Data.CopyArray( m_Baselines[iFrom][i].m_Data.Base(), m_Baselines[iFrom][i].m_Data.Count() );
+			m_Baselines[iTo][i].m_nBits = m_Baselines[iFrom][i].m_nBits;
+		}
+	}
+
+	Frame_t to;
+	to.m_nTick = m_nServerTick;
+	to.m_nLastEntity = -1;
+	to.m_Transmit.ClearAll();
+
+	EntityReadInfo_t u;
+	u.m_pBuf = &msg->m_DataIn;
+	u.m_pFrom = pFrom;
+	u.m_pTo = &to;
+	u.m_bAsDelta = msg->m_bIsDelta;
+	u.m_UpdateType = PreserveEnt;
+	u.m_nOldEntity = -1;
+	u.m_nNewEntity = -1;
+	u.m_nHeaderBase = -1;
+	u.m_nHeaderCount = msg->m_nUpdatedEntries;
+	u.m_UpdateFlags = FHDR_ZERO;
+	u.m_bIsEntity = false;
+	u.m_nBaseline = msg->m_nBaseline;
+	u.m_bUpdateBaselines = msg->m_bUpdateBaseline;
+
+	if ( !ReadPacketEntities( u ) )
+		return false;
+
+	WriteChangedEntities();
+
+	// The server won't delta from anything older than this again
+	if ( msg->m_bIsDelta )
+	{
+		while ( m_Frames.Count() && m_Frames[0].m_nTick < msg->m_nDeltaFrom )
+		{
+			m_Frames.Remove( 0 );
+		}
+	}
+
+	if ( m_Frames.Count() >= MAX_DEMO_FRAMES )
+	{
+		m_Frames.Remove( 0 );
+	}
+	m_Frames.AddToTail( to );
+
+	return true;
+}
+
+CDemoDecoder::Frame_t *CDemoDecoder::FindFrame( int nTick )
+{
+	for ( int i = m_Frames.Count() - 1; i >= 0; i-- )
+	{
+		if ( m_Frames[i].m_nTick == nTick )
+			return &m_Frames[i];
+	}
+	return NULL;
+}
+
+bool CDemoDecoder::ReadPacketEntities( EntityReadInfo_t &u )
+{
+	u.NextOldEntity();
+
+	while ( u.m_UpdateType < Finished )
+	{
+		u.m_nHeaderCount--;
+		u.m_bIsEntity = u.m_nHeaderCount >= 0;
+
+		if ( u.m_bIsEntity )
+		{
+			// Same as CL_ParseDeltaHeader
+			u.m_UpdateFlags = FHDR_ZERO;
+			u.m_nNewEntity = u.m_nHeaderBase + 1 + u.m_pBuf->ReadUBitVar();
+			u.m_nHeaderBase = u.m_nNewEntity;
+
+			if ( u.m_pBuf->ReadOneBit() == 0 )
+			{
+				if ( u.m_pBuf->ReadOneBit() != 0 )
+				{
+					u.m_UpdateFlags |= FHDR_ENTERPVS;
+				}
+			}
+			else
+			{
+				u.m_UpdateFlags |= FHDR_LEAVEPVS;
+				if ( u.m_pBuf->ReadOneBit() != 0 )
+				{
+					u.m_UpdateFlags |= FHDR_DELETE;
+				}
+			}
+
+			if ( u.m_nNewEntity < 0 || u.m_nNewEntity >= MAX_EDICTS )
+			{
+				Warning( "Bad entity index %i\n", u.m_nNewEntity );
+				return false;
+			}
+		}
+
+		u.m_UpdateType = PreserveEnt;
+
+		while ( u.m_UpdateType == PreserveEnt )
+		{
+			// Same as CL_DetermineUpdateType
+			if ( !u.m_bIsEntity || u.m_nNewEntity > u.m_nOldEntity )
+			{
+				if ( !u.m_pFrom || u.m_nOldEntity > u.m_pFrom->m_nLastEntity )
+				{
+					u.m_UpdateType = Finished;
+					break;
+				}
+				u.m_UpdateType = PreserveEnt;
+			}
+			else if ( u.m_UpdateFlags & FHDR_ENTERPVS )
+			{
+				u.m_UpdateType = EnterPVS;
+			}
+			else if ( u.m_UpdateFlags & FHDR_LEAVEPVS )
+			{
+				u.m_UpdateType = LeavePVS;
+			}
+			else
+			{
+				u.m_UpdateType = DeltaEnt;
+			}
+
+			switch ( u.m_UpdateType )
+			{
+			case EnterPVS:
+				if ( !ReadEnterPVS( u ) )
+					return false;
+				break;
+
+			case LeavePVS:
+				ReadLeavePVS( u );
+				break;
+
+			case DeltaEnt:
+				if ( !ReadDeltaEnt( u ) )
+					return false;
+				break;
+
+			case PreserveEnt:
+				ReadPreserveEnt( u );
+				break;
+
+			default:
+				break;
+			}
+		}
+	}
+
+	if ( u.m_UpdateType == Failed )
+		return false;
+
+	if ( u.m_bAsDelta )
+	{
+		ReadDeletions( u );
+	}
+
+	if ( u.m_pBuf->IsOverflowed() )
+	{
+		Warning( "Packet entities buffer overflow\n" );
+		return false;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Same as CL_CopyNewEntity, the entity gets its baseline and then the
+//			delta from the stream
+//-----------------------------------------------------------------------------
+bool CDemoDecoder::ReadEnterPVS( EntityReadInfo_t &u )
+{
+	int iClass = u.m_pBuf->ReadUBitLong( m_nServerClassBits );
+	int nSerial = u.m_pBuf->ReadUBitLong( NUM_NETWORKED_EHANDLE_SERIAL_NUMBER_BITS );
+	int iEnt = u.m_nNewEntity;
+
+	if ( iClass >= m_ServerClasses.Count() )
+	{
+		Warning( "Entity %i has bad class %i\n", iEnt, iClass );
+		return false;
+	}
+
+	ServerClass_t &cls = m_ServerClasses[iClass];
+	Entity_t &ent = m_Entities[iEnt];
+
+	// A new serial number is a new entity in the same slot
+	if ( ent.m_iClass >= 0 && ( ent.m_nSerial != nSerial || ent.m_iClass != iClass ) )
+	{
+		DeleteEntity( iEnt );
+	}
+
+	if ( ent.m_iClass < 0 )
+	{
+		ent.m_iClass = iClass;
+		ent.m_nSerial = nSerial;
+		ent.m_bWritten = false;
+		ent.m_Data.SetCount( MAX( cls.m_nSize, (int)sizeof( int ) ) );
+		V_memset( ent.m_Data.Base(), 0, ent.m_Data.Count() );
+		WriteEntityAction( iEnt, "create" );
+	}
+	else
+	{
+		WriteEntityAction( iEnt, "enter" );
+	}
+
+	const void *pFromData;
+	int nFromBits;
+
+	Baseline_t &baseline = m_Baselines[u.m_nBaseline][iEnt];
+	if ( u.m_bAsDelta && baseline.m_iClass == iClass )
+	{
+		pFromData = baseline.m_Data.Base();
+		nFromBits = baseline.m_nBits;
+	}
+	else
+	{
+		int nBytes;
+		if ( !GetClassBaseline( iClass, &pFromData, &nBytes ) )
+		{
+			Warning( "No baseline for class %s\n", cls.m_ClassName.String() );
+			return false;
+		}
+		nFromBits = nBytes * 8;
+	}
+
+	bf_read fromBuf( "ReadEnterPVS", pFromData, Bits2Bytes( nFromBits ), nFromBits );
+
+	if ( u.m_bUpdateBaselines )
+	{
+		ALIGN4 char packedData[MAX_PACKEDENTITY_DATA] ALIGN4_POST;
+		bf_write writeBuf( "ReadEnterPVS", packedData, sizeof( packedData ) );
+
+		RecvTable_MergeDeltas( cls.m_pTable, &fromBuf, u.m_pBuf, &writeBuf );
+
+		Baseline_t &newBaseline = m_Baselines[ u.m_nBaseline == 0 ? 1 : 0 ][iEnt];
+		newBaseline.m_iClass = iClass;
+		newBaseline.m_Data.CopyArray( (unsigned char *)packedData, writeBuf.GetNumBytesWritten() );
+		newBaseline.m_nBits = writeBuf.GetNumBitsWritten();
+
+		bf_read mergedBuf( "ReadEnterPVS", packedData, writeBuf.GetNumBytesWritten(), writeBuf.GetNumBitsWritten() );
+		RecvTable_Decode( cls.m_pTable, ent.m_Data.Base(), &mergedBuf, iEnt, false );
+	}
+	else
+	{
+		RecvTable_Decode( cls.m_pTable, ent.m_Data.Base(), &fromBuf, iEnt, false );
+		RecvTable_Decode( cls.m_pTable, ent.m_Data.Base(), u.m_pBuf, iEnt );
+	}
+
+	ent.m_bChanged = true;
+
+	u.m_pTo->m_nLastEntity = iEnt;
+	u.m_pTo->m_Transmit.Set( iEnt );
+
+	// If it was in the old frame too, it's handled
+	if ( u.m_nNewEntity == u.m_nOldEntity )
+	{
+		u.NextOldEntity();
+	}
+
+	return true;
+}
+
+bool CDemoDecoder::ReadDeltaEnt( EntityReadInfo_t &u )
+{
+	int iEnt = u.m_nNewEntity;
+	Entity_t &ent = m_Entities[iEnt];
+
+	if ( ent.m_iClass < 0 )
+	{
+		Warning( "Delta for entity %i that doesn't exist\n", iEnt );
+		return false;
+	}
+
+	RecvTable_Decode( m_ServerClasses[ent.m_iClass].m_pTable, ent.m_Data.Base(), u.m_pBuf, iEnt );
+	ent.m_bChanged = true;
+
+	u.m_pTo->m_nLastEntity = iEnt;
+	u.m_pTo->m_Transmit.Set( iEnt );
+
+	u.NextOldEntity();
+	return true;
+}
+
+void CDemoDecoder::ReadLeavePVS( EntityReadInfo_t &u )
+{
+	if ( !u.m_bAsDelta )
+	{
+		Warning( "Leave PVS on full update\n" );
+		u.m_UpdateType = Failed;
+		return;
+	}
+
+	if ( u.m_UpdateFlags & FHDR_DELETE )
+	{
+		DeleteEntity( u.m_nOldEntity );
+	}
+	else
+	{
+		WriteEntityAction( u.m_nOldEntity, "leave" );
+	}
+
+	u.NextOldEntity();
+}
+
+void CDemoDecoder::ReadPreserveEnt( EntityReadInfo_t &u )
+{
+	if ( !u.m_bAsDelta || u.m_nOldEntity >= MAX_EDICTS )
+	{
+		Warning( "Bad preserved entity %i\n", u.m_nOldEntity );
+		u.m_UpdateType = Failed;
+		return;
+	}
+
+	u.m_pTo->m_nLastEntity = u.m_nOldEntity;
+	u.m_pTo->m_Transmit.Set( u.m_nOldEntity );
+
+	u.NextOldEntity();
+}
+
+void CDemoDecoder::ReadDeletions( EntityReadInfo_t &u )
+{
+	while ( u.m_pBuf->ReadOneBit() != 0 )
+	{
+		int iEnt = u.m_pBuf->ReadUBitLong( MAX_EDICT_BITS );
+		DeleteEntity( iEnt );
+	}
+}
+
+bool CDemoDecoder::GetClassBaseline( int iClass, const void **pData, int *pnBytes )
+{
+	INetworkStringTable *pBaselines = m_pStringTables->FindTable( INSTANCE_BASELINE_TABLENAME );
+	if ( !pBaselines )
+		return false;
+
+	ServerClass_t &cls = m_ServerClasses[iClass];
+	if ( cls.m_iBaseline == INVALID_STRING_INDEX )
+	{
+		char str[64];
+		Q_snprintf( str, sizeof( str ), "%d", iClass );
+		cls.m_iBaseline = pBaselines->FindStringIndex( str );
+		if ( cls.m_iBaseline == INVALID_STRING_INDEX )
+			return false;
+	}
+
+	*pData = pBaselines->GetStringUserData( cls.m_iBaseline, pnBytes );
+	return *pData != NULL;
+}
+
+void CDemoDecoder::DeleteEntity( int iEntity )
+{
+	Entity_t &ent = m_Entities[iEntity];
+	if ( ent.m_iClass < 0 )
+		return;
+
+	// Don't lose what it was decoded to in this packet
+	if ( ent.m_bChanged )
+	{
+		WriteEntityProps( iEntity );
+	}
+
+	WriteEntityAction( iEntity, "delete" );
+
+	ent.m_iClass = -1;
+	ent.m_bChanged = false;
+	ent.m_bWritten = false;
+	ent.m_Data.Purge();
+	ent.m_WrittenData.Purge();
+}
+
+void CDemoDecoder::WriteEntityAction( int iEntity, const char *pAction )
+{
+	const Entity_t &ent = m_Entities[iEntity];
+	if ( ent.m_iClass < 0 )
+		return;
+
+	m_pEntityOutput->SetInt( 0, m_nServerTick );
+	m_pEntityOutput->SetInt( 1, iEntity );
+	m_pEntityOutput->SetInt( 2, ent.m_nSerial );
+	m_pEntityOutput->SetString( 3, m_ServerClasses[ent.m_iClass].m_ClassName.String() );
+	m_pEntityOutput->SetString( 4, pAction );
+	m_pEntityOutput->EndRow();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Picks the props of a class that get written and adds their columns
+//-----------------------------------------------------------------------------
+void CDemoDecoder::SetupClassOutput( int iClass )
+{
+	ServerClass_t &cls = m_ServerClasses[iClass];
+	cls.m_bOutputSetup = true;
+
+	CRecvDecoder *pDecoder = cls.m_pTable->m_pDecoder;
+	CUtlVector< int > offsets;
+	DemoRecvTables_GetPropOffsets( pDecoder, offsets );
+
+	CUtlVector< const char * > propNames;
+
+	for ( int i = 0; i < pDecoder->GetNumProps(); i++ )
+	{
+		const SendProp *pProp = pDecoder->GetSendProp( i );
+		if ( offsets[i] < 0 || !m_Options.WantsProp( pProp->GetName() ) )
+			continue;
+
+		OutputProp_t prop;
+		prop.m_nOffset = offsets[i];
+		prop.m_Type = pProp->GetType();
+		prop.m_iColumn = -1;
+
+		switch ( prop.m_Type )
+		{
+		case DPT_Int:		prop.m_nSize = sizeof( int ); break;
+		case DPT_Float:		prop.m_nSize = sizeof( float ); break;
+		case DPT_Vector:	prop.m_nSize = 3 * sizeof( float ); break;
+		case DPT_VectorXY:	prop.m_nSize = 2 * sizeof( float ); break;
+		case DPT_String:	prop.m_nSize = DT_MAX_STRING_BUFFERSIZE; break;
+		default:			continue;	// arrays aren't written
+		}
+
+		cls.m_OutputProps.AddToTail( prop );
+		propNames.AddToTail( pProp->GetName() );
+	}
+
+	if ( !cls.m_OutputProps.Count() )
+		return;
+
+	cls.m_pOutput = m_pOutput->FindOrAddTable( cls.m_ClassName.String() );
+	cls.m_pOutput->AddColumn( "tick", COLUMN_INT );
+	cls.m_pOutput->AddColumn( "entity", COLUMN_INT );
+
+	// Props of different base classes can share a name
+	CUtlVector< CUtlString > names;
+
+	for ( int i = 0; i < cls.m_OutputProps.Count(); i++ )
+	{
+		OutputProp_t &prop = cls.m_OutputProps[i];
+		const char *pName = propNames[i];
+
+		CUtlString name( pName );
+		for ( int nSuffix = 2; names.Find( name ) != names.InvalidIndex(); nSuffix++ )
+		{
+			name = CFmtStr( "%s#%d", pName, nSuffix ).Access();
+		}
+		names.AddToTail( name );
+
+		switch ( prop.m_Type )
+		{
+		case DPT_Int:
+			prop.m_iColumn = cls.m_pOutput->AddColumn( name.String(), COLUMN_INT );
+			break;
+		case DPT_Float:
+			prop.m_iColumn = cls.m_pOutput->AddColumn( name.String(), COLUMN_FLOAT );
+			break;
+		case DPT_Vector:
+			prop.m_iColumn = cls.m_pOutput->AddColumn( CFmtStr( "%s_x", name.String() ), COLUMN_FLOAT );
+			cls.m_pOutput->AddColumn( CFmtStr( "%s_y", name.String() ), COLUMN_FLOAT );
+			cls.m_pOutput->AddColumn( CFmtStr( "%s_z", name.String() ), COLUMN_FLOAT );
+			break;
+		case DPT_VectorXY:
+			prop.m_iColumn = cls.m_pOutput->AddColumn( CFmtStr( "%s_x", name.String() ), COLUMN_FLOAT );
+			cls.m_pOutput->AddColumn( CFmtStr( "%s_y", name.String() ), COLUMN_FLOAT );
+			break;
+		case DPT_String:
+			prop.m_iColumn = cls.m_pOutput->AddColumn( name.String(), COLUMN_STRING );
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes a row for an entity if any of the written props changed
+//-----------------------------------------------------------------------------
+void CDemoDecoder::WriteEntityProps( int iEntity )
+{
+	Entity_t &ent = m_Entities[iEntity];
+	ServerClass_t &cls = m_ServerClasses[ent.m_iClass];
+	ent.m_bChanged = false;
+
+	if ( !cls.m_bOutputSetup )
+	{
+		SetupClassOutput( ent.m_iClass );
+	}
+
+	if ( !cls.m_pOutput )
+		return;
+
+	const unsigned char *pData = ent.m_Data.Base();
+
+	if ( ent.m_bWritten )
+	{
+		bool bDifferent = false;
+		for ( int i = 0; i < cls.m_OutputProps.Count() && !bDifferent; i++ )
+		{
+			const OutputProp_t &prop = cls.m_OutputProps[i];
+			const unsigned char *pOld = ent.m_WrittenData.Base() + prop.m_nOffset;
+			const unsigned char *pNew = pData + prop.m_nOffset;
+
+			// The string proxy leaves old characters behind the terminator
+			if ( prop.m_Type == DPT_String )
+				bDifferent = Q_strcmp( (const char *)pOld, (const char *)pNew ) != 0;
+			else
+				bDifferent = V_memcmp( pOld, pNew, prop.m_nSize ) != 0;
+		}
+
+		if ( !bDifferent )
+			return;
+	}
+
+	CColumnTable *pTable = cls.m_pOutput;
+	pTable->SetInt( 0, m_nServerTick );
+	pTable->SetInt( 1, iEntity );
+
+	for ( int i = 0; i < cls.m_OutputProps.Count(); i++ )
+	{
+		const OutputProp_t &prop = cls.m_OutputProps[i];
+		const void *pValue = pData + prop.m_nOffset;
+
+		switch ( prop.m_Type )
+		{
+		case DPT_Int:
+			pTable->SetInt( prop.m_iColumn, *(const int *)pValue );
+			break;
+		case DPT_Float:
+			pTable->SetFloat( prop.m_iColumn, *(const float *)pValue );
+			break;
+		case DPT_Vector:
+			pTable->SetFloat( prop.m_iColumn, ( (const float *)pValue )[0] );
+			pTable->SetFloat( prop.m_iColumn + 1, ( (const float *)pValue )[1] );
+			pTable->SetFloat( prop.m_iColumn + 2, ( (const float *)pValue )[2] );
+			break;
+		case DPT_VectorXY:
+			pTable->SetFloat( prop.m_iColumn, ( (const float *)pValue )[0] );
+			pTable->SetFloat( prop.m_iColumn + 1, ( (const float *)pValue )[1] );
+			break;
+		case DPT_String:
+			pTable->SetString( prop.m_iColumn, (const char *)pValue );
+			break;
+		default:
+			break;
+		}
+	}
+
+	pTable->EndRow();
+
+	ent.m_WrittenData.CopyArray( pData, ent.m_Data.Count() );
+	ent.m_bWritten = true;
+}
+
+void CDemoDecoder::WriteChangedEntities()
+{
+	for ( int i = 0; i < MAX_EDICTS; i++ )
+	{
+		if ( m_Entities[i].m_iClass >= 0 && m_Entities[i].m_bChanged )
+		{
+			WriteEntityProps( i );
+		}
+	}
+}
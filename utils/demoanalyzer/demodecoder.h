@@ -0,0 +1,312 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Decodes a demo file into column tables without a client.
+//
+//			Reads the demo with CDemoFile, feeds its packets through the regular
+//			net messages and decodes entities with the engine's recv table decoder.
+//			Entity lifetimes go into the "entities" table, prop values into one table
+//			per server class and game events into one "event:<name>" table each.
+//
+//=============================================================================//
+
+#ifndef DEMODECODER_H
+#define DEMODECODER_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "inetmsghandler.h"
+#include "inetchannel.h"
+#include "netmessages.h"
+#include "protocol.h"
+#include "networkstringtable.h"
+#include "dt_common.h"
+#include "bitvec.h"
+#include "tier1/utlvector.h"
+#include "tier1/utlstring.h"
+#include "const.h"
+#include "igameevents.h"
+#include "columnwriter.h"
+
+class CDemoFile;
+class RecvTable;
+class CRecvDecoder;
+
+//-----------------------------------------------------------------------------
+// Which props of which classes get written
+//-----------------------------------------------------------------------------
+struct DemoAnalyzerOptions_t
+{
+	DemoAnalyzerOptions_t() : m_bAllProps( false ) {}
+
+	bool	WantsProp( const char *pName ) const;
+
+	bool						m_bAllProps;
+	CUtlVector< CUtlString >	m_Props;
+};
+
+//-----------------------------------------------------------------------------
+// The net messages in a demo packet are parsed through a net channel, this one
+// just holds the registered messages and the protocol the demo was recorded with
+//-----------------------------------------------------------------------------
+class CDemoNetChannel : public INetChannel
+{
+public:
+	CDemoNetChannel();
+	virtual ~CDemoNetChannel();
+
+	void			SetProtocolVersion( int nProtocol ) { m_nProtocol = nProtocol; }
+	INetMessage		*FindMessage( int type );
+
+	// Parses and processes all messages in a packet, false on a bad message or disconnect
+	bool			ProcessMessages( bf_read &buf );
+
+	// INetChannelInfo
+	virtual const char  *GetName( void ) const { return "demo"; }
+	virtual const char  *GetAddress( void ) const { return "demo"; }
+	virtual float		GetTime( void ) const { return 0.0f; }
+	virtual float		GetTimeConnected( void ) const { return 0.0f; }
+	virtual int			GetBufferSize( void ) const { return 0; }
+	virtual int			GetDataRate( void ) const { return 0; }
+	virtual bool		IsLoopback( void ) const { return false; }
+	virtual bool		IsTimingOut( void ) const { return false; }
+	virtual bool		IsPlayback( void ) const { return true; }
+	virtual float		GetLatency( int flow ) const { return 0.0f; }
+	virtual float		GetAvgLatency( int flow ) const { return 0.0f; }
+	virtual float		GetAvgLoss( int flow ) const { return 0.0f; }
+	virtual float		GetAvgChoke( int flow ) const { return 0.0f; }
+	virtual float		GetAvgData( int flow ) const { return 0.0f; }
+	virtual float		GetAvgPackets( int flow ) const { return 0.0f; }
+	virtual int			GetTotalData( int flow ) const { return 0; }
+	virtual int			GetSequenceNr( int flow ) const { return 0; }
+	virtual bool		IsValidPacket( int flow, int frame_number ) const { return true; }
+	virtual float		GetPacketTime( int flow, int frame_number ) const { return 0.0f; }
+	virtual int			GetPacketBytes( int flow, int frame_number, int group ) const { return 0; }
+	virtual bool		GetStreamProgress( int flow, int *received, int *total ) const { return false; }
+	virtual float		GetTimeSinceLastReceived( void ) const { return 0.0f; }
+	virtual	float		GetCommandInterpolationAmount( int flow, int frame_number ) const { return 0.0f; }
+	virtual void		GetPacketResponseLatency( int flow, int frame_number, int *pnLatencyMsecs, int *pnChoke ) const { *pnLatencyMsecs = 0; *pnChoke = 0; }
+	virtual void		GetRemoteFramerate( float *pflFrameTime, float *pflFrameTimeStdDeviation ) const { *pflFrameTime = 0.0f; *pflFrameTimeStdDeviation = 0.0f; }
+	virtual float		GetTimeoutSeconds() const { return 0.0f; }
+
+	// INetChannel
+	virtual void	SetDataRate(float rate) {}
+	virtual bool	RegisterMessage(INetMessage *msg);
+	virtual bool	StartStreaming( unsigned int challengeNr ) { return false; }
+	virtual void	ResetStreaming( void ) {}
+	virtual void	SetTimeout(float seconds) {}
+	virtual void	SetDemoRecorder(IDemoRecorder *recorder) {}
+	virtual void	SetChallengeNr(unsigned int chnr) {}
+	virtual void	Reset( void ) {}
+	virtual void	Clear( void ) {}
+	virtual void	Shutdown(const char *reason) {}
+	virtual void	ProcessPlayback( void ) {}
+	virtual bool	ProcessStream( void ) { return false; }
+	virtual void	ProcessPacket( struct netpacket_s* packet, bool bHasHeader ) {}
+	virtual bool	SendNetMsg(INetMessage &msg, bool bForceReliable = false, bool bVoice = false ) { return true; }
+	virtual bool	SendData(bf_write &msg, bool bReliable = true) { return true; }
+	virtual bool	SendFile(const char *filename, unsigned int transferID) { return false; }
+	virtual void	DenyFile(const char *filename, unsigned int transferID) {}
+	virtual void	RequestFile_OLD(const char *filename, unsigned int transferID) {}
+	virtual void	SetChoked( void ) {}
+	virtual int		SendDatagram(bf_write *data) { return 0; }
+	virtual bool	Transmit(bool onlyReliable = false) { return true; }
+	virtual const netadr_t	&GetRemoteAddress( void ) const;
+	virtual INetChannelHandler *GetMsgHandler( void ) const { return NULL; }
+	virtual int				GetDropNumber( void ) const { return 0; }
+	virtual int				GetSocket( void ) const { return 0; }
+	virtual unsigned int	GetChallengeNr( void ) const { return 0; }
+	virtual void			GetSequenceData( int &nOutSequenceNr, int &nInSequenceNr, int &nOutSequenceNrAck ) { nOutSequenceNr = nInSequenceNr = nOutSequenceNrAck = 0; }
+	virtual void			SetSequenceData( int nOutSequenceNr, int nInSequenceNr, int nOutSequenceNrAck ) {}
+	virtual void	UpdateMessageStats( int msggroup, int bits) {}
+	virtual bool	CanPacket( void ) const { return false; }
+	virtual bool	IsOverflowed( void ) const { return false; }
+	virtual bool	IsTimedOut( void ) const { return false; }
+	virtual bool	HasPendingReliableData( void ) { return false; }
+	virtual void	SetFileTransmissionMode(bool bBackgroundMode) {}
+	virtual void	SetCompressionMode( bool bUseCompression ) {}
+	virtual unsigned int RequestFile(const char *filename) { return 0; }
+	virtual void	SetMaxBufferSize(bool bReliable, int nBytes, bool bVoice = false ) {}
+	virtual bool	IsNull() const { return false; }
+	virtual int		GetNumBitsWritten( bool bReliable ) { return 0; }
+	virtual void	SetInterpolationAmount( float flInterpolationAmount ) {}
+	virtual void	SetRemoteFramerate( float flFrameTime, float flFrameTimeStdDeviation ) {}
+	virtual void	SetMaxRoutablePayloadSize( int nSplitSize ) {}
+	virtual int		GetMaxRoutablePayloadSize() { return 0; }
+	virtual int		GetProtocolVersion() { return m_nProtocol; }
+
+private:
+	CUtlVector< INetMessage * >	m_NetMessages;
+	int							m_nProtocol;
+};
+
+//-----------------------------------------------------------------------------
+// Decodes one demo at a time. Uses the engine's global decoder state, so there
+// can only be one per process.
+//-----------------------------------------------------------------------------
+class CDemoDecoder : public IServerMessageHandler
+{
+public:
+	CDemoDecoder( const DemoAnalyzerOptions_t &options );
+	virtual ~CDemoDecoder();
+
+	bool	DecodeDemo( const char *pFileName, CColumnFile &output );
+
+	// IServerMessageHandler
+	virtual int GetDemoProtocolVersion() const { return m_nDemoProtocol; }
+
+	PROCESS_NET_MESSAGE( Tick );
+	PROCESS_NET_MESSAGE( StringCmd ) { return true; }
+	PROCESS_NET_MESSAGE( SetConVar ) { return true; }
+	PROCESS_NET_MESSAGE( SignonState ) { return true; }
+
+	PROCESS_SVC_MESSAGE( Print ) { return true; }
+	PROCESS_SVC_MESSAGE( ServerInfo );
+	PROCESS_SVC_MESSAGE( SendTable ) { return true; }
+	PROCESS_SVC_MESSAGE( ClassInfo ) { return true; }
+	PROCESS_SVC_MESSAGE( SetPause ) { return true; }
+	PROCESS_SVC_MESSAGE( CreateStringTable );
+	PROCESS_SVC_MESSAGE( UpdateStringTable );
+	PROCESS_SVC_MESSAGE( VoiceInit ) { return true; }
+	PROCESS_SVC_MESSAGE( VoiceData ) { return true; }
+	PROCESS_SVC_MESSAGE( Sounds ) { return true; }
+	PROCESS_SVC_MESSAGE( SetView ) { return true; }
+	PROCESS_SVC_MESSAGE( FixAngle ) { return true; }
+	PROCESS_SVC_MESSAGE( CrosshairAngle ) { return true; }
+	PROCESS_SVC_MESSAGE( BSPDecal ) { return true; }
+	PROCESS_SVC_MESSAGE( GameEvent );
+	PROCESS_SVC_MESSAGE( UserMessage ) { return true; }
+	PROCESS_SVC_MESSAGE( EntityMessage ) { return true; }
+	PROCESS_SVC_MESSAGE( PacketEntities );
+	PROCESS_SVC_MESSAGE( TempEntities ) { return true; }
+	PROCESS_SVC_MESSAGE( Prefetch ) { return true; }
+	PROCESS_SVC_MESSAGE( Menu ) { return true; }
+	PROCESS_SVC_MESSAGE( GameEventList );
+	PROCESS_SVC_MESSAGE( GetCvarValue ) { return true; }
+	PROCESS_SVC_MESSAGE( CmdKeyValues ) { return true; }
+	PROCESS_SVC_MESSAGE( SetPauseTimed ) { return true; }
+
+private:
+	struct OutputProp_t
+	{
+		int				m_nOffset;
+		SendPropType	m_Type;
+		int				m_iColumn;		// first column, vectors use 2 or 3
+		int				m_nSize;		// bytes compared to find changes
+	};
+
+	struct ServerClass_t
+	{
+		CUtlString		m_ClassName;
+		CUtlString		m_DataTableName;
+		RecvTable		*m_pTable;
+		int				m_nSize;
+		int				m_iBaseline;		// index in the instancebaseline table
+		bool			m_bOutputSetup;
+		CColumnTable	*m_pOutput;			// NULL if no props of this class are written
+		CUtlVector< OutputProp_t > m_OutputProps;
+	};
+
+	struct Entity_t
+	{
+		int				m_iClass;			// -1 if the slot is free
+		int				m_nSerial;
+		bool			m_bChanged;			// decoded this packet
+		bool			m_bWritten;			// a row was written since it was created
+		CUtlVector< unsigned char > m_Data;
+		CUtlVector< unsigned char > m_WrittenData;	// values of the last row
+	};
+
+	struct Baseline_t
+	{
+		int				m_iClass;			// -1 if not set
+		CUtlVector< unsigned char > m_Data;
+		int				m_nBits;
+	};
+
+	// Which entities a packet contained, needed to read later packets that delta from it
+	struct Frame_t
+	{
+		int					m_nTick;
+		int					m_nLastEntity;
+		CBitVec<MAX_EDICTS>	m_Transmit;
+	};
+
+	struct EventKey_t
+	{
+		CUtlString		m_Name;
+		int				m_Type;
+	};
+
+	struct EventDescriptor_t
+	{
+		int				m_nEventID;
+		CUtlString		m_Name;
+		CUtlVector< EventKey_t > m_Keys;
+		CColumnTable	*m_pOutput;
+	};
+
+	struct EntityReadInfo_t
+	{
+		bf_read		*m_pBuf;
+		Frame_t		*m_pFrom;
+		Frame_t		*m_pTo;
+		bool		m_bAsDelta;
+		UpdateType	m_UpdateType;
+		int			m_nOldEntity;
+		int			m_nNewEntity;
+		int			m_nHeaderBase;
+		int			m_nHeaderCount;
+		int			m_UpdateFlags;
+		bool		m_bIsEntity;
+		int			m_nBaseline;
+		bool		m_bUpdateBaselines;
+
+		void		NextOldEntity();
+	};
+
+	void	Reset();
+	bool	ReadDataTables( bf_read &buf );
+	bool	ReadStringTables( bf_read &buf );
+
+	// Entities
+	bool	ReadPacketEntities( EntityReadInfo_t &u );
+	bool	ReadEnterPVS( EntityReadInfo_t &u );
+	bool	ReadDeltaEnt( EntityReadInfo_t &u );
+	void	ReadLeavePVS( EntityReadInfo_t &u );
+	void	ReadPreserveEnt( EntityReadInfo_t &u );
+	void	ReadDeletions( EntityReadInfo_t &u );
+	bool	GetClassBaseline( int iClass, const void **pData, int *pnBytes );
+	void	DeleteEntity( int iEntity );
+	Frame_t	*FindFrame( int nTick );
+
+	// Output
+	void	WriteEntityAction( int iEntity, const char *pAction );
+	void	SetupClassOutput( int iClass );
+	void	WriteEntityProps( int iEntity );
+	void	WriteChangedEntities();
+
+	const DemoAnalyzerOptions_t &m_Options;
+	CDemoNetChannel			m_NetChannel;
+	CNetworkStringTableContainer *m_pStringTables;
+	CColumnFile				*m_pOutput;
+	CColumnTable			*m_pEntityOutput;
+
+	int						m_nDemoProtocol;
+	int						m_nServerTick;
+	int						m_nServerClassBits;
+	bool					m_bDecodersReady;
+
+	CUtlVector< ServerClass_t >		m_ServerClasses;
+	CUtlVector< EventDescriptor_t >	m_Events;
+	int						m_EventLookup[1 << MAX_EVENT_BITS];	// event id -> index in m_Events
+	CUtlVector< Frame_t >			m_Frames;
+	Entity_t				m_Entities[MAX_EDICTS];
+	Baseline_t				m_Baselines[2][MAX_EDICTS];
+};
+
+// Gives up on the demo being decoded after a fatal error in the engine code, the
+// analyzer moves on to the next one. Exits if no demo is being decoded.
+void DemoAnalyzer_AbortDemo();
+
+#endif // DEMODECODER_H
@@ -0,0 +1,419 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: RecvTables for the demo analyzer.
+//
+//			The engine builds its decoders by matching the SendTables in the demo
+//			against the client dll's RecvTables. The analyzer has no client dll, so it
+//			provides DataTable_SetupReceiveTableFromSendTable itself and makes a
+//			RecvTable for each SendTable as it comes in. Once all of them are in, the
+//			tables are linked, laid out and handed to RecvTable_CreateDecoders as usual.
+//
+//=============================================================================//
+
+#include "dt_recv_eng.h"
+#include "dt_recv_decoder.h"
+#include "dt_common_eng.h"
+#include "dt_stack.h"
+#include "utllinkedlist.h"
+#include "tier1/strtools.h"
+#include "demorecvtables.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+extern CUtlLinkedList< CClientSendTable*, unsigned short > g_ClientSendTables;
+extern CUtlLinkedList< CRecvDecoder *, unsigned short > g_RecvDecoders;
+
+
+class CDemoRecvTable
+{
+public:
+	CDemoRecvTable();
+	~CDemoRecvTable();
+
+	RecvTable			m_Table;
+	RecvProp			*m_pProps;
+
+	// For DPT_DataTable props, the name of the child table
+	CUtlVector< char * >	m_DataTableNames;
+
+	CClientSendTable	*m_pClientSendTable;
+	bool				m_bNeedsDecoder;
+
+	int					m_nSize;		// -1 until laid out
+	bool				m_bLayingOut;	// catches tables that contain themselves
+};
+
+static CUtlVector< CDemoRecvTable * > g_DemoRecvTables;
+
+
+// Names go through delete[] when the engine frees the client send tables
+static char *StringCopy( const char *pString )
+{
+	int len = Q_strlen( pString ) + 1;
+	char *pCopy = new char[ len ];
+	Q_strncpy( pCopy, pString, len );
+	return pCopy;
+}
+
+CDemoRecvTable::CDemoRecvTable()
+{
+	m_pProps = NULL;
+	m_pClientSendTable = NULL;
+	m_bNeedsDecoder = false;
+	m_nSize = -1;
+	m_bLayingOut = false;
+}
+
+CDemoRecvTable::~CDemoRecvTable()
+{
+	for ( int i = 0; i < m_Table.m_nProps; i++ )
+	{
+		delete [] m_pProps[i].m_pVarName;
+		delete [] m_DataTableNames[i];
+	}
+
+	delete [] m_pProps;
+	delete [] m_Table.m_pNetTableName;
+}
+
+
+static CDemoRecvTable *FindDemoRecvTable( RecvTable *pTable )
+{
+	for ( int i = 0; i < g_DemoRecvTables.Count(); i++ )
+	{
+		if ( &g_DemoRecvTables[i]->m_Table == pTable )
+			return g_DemoRecvTables[i];
+	}
+	return NULL;
+}
+
+RecvTable *DemoRecvTables_Find( const char *pName )
+{
+	for ( int i = 0; i < g_DemoRecvTables.Count(); i++ )
+	{
+		if ( !Q_stricmp( g_DemoRecvTables[i]->m_Table.GetName(), pName ) )
+			return &g_DemoRecvTables[i]->m_Table;
+	}
+	return NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+// Called by RecvTable_RecvClassInfos for each SendTable in the demo. Stores the
+// SendTable like the engine does and makes a RecvTable with the same props.
+//-----------------------------------------------------------------------------
+bool DataTable_SetupReceiveTableFromSendTable( SendTable *sendTable, bool bNeedsDecoder )
+{
+	CClientSendTable *pClientSendTable = new CClientSendTable;
+	SendTable *pTable = &pClientSendTable->m_SendTable;
+	g_ClientSendTables.AddToTail( pClientSendTable );
+
+	pTable->m_pNetTableName = StringCopy( sendTable->m_pNetTableName );
+
+	pTable->m_nProps = sendTable->m_nProps;
+	pTable->m_pProps = pTable->m_nProps ? new SendProp[ pTable->m_nProps ] : 0;
+	pClientSendTable->m_Props.SetSize( pTable->m_nProps );
+
+	CDemoRecvTable *pRecvTable = new CDemoRecvTable;
+	g_DemoRecvTables.AddToTail( pRecvTable );
+	pRecvTable->m_pClientSendTable = pClientSendTable;
+	pRecvTable->m_bNeedsDecoder = bNeedsDecoder;
+
+	// Exclude props only matter to the server
+	int nRecvProps = 0;
+	for ( int iProp = 0; iProp < sendTable->m_nProps; iProp++ )
+	{
+		if ( sendTable->m_pProps[iProp].GetType() == DPT_DataTable || !sendTable->m_pProps[iProp].IsExcludeProp() )
+			nRecvProps++;
+	}
+
+	pRecvTable->m_pProps = nRecvProps ? new RecvProp[ nRecvProps ] : NULL;
+	pRecvTable->m_DataTableNames.SetCount( nRecvProps );
+	pRecvTable->m_DataTableNames.FillWithValue( NULL );
+	pRecvTable->m_Table.Construct( pRecvTable->m_pProps, nRecvProps, StringCopy( sendTable->m_pNetTableName ) );
+
+	int iRecvProp = 0;
+	for ( int iProp=0; iProp < pTable->m_nProps; iProp++ )
+	{
+		CClientSendProp *pClientProp = &pClientSendTable->m_Props[iProp];
+		SendProp *pProp = &pTable->m_pProps[iProp];
+		const SendProp *pSendTableProp = &sendTable->m_pProps[ iProp ];
+
+		pProp->m_Type = (SendPropType)pSendTableProp->m_Type;
+		pProp->m_pVarName = StringCopy( pSendTableProp->GetName() );
+		pProp->SetFlags( pSendTableProp->GetFlags() );
+
+		if ( pProp->m_Type == DPT_DataTable )
+		{
+			const char *pDTName = pSendTableProp->m_pExcludeDTName; // HACK
+
+			if ( pSendTableProp->GetDataTable() )
+				pDTName = pSendTableProp->GetDataTable()->m_pNetTableName;
+
+			Assert( pDTName && Q_strlen(pDTName) > 0 );
+
+			pClientProp->SetTableName( StringCopy( pDTName ) );
+			pProp->SetDataTableProxyFn( pSendTableProp->GetDataTableProxyFn() );
+			pProp->SetOffset( pSendTableProp->GetOffset() );
+		}
+		else
+		{
+			if ( pProp->IsExcludeProp() )
+			{
+				pProp->m_pExcludeDTName = StringCopy( pSendTableProp->GetExcludeDTName() );
+				continue;
+			}
+			else if ( pProp->GetType() == DPT_Array )
+			{
+				pProp->SetNumElements( pSendTableProp->GetNumElements() );
+			}
+			else
+			{
+				pProp->m_fLowValue = pSendTableProp->m_fLowValue;
+				pProp->m_fHighValue = pSendTableProp->m_fHighValue;
+				pProp->m_nBits = pSendTableProp->m_nBits;
+			}
+		}
+
+		// The matching RecvProp, storage is assigned once all tables are in
+		RecvProp *pRecvProp = &pRecvTable->m_pProps[ iRecvProp ];
+		iRecvProp++;
+
+		pRecvProp->m_pVarName = StringCopy( pSendTableProp->GetName() );
+		pRecvProp->m_RecvType = pProp->m_Type;
+		pRecvProp->m_Flags = pProp->GetFlags();
+
+		switch ( pProp->m_Type )
+		{
+		case DPT_Int:
+			pRecvProp->SetProxyFn( RecvProxy_Int32ToInt32 );
+			break;
+		case DPT_Float:
+			pRecvProp->SetProxyFn( RecvProxy_FloatToFloat );
+			break;
+		case DPT_Vector:
+			pRecvProp->SetProxyFn( RecvProxy_VectorToVector );
+			break;
+		case DPT_VectorXY:
+			pRecvProp->SetProxyFn( RecvProxy_VectorXYToVectorXY );
+			break;
+		case DPT_String:
+			pRecvProp->m_StringBufferSize = DT_MAX_STRING_BUFFERSIZE;
+			pRecvProp->SetProxyFn( RecvProxy_StringToString );
+			break;
+		case DPT_Array:
+			pRecvProp->SetNumElements( pProp->GetNumElements() );
+			break;
+		case DPT_DataTable:
+			pRecvTable->m_DataTableNames[ iRecvProp - 1 ] = StringCopy( pClientProp->GetTableName() );
+			pRecvProp->SetDataTableProxyFn( DataTableRecvProxy_StaticDataTable );
+			break;
+		default:
+			Warning( "%s: unknown type %d for prop %s\n", pTable->m_pNetTableName, pProp->m_Type, pProp->GetName() );
+			return false;
+		}
+	}
+
+	Assert( iRecvProp == nRecvProps );
+	return true;
+}
+
+
+static int GetPropSize( const RecvProp *pProp )
+{
+	switch ( pProp->GetType() )
+	{
+	case DPT_Vector:	return 3 * sizeof( float );
+	case DPT_VectorXY:	return 2 * sizeof( float );
+	case DPT_String:	return DT_MAX_STRING_BUFFERSIZE;
+	default:			return sizeof( int );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Assigns offsets to the props of a table. Collapsible datatables (base classes)
+// don't get a proxy call while decoding, their props are read relative to the
+// parent, so they sit at offset 0 and the table's own props follow them.
+//-----------------------------------------------------------------------------
+static bool LayoutTable_R( CDemoRecvTable *pDemoTable )
+{
+	if ( pDemoTable->m_nSize >= 0 )
+		return true;
+
+	RecvTable *pTable = &pDemoTable->m_Table;
+	if ( pDemoTable->m_bLayingOut )
+	{
+		Warning( "Table %s contains itself\n", pTable->GetName() );
+		return false;
+	}
+	pDemoTable->m_bLayingOut = true;
+
+	int nSize = 0;
+	bool bCollapsed = false;
+	for ( int i = 0; i < pTable->GetNumProps(); i++ )
+	{
+		RecvProp *pProp = pTable->GetProp( i );
+		if ( pProp->GetType() != DPT_DataTable || !( pProp->GetFlags() & SPROP_COLLAPSIBLE ) )
+			continue;
+
+		CDemoRecvTable *pChild = FindDemoRecvTable( pProp->GetDataTable() );
+		if ( !LayoutTable_R( pChild ) )
+			return false;
+
+		if ( bCollapsed )
+		{
+			DevWarning( "%s: more than one collapsible table, %s shares its storage\n", pTable->GetName(), pChild->m_Table.GetName() );
+		}
+
+		pProp->SetOffset( 0 );
+		nSize = MAX( nSize, pChild->m_nSize );
+		bCollapsed = true;
+	}
+
+	for ( int i = 0; i < pTable->GetNumProps(); i++ )
+	{
+		RecvProp *pProp = pTable->GetProp( i );
+		int nPropSize;
+
+		if ( pProp->GetFlags() & SPROP_INSIDEARRAY )
+		{
+			// Array elements are placed by the array
+			pProp->SetOffset( 0 );
+			continue;
+		}
+
+		if ( pProp->GetType() == DPT_DataTable )
+		{
+			if ( pProp->GetFlags() & SPROP_COLLAPSIBLE )
+				continue;
+
+			CDemoRecvTable *pChild = FindDemoRecvTable( pProp->GetDataTable() );
+			if ( !LayoutTable_R( pChild ) )
+				return false;
+
+			nPropSize = pChild->m_nSize;
+		}
+		else if ( pProp->GetType() == DPT_Array )
+		{
+			if ( i == 0 )
+			{
+				Warning( "%s: array prop %s is at index zero\n", pTable->GetName(), pProp->GetName() );
+				return false;
+			}
+
+			int nStride = GetPropSize( pTable->GetProp( i - 1 ) );
+			pProp->InitArray( pProp->GetNumElements(), nStride );
+			nPropSize = pProp->GetNumElements() * nStride;
+		}
+		else
+		{
+			nPropSize = GetPropSize( pProp );
+		}
+
+		pProp->SetOffset( nSize );
+		nSize += AlignValue( nPropSize, sizeof( int ) );
+	}
+
+	pDemoTable->m_nSize = nSize;
+	pDemoTable->m_bLayingOut = false;
+	return true;
+}
+
+bool DemoRecvTables_Init()
+{
+	// Point datatable props at their tables
+	for ( int iTable = 0; iTable < g_DemoRecvTables.Count(); iTable++ )
+	{
+		CDemoRecvTable *pDemoTable = g_DemoRecvTables[iTable];
+		for ( int i = 0; i < pDemoTable->m_Table.GetNumProps(); i++ )
+		{
+			const char *pChildName = pDemoTable->m_DataTableNames[i];
+			if ( !pChildName )
+				continue;
+
+			RecvTable *pChild = DemoRecvTables_Find( pChildName );
+			if ( !pChild )
+			{
+				Warning( "Missing table %s (referenced by %s)\n", pChildName, pDemoTable->m_Table.GetName() );
+				return false;
+			}
+
+			pDemoTable->m_Table.GetProp( i )->SetDataTable( pChild );
+		}
+	}
+
+	CUtlVector< RecvTable * > tables;
+	for ( int iTable = 0; iTable < g_DemoRecvTables.Count(); iTable++ )
+	{
+		if ( !LayoutTable_R( g_DemoRecvTables[iTable] ) )
+			return false;
+
+		tables.AddToTail( &g_DemoRecvTables[iTable]->m_Table );
+	}
+
+	if ( !RecvTable_Init( tables.Base(), tables.Count() ) )
+		return false;
+
+	// Same as the engine does when the class tables come in
+	for ( int iTable = 0; iTable < g_DemoRecvTables.Count(); iTable++ )
+	{
+		CDemoRecvTable *pDemoTable = g_DemoRecvTables[iTable];
+		if ( !pDemoTable->m_bNeedsDecoder )
+			continue;
+
+		CRecvDecoder *pDecoder = new CRecvDecoder;
+		g_RecvDecoders.AddToTail( pDecoder );
+
+		RecvTable *pRecvTable = &pDemoTable->m_Table;
+		pRecvTable->m_pDecoder = pDecoder;
+		pDecoder->m_pTable = pRecvTable;
+
+		pDecoder->m_pClientSendTable = pDemoTable->m_pClientSendTable;
+		pDecoder->m_Precalc.m_pSendTable = pDemoTable->m_pClientSendTable->GetSendTable();
+		pDemoTable->m_pClientSendTable->GetSendTable()->m_pPrecalc = &pDecoder->m_Precalc;
+
+		SetupArrayProps_R<RecvTable, RecvTable::PropType>( pRecvTable );
+	}
+
+	// Every SendProp has a RecvProp here, so a mismatch means a broken demo
+	return RecvTable_CreateDecoders( NULL, false );
+}
+
+void DemoRecvTables_Term()
+{
+	RecvTable_Term( true );
+	g_DemoRecvTables.PurgeAndDeleteElements();
+}
+
+int DemoRecvTables_GetSize( RecvTable *pTable )
+{
+	CDemoRecvTable *pDemoTable = FindDemoRecvTable( pTable );
+	return pDemoTable ? pDemoTable->m_nSize : 0;
+}
+
+void DemoRecvTables_GetPropOffsets( CRecvDecoder *pDecoder, CUtlVector< int > &offsets )
+{
+	int nSize = DemoRecvTables_GetSize( pDecoder->GetRecvTable() );
+	CUtlVector< unsigned char > scratch;
+	scratch.SetCount( MAX( nSize, 1 ) );
+
+	// Walk the datatable proxies the same way RecvTable_Decode does
+	CClientDatatableStack theStack( pDecoder, scratch.Base(), -1 );
+	theStack.Init();
+
+	offsets.SetCount( pDecoder->GetNumProps() );
+	for ( int i = 0; i < pDecoder->GetNumProps(); i++ )
+	{
+		theStack.SeekToProp( i );
+
+		const RecvProp *pProp = pDecoder->GetProp( i );
+		if ( !pProp || !theStack.IsCurProxyValid() )
+		{
+			offsets[i] = -1;
+			continue;
+		}
+
+		offsets[i] = (int)( theStack.GetCurStructBase() - scratch.Base() ) + pProp->GetOffset();
+	}
+}
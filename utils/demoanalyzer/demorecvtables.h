@@ -0,0 +1,38 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: RecvTables for the demo analyzer.
+//
+//			There's no client dll to provide RecvTables, so every SendTable the demo
+//			carries gets a RecvTable with the same props. Values are decoded into a flat
+//			block of memory per entity, laid out like a C struct of the table.
+//
+//=============================================================================//
+
+#ifndef DEMORECVTABLES_H
+#define DEMORECVTABLES_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier1/utlvector.h"
+
+class RecvTable;
+class CRecvDecoder;
+
+// Links the tables received through RecvTable_RecvClassInfos, lays out their storage and
+// creates decoders for the tables that need one
+bool		DemoRecvTables_Init();
+
+// Frees all tables and decoders, for the next demo
+void		DemoRecvTables_Term();
+
+RecvTable	*DemoRecvTables_Find( const char *pName );
+
+// Bytes of storage one object of this table decodes into
+int			DemoRecvTables_GetSize( RecvTable *pTable );
+
+// Offsets of the decoder's flat property list in the table's storage, -1 for props
+// that aren't received
+void		DemoRecvTables_GetPropOffsets( CRecvDecoder *pDecoder, CUtlVector< int > &offsets );
+
+#endif // DEMORECVTABLES_H
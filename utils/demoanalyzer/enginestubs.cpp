@@ -0,0 +1,78 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Engine functions the linked engine files reference but that the
+//			demo analyzer has no use for, or handles its own way.
+//
+//=============================================================================//
+
+#include "tier0/dbg.h"
+#include "tier1/strtools.h"
+#include "tier1/bitbuf.h"
+#include "baseclient.h"
+#include "demodecoder.h"
+#include <stdarg.h>
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+// A broken demo, the analyzer gives up on it and goes on with the next one
+void Host_Error( const char *error, ... )
+{
+	va_list argptr;
+	char string[1024];
+
+	va_start( argptr, error );
+	Q_vsnprintf( string, sizeof( string ), error, argptr );
+	va_end( argptr );
+
+	Warning( "%s", string );
+	DemoAnalyzer_AbortDemo();
+}
+
+void Host_EndGame( bool bShowMainMenu, const char *message, ... )
+{
+	va_list argptr;
+	char string[1024];
+
+	va_start( argptr, message );
+	Q_vsnprintf( string, sizeof( string ), message, argptr );
+	va_end( argptr );
+
+	Warning( "%s", string );
+	DemoAnalyzer_AbortDemo();
+}
+
+void Sys_Error( const char *error, ... )
+{
+	va_list argptr;
+	char string[1024];
+
+	va_start( argptr, error );
+	Q_vsnprintf( string, sizeof( string ), error, argptr );
+	va_end( argptr );
+
+	Warning( "%s", string );
+	DemoAnalyzer_AbortDemo();
+}
+
+// Rotates through a bunch of string buffers, like the engine's
+char *tmpstr512()
+{
+	static char	string[32][512];
+	static int	curstring = 0;
+	curstring = ( curstring + 1 ) & 31;
+	return string[curstring];
+}
+
+const char *GetObjectClassName( int objectID )
+{
+	return "[demo entity]";
+}
+
+void CBaseClient::TraceNetworkData( bf_write &msg, char const *fmt, ... )
+{
+}
+
+void CBaseClient::TraceNetworkMsg( int nBits, char const *fmt, ... )
+{
+}